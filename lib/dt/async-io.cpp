@@ -0,0 +1,154 @@
+/* This file is part of Daedalus Turbo project: https://github.com/sierkov/daedalus-turbo/
+ * Copyright (c) 2022-2023 Alex Sierkov (alex dot sierkov at gmail dot com)
+ * Copyright (c) 2024-2025 R2 Rationality OÜ (info at r2rationality dot com)
+ * This code is distributed under the license specified in:
+ * https://github.com/sierkov/daedalus-turbo/blob/main/LICENSE */
+
+#include <condition_variable>
+#include <cstdlib>
+#include <deque>
+#include <thread>
+#include <vector>
+#ifdef __clang__
+#   pragma GCC diagnostic push
+#   pragma GCC diagnostic ignored "-Wdeprecated-declarations"
+#endif
+#ifdef _MSC_VER
+#   include <SDKDDKVer.h>
+#endif
+#define BOOST_ASIO_HAS_STD_INVOKE_RESULT 1
+#include <boost/asio/io_context.hpp>
+#include <boost/asio/post.hpp>
+#include <boost/asio/steady_timer.hpp>
+#ifdef __clang__
+#   pragma GCC diagnostic pop
+#endif
+#include <dt/async-io.hpp>
+#include <dt/file.hpp>
+#include <dt/logger.hpp>
+#include <dt/mutex.hpp>
+
+namespace daedalus_turbo {
+    struct io_pool::impl {
+        explicit impl(const size_t num_threads)
+        {
+            if (num_threads == 0)
+                throw error("io_pool requires at least one thread");
+            for (size_t i = 0; i < num_threads; ++i)
+                _threads.emplace_back([this] { _run(); });
+        }
+
+        ~impl()
+        {
+            {
+                mutex::scoped_lock lk { _mutex };
+                _shutdown = true;
+            }
+            _cv.notify_all();
+            for (auto &t: _threads)
+                t.join();
+        }
+
+        size_t num_threads() const
+        {
+            return _threads.size();
+        }
+
+        void post(std::function<void ()> &&action)
+        {
+            {
+                mutex::scoped_lock lk { _mutex };
+                _actions.emplace_back(std::move(action));
+            }
+            _cv.notify_one();
+        }
+    private:
+        mutex::unique_lock::mutex_type _mutex alignas(mutex::alignment) {};
+        std::condition_variable_any _cv alignas(mutex::alignment) {};
+        std::deque<std::function<void ()>> _actions {};
+        bool _shutdown = false;
+        std::vector<std::thread> _threads {};
+
+        void _run()
+        {
+            for (;;) {
+                std::function<void ()> action {};
+                {
+                    mutex::unique_lock lk { _mutex };
+                    _cv.wait(lk, [&] { return _shutdown || !_actions.empty(); });
+                    // the queued actions are completed even on shutdown, since each of them continues a suspended task
+                    if (_actions.empty())
+                        break;
+                    action = std::move(_actions.front());
+                    _actions.pop_front();
+                }
+                logger::run_log_errors(action);
+            }
+        }
+    };
+
+    size_t io_pool::default_thread_count()
+    {
+        if (const char *env_threads_str = std::getenv("DT_IO_THREADS"); env_threads_str != nullptr) {
+            if (const size_t env_threads = std::stoul(env_threads_str); env_threads != 0)
+                return env_threads;
+        }
+        return 4;
+    }
+
+    io_pool &io_pool::get()
+    {
+        static io_pool pool {};
+        return pool;
+    }
+
+    io_pool::io_pool(const size_t num_threads): _impl { std::make_unique<impl>(num_threads) }
+    {
+    }
+
+    io_pool::~io_pool() =default;
+
+    size_t io_pool::num_threads() const
+    {
+        return _impl->num_threads();
+    }
+
+    scheduled_event<uint8_vector> io_pool::read(const std::string &path)
+    {
+        return run([path] {
+            return file::read<uint8_vector>(path);
+        });
+    }
+
+    scheduled_event<uint8_vector> io_pool::read_auto(const std::string &path)
+    {
+        return run([path] {
+            return file::read_auto(path);
+        });
+    }
+
+    void io_pool::post(std::function<void ()> &&action)
+    {
+        _impl->post(std::move(action));
+    }
+
+    namespace asio {
+        void post(worker &w, std::function<void ()> &&action)
+        {
+            boost::asio::post(w.io_context(), std::move(action));
+        }
+
+        scheduled_event<> sleep_for(worker &w, const std::chrono::milliseconds duration)
+        {
+            return event(w, [&w, duration](const auto &done) {
+                auto timer = std::make_shared<boost::asio::steady_timer>(w.io_context(), duration);
+                timer->async_wait([timer, done](const boost::system::error_code &ec) {
+                    if (ec)
+                        done.fail(std::make_exception_ptr(error(fmt::format("async sleep failed: {}", ec.message()))));
+                    else
+                        done();
+                });
+            });
+        }
+    }
+}
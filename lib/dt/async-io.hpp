@@ -0,0 +1,82 @@
+/* This file is part of Daedalus Turbo project: https://github.com/sierkov/daedalus-turbo/
+ * Copyright (c) 2022-2023 Alex Sierkov (alex dot sierkov at gmail dot com)
+ * Copyright (c) 2024-2025 R2 Rationality OÜ (info at r2rationality dot com)
+ * This code is distributed under the license specified in:
+ * https://github.com/sierkov/daedalus-turbo/blob/main/LICENSE */
+#ifndef DAEDALUS_TURBO_ASYNC_IO_HPP
+#define DAEDALUS_TURBO_ASYNC_IO_HPP
+
+#include <chrono>
+#include <functional>
+#include <memory>
+#include <string>
+#include <dt/asio.hpp>
+#include <dt/common/bytes.hpp>
+#include <dt/scheduler.hpp>
+
+namespace daedalus_turbo {
+    // A few threads for blocking file operations, so that coroutine tasks can wait for the disk
+    // without holding the scheduler's workers.
+    struct io_pool {
+        // 4 unless overridden with the DT_IO_THREADS environment variable
+        static size_t default_thread_count();
+        static io_pool &get();
+
+        explicit io_pool(size_t num_threads=default_thread_count());
+        ~io_pool();
+        size_t num_threads() const;
+
+        // Runs the action on a pool thread; the awaiting coroutine continues with its result or exception.
+        template<typename F>
+        auto run(F &&action) -> scheduled_event<std::invoke_result_t<std::decay_t<F> &>>
+        {
+            using result_type = std::invoke_result_t<std::decay_t<F> &>;
+            return scheduled_event<result_type> { [this, action=std::forward<F>(action)](const auto &done) {
+                post([action, done]() mutable {
+                    try {
+                        if constexpr (std::is_void_v<result_type>) {
+                            action();
+                            done();
+                        } else {
+                            done(action());
+                        }
+                    } catch (...) {
+                        done.fail(std::current_exception());
+                    }
+                });
+            } };
+        }
+
+        // runs the action on a pool thread without waiting for it; errors are logged
+        void post(std::function<void ()> &&action);
+        scheduled_event<uint8_vector> read(const std::string &path);
+        // decompresses .zstd files like file::read_auto
+        scheduled_event<uint8_vector> read_auto(const std::string &path);
+    private:
+        struct impl;
+        std::unique_ptr<impl> _impl;
+    };
+
+    namespace asio {
+        extern void post(worker &w, std::function<void ()> &&action);
+        extern scheduled_event<> sleep_for(worker &w, std::chrono::milliseconds duration);
+
+        // Continues the awaiting coroutine once the handlers started by start on the worker's event loop call the completion.
+        // Meant for network operations, which are best left to the event loop.
+        template<typename T=void>
+        scheduled_event<T> event(worker &w, std::function<void (const typename scheduled_event<T>::completion &)> &&start)
+        {
+            return scheduled_event<T> { [&w, start=std::move(start)](const auto &done) {
+                post(w, [start, done] {
+                    try {
+                        start(done);
+                    } catch (...) {
+                        done.fail(std::current_exception());
+                    }
+                });
+            } };
+        }
+    }
+}
+
+#endif // !DAEDALUS_TURBO_ASYNC_IO_HPP
@@ -0,0 +1,60 @@
+/* This file is part of Daedalus Turbo project: https://github.com/sierkov/daedalus-turbo/
+ * Copyright (c) 2022-2023 Alex Sierkov (alex dot sierkov at gmail dot com)
+ * Copyright (c) 2024-2025 R2 Rationality OÜ (info at r2rationality dot com)
+ * This code is distributed under the license specified in:
+ * https://github.com/sierkov/daedalus-turbo/blob/main/LICENSE */
+
+#include <dt/async-io.hpp>
+#include <dt/common/test.hpp>
+#include <dt/file.hpp>
+
+using namespace daedalus_turbo;
+
+namespace {
+    coro::task<size_t> read_size(const std::string path)
+    {
+        const auto data = co_await io_pool::get().read(path);
+        co_return data.size();
+    }
+
+    coro::task<> sleep_and_count(std::atomic_size_t &num_done)
+    {
+        co_await asio::sleep_for(*asio::worker::get(), std::chrono::milliseconds { 100 });
+        ++num_done;
+    }
+}
+
+suite async_io_suite = [] {
+    "async_io"_test = [] {
+        "io_pool read"_test = [] {
+            file::tmp tmp { "async-io-read.txt" };
+            file::write(tmp.path(), std::string_view { "Hello, async world!\n" });
+            scheduler s { 2 };
+            static const auto tg = scheduler::group_id("async-read");
+            size_t total = 0;
+            s.on_result<size_t>(tg, [&](size_t &&res) {
+                total += res;
+            });
+            for (size_t i = 0; i < 16; ++i)
+                s.submit_coro(tg, 100, read_size(tmp.path()));
+            s.process();
+            test_same(16 * 20, total);
+        };
+        "io_pool errors"_test = [] {
+            scheduler s { 2 };
+            s.submit_coro(scheduler::group_id("async-read-missing"), 100, read_size("/non-existing/async-io.txt"));
+            expect(!s.process_ok());
+        };
+        "asio sleep"_test = [] {
+            scheduler s { 2 };
+            std::atomic_size_t num_done { 0 };
+            const auto start = std::chrono::system_clock::now();
+            for (size_t i = 0; i < 16; ++i)
+                s.submit_coro(scheduler::group_id("async-sleep"), 100, sleep_and_count(num_done));
+            s.process();
+            test_same(16, num_done.load());
+            // all sleeps overlap since none of them holds a worker
+            expect(std::chrono::system_clock::now() - start < std::chrono::seconds { 1 });
+        };
+    };
+};
@@ -240,11 +240,13 @@ namespace daedalus_turbo::cardano::ledger::conway {
         _apply_conway_params(_params);
         _params_prev = _params;
         static const std::string task_name { "conway-update-utxos" };
-        _sched.wait_all_done(task_name, txo_map::num_parts,
+        _sched.wait_all_done(task_name, _utxo.num_parts,
             [&] {
-                for (size_t part_idx = 0; part_idx < txo_map::num_parts; ++part_idx) {
+                for (size_t part_idx = 0; part_idx < _utxo.num_parts; ++part_idx) {
                     _sched.submit_void(task_name, 1000, [this, part_idx] {
                         auto &utxo_part = _utxo.partition(part_idx);
+                        // the stored values are immutable, so the updated ones are collected first
+                        vector<utxo_store::partition_type::value_type> updated {};
                         for (auto &&[txo_id, txo_data]: utxo_part) {
                             if (const auto addr = txo_data.addr(); addr.has_pointer()) {
                                 const auto ptr = addr.pointer();
@@ -255,9 +257,12 @@ namespace daedalus_turbo::cardano::ledger::conway {
                                     txo_data.address_raw.resize(29);
                                     txo_data.address_raw << uint8_t { 0 } << uint8_t { 0 } << uint8_t { 0 };
                                     logger::debug("conway-start: txo_id: {} updated address {} => {}", txo_id, old_addr, txo_data.address_raw);
+                                    updated.emplace_back(txo_id, std::move(txo_data));
                                 }
                             }
                         }
+                        for (const auto &[txo_id, txo_data]: updated)
+                            utxo_part.insert_or_assign(txo_id, txo_data);
                     });
                 }
             }
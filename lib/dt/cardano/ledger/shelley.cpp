@@ -176,8 +176,8 @@ namespace daedalus_turbo::cardano::ledger::shelley {
         });
     }
 
-    state::state(const cardano::config &cfg, scheduler &sched):
-        _cfg { cfg }, _sched { sched }, _utxo { _cfg.byron_utxos }
+    state::state(const cardano::config &cfg, scheduler &sched, const utxo_store_config_ptr &utxo_cfg):
+        _cfg { cfg }, _sched { sched }, _utxo { _cfg.byron_utxos, utxo_cfg }
     {
     }
 
@@ -449,25 +449,22 @@ namespace daedalus_turbo::cardano::ledger::shelley {
         }
     }
 
-    const tx_out_data *state::utxo_find(const tx_out_ref &txo_id)
+    std::optional<tx_out_data> state::utxo_find(const tx_out_ref &txo_id)
     {
-        if (const auto it = _utxo.find(txo_id);it != _utxo.end()) [[likely]]
-            return &it->second;
-        return nullptr;
+        return _utxo.find(txo_id);
     }
 
     void state::utxo_add(const cardano::tx_out_ref &txo_id, cardano::tx_out_data &&txo_data)
     {
         if (!txo_data.empty()) [[likely]] {
-            auto [it, created] = _utxo.try_emplace(txo_id, std::move(txo_data));
-            if (!created)
-                logger::warn("a non-unique TXO {}!", it->first);
+            if (!_utxo.try_emplace(txo_id, txo_data))
+                logger::warn("a non-unique TXO {}!", txo_id);
         }
     }
 
     void state::utxo_del(const cardano::tx_out_ref &txo_id)
     {
-        if (const size_t num_del = _utxo.erase(txo_id); num_del != 1)
+        if (!_utxo.erase(txo_id))
             throw error(fmt::format("request to remove an unknown TXO {}!", txo_id));
     }
 
@@ -590,9 +587,9 @@ namespace daedalus_turbo::cardano::ledger::shelley {
         mutex::unique_lock::mutex_type all_mutex alignas(mutex::alignment) {};
         stake_update_map all_deltas {};
         pointer_update_map all_pointer_deltas {};
-        _sched.wait_all_done(task_group, txo_map::num_parts,
+        _sched.wait_all_done(task_group, _utxo.num_parts,
             [&] {
-                for (size_t part_idx = 0; part_idx < txo_map::num_parts; ++part_idx) {
+                for (size_t part_idx = 0; part_idx < _utxo.num_parts; ++part_idx) {
                     _sched.submit_void(task_group, 1000, [this, part_idx, &utxo_updates, &all_mutex, &all_deltas, &all_pointer_deltas] {
                         stake_update_map deltas {};
                         pointer_update_map pointer_deltas {};
@@ -607,17 +604,16 @@ namespace daedalus_turbo::cardano::ledger::shelley {
                                     else if (addr.has_pointer()) [[unlikely]]
                                         pointer_deltas[addr.pointer()] += static_cast<int64_t>(txo_data.coin);
                                     if (!txo_data.empty()) [[likely]] {
-                                        if (auto [it, created] = utxo_part.try_emplace(txo_id, std::move(txo_data)); !created) [[unlikely]]
-                                            logger::warn("a non-unique TXO {}!", it->first);
+                                        if (!utxo_part.try_emplace(txo_id, txo_data)) [[unlikely]]
+                                            logger::warn("a non-unique TXO {}!", txo_id);
                                     }
                                 } else {
-                                    if (auto it = utxo_part.find(txo_id); it != utxo_part.end()) [[likely]] {
-                                        const auto addr = it->second.addr();
+                                    if (const auto prev_data = utxo_part.extract(txo_id); prev_data) [[likely]] {
+                                        const auto addr = prev_data->addr();
                                         if (addr.has_stake_id()) [[likely]]
-                                            _update_stake_delta(deltas, addr.stake_id(), -static_cast<int64_t>(it->second.coin));
+                                            _update_stake_delta(deltas, addr.stake_id(), -static_cast<int64_t>(prev_data->coin));
                                         else if (addr.has_pointer()) [[unlikely]]
-                                            pointer_deltas[addr.pointer()] -= static_cast<int64_t>(it->second.coin);
-                                        utxo_part.erase(it);
+                                            pointer_deltas[addr.pointer()] -= static_cast<int64_t>(prev_data->coin);
                                     } else {
                                         throw error(fmt::format("request to remove an unknown TXO {}!", txo_id));
                                     }
@@ -681,12 +677,7 @@ namespace daedalus_turbo::cardano::ledger::shelley {
         _sched.wait_all_done(task_group, _utxo.num_parts, [&] {
             for (size_t pi = 0; pi < _utxo.num_parts; ++pi) {
                 _sched.submit_void(task_group, 1000, [&, pi] {
-                    uint64_t part_balance = 0;
-                    const auto &part = _utxo.partition(pi);
-                    for (const auto &[txo_id, txo_data]: part) {
-                        part_balance += txo_data.coin;
-                    }
-                    total_balance.fetch_add(part_balance, std::memory_order_relaxed);
+                    total_balance.fetch_add(_utxo.partition(pi).balance(), std::memory_order_relaxed);
                 });
             }
         });
@@ -1121,9 +1112,8 @@ namespace daedalus_turbo::cardano::ledger::shelley {
             for (size_t pi = 0; pi < _utxo.num_parts; ++pi) {
                 _sched.submit_void(task_group, 1000, [&, pi] {
                     uint64_t part_balance = 0;
-                    auto &part = _utxo.partition(pi);
-                    for (auto it = part.begin(), end = part.end(); it != end; ) {
-                        const auto &txo_data = it->second;
+                    _utxo.partition(pi).erase_if([&](const auto &item) {
+                        const auto &txo_data = item.second;
                         if (txo_data.address_raw.at(0) == 0x82) {
                             auto crc_v = cbor::zero2::parse(txo_data.address_raw);
                             auto &crc_v_it = crc_v.get().array();
@@ -1133,12 +1123,11 @@ namespace daedalus_turbo::cardano::ledger::shelley {
                             addr_v_it.skip(2);
                             if (addr_v_it.read().uint() == 2) {
                                 part_balance += txo_data.coin;
-                                it = part.erase(it);
-                                continue;
+                                return true;
                             }
                         }
-                        ++it;
-                    }
+                        return false;
+                    });
                     total_balance.fetch_add(part_balance, std::memory_order_relaxed);
                 });
             }
@@ -1399,19 +1388,16 @@ namespace daedalus_turbo::cardano::ledger::shelley {
                 }
                 // remove empty UTXO entries
                 static const std::string task_name { "shelley-remove-empty-utxos" };
-                _sched.wait_all_done(task_name, txo_map::num_parts,
+                _sched.wait_all_done(task_name, _utxo.num_parts,
                     [&] {
-                        for (size_t part_idx = 0; part_idx < txo_map::num_parts; ++part_idx) {
+                        for (size_t part_idx = 0; part_idx < _utxo.num_parts; ++part_idx) {
                             _sched.submit_void(task_name, 1000, [this, part_idx] {
-                                auto &utxo_part = _utxo.partition(part_idx);
-                                for (auto it = utxo_part.begin(); it != utxo_part.end();) {
-                                    if (it->second.coin) [[likely]] {
-                                        ++it;
-                                    } else {
-                                        logger::debug("removed empty UTXO {}", it->first);
-                                        it = utxo_part.erase(it);
-                                    }
-                                }
+                                _utxo.partition(part_idx).erase_if([](const auto &item) {
+                                    if (item.second.coin) [[likely]]
+                                        return false;
+                                    logger::debug("removed empty UTXO {}", item.first);
+                                    return true;
+                                });
                             });
                         }
                     }
@@ -1662,8 +1648,7 @@ namespace daedalus_turbo::cardano::ledger::shelley {
     void state::_node_load_utxo_state(cbor::zero2::value &v)
     {
         auto &it = v.array();
-        _utxo.clear();
-        _utxo = map_from_cbor<decltype(_utxo)>(it.read());
+        _utxo = utxo_store::from_cbor(it.read(), _utxo.config());
         _deposited = it.read().uint();
         _fees_utxo = it.read().uint();
         {
@@ -1984,13 +1969,7 @@ namespace daedalus_turbo::cardano::ledger::shelley {
         });
         for (size_t pi = 0; pi < _utxo.num_parts; ++pi) {
             _add_encode_task(ser, [this, pi](auto &enc) {
-                const auto &part = _utxo.partition(pi);
-                for (const auto &[txo_id, txo_data]: part) {
-                    enc.array(2)
-                        .bytes(txo_id.hash)
-                        .uint(txo_id.idx);
-                    txo_data.to_cbor(enc);
-                }
+                _utxo.partition(pi).to_cbor(enc);
             });
         }
         _add_encode_task(ser, [this] (auto &enc) {
@@ -2147,7 +2126,9 @@ namespace daedalus_turbo::cardano::ledger::shelley {
         v(_active_pool_dist);
         v(_active_inv_delegs);
 
-        v(_accounts);
+        // a chunk per partition so that delta snapshots skip the unchanged ones
+        for (size_t pi = 0; pi < _accounts.num_parts; ++pi)
+            v(_accounts.partition(pi));
 
         v(_epoch);
         v(_blocks_current);
@@ -2202,9 +2183,14 @@ namespace daedalus_turbo::cardano::ledger::shelley {
     void state::to_zpp(zpp_encoder &sec) const
     {
         _visit([&](const auto &obj) {
-           sec.add([&](auto) {
-               return zpp::serialize(obj);
-           });
+            using T = std::decay_t<decltype(obj)>;
+            sec.add([&](const zpp_options opts) {
+                if constexpr (std::is_same_v<T, utxo_store::partition_type>) {
+                    if (opts.delta)
+                        return zpp::serialize(obj.delta());
+                }
+                return zpp::serialize(obj);
+            });
         });
     }
 
@@ -2213,6 +2199,12 @@ namespace daedalus_turbo::cardano::ledger::shelley {
         _visit([&](auto &obj) {
             using T = std::decay_t<decltype(obj)>;
             dec.add([&](const auto b) {
+                if constexpr (std::is_same_v<T, utxo_store::partition_type>) {
+                    if (dec.options().delta) {
+                        const_cast<T &>(obj).apply(zpp::deserialize<utxo_store::partition_delta>(b));
+                        return;
+                    }
+                }
                 zpp::deserialize(const_cast<T &>(obj), b);
             });
         });
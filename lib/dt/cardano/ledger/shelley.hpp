@@ -10,6 +10,7 @@
 #include <dt/cardano/common/cert.hpp>
 #include <dt/cardano/shelley/block.hpp>
 #include <dt/cardano/ledger/types.hpp>
+#include <dt/cardano/ledger/utxo-store.hpp>
 #include <dt/parallel/encoder.hpp>
 #include <dt/index/vrf.hpp>
 
@@ -98,7 +99,7 @@ namespace daedalus_turbo::cardano::ledger::shelley {
     };
 
     struct state {
-        state(const cardano::config &cfg, scheduler &sched);
+        state(const cardano::config &cfg, scheduler &sched, const utxo_store_config_ptr &utxo_cfg=utxo_store_config::get());
         virtual ~state() =default;
 
         virtual point from_cbor(cbor::zero2::value &v);
@@ -126,7 +127,7 @@ namespace daedalus_turbo::cardano::ledger::shelley {
         virtual void instant_reward_reserves(const stake_ident &stake_id, uint64_t reward);
         virtual void instant_reward_treasury(const stake_ident &stake_id, uint64_t reward);
 
-        virtual const tx_out_data *utxo_find(const tx_out_ref &txo_id);
+        virtual std::optional<tx_out_data> utxo_find(const tx_out_ref &txo_id);
         virtual void utxo_add(const tx_out_ref &txo_id, tx_out_data &&txo_data);
         virtual void utxo_del(const tx_out_ref &txo_id);
         virtual uint64_t utxo_balance() const;
@@ -190,7 +191,7 @@ namespace daedalus_turbo::cardano::ledger::shelley {
         uint64_t _fees_next_reward = 0;
 
         //// stateBefore.utxoState
-        txo_map _utxo {};
+        utxo_store _utxo {};
         uint64_t _deposited = 0;
         uint64_t _delta_fees = 0;
         uint64_t _fees_utxo = 0;
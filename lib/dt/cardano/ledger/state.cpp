@@ -20,9 +20,9 @@
 #endif
 
 namespace daedalus_turbo::cardano::ledger {
-    state::state(const cardano::config &cfg, scheduler &sched):
-        _cfg { cfg }, _sched { sched },
-        _state { std::make_unique<shelley::state>(_cfg, _sched) },
+    state::state(const cardano::config &cfg, scheduler &sched, const utxo_store_config_ptr &utxo_cfg):
+        _cfg { cfg }, _sched { sched }, _utxo_cfg { utxo_cfg },
+        _state { std::make_unique<shelley::state>(_cfg, _sched, _utxo_cfg) },
         _vrf_state { std::make_unique<shelley::vrf_state>(_cfg) }
     {
     }
@@ -135,10 +135,10 @@ namespace daedalus_turbo::cardano::ledger {
         _vrf_state->to_cbor(ser);
     }
 
-    cbor_encoder state::to_cbor(const point &tip, const int prio) const
+    cbor_encoder state::_node_encoder(const point &tip) const
     {
-        timer t { "serialize the state into the Cardano Node format", logger::level::info };
-        cbor_encoder ser { [&] { return era_encoder { era_from_number(_eras.size()) }; } };
+        const auto era = era_from_number(_eras.size());
+        cbor_encoder ser { [era] { return era_encoder { era }; } };
         ser.add([](auto enc) {
             enc.array(2); // versioned encoding tuple
             enc.uint(1); // version number
@@ -147,33 +147,71 @@ namespace daedalus_turbo::cardano::ledger {
         });
         _serialize_node_state(ser, tip);
         _serialize_node_vrf_state(ser, tip);
+        return ser;
+    }
+
+    cbor_encoder state::to_cbor(const point &tip, const int prio) const
+    {
+        timer t { "serialize the state into the Cardano Node format", logger::level::info };
+        auto ser = _node_encoder(tip);
         ser.run(_sched, "ledger-export", prio, true);
         return ser;
     }
 
     void state::save_node(const std::string &path, const point &tip, const int prio) const
     {
-        const auto ser = to_cbor(tip, prio);
-        timer t { "write the serialized node state to a file", logger::level::info };
-        ser.save(path, false);
+        timer t { "serialize the state into the Cardano Node format and write it to a file", logger::level::info };
+        // the encoded chunks are written as soon as they are contiguous, so the whole export is never in memory
+        auto ser = _node_encoder(tip);
+        ser.run_save(_sched, "ledger-export", path, prio, true);
         progress::get().update("ledger-export", 1, 1);
     }
 
-    void state::load_zpp(const std::string &path)
+    void state::load_zpp(const std::string &path, const bool as_base)
+    {
+        _zpp_base.reset();
+        _load_zpp(path, false, as_base);
+    }
+
+    void state::load_zpp(const std::string &base_path, const std::string &delta_path, const bool as_base)
+    {
+        load_zpp(base_path, as_base);
+        _load_zpp(delta_path, true, false);
+    }
+
+    void state::_load_zpp(const std::string &path, const bool delta, const bool as_base)
     {
         try {
-            parallel_decoder dec { path };
-            zpp::deserialize(_subchains, dec.at(0));
+            const auto base_end_offset = end_offset();
+            parallel_decoder dec { path, zpp_options { delta } };
+            if (!dec.unchanged(0))
+                zpp::deserialize(_subchains, dec.at(0));
             dec.add([&](const auto) {
                 // do nothing as the field has been already decoded above
             });
-            zpp::deserialize(_eras, dec.at(1));
+            if (delta) {
+                if (const auto delta_base = zpp::deserialize<uint64_t>(dec.at(dec.size() - 1)); delta_base != base_end_offset) [[unlikely]]
+                    throw error(fmt::format("the delta has been saved against the state at {} but the loaded one is at {}", delta_base, base_end_offset));
+                if (!dec.unchanged(1)) {
+                    auto eras = zpp::deserialize<era_list>(dec.at(1));
+                    if (eras.size() != _eras.size()) [[unlikely]]
+                        throw error(fmt::format("the delta has {} eras while its base has {}", eras.size(), _eras.size()));
+                    _eras = std::move(eras);
+                }
+            } else {
+                zpp::deserialize(_eras, dec.at(1));
+                _transition_era(0, _eras.size());
+            }
             dec.add([&](const auto) {
                 // do nothing as the field has been already decoded above
             });
-            _transition_era(0, _eras.size());
             _state->from_zpp(dec);
             _vrf_state->from_zpp(dec);
+            if (delta) {
+                dec.add([&](const auto) {
+                    // the base's end offset has been checked above
+                });
+            }
             dec.run(_sched, "parallel_decoder::run", 1000);
             if (!_subchains.empty()) {
                 // Reserve snapshots can be saved to disk before the validation is fully finished.
@@ -194,6 +232,8 @@ namespace daedalus_turbo::cardano::ledger {
             if (end_offset() != valid_end_offset())
                 throw error(fmt::format("validator state from {} is in inconsistent state valid_end_offset: {} vs end_offset: {}",
                     path, valid_end_offset(), end_offset()));
+            if (as_base)
+                _mark_zpp_base(_chunk_hashes(dec.size(), [&](const size_t i) { return dec.at(i); }));
         } catch (const std::exception &ex) {
             const auto err_path = path + ".err";
             std::filesystem::rename(path, err_path);
@@ -201,9 +241,20 @@ namespace daedalus_turbo::cardano::ledger {
         }
     }
 
-    void state::save_zpp(const std::string &path, const std::unique_ptr<subchain_list> tmp_sc)
+    void state::save_zpp(const std::string &path, std::unique_ptr<subchain_list> tmp_sc)
     {
-        zpp_encoder ser {};
+        _save_zpp(path, std::move(tmp_sc), false);
+    }
+
+    std::optional<uint64_t> state::save_zpp_delta(const std::string &path, std::unique_ptr<subchain_list> tmp_sc)
+    {
+        return _save_zpp(path, std::move(tmp_sc), true);
+    }
+
+    std::optional<uint64_t> state::_save_zpp(const std::string &path, const std::unique_ptr<subchain_list> tmp_sc, const bool allow_delta)
+    {
+        bool delta = false;
+        zpp_encoder ser { [&delta] { return zpp_options { delta }; } };
         ser.add([&](auto) {
             mutex::scoped_lock lk { _subchains_mutex };
             std::unique_ptr<subchain_list> orig_sc {};
@@ -221,15 +272,61 @@ namespace daedalus_turbo::cardano::ledger {
         });
         _state->to_zpp(ser);
         _vrf_state->to_zpp(ser);
-        ser.run(_sched, "ledger-state:save-state-snapshot");
+        // era transitions change the layout of the chunks, and a UTxO delta may have grown too large
+        delta = allow_delta && _zpp_base && _zpp_base->num_eras == _eras.size() && _zpp_base->chunk_hashes.size() == ser.size()
+            && _state->_utxo.has_delta();
+        if (!delta) {
+            ser.run(_sched, "ledger-state:save-state-snapshot");
+            ser.save(path, true);
+            _mark_zpp_base(_chunk_hashes(ser.size(), [&](const size_t i) { return static_cast<buffer>(ser.at(i)); }));
+            return {};
+        }
+        const auto base_end_offset = _zpp_base->end_offset;
+        ser.add([base_end_offset](auto) {
+            return zpp::serialize(base_end_offset);
+        });
+        ser.run(_sched, "ledger-state:save-state-delta");
+        // the chunks same as in the base are replaced with a zero byte and the others get a trailing one
+        const auto hashes = _chunk_hashes(ser.size(), [&](const size_t i) { return static_cast<buffer>(ser.at(i)); });
+        for (size_t i = 0; i < ser.size(); ++i) {
+            auto &chunk = ser.at(i);
+            if (i < _zpp_base->chunk_hashes.size() && hashes[i] == _zpp_base->chunk_hashes[i]) {
+                chunk.clear();
+                chunk.emplace_back(0);
+            } else {
+                chunk.emplace_back(1);
+            }
+        }
         ser.save(path, true);
+        return base_end_offset;
+    }
+
+    vector<blake2b_256_hash> state::_chunk_hashes(const size_t num_chunks, const std::function<buffer(size_t)> &get_chunk) const
+    {
+        vector<blake2b_256_hash> hashes(num_chunks);
+        const std::string task_group { "ledger-state:hash-snapshot-chunks" };
+        _sched.wait_all_done(task_group, num_chunks, [&] {
+            for (size_t i = 0; i < num_chunks; ++i) {
+                _sched.submit_void(task_group, 1000, [&, i] {
+                    hashes[i] = blake2b<blake2b_256_hash>(get_chunk(i));
+                });
+            }
+        });
+        return hashes;
+    }
+
+    void state::_mark_zpp_base(vector<blake2b_256_hash> &&chunk_hashes)
+    {
+        _state->_utxo.mark_base();
+        _zpp_base.emplace(end_offset(), _eras.size(), std::move(chunk_hashes));
     }
 
     void state::clear()
     {
+        _zpp_base.reset();
         _subchains.clear();
         _eras.clear();
-        _state = std::make_unique<shelley::state>(_cfg, _sched);
+        _state = std::make_unique<shelley::state>(_cfg, _sched, _utxo_cfg);
         _vrf_state = std::make_unique<shelley::vrf_state>(_cfg);
     }
 
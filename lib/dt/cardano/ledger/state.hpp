@@ -17,13 +17,32 @@ namespace daedalus_turbo {
 
 namespace daedalus_turbo::cardano::ledger {
     struct state {
-        explicit state(const cardano::config &cfg=cardano::config::get(), scheduler &sched=scheduler::get());
+        // the version of the snapshot layout written by save_zpp; must be incremented with any change to it,
+        // so that the snapshots of the older layouts are dropped instead of failing to load
+        static constexpr uint64_t zpp_version = 2;
+
+        explicit state(const cardano::config &cfg=cardano::config::get(), scheduler &sched=scheduler::get(),
+            const utxo_store_config_ptr &utxo_cfg=utxo_store_config::get());
 
         bool operator==(const state &o) const;
         void clear();
 
-        void load_zpp(const std::string &path);
+        // with as_base set, the loaded snapshot becomes the base of the following delta snapshots
+        void load_zpp(const std::string &path, bool as_base=false);
+        // loads a full snapshot and applies a delta snapshot saved against it
+        void load_zpp(const std::string &base_path, const std::string &delta_path, bool as_base=false);
+        // the saved snapshot becomes the base of the following delta snapshots
         void save_zpp(const std::string &path, std::unique_ptr<subchain_list> tmp_sc={});
+        // saves only the UTxO changes and the chunks that differ from the base and returns the base's end offset;
+        // without a compatible base, saves a full snapshot instead and returns nothing
+        std::optional<uint64_t> save_zpp_delta(const std::string &path, std::unique_ptr<subchain_list> tmp_sc={});
+
+        std::optional<uint64_t> zpp_base() const
+        {
+            if (_zpp_base)
+                return _zpp_base->end_offset;
+            return {};
+        }
         cbor_encoder to_cbor(const point &tip, int prio=1000) const;
         point deserialize_node(buffer data);
         point load_node(const std::string &path);
@@ -111,7 +130,7 @@ namespace daedalus_turbo::cardano::ledger {
             return *_vrf_state;
         }
 
-        const txo_map &utxos() const
+        const utxo_store &utxos() const
         {
             return _state->_utxo;
         }
@@ -233,9 +252,17 @@ namespace daedalus_turbo::cardano::ledger {
             return _state->has_drep(id);
         }
     private:
+        struct zpp_base_info {
+            uint64_t end_offset = 0;
+            size_t num_eras = 0;
+            vector<blake2b_256_hash> chunk_hashes {};
+        };
+
         // non-serializable members:
         const cardano::config &_cfg;
         scheduler &_sched;
+        utxo_store_config_ptr _utxo_cfg;
+        std::optional<zpp_base_info> _zpp_base {};
 
         mutable mutex::unique_lock::mutex_type _subchains_mutex alignas(mutex::alignment) {};
         subchain_list _subchains{};
@@ -246,11 +273,16 @@ namespace daedalus_turbo::cardano::ledger {
 
         void _deserialize_node_ledger_state(cbor::zero2::value &);
         point _deserialize_node_vrf_state(cbor::zero2::value &);
+        cbor_encoder _node_encoder(const point &tip) const;
         void _serialize_node_state(cbor_encoder &ser, const point &tip) const;
         void _serialize_node_vrf_state(cbor_encoder &ser, const point &tip) const;
         void _transition_ledger_era(uint64_t from_era, uint64_t to_era);
         void _transition_vrf_era(uint64_t from_era, uint64_t to_era);
         void _transition_era(uint64_t from_era, uint64_t to_era);
+        void _load_zpp(const std::string &path, bool delta, bool as_base);
+        std::optional<uint64_t> _save_zpp(const std::string &path, std::unique_ptr<subchain_list> tmp_sc, bool allow_delta);
+        vector<blake2b_256_hash> _chunk_hashes(size_t num_chunks, const std::function<buffer(size_t)> &get_chunk) const;
+        void _mark_zpp_base(vector<blake2b_256_hash> &&chunk_hashes);
 
         delegation_map_copy _filtered_delegs(const size_t idx) const
         {
@@ -6,6 +6,7 @@
 
 #include <dt/common/test.hpp>
 #include <dt/cardano/ledger/state.hpp>
+#include <dt/cardano/ledger/updates.hpp>
 
 namespace {
     using namespace daedalus_turbo;
@@ -71,6 +72,53 @@ suite cardano_ledger_state_suite = [] {
             st2.load_zpp(tmp_state.path());
             expect(st == st2);
         };
+        "save and load a delta"_test = [] {
+            file::tmp_directory tmp_dir { "validator-state-delta-test" };
+            const auto base_path = fmt::format("{}/base.bin", tmp_dir.path());
+            const auto delta_path = fmt::format("{}/delta.bin", tmp_dir.path());
+            const auto make_updates = [](const uint64_t first, const uint64_t last) {
+                cardano::txo_map utxos {};
+                for (uint64_t i = first; i < last; ++i) {
+                    cardano::tx_out_data data {};
+                    data.address_raw << uint8_t { 0x61 } << blake2b<cardano::key_hash>(buffer::from(i % 100));
+                    data.coin = 1'000'000 + i;
+                    utxos.try_emplace(cardano::tx_out_ref { blake2b<cardano::tx_hash>(buffer::from(i)), 0 }, std::move(data));
+                }
+                updates_t updates {};
+                updates.utxos.emplace_back(std::move(utxos));
+                return updates;
+            };
+            state st {};
+            update_params(st, 1, { .protocol_ver=cardano::protocol_version { 8, 0 } });
+            st.start_epoch();
+            st.reserves(10'000'000'000'000'000ULL);
+            st.process_updates(make_updates(0, 100'000));
+            // without a base, a full snapshot is saved
+            expect(!st.zpp_base());
+            expect(!st.save_zpp_delta(base_path));
+            expect(st.zpp_base() == st.end_offset());
+            st.process_updates(make_updates(100'000, 101'000));
+            st.reserves(9'000'000'000'000'000ULL);
+            expect(st.save_zpp_delta(delta_path) == st.end_offset());
+            expect(std::filesystem::file_size(delta_path) * 10 < std::filesystem::file_size(base_path));
+            {
+                state st2 {};
+                st2.load_zpp(base_path, delta_path);
+                expect(st == st2);
+                expect(!st2.zpp_base());
+            }
+            {
+                // a state loaded as a base keeps producing deltas against it
+                state st2 {};
+                st2.load_zpp(base_path, delta_path, true);
+                expect(st2.zpp_base() == st2.end_offset());
+                st2.process_updates(make_updates(101'000, 102'000));
+                expect(st2.save_zpp_delta(delta_path).has_value());
+                state st3 {};
+                st3.load_zpp(base_path, delta_path);
+                expect(st2 == st3);
+            }
+        };
         "save_node and load_node"_test = [] {
             file::tmp tmp_state { "validator-state-node-test" };
             state st {};
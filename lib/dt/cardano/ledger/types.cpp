@@ -11,14 +11,24 @@
 #include <dt/timer.hpp>
 
 namespace daedalus_turbo::cardano::ledger {
-    parallel_decoder::parallel_decoder(const std::string &path): _data { file::read(path) }
+    parallel_decoder::parallel_decoder(const std::string &path, const zpp_options &opts): _data { file::read(path) }, _opts { opts }
     {
         const auto data = static_cast<buffer>(_data);
         const auto num_bufs = data.subbuf(0, sizeof(size_t)).to<size_t>();
         size_t next_offset = (num_bufs + 1) * sizeof(size_t);
         for (size_t i = 0; i < num_bufs; ++i) {
             const auto buf_size = data.subbuf((i + 1) * sizeof(size_t), sizeof(size_t)).to<size_t>();
-            _buffers.emplace_back(data.subbuf(next_offset, buf_size));
+            auto buf = data.subbuf(next_offset, buf_size);
+            // each chunk of a delta ends with a byte telling if it has changed since the base
+            if (_opts.delta) {
+                if (buf.empty()) [[unlikely]]
+                    throw error(fmt::format("a delta chunk #{} in {} is empty", i, path));
+                _unchanged.emplace_back(buf[buf.size() - 1] == 0);
+                buf = buf.subbuf(0, buf.size() - 1);
+            } else {
+                _unchanged.emplace_back(false);
+            }
+            _buffers.emplace_back(buf);
             next_offset += buf_size;
         }
     }
@@ -33,6 +43,11 @@ namespace daedalus_turbo::cardano::ledger {
         return _buffers.at(idx);
     }
 
+    bool parallel_decoder::unchanged(const size_t idx) const
+    {
+        return _unchanged.at(idx);
+    }
+
     void parallel_decoder::add(const decode_func &t)
     {
         _tasks.emplace_back(t);
@@ -47,15 +62,17 @@ namespace daedalus_turbo::cardano::ledger {
     {
         if (_tasks.size() != _buffers.size()) [[unlikely]]
             throw error(fmt::format("was expecting {} items in the serialized data but got {}!", _buffers.size(), _tasks.size()));
-        sched.wait_all_done(task_group, _buffers.size(),
+        const auto num_tasks = static_cast<size_t>(std::count(_unchanged.begin(), _unchanged.end(), false));
+        sched.wait_all_done(task_group, num_tasks,
             [&] {
                 for (size_t i = 0; i < _buffers.size(); ++i) {
-                    sched.submit_void(task_group, _buffers[i].size() * prio / _data.size(), [&, i] { _tasks[i](_buffers[i]); } );
+                    if (!_unchanged[i])
+                        sched.submit_void(task_group, _buffers[i].size() * prio / _data.size(), [&, i] { _tasks[i](_buffers[i]); } );
                 }
             },
-            [this, &task_group, report_progress](auto &&, auto done, auto errs) {
+            [this, &task_group, report_progress, num_tasks](auto &&, auto done, auto errs) {
                 if (report_progress)
-                    progress::get().update(task_group, done - errs, _tasks.size());
+                    progress::get().update(task_group, done - errs, num_tasks);
             }
         );
         for (const auto &f: _on_done)
@@ -11,12 +11,18 @@
 #include <dt/cardano/ledger/pool-rank.hpp>
 #include <dt/parallel/encoder.hpp>
 #include <dt/partitioned-map.hpp>
+#include <dt/persistent-set.hpp>
 #include <dt/scheduler.hpp>
 #include <dt/static-map.hpp>
 
 namespace daedalus_turbo::cardano::ledger {
+    struct zpp_options {
+        // a delta snapshot stores only the changes since its base snapshot
+        bool delta = false;
+    };
+
     using cbor_encoder = parallel::encoder<era_encoder>;
-    using zpp_encoder = parallel::encoder<std::monostate>;
+    using zpp_encoder = parallel::encoder<zpp_options>;
 
     template<typename C>
     struct map_with_get: C
@@ -183,8 +189,9 @@ namespace daedalus_turbo::cardano::ledger {
     using reward_distribution_copy = static_map<cardano::stake_ident, uint64_t>;
     using delegation_map = map<cardano::stake_ident, cardano::pool_hash>;
     using delegation_map_copy = static_map<cardano::stake_ident, cardano::pool_hash>;
-    using inv_delegation_map = map<cardano::pool_hash, std::unordered_set<cardano::stake_ident>>;
-    using inv_delegation_map_copy = static_map<cardano::pool_hash, std::unordered_set<cardano::stake_ident>>;
+    // the delegator sets are shared between the active state and its mark, set, and go copies until they change
+    using inv_delegation_map = map<cardano::pool_hash, persistent_set<cardano::stake_ident>>;
+    using inv_delegation_map_copy = static_map<cardano::pool_hash, persistent_set<cardano::stake_ident>>;
 
     using ptr_to_stake_map = map<cardano::stake_pointer, cardano::stake_ident>;
     using stake_to_ptr_map = map<cardano::stake_ident, cardano::stake_pointer>;
@@ -384,15 +391,24 @@ namespace daedalus_turbo::cardano::ledger {
         using decode_func = std::function<void(buffer)>;
         using done_func = std::function<void()>;
 
-        explicit parallel_decoder(const std::string &path);
+        explicit parallel_decoder(const std::string &path, const zpp_options &opts={});
         [[nodiscard]] size_t size() const;
         void add(const decode_func &t);
         buffer at(size_t idx) const;
+        // the chunks of a delta that are the same as in its base are not stored and their tasks are not run
+        [[nodiscard]] bool unchanged(size_t idx) const;
         void on_done(const done_func &);
         void run(scheduler &sched, const std::string &task_group, int prio=1000, bool report_progress=false);
+
+        [[nodiscard]] const zpp_options &options() const
+        {
+            return _opts;
+        }
     private:
         const uint8_vector _data;
+        const zpp_options _opts;
         vector<buffer> _buffers {};
+        vector<bool> _unchanged {};
         vector<decode_func> _tasks {};
         vector<done_func> _on_done {};
     };
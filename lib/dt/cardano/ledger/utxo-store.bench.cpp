@@ -0,0 +1,163 @@
+/* This file is part of Daedalus Turbo project: https://github.com/sierkov/daedalus-turbo/
+ * Copyright (c) 2022-2023 Alex Sierkov (alex dot sierkov at gmail dot com)
+ * Copyright (c) 2024-2025 R2 Rationality OÜ (info at r2rationality dot com)
+ * This code is distributed under the license specified in:
+ * https://github.com/sierkov/daedalus-turbo/blob/main/LICENSE */
+
+#include <random>
+#include <dt/common/benchmark.hpp>
+#include <dt/cardano/ledger/utxo-store.hpp>
+#include <dt/memory.hpp>
+#include <dt/scheduler.hpp>
+#include <dt/timer.hpp>
+#include <dt/zpp.hpp>
+
+namespace {
+    using namespace daedalus_turbo;
+    using namespace daedalus_turbo::cardano;
+    using namespace daedalus_turbo::cardano::ledger;
+
+    // base addresses with a skewed reuse and about one in five outputs with assets
+    txo_map make_utxos(const size_t num_items)
+    {
+        std::default_random_engine rnd { 12345 };
+        txo_map utxos {};
+        for (uint64_t i = 0; i < num_items; ++i) {
+            tx_out_data data {};
+            const auto pay_no = static_cast<uint64_t>(rnd() % 4 == 0 ? rnd() % 1000 : rnd());
+            data.address_raw << uint8_t { 0x01 }
+                << blake2b<blake2b_224_hash>(buffer::from(pay_no))
+                << blake2b<blake2b_224_hash>(buffer::from(pay_no / 4));
+            data.coin = rnd() % 100'000'000;
+            if (rnd() % 5 == 0) {
+                const auto policy_id = blake2b<script_hash>(buffer::from(static_cast<uint64_t>(rnd() % 100)));
+                data.assets[policy_id][asset_name_t { buffer::from(static_cast<uint64_t>(rnd() % 10)) }] = rnd() % 1000 + 1;
+            }
+            utxos.try_emplace(tx_out_ref { blake2b<tx_hash>(buffer::from(i)), rnd() % 3 }, std::move(data));
+        }
+        return utxos;
+    }
+
+    // the same partition-parallel pattern as shelley::state::_process_utxo_updates
+    template<typename PART>
+    void apply_updates(const std::string &task_group, const txo_map &updates, const std::function<PART &(size_t)> &get_part)
+    {
+        auto &sched = scheduler::get();
+        sched.wait_all_done(task_group, txo_map::num_parts, [&] {
+            for (size_t pi = 0; pi < txo_map::num_parts; ++pi) {
+                sched.submit_void(task_group, 1000, [&, pi] {
+                    auto &part = get_part(pi);
+                    for (const auto &[id, data]: updates.partition(pi))
+                        part.try_emplace(id, data);
+                    for (const auto &[id, data]: updates.partition(pi)) {
+                        if (id.idx == 0)
+                            part.erase(id);
+                    }
+                });
+            }
+        });
+    }
+}
+
+suite cardano_ledger_utxo_store_bench_suite = [] {
+    "cardano::ledger::utxo_store"_test = [] {
+        static constexpr size_t num_items = 1 << 20;
+        const auto updates = make_utxos(num_items);
+        "memory use"_test = [&] {
+            // the compact store goes first, since the RSS does not always shrink after the map is freed
+            auto mem_before = memory::my_usage_mb();
+            const utxo_store st { updates };
+            const auto store_mb = memory::my_usage_mb() - mem_before;
+            mem_before = memory::my_usage_mb();
+            txo_map m {};
+            for (const auto &[id, data]: updates)
+                m.try_emplace(id, data);
+            const auto map_mb = memory::my_usage_mb() - mem_before;
+            std::clog << fmt::format("[utxo memory use] {} UTxOs: txo_map: {} MB utxo_store: {} MB (internal estimate: {} MB)\n",
+                st.size(), map_mb, store_mb, st.memory_usage() >> 20);
+            expect(store_mb < map_mb) << store_mb << map_mb;
+        };
+        benchmark_r("txo_map updates", 1e5, 3, [&] {
+            txo_map m {};
+            apply_updates<txo_map::partition_type>("bench-txo-map", updates, [&](const size_t pi) -> txo_map::partition_type & {
+                return m.partition(pi);
+            });
+            return updates.size();
+        });
+        benchmark_r("utxo_store updates", 1e5, 3, [&] {
+            utxo_store st {};
+            apply_updates<utxo_store::partition_type>("bench-utxo-store", updates, [&](const size_t pi) -> utxo_store::partition_type & {
+                return st.partition(pi);
+            });
+            return updates.size();
+        });
+        "snapshot deltas"_test = [&] {
+            utxo_store st { updates };
+            st.mark_base();
+            daedalus_turbo::vector<uint8_vector> base_chunks {};
+            for (size_t pi = 0; pi < utxo_store::num_parts; ++pi)
+                base_chunks.emplace_back(daedalus_turbo::zpp::serialize(st.partition(pi)));
+            // about one percent of the UTxOs change between two snapshots
+            uint64_t i = 0;
+            for (const auto &[id, data]: updates) {
+                if (++i % 200 == 0)
+                    st.erase(id);
+                else if (i % 200 == 1)
+                    st.try_emplace(tx_out_ref { id.hash, id.idx + 3 }, data);
+            }
+            timer t_full { "utxo full" };
+            daedalus_turbo::vector<uint8_vector> full_chunks {};
+            for (size_t pi = 0; pi < utxo_store::num_parts; ++pi)
+                full_chunks.emplace_back(daedalus_turbo::zpp::serialize(st.partition(pi)));
+            const auto full_save_sec = t_full.stop(false);
+            size_t full_bytes = 0;
+            for (const auto &chunk: full_chunks)
+                full_bytes += chunk.size();
+            timer t_full_restore { "utxo full restore" };
+            utxo_store full_restored {};
+            for (size_t pi = 0; pi < utxo_store::num_parts; ++pi)
+                daedalus_turbo::zpp::deserialize(full_restored.partition(pi), full_chunks[pi]);
+            const auto full_restore_sec = t_full_restore.stop(false);
+            timer t_delta { "utxo delta" };
+            daedalus_turbo::vector<uint8_vector> delta_chunks {};
+            for (size_t pi = 0; pi < utxo_store::num_parts; ++pi)
+                delta_chunks.emplace_back(daedalus_turbo::zpp::serialize(st.partition(pi).delta()));
+            const auto delta_save_sec = t_delta.stop(false);
+            size_t delta_bytes = 0;
+            for (const auto &chunk: delta_chunks)
+                delta_bytes += chunk.size();
+            timer t_restore { "utxo restore" };
+            utxo_store restored {};
+            for (size_t pi = 0; pi < utxo_store::num_parts; ++pi) {
+                daedalus_turbo::zpp::deserialize(restored.partition(pi), base_chunks[pi]);
+                restored.partition(pi).apply(daedalus_turbo::zpp::deserialize<utxo_store::partition_delta>(delta_chunks[pi]));
+            }
+            const auto delta_restore_sec = t_restore.stop(false);
+            std::clog << fmt::format("[utxo snapshots] full: {:.1f} MB saved in {:.3f} sec and restored in {:.3f} sec;"
+                " delta: {:.1f} MB saved in {:.3f} sec and restored with its base in {:.3f} sec\n",
+                static_cast<double>(full_bytes) / 1e6, full_save_sec, full_restore_sec, static_cast<double>(delta_bytes) / 1e6, delta_save_sec, delta_restore_sec);
+            expect(full_restored == st);
+            expect(restored == st);
+            expect(delta_bytes * 20 < full_bytes) << delta_bytes << full_bytes;
+        };
+        "disk tier"_test = [&] {
+            file::tmp_directory tmp_dir { "bench-utxo-store-cold" };
+            auto &cfg = utxo_store_config::get();
+            const auto prev_cfg = cfg;
+            cfg = { 64ULL << 20, tmp_dir.path() };
+            benchmark_r("utxo_store updates with a 64 MB hot tier", 1e4, 3, [&] {
+                utxo_store st {};
+                apply_updates<utxo_store::partition_type>("bench-utxo-store-cold", updates, [&](const size_t pi) -> utxo_store::partition_type & {
+                    return st.partition(pi);
+                });
+                return updates.size();
+            });
+            {
+                const utxo_store st { updates };
+                std::clog << fmt::format("[utxo memory use] {} UTxOs with a 64 MB hot tier: {} MB\n", st.size(), st.memory_usage() >> 20);
+                expect(st.memory_usage() < cfg.hot_budget * 2);
+            }
+            cfg = prev_cfg;
+        };
+    };
+};
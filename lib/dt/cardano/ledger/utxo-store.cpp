@@ -0,0 +1,850 @@
+/* This file is part of Daedalus Turbo project: https://github.com/sierkov/daedalus-turbo/
+ * Copyright (c) 2022-2023 Alex Sierkov (alex dot sierkov at gmail dot com)
+ * Copyright (c) 2024-2025 R2 Rationality OÜ (info at r2rationality dot com)
+ * This code is distributed under the license specified in:
+ * https://github.com/sierkov/daedalus-turbo/blob/main/LICENSE */
+
+#include <cstdlib>
+#include <random>
+#include <dt/cardano/ledger/utxo-store.hpp>
+#include <dt/cbor/zero2.hpp>
+#include <dt/logger.hpp>
+#include <dt/zpp.hpp>
+
+namespace daedalus_turbo::cardano::ledger {
+    // arenas are compacted once they are at least half garbage
+    static constexpr uint64_t min_compact_garbage = 64 << 10;
+
+    const utxo_store_config_ptr &utxo_store_config::get()
+    {
+        static const utxo_store_config_ptr cfg = [] {
+            auto c = std::make_shared<utxo_store_config>();
+            if (const char *env_hot_str = std::getenv("DT_UTXO_HOT_MB"); env_hot_str != nullptr)
+                c->hot_budget = std::stoull(env_hot_str) << 20;
+            if (const char *env_dir_str = std::getenv("DT_UTXO_COLD_DIR"); env_dir_str != nullptr)
+                c->cold_dir = env_dir_str;
+            else
+                c->cold_dir = std::filesystem::temp_directory_path() / "dt-utxo";
+            return c;
+        }();
+        return cfg;
+    }
+
+    static std::string cold_run_path(const std::filesystem::path &dir)
+    {
+        // the runs of all partitions and of all processes can share the same directory
+        static const auto prefix = fmt::format("{:08X}{:08X}", std::random_device {}(), std::random_device {}());
+        static std::atomic_uint64_t next_id { 0 };
+        return (dir / fmt::format("utxo-{}-{}.run", prefix, next_id.fetch_add(1, std::memory_order_relaxed))).string();
+    }
+
+    utxo_cold_run::writer::writer(const std::filesystem::path &dir):
+        _path { cold_run_path(dir) }, _ws { _path }
+    {
+    }
+
+    utxo_cold_run::writer::~writer()
+    {
+        // an unfinished run is of no use
+        if (!_finished) {
+            _ws.close();
+            std::error_code ec {};
+            std::filesystem::remove(_path, ec);
+        }
+    }
+
+    void utxo_cold_run::writer::add(const item &it)
+    {
+        if (!_ids.empty() && !(_ids.back() < it.id)) [[unlikely]]
+            throw error(fmt::format("cold run items must be added in the order of their ids but got {} after {}", it.id, _ids.back()));
+        _ids.emplace_back(it.id);
+        _balance += it.data.coin;
+        _items.emplace_back(it);
+        if (_items.size() >= block_items)
+            _flush();
+    }
+
+    std::shared_ptr<const utxo_cold_run> utxo_cold_run::writer::finish()
+    {
+        _flush();
+        _ws.close();
+        _finished = true;
+        if (!_num_items) {
+            std::filesystem::remove(_path);
+            return {};
+        }
+        vector<uint64_t> filter((_num_items * filter_bits_per_item + 63) / 64);
+        for (const auto &id: _ids) {
+            for (const auto bit: _filter_bits(id, filter.size() * 64))
+                filter[bit >> 6] |= 1ULL << (bit & 63);
+        }
+        return std::shared_ptr<const utxo_cold_run>(new utxo_cold_run { _path, std::move(_blocks), std::move(filter), _num_items, _balance });
+    }
+
+    void utxo_cold_run::writer::_flush()
+    {
+        if (_items.empty())
+            return;
+        if (_num_items + _items.size() > std::numeric_limits<uint32_t>::max()) [[unlikely]]
+            throw error(fmt::format("too many items in a cold run: {}", _path));
+        const auto bytes = zpp::serialize(_items);
+        _blocks.emplace_back(_items.front().id, _offset, static_cast<uint32_t>(bytes.size()), static_cast<uint32_t>(_num_items));
+        _ws.write(bytes);
+        _offset += bytes.size();
+        _num_items += _items.size();
+        _items.clear();
+    }
+
+    utxo_cold_run::utxo_cold_run(const std::string &path, vector<block> &&blocks, vector<uint64_t> &&filter, const uint64_t num_items, const uint64_t balance):
+        _file { path }, _blocks { std::move(blocks) }, _filter { std::move(filter) }, _num_items { num_items }, _balance { balance }
+    {
+    }
+
+    utxo_cold_run::~utxo_cold_run()
+    {
+        const auto path = _file.path();
+        _file.close();
+        std::error_code ec {};
+        std::filesystem::remove(path, ec);
+        if (ec) [[unlikely]]
+            logger::warn("failed to remove a UTxO cold run {}: {}", path, ec.message());
+    }
+
+    std::optional<std::pair<uint64_t, tx_out_data>> utxo_cold_run::find(const tx_out_ref &id) const
+    {
+        for (const auto bit: _filter_bits(id, _filter.size() * 64)) {
+            if (!((_filter[bit >> 6] >> (bit & 63)) & 1))
+                return {};
+        }
+        const auto b_it = std::upper_bound(_blocks.begin(), _blocks.end(), id,
+            [](const tx_out_ref &a, const block &b) { return a < b.first_id; });
+        if (b_it == _blocks.begin())
+            return {};
+        const auto block_idx = static_cast<size_t>(b_it - _blocks.begin()) - 1;
+        auto items = read_block(block_idx);
+        const auto it = std::lower_bound(items.begin(), items.end(), id,
+            [](const item &a, const tx_out_ref &b) { return a.id < b; });
+        if (it == items.end() || !(it->id == id))
+            return {};
+        return std::make_pair(_blocks[block_idx].first_item + static_cast<uint64_t>(it - items.begin()), std::move(it->data));
+    }
+
+    utxo_cold_run::item_list utxo_cold_run::read_block(const size_t block_idx) const
+    {
+        const auto &b = _blocks.at(block_idx);
+        uint8_vector bytes(b.size);
+        _file.read(b.offset, std::span { bytes.data(), bytes.size() });
+        return zpp::deserialize<item_list>(bytes);
+    }
+
+    size_t utxo_cold_run::memory_usage() const
+    {
+        return _blocks.capacity() * sizeof(block) + _filter.capacity() * sizeof(uint64_t);
+    }
+
+    std::array<uint64_t, utxo_cold_run::filter_probes> utxo_cold_run::_filter_bits(const tx_out_ref &id, const uint64_t num_bits)
+    {
+        // double hashing over the bytes that neither the partitioning nor the hot tables use
+        uint64_t h1 = 0, h2 = 0;
+        for (size_t i = 9; i < 17; ++i)
+            h1 = (h1 << 8) | id.hash[i];
+        for (size_t i = 17; i < 25; ++i)
+            h2 = (h2 << 8) | id.hash[i];
+        h1 ^= static_cast<uint64_t>(id.idx) * 0x9E3779B97F4A7C15ULL;
+        h2 |= 1;
+        std::array<uint64_t, filter_probes> bits;
+        for (size_t i = 0; i < filter_probes; ++i)
+            bits[i] = (h1 + i * h2) % num_bits;
+        return bits;
+    }
+
+    // backward-shift deletion from a linear-probing table keeps the probe sequences intact without tombstones
+    template<typename S, typename IS_USED, typename HOME>
+    static size_t shift_back(S &slots, size_t pos, const IS_USED &is_used, const HOME &home)
+    {
+        const auto mask = slots.size() - 1;
+        for (size_t next = (pos + 1) & mask; is_used(slots[next]); next = (next + 1) & mask) {
+            if (((next - home(slots[next])) & mask) >= ((next - pos) & mask)) {
+                slots[pos] = slots[next];
+                pos = next;
+            }
+        }
+        return pos;
+    }
+
+    void utxo_store::partition_type::addr_table::clear()
+    {
+        _bytes.clear();
+        _infos.clear();
+        _free_ids.clear();
+        _slots.clear();
+        _size = 0;
+        _garbage = 0;
+    }
+
+    uint32_t utxo_store::partition_type::addr_table::acquire(const buffer addr)
+    {
+        if (addr.empty() || addr.size() > std::numeric_limits<uint32_t>::max()) [[unlikely]]
+            throw error(fmt::format("an address of an unsupported size: {}", addr.size()));
+        if ((_size + 1) * 4 > _slots.size() * 3)
+            _grow();
+        const auto pos = _find(addr, _hash(addr));
+        if (const auto id = _slots[pos]; id) {
+            ++_infos[id - 1].refs;
+            return id;
+        }
+        uint32_t id;
+        if (!_free_ids.empty()) {
+            id = _free_ids.back();
+            _free_ids.pop_back();
+        } else {
+            if (_infos.size() >= std::numeric_limits<uint32_t>::max()) [[unlikely]]
+                throw error("too many unique addresses in a UTxO partition");
+            _infos.emplace_back();
+            id = static_cast<uint32_t>(_infos.size());
+        }
+        _infos[id - 1] = { _bytes.size(), static_cast<uint32_t>(addr.size()), 1 };
+        _bytes.insert(_bytes.end(), addr.begin(), addr.end());
+        _slots[pos] = id;
+        ++_size;
+        return id;
+    }
+
+    void utxo_store::partition_type::addr_table::release(const uint32_t id)
+    {
+        auto &i = _infos.at(id - 1);
+        if (!i.refs) [[unlikely]]
+            throw error(fmt::format("internal error: releasing a free address id {}", id));
+        if (--i.refs)
+            return;
+        const auto mask = _slots.size() - 1;
+        const auto pos = shift_back(_slots, _find(get(id), _hash(get(id))),
+            [](const uint32_t sid) { return sid != 0; },
+            [&](const uint32_t sid) { return _hash(get(sid)) & mask; });
+        _slots[pos] = 0;
+        _garbage += i.size;
+        i = {};
+        _free_ids.emplace_back(id);
+        --_size;
+        if (_garbage >= min_compact_garbage && _garbage * 2 >= _bytes.size())
+            _compact();
+    }
+
+    size_t utxo_store::partition_type::addr_table::memory_usage() const
+    {
+        return _bytes.capacity() + _infos.capacity() * sizeof(info)
+            + (_free_ids.capacity() + _slots.capacity()) * sizeof(uint32_t);
+    }
+
+    uint64_t utxo_store::partition_type::addr_table::_hash(const buffer addr)
+    {
+        // FNV-1a: the slots are serialized, so the hash must not depend on the platform or the build
+        uint64_t h = 0xCBF29CE484222325ULL;
+        for (const auto b: addr) {
+            h ^= b;
+            h *= 0x100000001B3ULL;
+        }
+        return h;
+    }
+
+    // returns the position of the address or of the free slot where it belongs
+    size_t utxo_store::partition_type::addr_table::_find(const buffer addr, const uint64_t hash) const
+    {
+        const auto mask = _slots.size() - 1;
+        size_t pos = hash & mask;
+        while (_slots[pos] && get(_slots[pos]) != addr)
+            pos = (pos + 1) & mask;
+        return pos;
+    }
+
+    void utxo_store::partition_type::addr_table::_grow()
+    {
+        vector<uint32_t> slots(std::max(min_capacity, _slots.size() * 2));
+        const auto mask = slots.size() - 1;
+        for (const auto id: _slots) {
+            if (id) {
+                auto pos = _hash(get(id)) & mask;
+                while (slots[pos])
+                    pos = (pos + 1) & mask;
+                slots[pos] = id;
+            }
+        }
+        _slots = std::move(slots);
+    }
+
+    void utxo_store::partition_type::addr_table::_compact()
+    {
+        uint8_vector bytes {};
+        bytes.reserve(_bytes.size() - _garbage);
+        for (auto &i: _infos) {
+            if (i.refs) {
+                const auto new_offset = bytes.size();
+                bytes.insert(bytes.end(), _bytes.begin() + i.offset, _bytes.begin() + i.offset + i.size);
+                i.offset = new_offset;
+            }
+        }
+        _bytes = std::move(bytes);
+        _garbage = 0;
+    }
+
+    bool utxo_store::partition_type::operator==(const partition_type &o) const
+    {
+        if (size() != o.size())
+            return false;
+        for (const auto &[id, data]: *this) {
+            const auto o_data = o.find(id);
+            if (!o_data || !(*o_data == data))
+                return false;
+        }
+        return true;
+    }
+
+    void utxo_store::partition_type::clear()
+    {
+        _clear_hot();
+        _gen = 0;
+        _cold_clear();
+        _track_changes = false;
+        _changed.clear();
+    }
+
+    std::optional<tx_out_data> utxo_store::partition_type::find(const tx_out_ref &id) const
+    {
+        if (const auto pos = _find(id); pos != npos)
+            return _decode(_entries[pos]);
+        if (auto cold = _cold_find(id); cold)
+            return std::move(cold->second);
+        return {};
+    }
+
+    bool utxo_store::partition_type::try_emplace(const tx_out_ref &id, const tx_out_data &data)
+    {
+        const auto pos = _insert_pos(id);
+        auto &e = _entries[pos];
+        if (e.addr_id || _cold_find(id))
+            return false;
+        e.id = id;
+        e.gen = _gen;
+        _set(e, data);
+        ++_size;
+        _track(id);
+        _spill_if_needed();
+        return true;
+    }
+
+    void utxo_store::partition_type::insert_or_assign(const tx_out_ref &id, const tx_out_data &data)
+    {
+        const auto pos = _insert_pos(id);
+        auto &e = _entries[pos];
+        const auto prev = e;
+        e.id = id;
+        e.gen = _gen;
+        _set(e, data);
+        if (prev.addr_id) {
+            _release(prev);
+        } else {
+            ++_size;
+            if (const auto cold = _cold_find(id); cold)
+                _cold_erase(cold->first, cold->second.coin);
+        }
+        _track(id);
+        _spill_if_needed();
+    }
+
+    std::optional<tx_out_data> utxo_store::partition_type::extract(const tx_out_ref &id)
+    {
+        if (const auto pos = _find(id); pos != npos) {
+            auto data = _decode(_entries[pos]);
+            _remove_at(pos);
+            _track(id);
+            return data;
+        }
+        if (auto cold = _cold_find(id); cold) {
+            _cold_erase(cold->first, cold->second.coin);
+            _track(id);
+            return std::move(cold->second);
+        }
+        return {};
+    }
+
+    bool utxo_store::partition_type::erase(const tx_out_ref &id)
+    {
+        if (const auto pos = _find(id); pos != npos) {
+            _remove_at(pos);
+            _track(id);
+            return true;
+        }
+        if (const auto cold = _cold_find(id); cold) {
+            _cold_erase(cold->first, cold->second.coin);
+            _track(id);
+            return true;
+        }
+        return false;
+    }
+
+    void utxo_store::partition_type::spill(const bool all)
+    {
+        utxo_cold_run::item_list evicted {}, kept {};
+        for (const auto &e: _entries) {
+            if (e.addr_id) {
+                auto &dst = all || e.gen != _gen ? evicted : kept;
+                dst.emplace_back(e.id, _decode(e));
+            }
+        }
+        if (evicted.empty())
+            return;
+        std::sort(evicted.begin(), evicted.end(), [](const auto &a, const auto &b) { return a.id < b.id; });
+        utxo_cold_run::writer w { _cfg->cold_dir };
+        for (const auto &it: evicted)
+            w.add(it);
+        _cold_add(w.finish());
+        // the merges leave out the spent items and keep the run sizes at least doubling towards the oldest one
+        size_t first_part = _cold.size() - 1;
+        uint64_t merged_size = _cold.back().size;
+        while (first_part > 0 && _cold[first_part - 1].size < 2 * merged_size)
+            merged_size += _cold[--first_part].size;
+        if (first_part + 1 < _cold.size())
+            _cold_merge(first_part);
+        // rebuilds the hot table and arenas so that they shrink to the kept entries
+        _clear_hot();
+        for (const auto &it: kept) {
+            auto &e = _entries[_insert_pos(it.id)];
+            e.id = it.id;
+            e.gen = _gen;
+            _set(e, it.data);
+            ++_size;
+        }
+        ++_gen;
+    }
+
+    uint64_t utxo_store::partition_type::balance() const
+    {
+        uint64_t sum = _cold_balance;
+        for (const auto &e: _entries)
+            sum += e.coin;
+        return sum;
+    }
+
+    size_t utxo_store::partition_type::memory_usage() const
+    {
+        size_t cold_usage = _cold.capacity() * sizeof(cold_part);
+        for (const auto &cp: _cold)
+            cold_usage += cp.run->memory_usage() + cp.dead.capacity() * sizeof(uint64_t);
+        return _hot_memory_usage() + cold_usage + _changed.capacity() * sizeof(tx_out_ref);
+    }
+
+    void utxo_store::partition_type::mark_base()
+    {
+        _track_changes = true;
+        _changed_overflow = false;
+        _changed.clear();
+        _changed.shrink_to_fit();
+    }
+
+    void utxo_store::partition_type::_compact_changed()
+    {
+        std::sort(_changed.begin(), _changed.end());
+        _changed.erase(std::unique(_changed.begin(), _changed.end()), _changed.end());
+        if (_changed.size() > _max_changed()) {
+            // the next snapshot must be a full one, so the ids are no longer needed
+            _changed_overflow = true;
+            _changed.clear();
+            _changed.shrink_to_fit();
+        }
+    }
+
+    utxo_store::partition_delta utxo_store::partition_type::delta() const
+    {
+        if (!_track_changes) [[unlikely]]
+            throw error("a UTxO delta requires a base, but the partition does not have one");
+        if (_changed_overflow) [[unlikely]]
+            throw error("the UTxO partition has changed too much since its base to make a delta");
+        auto ids = _changed;
+        std::sort(ids.begin(), ids.end());
+        ids.erase(std::unique(ids.begin(), ids.end()), ids.end());
+        partition_delta d {};
+        for (const auto &id: ids) {
+            if (auto data = find(id); data)
+                d.upserted.emplace_back(id, std::move(*data));
+            else
+                d.erased.emplace_back(id);
+        }
+        return d;
+    }
+
+    void utxo_store::partition_type::apply(const partition_delta &d)
+    {
+        // the ids both created and spent since the base are in the erased list too
+        for (const auto &id: d.erased)
+            erase(id);
+        for (const auto &[id, data]: d.upserted)
+            insert_or_assign(id, data);
+    }
+
+    void utxo_store::partition_type::to_cbor(era_encoder &enc) const
+    {
+        vector<const entry *> sorted {};
+        sorted.reserve(_size);
+        for (const auto &e: _entries) {
+            if (e.addr_id)
+                sorted.emplace_back(&e);
+        }
+        std::sort(sorted.begin(), sorted.end(), [](const auto *a, const auto *b) { return a->id < b->id; });
+        // the cold items are already sorted, so the two sequences are merged
+        auto hot_it = sorted.begin();
+        const auto write_hot_before = [&](const tx_out_ref *limit) {
+            for (; hot_it != sorted.end() && (!limit || (*hot_it)->id < *limit); ++hot_it) {
+                enc.array(2)
+                    .bytes((*hot_it)->id.hash)
+                    .uint((*hot_it)->id.idx);
+                _decode(**hot_it).to_cbor(enc);
+            }
+        };
+        _cold_for_each([&](const auto &it) {
+            write_hot_before(&it.id);
+            enc.array(2)
+                .bytes(it.id.hash)
+                .uint(it.id.idx);
+            it.data.to_cbor(enc);
+        });
+        write_hot_before(nullptr);
+    }
+
+    uint64_t utxo_store::partition_type::_hash(const tx_out_ref &id)
+    {
+        // the first byte selects the partition, so the next eight are used
+        uint64_t h = 0;
+        for (size_t i = 1; i < 9; ++i)
+            h = (h << 8) | id.hash[i];
+        return h ^ (static_cast<uint64_t>(id.idx) * 0x9E3779B97F4A7C15ULL);
+    }
+
+    size_t utxo_store::partition_type::_find(const tx_out_ref &id) const
+    {
+        if (_entries.empty())
+            return npos;
+        const auto mask = _entries.size() - 1;
+        for (size_t pos = _hash(id) & mask; _entries[pos].addr_id; pos = (pos + 1) & mask) {
+            if (_entries[pos].id == id)
+                return pos;
+        }
+        return npos;
+    }
+
+    // returns the position of the id or of the free slot where it belongs
+    size_t utxo_store::partition_type::_insert_pos(const tx_out_ref &id)
+    {
+        if ((_size + 1) * 4 > _entries.size() * 3)
+            _grow();
+        const auto mask = _entries.size() - 1;
+        size_t pos = _hash(id) & mask;
+        while (_entries[pos].addr_id && !(_entries[pos].id == id))
+            pos = (pos + 1) & mask;
+        return pos;
+    }
+
+    void utxo_store::partition_type::_set(entry &e, const tx_out_data &data)
+    {
+        if (data.address_raw.empty()) [[unlikely]]
+            throw error(fmt::format("TXO {} has an empty address", e.id));
+        e.addr_id = _addrs.acquire(data.address_raw);
+        e.coin = data.coin;
+        e.extras_offset = 0;
+        e.extras_size = 0;
+        if (!data.assets.empty() || data.datum || data.script_ref) {
+            uint8_vector extras {};
+            ::zpp::bits::out out { extras };
+            out(data.assets, data.datum, data.script_ref).or_throw();
+            if (extras.size() > std::numeric_limits<uint32_t>::max()) [[unlikely]]
+                throw error(fmt::format("TXO {} has too much data: {} bytes", e.id, extras.size()));
+            e.extras_offset = _extras.size();
+            e.extras_size = static_cast<uint32_t>(extras.size());
+            _extras.insert(_extras.end(), extras.begin(), extras.end());
+        }
+    }
+
+    void utxo_store::partition_type::_release(const entry &e)
+    {
+        _addrs.release(e.addr_id);
+        _extras_garbage += e.extras_size;
+    }
+
+    void utxo_store::partition_type::_remove_at(const size_t pos)
+    {
+        _release(_entries[pos]);
+        const auto mask = _entries.size() - 1;
+        const auto free_pos = shift_back(_entries, pos,
+            [](const entry &e) { return e.addr_id != 0; },
+            [&](const entry &e) { return _hash(e.id) & mask; });
+        _entries[free_pos] = {};
+        --_size;
+        if (_extras_garbage >= min_compact_garbage && _extras_garbage * 2 >= _extras.size())
+            _compact_extras();
+    }
+
+    tx_out_data utxo_store::partition_type::_decode(const entry &e) const
+    {
+        tx_out_data data {};
+        data.address_raw = _addrs.get(e.addr_id);
+        data.coin = e.coin;
+        if (e.extras_size) {
+            const buffer extras { _extras.data() + e.extras_offset, e.extras_size };
+            ::zpp::bits::in in { extras };
+            in(data.assets, data.datum, data.script_ref).or_throw();
+        }
+        return data;
+    }
+
+    void utxo_store::partition_type::_grow()
+    {
+        vector<entry> entries(std::max(min_capacity, _entries.size() * 2));
+        const auto mask = entries.size() - 1;
+        for (const auto &e: _entries) {
+            if (e.addr_id) {
+                auto pos = _hash(e.id) & mask;
+                while (entries[pos].addr_id)
+                    pos = (pos + 1) & mask;
+                entries[pos] = e;
+            }
+        }
+        _entries = std::move(entries);
+    }
+
+    void utxo_store::partition_type::_compact_extras()
+    {
+        uint8_vector extras {};
+        extras.reserve(_extras.size() - _extras_garbage);
+        for (auto &e: _entries) {
+            if (e.addr_id && e.extras_size) {
+                const auto new_offset = extras.size();
+                extras.insert(extras.end(), _extras.begin() + e.extras_offset, _extras.begin() + e.extras_offset + e.extras_size);
+                e.extras_offset = new_offset;
+            }
+        }
+        _extras = std::move(extras);
+        _extras_garbage = 0;
+    }
+
+    void utxo_store::partition_type::_clear_hot()
+    {
+        // new objects rather than cleared ones, so that the memory is released
+        _entries = {};
+        _size = 0;
+        _extras = uint8_vector {};
+        _extras_garbage = 0;
+        _addrs = {};
+    }
+
+    size_t utxo_store::partition_type::_hot_memory_usage() const
+    {
+        return _entries.capacity() * sizeof(entry) + _extras.capacity() + _addrs.memory_usage();
+    }
+
+    void utxo_store::partition_type::_spill_if_needed()
+    {
+        const auto budget = _cfg->hot_budget / num_parts;
+        if (!budget || _hot_memory_usage() <= budget) [[likely]]
+            return;
+        spill();
+        // keeps at least a half of the budget free, so that the spills are not too frequent
+        if (_hot_memory_usage() > budget / 2)
+            spill(true);
+    }
+
+    std::optional<std::pair<uint64_t, tx_out_data>> utxo_store::partition_type::_cold_find(const tx_out_ref &id) const
+    {
+        // a spent and recreated id may have dead copies in the older runs, but only one live one
+        for (const auto &cp: _cold) {
+            if (auto res = cp.run->find(id); res && !cp.deleted(res->first)) {
+                res->first += cp.first;
+                return res;
+            }
+        }
+        return {};
+    }
+
+    void utxo_store::partition_type::_cold_erase(const uint64_t item_no, const uint64_t coin)
+    {
+        const auto cp_it = _cold.begin() + (&_cold_part(item_no) - _cold.data());
+        const auto local_no = item_no - cp_it->first;
+        cp_it->dead[local_no >> 6] |= 1ULL << (local_no & 63);
+        --_cold_size;
+        _cold_balance -= coin;
+        if (!--cp_it->size) {
+            _cold.erase(cp_it);
+            _cold_renumber();
+        }
+    }
+
+    void utxo_store::partition_type::_cold_clear()
+    {
+        _cold.clear();
+        _cold_size = 0;
+        _cold_balance = 0;
+    }
+
+    void utxo_store::partition_type::_cold_add(utxo_cold_run_ptr run)
+    {
+        if (!run)
+            return;
+        _cold_size += run->size();
+        _cold_balance += run->balance();
+        const auto num_items = run->size();
+        _cold.emplace_back(std::move(run), vector<uint64_t>((num_items + 63) / 64), _cold_items(), num_items);
+    }
+
+    void utxo_store::partition_type::_cold_merge(const size_t first_part)
+    {
+        utxo_cold_run::writer w { _cfg->cold_dir };
+        _cold_for_each([&](const auto &it) {
+            w.add(it);
+        }, first_part);
+        auto run = w.finish();
+        // the live items and their balance stay the same
+        _cold.erase(_cold.begin() + first_part, _cold.end());
+        if (run) {
+            const auto num_items = run->size();
+            _cold.emplace_back(std::move(run), vector<uint64_t>((num_items + 63) / 64), _cold_items(), num_items);
+        }
+    }
+
+    void utxo_store::partition_type::_cold_renumber()
+    {
+        uint64_t first = 0;
+        for (auto &cp: _cold) {
+            cp.first = first;
+            first += cp.run->size();
+        }
+    }
+
+    struct utxo_store::partition_type::cold_cursor {
+        explicit cold_cursor(const cold_part &part): _part { &part }
+        {
+            _skip_dead();
+        }
+
+        bool done() const
+        {
+            return _pos >= _items.size();
+        }
+
+        const utxo_cold_run::item &operator*() const
+        {
+            return _items[_pos];
+        }
+
+        void next()
+        {
+            ++_pos;
+            _skip_dead();
+        }
+    private:
+        const cold_part *_part;
+        utxo_cold_run::item_list _items {};
+        size_t _next_block = 0;
+        size_t _pos = 0;
+        uint64_t _first = 0;
+
+        // only one block of the run is in memory at a time
+        void _skip_dead()
+        {
+            const auto &blocks = _part->run->blocks();
+            for (;;) {
+                while (_pos < _items.size() && _part->deleted(_first + _pos))
+                    ++_pos;
+                if (_pos < _items.size() || _next_block >= blocks.size())
+                    return;
+                _items = _part->run->read_block(_next_block);
+                _first = blocks[_next_block].first_item;
+                _pos = 0;
+                ++_next_block;
+            }
+        }
+    };
+
+    void utxo_store::partition_type::_cold_for_each(const std::function<void(const utxo_cold_run::item &)> &observer, const size_t first_part) const
+    {
+        vector<cold_cursor> cursors {};
+        for (size_t pi = first_part; pi < _cold.size(); ++pi) {
+            if (cold_cursor c { _cold[pi] }; !c.done())
+                cursors.emplace_back(std::move(c));
+        }
+        // the number of runs is logarithmic in the number of items, so a linear search of the smallest id is enough
+        while (!cursors.empty()) {
+            auto min_it = cursors.begin();
+            for (auto it = std::next(min_it); it != cursors.end(); ++it) {
+                if ((**it).id < (**min_it).id)
+                    min_it = it;
+            }
+            observer(**min_it);
+            min_it->next();
+            if (min_it->done())
+                cursors.erase(min_it);
+        }
+    }
+
+    utxo_store utxo_store::from_cbor(cbor::zero2::value &v, const utxo_store_config_ptr &cfg)
+    {
+        utxo_store res { cfg };
+        auto &it = v.map();
+        while (!it.done()) {
+            auto &key = it.read_key();
+            const auto id = tx_out_ref::from_cbor(key);
+            auto &val = it.read_val(std::move(key));
+            res.try_emplace(id, tx_out_data::from_cbor(val));
+        }
+        return res;
+    }
+
+    utxo_store::utxo_store(const utxo_store_config_ptr &cfg)
+    {
+        for (auto &part: _parts)
+            part = partition_type { cfg };
+    }
+
+    utxo_store::utxo_store(const txo_map &m, const utxo_store_config_ptr &cfg): utxo_store { cfg }
+    {
+        for (const auto &[id, data]: m) {
+            if (!try_emplace(id, data)) [[unlikely]]
+                throw error(fmt::format("duplicate TXO {}", id));
+        }
+    }
+
+    bool utxo_store::operator==(const utxo_store &o) const
+    {
+        return _parts == o._parts;
+    }
+
+    size_t utxo_store::size() const
+    {
+        size_t sz = 0;
+        for (const auto &part: _parts)
+            sz += part.size();
+        return sz;
+    }
+
+    size_t utxo_store::memory_usage() const
+    {
+        size_t sz = 0;
+        for (const auto &part: _parts)
+            sz += part.memory_usage();
+        return sz;
+    }
+
+    void utxo_store::clear()
+    {
+        for (auto &part: _parts)
+            part.clear();
+    }
+
+    void utxo_store::mark_base()
+    {
+        for (auto &part: _parts)
+            part.mark_base();
+    }
+
+    bool utxo_store::has_delta() const
+    {
+        return std::all_of(_parts.begin(), _parts.end(), [](const auto &part) { return part.has_delta(); });
+    }
+}
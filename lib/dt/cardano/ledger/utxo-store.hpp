@@ -0,0 +1,560 @@
+/* This file is part of Daedalus Turbo project: https://github.com/sierkov/daedalus-turbo/
+ * Copyright (c) 2022-2023 Alex Sierkov (alex dot sierkov at gmail dot com)
+ * Copyright (c) 2024-2025 R2 Rationality OÜ (info at r2rationality dot com)
+ * This code is distributed under the license specified in:
+ * https://github.com/sierkov/daedalus-turbo/blob/main/LICENSE */
+#ifndef DAEDALUS_TURBO_CARDANO_LEDGER_UTXO_STORE_HPP
+#define DAEDALUS_TURBO_CARDANO_LEDGER_UTXO_STORE_HPP
+
+#include <filesystem>
+#include <dt/cardano/common/types.hpp>
+#include <dt/common/batch-read.hpp>
+
+namespace daedalus_turbo::cardano::ledger {
+    struct utxo_store_config;
+    using utxo_store_config_ptr = std::shared_ptr<const utxo_store_config>;
+
+    struct utxo_store_config {
+        // the memory budget of all partitions together; zero keeps all UTxOs in memory
+        uint64_t hot_budget = 0;
+        // the directory for the partitions' cold runs; the runs are removed once they are no longer used,
+        // and the directory itself is never cleaned
+        std::filesystem::path cold_dir {};
+        // a partition stops recording its changes once their number exceeds this share of its size and min_changed,
+        // since a delta that large costs about as much as a full snapshot, which then becomes the new base
+        double max_changed_share = 0.25;
+        size_t min_changed = 1 << 10;
+
+        // the process-wide defaults of the stores constructed without a config;
+        // the DT_UTXO_HOT_MB and DT_UTXO_COLD_DIR environment variables override them
+        static const utxo_store_config_ptr &get();
+    };
+
+    // An immutable file with UTxOs sorted by their ids and split into blocks.
+    // The block index and a Bloom filter stay in memory, so a lookup of a missing id rarely touches the disk.
+    // The file is removed once the last reference to the run is gone.
+    struct utxo_cold_run {
+        struct item {
+            tx_out_ref id {};
+            tx_out_data data {};
+
+            static constexpr auto serialize(auto &archive, auto &self)
+            {
+                return archive(self.id, self.data);
+            }
+        };
+        using item_list = vector<item>;
+
+        struct block {
+            tx_out_ref first_id {};
+            uint64_t offset = 0;
+            uint32_t size = 0;
+            uint32_t first_item = 0;
+        };
+
+        // accepts the items in the increasing order of their ids
+        struct writer {
+            explicit writer(const std::filesystem::path &dir);
+            ~writer();
+            void add(const item &it);
+            // returns nullptr if no items have been added
+            std::shared_ptr<const utxo_cold_run> finish();
+        private:
+            std::string _path;
+            file::write_stream _ws;
+            item_list _items {};
+            vector<block> _blocks {};
+            vector<tx_out_ref> _ids {};
+            uint64_t _offset = 0;
+            uint64_t _num_items = 0;
+            uint64_t _balance = 0;
+            bool _finished = false;
+
+            void _flush();
+        };
+
+        static constexpr size_t block_items = 128;
+
+        ~utxo_cold_run();
+        // returns the item's number and data
+        std::optional<std::pair<uint64_t, tx_out_data>> find(const tx_out_ref &id) const;
+        item_list read_block(size_t block_idx) const;
+        size_t memory_usage() const;
+
+        const vector<block> &blocks() const
+        {
+            return _blocks;
+        }
+
+        uint64_t size() const
+        {
+            return _num_items;
+        }
+
+        uint64_t balance() const
+        {
+            return _balance;
+        }
+    private:
+        file::read_handle _file;
+        vector<block> _blocks;
+        vector<uint64_t> _filter;
+        uint64_t _num_items;
+        uint64_t _balance;
+
+        utxo_cold_run(const std::string &path, vector<block> &&blocks, vector<uint64_t> &&filter, uint64_t num_items, uint64_t balance);
+        static constexpr size_t filter_bits_per_item = 16;
+        static constexpr size_t filter_probes = 4;
+
+        static std::array<uint64_t, filter_probes> _filter_bits(const tx_out_ref &id, uint64_t num_bits);
+    };
+    using utxo_cold_run_ptr = std::shared_ptr<const utxo_cold_run>;
+
+    // A compact UTxO set with the same partitioning as txo_map.
+    // Each partition is an open-addressing hash table of fixed-size entries holding the coin inline,
+    // while the variable-size data lives in the partition's arenas: addresses are interned and reference-counted,
+    // and the assets, datum, and script reference, if any, are serialized into a single blob.
+    // The partitions share nothing, so different partitions can be updated in parallel.
+    // With a non-zero hot budget, a partition exceeding its share of it moves the entries that have been there
+    // since its previous spill into a new cold run on disk. The recently created outputs, which are the most likely
+    // to be spent soon, stay in memory. A new run is merged with the preceding ones while they are less than
+    // twice its size, so every cold item is rewritten only a logarithmic number of times.
+    struct utxo_store {
+        static constexpr size_t num_parts = txo_map::num_parts;
+
+        // the changes of a partition since its base: the removed ids and the current values of the added or updated ones
+        struct partition_delta {
+            vector<tx_out_ref> erased {};
+            utxo_cold_run::item_list upserted {};
+
+            static constexpr auto serialize(auto &archive, auto &self)
+            {
+                return archive(self.erased, self.upserted);
+            }
+        };
+
+        struct partition_type {
+            using value_type = std::pair<tx_out_ref, tx_out_data>;
+
+            struct const_iterator {
+                using difference_type = std::ptrdiff_t;
+                using value_type = partition_type::value_type;
+
+                const_iterator() =default;
+
+                const_iterator(const partition_type &part, const size_t pos): _part { &part }, _pos { pos }
+                {
+                    _next_valid();
+                }
+
+                bool operator==(const const_iterator &o) const
+                {
+                    return _part == o._part && _pos == o._pos;
+                }
+
+                // the values are decoded on access, so the iterator returns copies
+                value_type operator*() const
+                {
+                    if (_pos < _part->_entries.size()) {
+                        const auto &e = _part->_entries[_pos];
+                        return { e.id, _part->_decode(e) };
+                    }
+                    const auto &it = (*_cold_items)[_pos - _part->_entries.size() - _cold_first];
+                    return { it.id, it.data };
+                }
+
+                const_iterator &operator++()
+                {
+                    ++_pos;
+                    _next_valid();
+                    return *this;
+                }
+
+                const_iterator operator++(int)
+                {
+                    auto copy = *this;
+                    ++(*this);
+                    return copy;
+                }
+            private:
+                const partition_type *_part = nullptr;
+                // the positions past the hot entries are the numbers of the cold items
+                size_t _pos = 0;
+                std::shared_ptr<const utxo_cold_run::item_list> _cold_items {};
+                uint64_t _cold_first = 0;
+
+                void _next_valid()
+                {
+                    while (_pos < _part->_entries.size() && !_part->_entries[_pos].addr_id)
+                        ++_pos;
+                    if (_pos >= _part->_entries.size()) {
+                        const auto end_pos = _part->_entries.size() + _part->_cold_items();
+                        while (_pos < end_pos && _part->_cold_deleted(_pos - _part->_entries.size()))
+                            ++_pos;
+                        if (_pos < end_pos)
+                            _load_cold(_pos - _part->_entries.size());
+                    }
+                }
+
+                void _load_cold(const uint64_t item_no)
+                {
+                    if (_cold_items && item_no >= _cold_first && item_no < _cold_first + _cold_items->size())
+                        return;
+                    const auto &cp = _part->_cold_part(item_no);
+                    const auto &blocks = cp.run->blocks();
+                    const auto it = std::upper_bound(blocks.begin(), blocks.end(), item_no - cp.first,
+                        [](const uint64_t no, const utxo_cold_run::block &b) { return no < b.first_item; });
+                    const auto block_idx = static_cast<size_t>(it - blocks.begin()) - 1;
+                    _cold_items = std::make_shared<const utxo_cold_run::item_list>(cp.run->read_block(block_idx));
+                    _cold_first = cp.first + blocks[block_idx].first_item;
+                }
+            };
+
+            partition_type() =default;
+
+            explicit partition_type(utxo_store_config_ptr cfg): _cfg { std::move(cfg) }
+            {
+            }
+
+            // the cold items are stored inline as a sorted list, so the result does not depend on the run files;
+            // they are streamed one by one in both directions, so that a snapshot never holds them all in memory
+            static constexpr auto serialize(auto &archive, auto &self)
+            {
+                // the count is written as zpp_bits writes the size of a vector
+                uint32_t num_cold = 0;
+                if constexpr (std::remove_cvref_t<decltype(archive)>::kind() == ::zpp::bits::kind::out) {
+                    if (self._cold_size > std::numeric_limits<uint32_t>::max()) [[unlikely]]
+                        throw error(fmt::format("too many cold UTxOs in a partition: {}", self._cold_size));
+                    num_cold = static_cast<uint32_t>(self._cold_size);
+                    auto res = archive(self._entries, self._size, self._extras, self._extras_garbage, self._addrs, self._gen, num_cold);
+                    // zpp_bits also visits the members only to count them
+                    if constexpr (std::is_same_v<decltype(res), ::zpp::bits::errc>) {
+                        self._cold_for_each([&](const utxo_cold_run::item &it) {
+                            if (!::zpp::bits::failure(res)) [[likely]]
+                                res = archive(it);
+                        });
+                    }
+                    return res;
+                } else {
+                    if (const auto res = archive(self._entries, self._size, self._extras, self._extras_garbage, self._addrs, self._gen, num_cold);
+                            ::zpp::bits::failure(res)) [[unlikely]]
+                        return res;
+                    self._cold_clear();
+                    if (num_cold) {
+                        utxo_cold_run::writer w { self._cfg->cold_dir };
+                        for (uint32_t i = 0; i < num_cold; ++i) {
+                            utxo_cold_run::item it {};
+                            if (const auto res = archive(it); ::zpp::bits::failure(res)) [[unlikely]]
+                                return res;
+                            w.add(it);
+                        }
+                        self._cold_add(w.finish());
+                    }
+                    // the loaded contents are not a base of any delta
+                    self._track_changes = false;
+                    self._changed.clear();
+                    return ::zpp::bits::errc {};
+                }
+            }
+
+            bool operator==(const partition_type &o) const;
+
+            const_iterator begin() const
+            {
+                return { *this, 0 };
+            }
+
+            const_iterator end() const
+            {
+                return { *this, _entries.size() + _cold_items() };
+            }
+
+            size_t size() const
+            {
+                return _size + _cold_size;
+            }
+
+            bool empty() const
+            {
+                return size() == 0;
+            }
+
+            // the number of entries on disk
+            size_t cold_size() const
+            {
+                return _cold_size;
+            }
+
+            bool contains(const tx_out_ref &id) const
+            {
+                return _find(id) != npos || _cold_find(id);
+            }
+
+            const utxo_store_config_ptr &config() const
+            {
+                return _cfg;
+            }
+
+            void clear();
+            std::optional<tx_out_data> find(const tx_out_ref &id) const;
+            // returns false and keeps the present value if the id is already there
+            bool try_emplace(const tx_out_ref &id, const tx_out_data &data);
+            void insert_or_assign(const tx_out_ref &id, const tx_out_data &data);
+            // removes the entry and returns its value
+            std::optional<tx_out_data> extract(const tx_out_ref &id);
+            bool erase(const tx_out_ref &id);
+            // moves the entries older than the previous spill or, if all is set, all of them to disk
+            void spill(bool all=false);
+            // starts recording the changed ids, so that the following deltas are made against the current contents
+            void mark_base();
+            // false if there is no base or too many changes since it; delta() throws then
+            bool has_delta() const
+            {
+                return _track_changes && !_changed_overflow;
+            }
+            partition_delta delta() const;
+            void apply(const partition_delta &d);
+            uint64_t balance() const;
+            size_t memory_usage() const;
+            // writes the entries in the order of their ids as expected by Cardano Node
+            void to_cbor(era_encoder &enc) const;
+
+            template<typename F>
+            size_t erase_if(const F &pred)
+            {
+                vector<tx_out_ref> ids {};
+                for (const auto &item: *this) {
+                    if (pred(item))
+                        ids.emplace_back(item.first);
+                }
+                for (const auto &id: ids)
+                    erase(id);
+                return ids.size();
+            }
+        private:
+            static constexpr size_t npos = std::numeric_limits<size_t>::max();
+            static constexpr size_t min_capacity = 16;
+
+            struct entry {
+                tx_out_ref id {};
+                // zero marks a free slot
+                uint32_t addr_id = 0;
+                uint32_t extras_size = 0;
+                // the number of spills preceding the creation of the entry
+                uint32_t gen = 0;
+                uint64_t coin = 0;
+                uint64_t extras_offset = 0;
+
+                static constexpr auto serialize(auto &archive, auto &self)
+                {
+                    return archive(self.id, self.addr_id, self.extras_size, self.gen, self.coin, self.extras_offset);
+                }
+            };
+
+            struct addr_table {
+                struct info {
+                    uint64_t offset = 0;
+                    uint32_t size = 0;
+                    // zero marks a free id
+                    uint32_t refs = 0;
+
+                    static constexpr auto serialize(auto &archive, auto &self)
+                    {
+                        return archive(self.offset, self.size, self.refs);
+                    }
+                };
+
+                static constexpr auto serialize(auto &archive, auto &self)
+                {
+                    return archive(self._bytes, self._infos, self._free_ids, self._slots, self._size, self._garbage);
+                }
+
+                void clear();
+                uint32_t acquire(buffer addr);
+                void release(uint32_t id);
+                size_t memory_usage() const;
+
+                buffer get(const uint32_t id) const
+                {
+                    const auto &i = _infos[id - 1];
+                    return { _bytes.data() + i.offset, i.size };
+                }
+            private:
+                uint8_vector _bytes {};
+                vector<info> _infos {};
+                vector<uint32_t> _free_ids {};
+                // ids of the interned addresses, zero marks a free slot
+                vector<uint32_t> _slots {};
+                uint64_t _size = 0;
+                uint64_t _garbage = 0;
+
+                static uint64_t _hash(buffer addr);
+                size_t _find(buffer addr, uint64_t hash) const;
+                void _grow();
+                void _compact();
+            };
+
+            // the live items of a cold run
+            struct cold_part {
+                utxo_cold_run_ptr run {};
+                // a bit per item of the run
+                vector<uint64_t> dead {};
+                // the number of the first item in the numbering continuing across the runs
+                uint64_t first = 0;
+                uint64_t size = 0;
+
+                bool deleted(const uint64_t item_no) const
+                {
+                    return (dead[item_no >> 6] >> (item_no & 63)) & 1;
+                }
+            };
+            struct cold_cursor;
+
+            utxo_store_config_ptr _cfg = utxo_store_config::get();
+            vector<entry> _entries {};
+            uint64_t _size = 0;
+            uint8_vector _extras {};
+            uint64_t _extras_garbage = 0;
+            addr_table _addrs {};
+            uint32_t _gen = 0;
+            // from the oldest to the newest run
+            vector<cold_part> _cold {};
+            uint64_t _cold_size = 0;
+            uint64_t _cold_balance = 0;
+            bool _track_changes = false;
+            bool _changed_overflow = false;
+            // may repeat ids; deduplicated when a delta is made or the list grows too long
+            vector<tx_out_ref> _changed {};
+
+            static uint64_t _hash(const tx_out_ref &id);
+            size_t _find(const tx_out_ref &id) const;
+            size_t _insert_pos(const tx_out_ref &id);
+            void _set(entry &e, const tx_out_data &data);
+            void _release(const entry &e);
+            void _remove_at(size_t pos);
+            tx_out_data _decode(const entry &e) const;
+            void _grow();
+            void _compact_extras();
+            void _clear_hot();
+            size_t _hot_memory_usage() const;
+            void _spill_if_needed();
+            // returns the number of the live cold item and its data
+            std::optional<std::pair<uint64_t, tx_out_data>> _cold_find(const tx_out_ref &id) const;
+            void _cold_erase(uint64_t item_no, uint64_t coin);
+            void _cold_clear();
+            // appends a run with the newest items, if any
+            void _cold_add(utxo_cold_run_ptr run);
+            // replaces the runs starting from first_part with a single run of their live items
+            void _cold_merge(size_t first_part);
+            void _cold_renumber();
+            // calls the observer for the live items of the runs starting from first_part in the order of their ids
+            void _cold_for_each(const std::function<void(const utxo_cold_run::item &)> &observer, size_t first_part=0) const;
+            void _compact_changed();
+
+            // the number of cold items including the deleted ones
+            uint64_t _cold_items() const
+            {
+                return _cold.empty() ? 0 : _cold.back().first + _cold.back().run->size();
+            }
+
+            const cold_part &_cold_part(const uint64_t item_no) const
+            {
+                return *std::prev(std::upper_bound(_cold.begin(), _cold.end(), item_no,
+                    [](const uint64_t no, const cold_part &p) { return no < p.first; }));
+            }
+
+            bool _cold_deleted(const uint64_t item_no) const
+            {
+                const auto &cp = _cold_part(item_no);
+                return cp.deleted(item_no - cp.first);
+            }
+
+            size_t _max_changed() const
+            {
+                return std::max(_cfg->min_changed, static_cast<size_t>(static_cast<double>(size()) * _cfg->max_changed_share));
+            }
+
+            void _track(const tx_out_ref &id)
+            {
+                if (_track_changes && !_changed_overflow) {
+                    _changed.emplace_back(id);
+                    // the repeats are dropped only now and then to keep the updates cheap
+                    if (_changed.size() >= 2 * _max_changed()) [[unlikely]]
+                        _compact_changed();
+                }
+            }
+        };
+
+        static size_t partition_idx(const tx_out_ref &id)
+        {
+            return txo_map::partition_idx(id);
+        }
+
+        static utxo_store from_cbor(cbor::zero2::value &v, const utxo_store_config_ptr &cfg=utxo_store_config::get());
+
+        static constexpr auto serialize(auto &archive, auto &self)
+        {
+            return archive(self._parts);
+        }
+
+        utxo_store() =default;
+        explicit utxo_store(const utxo_store_config_ptr &cfg);
+        utxo_store(const txo_map &m, const utxo_store_config_ptr &cfg=utxo_store_config::get());
+        bool operator==(const utxo_store &o) const;
+        size_t size() const;
+        size_t memory_usage() const;
+        void clear();
+        void mark_base();
+        // true if every partition can make a delta against the last base
+        bool has_delta() const;
+
+        const utxo_store_config_ptr &config() const
+        {
+            return _parts.front().config();
+        }
+
+        bool empty() const
+        {
+            return size() == 0;
+        }
+
+        std::optional<tx_out_data> find(const tx_out_ref &id) const
+        {
+            return _parts[partition_idx(id)].find(id);
+        }
+
+        bool contains(const tx_out_ref &id) const
+        {
+            return _parts[partition_idx(id)].contains(id);
+        }
+
+        bool try_emplace(const tx_out_ref &id, const tx_out_data &data)
+        {
+            return _parts[partition_idx(id)].try_emplace(id, data);
+        }
+
+        std::optional<tx_out_data> extract(const tx_out_ref &id)
+        {
+            return _parts[partition_idx(id)].extract(id);
+        }
+
+        bool erase(const tx_out_ref &id)
+        {
+            return _parts[partition_idx(id)].erase(id);
+        }
+
+        partition_type &partition(const size_t part_idx)
+        {
+            return _parts.at(part_idx);
+        }
+
+        const partition_type &partition(const size_t part_idx) const
+        {
+            return _parts.at(part_idx);
+        }
+    private:
+        std::array<partition_type, num_parts> _parts {};
+    };
+}
+
+#endif // !DAEDALUS_TURBO_CARDANO_LEDGER_UTXO_STORE_HPP
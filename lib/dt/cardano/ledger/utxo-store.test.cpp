@@ -0,0 +1,296 @@
+/* This file is part of Daedalus Turbo project: https://github.com/sierkov/daedalus-turbo/
+ * Copyright (c) 2022-2023 Alex Sierkov (alex dot sierkov at gmail dot com)
+ * Copyright (c) 2024-2025 R2 Rationality OÜ (info at r2rationality dot com)
+ * This code is distributed under the license specified in:
+ * https://github.com/sierkov/daedalus-turbo/blob/main/LICENSE */
+
+#include <random>
+#include <dt/common/test.hpp>
+#include <dt/cardano/ledger/utxo-store.hpp>
+#include <dt/zpp.hpp>
+
+namespace {
+    using namespace daedalus_turbo;
+    using namespace daedalus_turbo::cardano;
+    using namespace daedalus_turbo::cardano::ledger;
+
+    tx_out_ref make_id(const uint64_t tx_no, const size_t out_idx)
+    {
+        return { blake2b<tx_hash>(buffer::from(tx_no)), out_idx };
+    }
+
+    // a few shared addresses, assets, datums, and script references as in the real UTxO set
+    tx_out_data make_data(std::default_random_engine &rnd)
+    {
+        tx_out_data data {};
+        // an enterprise address
+        const auto pay_id = blake2b<blake2b_224_hash>(buffer::from(static_cast<uint64_t>(rnd() % 50)));
+        data.address_raw << uint8_t { 0x61 } << pay_id;
+        data.coin = rnd() % 1'000'000'000;
+        if (rnd() % 4 == 0) {
+            const auto policy_id = blake2b<script_hash>(buffer::from(static_cast<uint64_t>(rnd() % 3)));
+            data.assets[policy_id][asset_name_t { buffer::from(static_cast<uint64_t>(rnd() % 5)) }] = rnd() % 1000 + 1;
+        }
+        if (rnd() % 8 == 0)
+            data.datum.emplace(datum_hash { blake2b<datum_hash>(buffer::from(static_cast<uint64_t>(rnd()))) });
+        if (rnd() % 16 == 0)
+            data.script_ref.emplace(script_type::plutus_v2, uint8_vector::from_hex("4e4d01000033222220051200120011"));
+        return data;
+    }
+}
+
+suite cardano_ledger_utxo_store_suite = [] {
+    "cardano::ledger::utxo_store"_test = [] {
+        "basic operations"_test = [] {
+            std::default_random_engine rnd { 12345 };
+            utxo_store st {};
+            const auto id = make_id(1, 0);
+            const auto data = make_data(rnd);
+            expect(st.empty());
+            expect(!st.find(id));
+            expect(st.try_emplace(id, data));
+            expect(!st.try_emplace(id, make_data(rnd)));
+            test_same(1, st.size());
+            expect(st.contains(id));
+            expect(st.find(id) == data);
+            const auto pi = utxo_store::partition_idx(id);
+            auto &part = st.partition(pi);
+            test_same(data.coin, part.balance());
+            auto data2 = data;
+            data2.coin += 1;
+            part.insert_or_assign(id, data2);
+            test_same(1, st.size());
+            expect(st.find(id) == data2);
+            expect(st.extract(id) == data2);
+            expect(!st.erase(id));
+            expect(st.empty());
+            test_same(0, part.balance());
+            expect(throws([&] { st.try_emplace(id, tx_out_data {}); }));
+        };
+        "matches txo_map"_test = [] {
+            std::default_random_engine rnd { 12345 };
+            txo_map exp {};
+            utxo_store act {};
+            vector<tx_out_ref> live {};
+            // enough updates to grow the tables and to compact the arenas of some partitions
+            for (size_t i = 0; i < 200'000; ++i) {
+                if (live.empty() || rnd() % 3 != 0) {
+                    const auto id = make_id(i, rnd() % 4);
+                    const auto data = make_data(rnd);
+                    exp.try_emplace(id, data);
+                    act.try_emplace(id, data);
+                    live.emplace_back(id);
+                } else {
+                    const auto li = rnd() % live.size();
+                    const auto id = live[li];
+                    live[li] = live.back();
+                    live.pop_back();
+                    const auto data = act.extract(id);
+                    expect(data && *data == exp.at(id));
+                    exp.erase(id);
+                }
+            }
+            test_same(exp.size(), act.size());
+            size_t num_same = 0;
+            uint64_t balance = 0;
+            for (size_t pi = 0; pi < utxo_store::num_parts; ++pi) {
+                const auto &part = act.partition(pi);
+                for (const auto &[id, data]: part)
+                    num_same += exp.at(id) == data;
+                balance += part.balance();
+            }
+            test_same(exp.size(), num_same);
+            uint64_t exp_balance = 0;
+            for (const auto &[id, data]: exp)
+                exp_balance += data.coin;
+            test_same(exp_balance, balance);
+            expect(act == utxo_store { exp });
+            expect(act.memory_usage() > 0);
+        };
+        "arena compaction"_test = [] {
+            std::default_random_engine rnd { 12345 };
+            utxo_store::partition_type part {};
+            txo_map exp {};
+            for (uint64_t i = 0; i < 20'000; ++i) {
+                auto data = make_data(rnd);
+                // unique addresses free their arena space once their TXOs are gone
+                data.address_raw = uint8_vector {};
+                data.address_raw << uint8_t { 0x61 } << blake2b<blake2b_224_hash>(buffer::from(i));
+                const auto id = make_id(i, 0);
+                part.try_emplace(id, data);
+                exp.try_emplace(id, data);
+            }
+            const auto full_usage = part.memory_usage();
+            for (uint64_t i = 0; i < 20'000; ++i) {
+                if (i % 4 != 0) {
+                    expect(part.erase(make_id(i, 0)));
+                    exp.erase(make_id(i, 0));
+                }
+            }
+            test_same(exp.size(), part.size());
+            size_t num_same = 0;
+            for (const auto &[id, data]: exp)
+                num_same += part.find(id) == data;
+            test_same(exp.size(), num_same);
+            // the tables keep their capacity, but the arenas shrink
+            expect(part.memory_usage() < full_usage);
+        };
+        "serialization"_test = [] {
+            std::default_random_engine rnd { 12345 };
+            txo_map exp {};
+            for (size_t i = 0; i < 10'000; ++i)
+                exp.try_emplace(make_id(i, i % 3), make_data(rnd));
+            const utxo_store st { exp };
+            {
+                uint8_vector zpp_data {};
+                daedalus_turbo::zpp::serialize(zpp_data, st);
+                const auto st2 = daedalus_turbo::zpp::deserialize<utxo_store>(zpp_data);
+                expect(st2 == st);
+                auto st3 = st2;
+                const auto id = make_id(10'000, 0);
+                const auto data = make_data(rnd);
+                expect(st3.try_emplace(id, data));
+                expect(st3.find(id) == data);
+            }
+            for (size_t pi = 0; pi < utxo_store::num_parts; pi += 17) {
+                era_encoder exp_enc { era_t::conway };
+                for (const auto &[id, data]: exp.partition(pi)) {
+                    exp_enc.array(2).bytes(id.hash).uint(id.idx);
+                    data.to_cbor(exp_enc);
+                }
+                era_encoder act_enc { era_t::conway };
+                st.partition(pi).to_cbor(act_enc);
+                expect(exp_enc.cbor() == act_enc.cbor()) << pi;
+            }
+        };
+        "deltas"_test = [] {
+            std::default_random_engine rnd { 12345 };
+            utxo_store st {};
+            for (size_t i = 0; i < 10'000; ++i)
+                st.try_emplace(make_id(i, 0), make_data(rnd));
+            const auto base = st;
+            expect(throws([&] { st.partition(0).delta(); }));
+            st.mark_base();
+            for (size_t i = 0; i < 10'000; i += 3)
+                st.erase(make_id(i, 0));
+            for (size_t i = 1; i < 10'000; i += 7)
+                st.partition(utxo_store::partition_idx(make_id(i, 0))).insert_or_assign(make_id(i, 0), make_data(rnd));
+            for (size_t i = 10'000; i < 12'000; ++i) {
+                st.try_emplace(make_id(i, 1), make_data(rnd));
+                // created and spent since the base
+                if (i % 2 == 0)
+                    st.erase(make_id(i, 1));
+            }
+            auto act = base;
+            size_t delta_size = 0;
+            for (size_t pi = 0; pi < utxo_store::num_parts; ++pi) {
+                const auto d = daedalus_turbo::zpp::deserialize<utxo_store::partition_delta>(daedalus_turbo::zpp::serialize(st.partition(pi).delta()));
+                delta_size += d.erased.size() + d.upserted.size();
+                act.partition(pi).apply(d);
+            }
+            expect(act == st);
+            // the distinct ids touched since the base: 3334 erased, 1429 updated, 476 of them both, and 2000 created
+            test_same(3334 + 1429 - 476 + 2000, delta_size);
+        };
+        "delta limit"_test = [] {
+            std::default_random_engine rnd { 12345 };
+            const auto cfg = std::make_shared<const utxo_store_config>(0, std::filesystem::path {}, 0.25, 16);
+            utxo_store st { cfg };
+            for (size_t i = 0; i < 100'000; ++i)
+                st.try_emplace(make_id(i, 0), make_data(rnd));
+            expect(!st.has_delta());
+            st.mark_base();
+            expect(st.has_delta());
+            const auto id = make_id(0, 0);
+            const auto pi = utxo_store::partition_idx(id);
+            auto &part = st.partition(pi);
+            // the repeated changes of the same ids count once
+            for (size_t i = 0; i < 1000; ++i)
+                part.insert_or_assign(id, make_data(rnd));
+            expect(part.has_delta());
+            test_same(1, part.delta().upserted.size());
+            // more changed ids than a quarter of the partition
+            const auto part_size = part.size();
+            for (size_t i = 1'000'000, num_added = 0; num_added <= part_size / 2; ++i) {
+                if (const auto new_id = make_id(i, 0); utxo_store::partition_idx(new_id) == pi)
+                    num_added += part.try_emplace(new_id, make_data(rnd));
+            }
+            expect(!part.has_delta());
+            expect(!st.has_delta());
+            expect(throws([&] { part.delta(); }));
+            // the other partitions are not affected
+            expect(st.partition((pi + 1) % utxo_store::num_parts).has_delta());
+            st.mark_base();
+            expect(st.has_delta());
+            test_same(0, part.delta().upserted.size());
+        };
+        "disk tier"_test = [] {
+            file::tmp_directory tmp_dir { "test-utxo-store-cold" };
+            // 16 KB per partition
+            const auto cfg = std::make_shared<const utxo_store_config>(utxo_store::num_parts << 14, tmp_dir.path());
+            {
+                std::default_random_engine rnd { 12345 };
+                txo_map exp {};
+                utxo_store act { cfg };
+                vector<tx_out_ref> live {};
+                for (size_t i = 0; i < 100'000; ++i) {
+                    if (live.empty() || rnd() % 3 != 0) {
+                        const auto id = make_id(i, rnd() % 4);
+                        const auto data = make_data(rnd);
+                        exp.try_emplace(id, data);
+                        expect(act.try_emplace(id, data));
+                        live.emplace_back(id);
+                    } else {
+                        // spends both the recent and the old TXOs
+                        const auto li = rnd() % live.size();
+                        const auto id = live[li];
+                        live[li] = live.back();
+                        live.pop_back();
+                        const auto data = act.extract(id);
+                        expect(data && *data == exp.at(id));
+                        exp.erase(id);
+                    }
+                }
+                test_same(exp.size(), act.size());
+                size_t cold_size = 0;
+                uint64_t balance = 0;
+                for (size_t pi = 0; pi < utxo_store::num_parts; ++pi) {
+                    cold_size += act.partition(pi).cold_size();
+                    balance += act.partition(pi).balance();
+                }
+                expect(cold_size > exp.size() / 2) << cold_size;
+                // the runs of a partition are merged as they accumulate
+                size_t num_runs = 0;
+                for ([[maybe_unused]] const auto &e: std::filesystem::directory_iterator(tmp_dir.path()))
+                    ++num_runs;
+                expect(num_runs <= utxo_store::num_parts * 8) << num_runs;
+                uint64_t exp_balance = 0;
+                size_t num_same = 0;
+                for (const auto &[id, data]: exp) {
+                    exp_balance += data.coin;
+                    num_same += act.find(id) == data;
+                }
+                test_same(exp.size(), num_same);
+                test_same(exp_balance, balance);
+                for (size_t pi = 0; pi < utxo_store::num_parts; pi += 17) {
+                    era_encoder exp_enc { era_t::conway };
+                    for (const auto &[id, data]: exp.partition(pi)) {
+                        exp_enc.array(2).bytes(id.hash).uint(id.idx);
+                        data.to_cbor(exp_enc);
+                    }
+                    era_encoder act_enc { era_t::conway };
+                    act.partition(pi).to_cbor(act_enc);
+                    expect(exp_enc.cbor() == act_enc.cbor()) << pi;
+                }
+                utxo_store st2 { cfg };
+                daedalus_turbo::zpp::deserialize(st2, daedalus_turbo::zpp::serialize(act));
+                expect(st2 == act);
+                const utxo_store mem_st { exp, std::make_shared<const utxo_store_config>() };
+                expect(mem_st == act);
+                expect(act.memory_usage() < mem_st.memory_usage() / 2) << act.memory_usage() << mem_st.memory_usage();
+            }
+            // the runs are removed together with the stores
+            expect(std::filesystem::is_empty(tmp_dir.path()));
+        };
+    };
+};
@@ -4,17 +4,47 @@
  * This code is distributed under the license specified in:
  * https://github.com/sierkov/daedalus-turbo/blob/main/LICENSE */
 
+#include <charconv>
+#include <future>
 #include <dt/cardano.hpp>
 #include <dt/cardano/ledger/state.hpp>
 #include <dt/chunk-registry.hpp>
+#include <dt/common/batch-read.hpp>
 
 namespace daedalus_turbo {
+    namespace {
+        // the chunk layout of the state files that keep the blocks in the memory-mapped block index segments
+        struct indexed_chunk_info: storage::chunk_info {
+            uint64_t block_segment = 0;
+            uint64_t block_row = 0;
+
+            constexpr static auto serialize(auto &archive, auto &self)
+            {
+                return archive(
+                    self.data_size, self.compressed_size,
+                    self.num_blocks, self.first_slot, self.last_slot,
+                    self.data_hash, self.prev_block_hash, self.last_block_hash,
+                    self.offset, self.frames, self.compression_level, self.generation,
+                    self.block_segment, self.block_row
+                );
+            }
+        };
+        using indexed_chunk_map = std::map<uint64_t, indexed_chunk_info>;
+
+        // must be incremented with any change to the layout of indexed_chunk_info;
+        // the states of the other versions except for the original state.bin are not loaded
+        static constexpr uint64_t state_version = 4;
+    }
+
     chunk_registry::chunk_registry(const std::string &data_dir, const mode mode,
         cardano::config ccfg, scheduler &sched, file_remover &fr, const bool auto_maintenance)
         : _data_dir { data_dir }, _db_dir { init_db_dir((_data_dir / "compressed").string()) },
             _cardano_cfg { std::move(ccfg) }, _sched { sched }, _file_remover { fr },
-            _state_path { (_db_dir / "state.bin").string() },
-            _state_path_pre { (_db_dir / "state-pre.bin").string() }
+            _state_path { (_db_dir / fmt::format("state-v{}.bin", state_version)).string() },
+            _state_path_pre { (_db_dir / fmt::format("state-v{}-pre.bin", state_version)).string() },
+            _state_path_legacy { (_db_dir / "state.bin").string() },
+            _block_index_dir { (_db_dir / "blocks").string() },
+            _dict_dir { (_db_dir / "dict").string() }
     {
         timer t { "chunk-registry construct" };
         switch (mode) {
@@ -31,10 +61,15 @@ namespace daedalus_turbo {
             default:
                 throw error(fmt::format("unsupported mode: {}", static_cast<int>(mode)));
         }
+        _load_dictionaries();
         file_set known_chunks {}, deletable_chunks {};
         chunk_map chunks {};
-        if (std::filesystem::exists(_state_path))
-            zpp::load(chunks, _state_path);
+        if (std::filesystem::exists(_state_path)) {
+            chunks = _load_state(_state_path);
+        } else if (std::filesystem::exists(_state_path_legacy)) {
+            // the original state has the blocks inline and no frame tables, and chunks without a frame table are read whole
+            zpp::load(chunks, _state_path_legacy);
+        }
         for (auto &&[last_byte_offset, chunk]: chunks) {
             const auto path = full_path(chunk.rel_path());
             std::error_code ec {};
@@ -56,13 +91,39 @@ namespace daedalus_turbo {
             auto path = full_path(entry.path().string());
             if (entry.is_regular_file() && entry.path().extension() == ".zstd" && !known_chunks.contains(path))
                 _file_remover.mark(path);
+            // left by an interrupted background recompression
+            else if (entry.is_regular_file() && entry.path().extension() == ".recompress")
+                _file_remover.mark(path);
+            // the states of the versions that are not loaded
+            else if (entry.is_regular_file() && entry.path().extension() == ".bin" && entry.path().stem().string().starts_with("state-v")
+                    && entry.path().filename() != std::filesystem::path { _state_path }.filename()
+                    && entry.path().filename() != std::filesystem::path { _state_path_pre }.filename())
+                _file_remover.mark(path);
         }
+        _mark_unused_block_segments();
         logger::info("chunk_registry has data up to offset {}", num_bytes());
         if (auto_maintenance)
             _maintenance();
     }
 
-    chunk_registry::~chunk_registry() =default;
+    chunk_registry::~chunk_registry()
+    {
+        // the queued recompressions are picked up on the next start
+        _recompress_stop.store(true, std::memory_order_relaxed);
+        if (!_transaction) {
+            logger::run_log_errors([&] {
+                finish_recompression();
+            });
+        }
+        const auto rs = recompression_stat();
+        if (rs.num_chunks) {
+            logger::info("chunk recompression: {} chunks from {} to {} MiB; the fast compression took {:0.3f} sec, the background one {:0.3f} sec",
+                rs.num_chunks, rs.size_before >> 20, rs.size_after >> 20, rs.fast_secs, rs.final_secs);
+        }
+        const auto cs = _chunk_cache.stat();
+        logger::debug("chunk cache hits: {} misses: {} evictions: {} cached: {} chunks {} MiB",
+            cs.hits, cs.misses, cs.evictions, cs.num_chunks, cs.num_bytes >> 20);
+    }
 
     void chunk_registry::register_processor(const chunk_processor &p)
     {
@@ -256,10 +317,9 @@ namespace daedalus_turbo {
                 volatile_chunks.emplace_back(&chunk);
             } else {
                 const auto chunk_id = make_slot(chunk.first_slot).chunk_id();
-                const auto chunk_path = full_path(chunk.rel_path());
                 const auto [it, created] = immutable_chunks.try_emplace(chunk_id, chunk.first_slot);
                 it->second.last_slot = chunk.last_slot;
-                it->second.files.emplace_back(chunk_path);
+                it->second.files.emplace_back(chunk_path(chunk));
                 for (const auto &block: chunk.blocks)
                     it->second.blocks.emplace_back(&block);
             }
@@ -329,7 +389,7 @@ namespace daedalus_turbo {
             uint8_vector volatile_data {};
             vector<size_t> volatile_block_sizes {};
             for (const auto *chunk_ptr: volatile_chunks) {
-                volatile_data << file::read_auto(full_path(chunk_ptr->rel_path()));
+                volatile_data << file::read_auto(chunk_path(*chunk_ptr));
                 for (const auto &block: chunk_ptr->blocks)
                     volatile_block_sizes.emplace_back(block.size);
             }
@@ -494,9 +554,7 @@ namespace daedalus_turbo {
         chunk.num_blocks = chunk.blocks.size();
         if (ok_data.size() != raw_data.size()) {
             chunk.data_size = ok_data.size();
-            const auto compressed = zstd::compress(ok_data);
-            chunk.compressed_size = compressed.size();
-            file::write(full_path(chunk.rel_path()), compressed);
+            _write_chunk(chunk, ok_data);
         }
         for (const auto *p: _processors) {
             if (p->on_chunk_add)
@@ -509,32 +567,383 @@ namespace daedalus_turbo {
         return std::make_pair(std::move(chunk), std::move(ex_ptr));
     }
 
-    buffer chunk_registry::const_iterator::_prep_chunk_cache() const
+    int chunk_registry::fast_compression_level()
+    {
+        if (const char *env_level_str = std::getenv("DT_CHUNK_FAST_LEVEL"); env_level_str != nullptr)
+            return std::stoi(env_level_str);
+        return 3;
+    }
+
+    uint64_t chunk_registry::default_frame_size()
+    {
+        if (const char *env_frame_kb_str = std::getenv("DT_CHUNK_FRAME_KB"); env_frame_kb_str != nullptr)
+            return std::stoull(env_frame_kb_str) << 10;
+        return 256ULL << 10;
+    }
+
+    uint8_vector chunk_registry::compress_chunk(const buffer &data, const std::optional<uint64_t> era, const int level, const uint64_t frame_size) const
+    {
+        const auto dict = era ? era_dictionary(*era) : zstd::dictionary_ptr {};
+        const auto start = std::chrono::steady_clock::now();
+        uint8_vector compressed {};
+        if (frame_size && data.size() > frame_size)
+            zstd::compress_frames(compressed, data, frame_size, level, dict);
+        else
+            zstd::compress(compressed, data, level, zstd::max_zstd_buffer, dict);
+        if (level < final_compression_level) {
+            const auto duration = std::chrono::duration_cast<std::chrono::nanoseconds>(std::chrono::steady_clock::now() - start);
+            _fast_compress_ns.fetch_add(duration.count(), std::memory_order_relaxed);
+        }
+        return compressed;
+    }
+
+    void chunk_registry::train_dictionaries(const size_t max_chunks, const size_t dict_size)
+    {
+        timer t { "chunk_registry::train_dictionaries", logger::level::info };
+        map<uint64_t, storage::chunk_cptr_list> era_chunks {};
+        for (const auto &[last_byte_offset, chunk]: _chunks)
+            era_chunks[chunk.blocks.back().era].emplace_back(&chunk);
+        mutex::unique_lock::mutex_type trained_mutex {};
+        map<uint64_t, zstd::dictionary_ptr> trained {};
+        for (const auto &[era, chunks]: era_chunks) {
+            _sched.submit_void("train-dictionary", 100, [&, era, chunks] {
+                const size_t step = std::max(static_cast<size_t>(1), chunks.size() / max_chunks);
+                // zstd recommends about a hundred times more sample data than the dictionary size
+                const size_t chunk_budget = dict_size * 100 / ((chunks.size() + step - 1) / step);
+                std::vector<storage::chunk_cache::data_ptr> chunk_data {};
+                std::vector<buffer> samples {};
+                for (size_t i = 0; i < chunks.size(); i += step) {
+                    const auto &chunk = *chunks[i];
+                    const auto &data = chunk_data.emplace_back(read_chunk(chunk));
+                    // a block is the unit of data that seekable readers decompress
+                    for (size_t chunk_sampled = 0; const auto &blk: chunk.blocks) {
+                        if (chunk_sampled >= chunk_budget)
+                            break;
+                        samples.emplace_back(static_cast<buffer>(*data).subbuf(blk.offset - chunk.offset, blk.size));
+                        chunk_sampled += blk.size;
+                    }
+                }
+                auto dict = zstd::dictionary::train(samples, dict_size);
+                logger::info("trained dictionary {} for era {} over {} blocks from {} chunks", dict->id(), era, samples.size(), chunk_data.size());
+                mutex::scoped_lock lk { trained_mutex };
+                trained.try_emplace(era, std::move(dict));
+            });
+        }
+        _sched.process();
+        std::filesystem::create_directories(_dict_dir);
+        json::object j_eras {};
+        for (const auto &[era, dict]: trained) {
+            file::write(fmt::format("{}/{}.zdict", _dict_dir, dict->id()), dict->bytes());
+            zstd::dictionaries::get().add(dict);
+            j_eras.emplace(fmt::format("{}", era), dict->id());
+        }
+        json::save_pretty(fmt::format("{}/eras.json", _dict_dir), j_eras);
+        mutex::scoped_lock lk { _dicts_mutex };
+        _era_dicts = std::move(trained);
+    }
+
+    void chunk_registry::_load_dictionaries()
+    {
+        // the dictionaries of older eras' files must be loaded even when an era has been retrained
+        const auto dicts = zstd::dictionaries::get().load_dir(_dict_dir);
+        if (const auto eras_path = fmt::format("{}/eras.json", _dict_dir); std::filesystem::exists(eras_path)) {
+            for (const auto &[era, j_id]: json::load(eras_path).as_object()) {
+                const auto id = json::value_to<uint32_t>(j_id);
+                const auto dict_it = dicts.find(id);
+                if (dict_it == dicts.end())
+                    throw error(fmt::format("the dictionary {} of era {} is missing from {}", id, std::string_view { era }, _dict_dir));
+                _era_dicts.try_emplace(std::stoull(std::string { era }), dict_it->second);
+            }
+        }
+    }
+
+    void chunk_registry::_import_dictionary(const chunk_registry &src_cr, const std::string &src_path)
+    {
+        // the dictionary id is in the header of the first frame, which takes at most 18 bytes
+        uint8_vector header(std::min(uint64_t { 18 }, static_cast<uint64_t>(std::filesystem::file_size(src_path))));
+        file::read_stream { src_path }.read(header.data(), header.size());
+        const auto dict_id = zstd::dictionary_id(header);
+        if (!dict_id)
+            return;
+        const auto local_path = fmt::format("{}/{}.zdict", _dict_dir, dict_id);
+        if (std::filesystem::exists(local_path))
+            return;
+        const auto src_dict_path = fmt::format("{}/{}.zdict", src_cr._dict_dir, dict_id);
+        if (!std::filesystem::exists(src_dict_path))
+            throw error(fmt::format("the dictionary {} of the imported chunk {} is missing from {}", dict_id, src_path, src_cr._dict_dir));
+        std::filesystem::create_directories(_dict_dir);
+        std::filesystem::copy_file(src_dict_path, local_path);
+        if (!zstd::dictionaries::get().find(dict_id))
+            zstd::dictionaries::get().add(std::make_shared<const zstd::dictionary>(file::read<uint8_vector>(local_path)));
+    }
+
+    std::string chunk_registry::_block_segment_path(const uint64_t segment_id) const
+    {
+        return (std::filesystem::path { _block_index_dir } / fmt::format("{}.bin", segment_id)).string();
+    }
+
+    chunk_registry::chunk_map chunk_registry::_load_state(const std::string &path)
+    {
+        indexed_chunk_map indexed_chunks {};
+        zpp::load(indexed_chunks, path);
+        map<uint64_t, storage::block_index_ptr> segments {};
+        chunk_map chunks {};
+        for (auto &&[last_byte_offset, chunk]: indexed_chunks) {
+            auto [seg_it, seg_created] = segments.try_emplace(chunk.block_segment);
+            if (seg_created) {
+                try {
+                    seg_it->second = std::make_shared<const storage::block_index>(_block_segment_path(chunk.block_segment));
+                } catch (const std::exception &ex) {
+                    logger::info("load_state: block index segment {} is not usable: {} - ignoring it and the following chunks!",
+                        chunk.block_segment, ex.what());
+                    break;
+                }
+            }
+            chunk.blocks = storage::block_list { seg_it->second, chunk.block_row, chunk.num_blocks };
+            chunks.try_emplace(last_byte_offset, std::move(static_cast<storage::chunk_info &>(chunk)));
+        }
+        return chunks;
+    }
+
+    void chunk_registry::_save_state(const std::string &path)
+    {
+        // the caller is responsible to hold a lock protecting access to the _chunks!
+        _persist_blocks();
+        indexed_chunk_map indexed_chunks {};
+        for (const auto &[last_byte_offset, chunk]: _chunks) {
+            const auto segment_id = std::stoull(std::filesystem::path { chunk.blocks.index()->path() }.stem().string());
+            indexed_chunks.try_emplace(last_byte_offset, indexed_chunk_info { chunk, segment_id, chunk.blocks.first_row() });
+        }
+        zpp::save(path, indexed_chunks);
+    }
+
+    void chunk_registry::_persist_blocks()
+    {
+        vector<chunk_info *> unsaved {};
+        set<const storage::block_index *> segments {};
+        for (auto &[last_byte_offset, chunk]: _chunks) {
+            if (chunk.blocks.mapped())
+                segments.emplace(chunk.blocks.index().get());
+            else
+                unsaved.emplace_back(&chunk);
+        }
+        if (unsaved.empty())
+            return;
+        // each segment costs a mapping and keeps the rows of truncated chunks on disk, so once there are too many,
+        // all blocks are rewritten into a single segment
+        if (segments.size() >= max_block_segments) {
+            unsaved.clear();
+            for (auto &[last_byte_offset, chunk]: _chunks)
+                unsaved.emplace_back(&chunk);
+        }
+        vector<std::span<const storage::block_info>> runs {};
+        runs.reserve(unsaved.size());
+        for (const auto *chunk: unsaved)
+            runs.emplace_back(chunk->blocks.data(), chunk->blocks.size());
+        const auto seg_path = _block_segment_path(_next_block_segment++);
+        storage::block_index::write(seg_path, runs);
+        const auto seg = std::make_shared<const storage::block_index>(seg_path);
+        size_t row = 0;
+        for (auto *chunk: unsaved) {
+            const auto num_blocks = chunk->blocks.size();
+            chunk->blocks = storage::block_list { seg, row, num_blocks };
+            row += num_blocks;
+        }
+    }
+
+    void chunk_registry::_mark_unused_block_segments()
+    {
+        std::error_code ec {};
+        if (!std::filesystem::is_directory(_block_index_dir, ec))
+            return;
+        set<std::string> used {};
+        for (const auto &[last_byte_offset, chunk]: _chunks) {
+            if (chunk.blocks.mapped())
+                used.emplace(chunk.blocks.index()->path());
+        }
+        for (const auto &entry: std::filesystem::directory_iterator { _block_index_dir }) {
+            if (!entry.is_regular_file())
+                continue;
+            // segment ids are never reused, so that the files of the committed state are never overwritten
+            uint64_t segment_id = 0;
+            const auto stem = entry.path().stem().string();
+            if (std::from_chars(stem.data(), stem.data() + stem.size(), segment_id).ec == std::errc {})
+                _next_block_segment = std::max(_next_block_segment, segment_id + 1);
+            if (const auto path = entry.path().string(); !used.contains(path))
+                _file_remover.mark(path);
+        }
+    }
+
+    zstd::frame_list chunk_registry::frame_table(const buffer &compressed)
+    {
+        auto frames = zstd::frames(compressed);
+        if (frames.size() < 2)
+            frames.clear();
+        return frames;
+    }
+
+    std::string chunk_registry::chunk_path(const chunk_info &chunk) const
+    {
+        mutex::scoped_lock lk { _swap_mutex };
+        return full_path(chunk.rel_path());
+    }
+
+    std::pair<storage::chunk_cache::data_ptr, uint64_t> chunk_registry::read_chunk_range(const chunk_info &chunk, const uint64_t rel_offset, const uint64_t size) const
+    {
+        // a chunk decompressed by another reader is cheaper to share than to decompress again
+        if (auto data = _chunk_cache.find(chunk))
+            return { std::move(data), 0 };
+        // the frame table and the path are taken together, since a recompression may be swapped in concurrently
+        std::optional<storage::chunk_info::frame_span> span {};
+        std::string path {};
+        {
+            mutex::scoped_lock lk { _swap_mutex };
+            if (!chunk.frames.empty()) {
+                span = chunk.frames_for(rel_offset, size);
+                path = full_path(chunk.rel_path());
+            }
+        }
+        if (!span)
+            return { read_chunk(chunk), 0 };
+        uint8_vector compressed(span->compressed_size);
+        file::read_handle { path }.read(span->compressed_offset, compressed);
+        auto data = std::make_shared<uint8_vector>();
+        zstd::decompress(*data, compressed);
+        return { std::move(data), span->offset };
+    }
+
+    void chunk_registry::_write_chunk(chunk_info &chunk, const buffer &data) const
     {
-        const auto rel_path = _chunk_it->second.rel_path();
-        const auto path = _cr.full_path(_chunk_it->second.rel_path());
-        if (!_chunk_cache || _chunk_cache->full_path != path || _chunk_it->second.data_size != _chunk_cache->data.size()) {
-            _chunk_cache.emplace(path, zstd::read(path));
+        const auto level = fast_compression_level();
+        const auto compressed = compress_chunk(data, chunk.blocks.empty() ? std::optional<uint64_t> {} : chunk.blocks.back().era, level);
+        // the data hash of a rewritten chunk is new, so its files start from the first generation again
+        chunk.generation = 0;
+        file::write(full_path(chunk.rel_path()), compressed);
+        chunk.compressed_size = compressed.size();
+        chunk.frames = frame_table(compressed);
+        chunk.compression_level = numeric_cast<uint8_t>(level);
+    }
+
+    void chunk_registry::finish_recompression()
+    {
+        if (_transaction)
+            throw error("finish_recompression cannot be executed inside of a transaction!");
+        // the pool has a single thread, so all previously queued recompressions are done when this action runs
+        std::promise<void> done {};
+        _recompress_pool.post([&] { done.set_value(); });
+        done.get_future().wait();
+        _apply_recompressed();
+    }
+
+    void chunk_registry::_recompress(const chunk_info &chunk)
+    {
+        if (_recompress_stop.load(std::memory_order_relaxed))
+            return;
+        const auto start = std::chrono::steady_clock::now();
+        const auto path = chunk_path(chunk);
+        const auto data = zstd::read<uint8_vector>(path);
+        const auto compressed = compress_chunk(data, chunk.blocks.back().era, final_compression_level);
+        recompressed_chunk res { chunk.offset, chunk.data_hash, path + ".recompress", compressed.size(), frame_table(compressed) };
+        file::write(res.tmp_path, compressed);
+        res.duration_ns = std::chrono::duration_cast<std::chrono::nanoseconds>(std::chrono::steady_clock::now() - start).count();
+        mutex::scoped_lock lk { _recompressed_mutex };
+        _recompressed.emplace_back(std::move(res));
+    }
+
+    void chunk_registry::_schedule_recompression()
+    {
+        if (fast_compression_level() >= final_compression_level)
+            return;
+        for (const auto &[last_byte_offset, chunk]: _chunks) {
+            if (!chunk.compression_level || chunk.compression_level >= final_compression_level)
+                continue;
+            if (const auto [it, created] = _recompress_queued.try_emplace(chunk.offset, chunk.data_hash); !created) {
+                if (it->second == chunk.data_hash)
+                    continue;
+                it->second = chunk.data_hash;
+            }
+            _recompress_pool.post([this, chunk] {
+                _recompress(chunk);
+            });
+        }
+    }
+
+    void chunk_registry::_apply_recompressed()
+    {
+        vector<recompressed_chunk> done {};
+        {
+            mutex::scoped_lock lk { _recompressed_mutex };
+            done = std::move(_recompressed);
+            _recompressed.clear();
+        }
+        if (done.empty())
+            return;
+        mutex::scoped_lock update_lk { _update_mutex };
+        size_t num_applied = 0;
+        for (auto &r: done) {
+            if (const auto q_it = _recompress_queued.find(r.offset); q_it != _recompress_queued.end() && q_it->second == r.data_hash)
+                _recompress_queued.erase(q_it);
+            const auto chunk_it = _chunks.lower_bound(r.offset);
+            // the chunk may have been truncated or replaced in the meantime
+            if (chunk_it == _chunks.end() || chunk_it->second.offset != r.offset || chunk_it->second.data_hash != r.data_hash
+                    || chunk_it->second.compression_level >= final_compression_level) {
+                std::filesystem::remove(r.tmp_path);
+                continue;
+            }
+            auto &chunk = chunk_it->second;
+            if (chunk.generation == std::numeric_limits<decltype(chunk.generation)>::max()) [[unlikely]] {
+                std::filesystem::remove(r.tmp_path);
+                continue;
+            }
+            // readers holding the old frame table keep reading the old file until the file remover deletes it
+            const auto old_path = full_path(chunk.rel_path());
+            auto next_gen = chunk;
+            ++next_gen.generation;
+            std::filesystem::rename(r.tmp_path, full_path(next_gen.rel_path()));
+            _file_remover.mark(old_path);
+            _recompress_stats.size_before += chunk.compressed_size;
+            _recompress_stats.size_after += r.compressed_size;
+            _recompress_stats.final_secs += static_cast<double>(r.duration_ns) / 1e9;
+            ++_recompress_stats.num_chunks;
+            ++num_applied;
+            mutex::scoped_lock swap_lk { _swap_mutex };
+            chunk.compressed_size = r.compressed_size;
+            chunk.frames = std::move(r.frames);
+            chunk.compression_level = final_compression_level;
+            ++chunk.generation;
+        }
+        if (num_applied) {
+            // the replaced files no longer match the sizes recorded in the committed state
+            _save_state(_state_path_pre);
+            std::filesystem::rename(_state_path_pre, _state_path);
+            logger::info("swapped in {} recompressed chunks; total size delta: {} MiB",
+                num_applied, (static_cast<int64_t>(_recompress_stats.size_after) - static_cast<int64_t>(_recompress_stats.size_before)) / (1 << 20));
         }
-        return _chunk_cache->data;
+    }
+
+    buffer chunk_registry::const_iterator::_prep_data(const uint64_t rel_offset, const uint64_t size) const
+    {
+        const auto &chunk = _chunk_it->second;
+        if (!_chunk_data || _chunk_data_hash != chunk.data_hash
+                || rel_offset < _chunk_data_offset || rel_offset + size > _chunk_data_offset + _chunk_data->size()) {
+            std::tie(_chunk_data, _chunk_data_offset) = _cr.read_chunk_range(chunk, rel_offset, size);
+            _chunk_data_hash = chunk.data_hash;
+        }
+        return static_cast<buffer>(*_chunk_data).subbuf(rel_offset - _chunk_data_offset, size);
     }
 
     cardano::parsed_header chunk_registry::const_iterator::header() const
     {
-        const auto bytes = _prep_chunk_cache();
         const auto &blk = operator*();
+        const auto bytes = _prep_data(blk.offset - _chunk_it->second.offset, blk.size);
         // + 1 is the offset of the first entry in the block array which is the header
-        const auto file_offset = blk.offset + blk.header_offset + 1 - _chunk_it->second.offset;
-        return { blk.era, static_cast<buffer>(bytes).subbuf(file_offset,  blk.header_size), _cr.config() };
+        return { blk.era, bytes.subbuf(blk.header_offset + 1, blk.header_size), _cr.config() };
     }
 
     uint8_vector chunk_registry::const_iterator::block_data() const
     {
-        const auto bytes = _prep_chunk_cache();
         const auto &blk = operator*();
-        // + 1 is the offset of the first entry in the block array which is the header
-        const auto file_offset = blk.offset - _chunk_it->second.offset;
-        return { bytes.subbuf(file_offset,  blk.size) };
+        return { _prep_data(blk.offset - _chunk_it->second.offset, blk.size) };
     }
 
     std::pair<uint8_vector, chunk_registry::const_iterator>
@@ -543,20 +952,21 @@ namespace daedalus_turbo {
         if (*this == last_it) [[unlikely]]
             return std::make_pair(uint8_vector {}, last_it);
         if (**this == _chunk_it->second.blocks.front() && last_it._chunk_it != _chunk_it) {
-            const auto path = _cr.full_path(_chunk_it->second.rel_path());
-            return std::make_pair(file::read<uint8_vector>(path), const_iterator { _cr, std::next(_chunk_it), 0 });
+            const auto path = _cr.chunk_path(_chunk_it->second);
+            // peers do not have the local dictionaries
+            if (auto data = file::read<uint8_vector>(path); !zstd::dictionary_id(data))
+                return std::make_pair(std::move(data), const_iterator { _cr, std::next(_chunk_it), 0 });
         }
-        const auto bytes = _prep_chunk_cache();
         const auto &blk = operator*();
         const auto file_offset = blk.offset - _chunk_it->second.offset;
         if (last_it._chunk_it == _chunk_it && last_it._block_no < _chunk_it->second.blocks.size()) {
             return std::make_pair(
-                zstd::compress(bytes.subbuf(file_offset, last_it->offset - blk.offset), 3),
+                zstd::compress(_prep_data(file_offset, last_it->offset - blk.offset), 3),
                 last_it
             );
         }
         return std::make_pair(
-            zstd::compress(bytes.subbuf(file_offset), 3),
+            zstd::compress(_prep_data(file_offset, _chunk_it->second.data_size - file_offset), 3),
             const_iterator { _cr, std::next(_chunk_it), 0 }
         );
     }
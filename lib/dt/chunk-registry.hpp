@@ -9,6 +9,7 @@
 #include <map>
 #include <set>
 #include <string>
+#include <dt/async-io.hpp>
 #include <dt/cardano/common/config.hpp>
 #include <dt/cardano.hpp>
 #include <dt/file.hpp>
@@ -17,6 +18,7 @@
 #include <dt/json.hpp>
 #include <dt/progress.hpp>
 #include <dt/scheduler.hpp>
+#include <dt/storage/chunk-cache.hpp>
 #include <dt/storage/chunk-info.hpp>
 #include <dt/timer.hpp>
 #include <dt/validator.hpp>
@@ -185,7 +187,10 @@ namespace daedalus_turbo {
             const_iterator(const const_iterator &o) noexcept:
                 _cr { o._cr },
                 _chunk_it { o._chunk_it },
-                _block_no { o._block_no }
+                _block_no { o._block_no },
+                _chunk_data { o._chunk_data },
+                _chunk_data_offset { o._chunk_data_offset },
+                _chunk_data_hash { o._chunk_data_hash }
             {
             }
 
@@ -195,7 +200,9 @@ namespace daedalus_turbo {
                     throw error(fmt::format("an attempt to assing an iterator across different instances of chunk_registry"));
                 _chunk_it = o._chunk_it;
                 _block_no = o._block_no;
-                _chunk_cache.reset();
+                _chunk_data = o._chunk_data;
+                _chunk_data_offset = o._chunk_data_offset;
+                _chunk_data_hash = o._chunk_data_hash;
                 return *this;
             }
 
@@ -232,15 +239,14 @@ namespace daedalus_turbo {
         private:
             friend chunk_registry;
 
-            struct chunk_cache {
-                std::string full_path;
-                write_vector data;
-            };
-
             const chunk_registry &_cr;
             chunk_map::const_iterator _chunk_it;
             size_t _block_no = 0;
-            mutable std::optional<chunk_cache> _chunk_cache {};
+            // keeps the data referenced by the returned headers alive even if the shared cache evicts it
+            mutable storage::chunk_cache::data_ptr _chunk_data {};
+            // the chunk-relative offset of the first byte of _chunk_data, which covers only some frames of seekable chunks
+            mutable uint64_t _chunk_data_offset = 0;
+            mutable cardano::block_hash _chunk_data_hash {};
 
             const_iterator(const chunk_registry &cr, const chunk_map::const_iterator chunk_it, const size_t block_no) noexcept:
                 _cr { cr },
@@ -249,7 +255,7 @@ namespace daedalus_turbo {
             {
             }
 
-            buffer _prep_chunk_cache() const;
+            buffer _prep_data(uint64_t rel_offset, uint64_t size) const;
         };
 
         struct active_transaction {
@@ -691,15 +697,86 @@ namespace daedalus_turbo {
             return canon_path.string();
         }
 
-        uint64_t read_holding_chunk(uint8_vector &chunk_data, const uint64_t offset) const
+        struct recompression_stats {
+            size_t num_chunks = 0;
+            uint64_t size_before = 0;
+            uint64_t size_after = 0;
+            // the time spent on the fast compression of new chunks and on their recompression in the background
+            double fast_secs = 0;
+            double final_secs = 0;
+        };
+
+        static constexpr int final_compression_level = 22;
+        // the number of block index segments above which the next commit merges them into one
+        static constexpr size_t max_block_segments = 32;
+        // 3 unless overridden with the DT_CHUNK_FAST_LEVEL environment variable.
+        // Chunks written at a lower level than the final one are recompressed in the background.
+        static int fast_compression_level();
+        // 256 KiB unless overridden with the DT_CHUNK_FRAME_KB environment variable; zero disables seekable compression
+        static uint64_t default_frame_size();
+        // compresses chunk data as independent frames, so that readers of a few blocks can skip the rest,
+        // with the dictionary of the era if one has been trained
+        uint8_vector compress_chunk(const buffer &data, std::optional<uint64_t> era={}, int level=fast_compression_level(), uint64_t frame_size=default_frame_size()) const;
+        // the frame table to store in chunk_info; empty for single-frame data
+        static zstd::frame_list frame_table(const buffer &compressed);
+
+        // the decompressed data of a chunk through the cache shared by all readers
+        storage::chunk_cache::data_ptr read_chunk(const chunk_info &chunk) const
+        {
+            return _chunk_cache.get(chunk, [&] {
+                return file::read_auto(chunk_path(chunk));
+            });
+        }
+
+        // the path of the chunk's current data file; safe to call concurrently with the swapping in of recompressed chunks
+        std::string chunk_path(const chunk_info &chunk) const;
+
+        storage::chunk_cache &chunk_cache() const
+        {
+            return _chunk_cache;
+        }
+
+        // Trains a compression dictionary per era over the blocks of up to max_chunks evenly spaced chunks.
+        // Only the chunks written afterwards use them.
+        void train_dictionaries(size_t max_chunks=64, size_t dict_size=zstd::dictionary::default_size);
+
+        // waits for the queued background recompressions and swaps them in; cannot be called inside of a transaction
+        void finish_recompression();
+
+        recompression_stats recompression_stat() const
+        {
+            auto stats = _recompress_stats;
+            stats.fast_secs = static_cast<double>(_fast_compress_ns.load(std::memory_order_relaxed)) / 1e9;
+            return stats;
+        }
+
+        zstd::dictionary_ptr era_dictionary(const uint64_t era) const
+        {
+            mutex::scoped_lock lk { _dicts_mutex };
+            if (const auto it = _era_dicts.find(era); it != _era_dicts.end())
+                return it->second;
+            return {};
+        }
+
+        // decompressed data covering the chunk-relative range and the chunk-relative offset of its first byte;
+        // chunks without a frame table are returned whole
+        std::pair<storage::chunk_cache::data_ptr, uint64_t> read_chunk_range(const chunk_info &chunk, uint64_t rel_offset, uint64_t size) const;
+
+        std::pair<storage::chunk_cache::data_ptr, uint64_t> read_holding_chunk(const uint64_t offset) const
         {
             if (offset >= num_bytes())
                 throw error(fmt::format("the requested offset {} is larger than the maximum one: {}", offset, num_bytes()));
             const auto &chunk = find_offset(offset);
             if (offset >= chunk.offset + chunk.data_size)
                 throw error("the requested chunk segment is too small to parse it");
-            file::read_auto(full_path(chunk.rel_path()), chunk_data);
-            return chunk.offset;
+            return { read_chunk(chunk), chunk.offset };
+        }
+
+        uint64_t read_holding_chunk(uint8_vector &chunk_data, const uint64_t offset) const
+        {
+            const auto [data, chunk_offset] = read_holding_chunk(offset);
+            chunk_data = *data;
+            return chunk_offset;
         }
 
         cbor::zero2::parsed_value read_from_chunk_buffer(const uint64_t value_offset, const buffer &chunk_data, const uint64_t chunk_offset) const
@@ -713,10 +790,22 @@ namespace daedalus_turbo {
             return cbor::zero2::parse(chunk_data.subbuf(read_offset, read_size));
         }
 
+        // the returned value references the chunk data, which stays valid until the next read call in the same thread
         cbor::zero2::parsed_value read(const uint64_t offset) const
         {
-            const auto chunk_offset = read_holding_chunk(_read_buffer, offset);;
-            return read_from_chunk_buffer(offset, _read_buffer, chunk_offset);
+            if (offset >= num_bytes())
+                throw error(fmt::format("the requested offset {} is larger than the maximum one: {}", offset, num_bytes()));
+            const auto &chunk = find_offset(offset);
+            uint64_t rel_offset = 0, size = chunk.data_size;
+            // a value never crosses the boundary of its block
+            if (!chunk.frames.empty()) {
+                const auto blk = find_block_by_offset(offset);
+                rel_offset = blk.offset - chunk.offset;
+                size = blk.size;
+            }
+            auto [data, data_offset] = read_chunk_range(chunk, rel_offset, size);
+            _read_chunk = std::move(data);
+            return read_from_chunk_buffer(offset, *_read_chunk, chunk.offset + data_offset);
         }
 
         // state modifying methods
@@ -728,6 +817,7 @@ namespace daedalus_turbo {
             for (const auto &[last_byte_offset, src_chunk]: src_cr.chunks()) {
                 const auto src_path  = src_cr.full_path(src_chunk.rel_path());
                 const auto local_path = full_path(chunk_info::rel_path_from_hash(src_chunk.data_hash));
+                _import_dictionary(src_cr, src_path);
                 std::filesystem::copy_file(src_path, local_path);
                 add(src_chunk.offset, local_path);
             }
@@ -735,16 +825,17 @@ namespace daedalus_turbo {
             _commit_tx();
         }
 
-        std::string add_compressed(const uint64_t offset, uint8_vector compressed, uint8_vector uncompressed)
+        std::string add_compressed(const uint64_t offset, uint8_vector compressed, uint8_vector uncompressed, const int compression_level=0)
         {
             const auto data_hash = blake2b<blake2b_256_hash>(uncompressed);
             const auto rel_path = fmt::format("chunk/{}.zstd.tmp", data_hash);
             const auto local_path = full_path(rel_path);
             file::write(local_path, compressed);
-            return add(offset, local_path, std::move(uncompressed));
+            return add(offset, local_path, std::move(uncompressed), compression_level);
         }
 
-        std::string add(const uint64_t offset, const std::string &local_path, std::optional<uint8_vector> uncompressed={})
+        // compression_level is zero when unknown
+        std::string add(const uint64_t offset, const std::string &local_path, std::optional<uint8_vector> uncompressed={}, const int compression_level=0)
         {
             // TODO: add a fast path for data beyond earliest known invalid offset
             if (!_transaction)
@@ -755,11 +846,12 @@ namespace daedalus_turbo {
             auto [parsed_chunk, ex_ptr] = _parse(offset, *uncompressed, compressed.size());
             const auto final_path = full_path(parsed_chunk.rel_path());
             if (!parsed_chunk.blocks.empty()) {
+                // _parse has already written the valid part of a partially valid chunk
                 if (!ex_ptr) {
+                    parsed_chunk.frames = frame_table(compressed);
+                    parsed_chunk.compression_level = numeric_cast<uint8_t>(compression_level);
                     if (local_path != final_path)
                         std::filesystem::rename(local_path, final_path);
-                } else {
-                    zstd::write(final_path, static_cast<buffer>(*uncompressed).subbuf(0, parsed_chunk.block_data_size()));
                 }
                 _add(std::move(parsed_chunk));
             }
@@ -811,18 +903,58 @@ namespace daedalus_turbo {
         mutable std::atomic_size_t _tx_progress_parse { 0 };
         const std::string _state_path;
         const std::string _state_path_pre;
+        const std::string _state_path_legacy;
+        const std::string _block_index_dir;
+        uint64_t _next_block_segment = 0;
+        const std::string _dict_dir;
+        mutable mutex::unique_lock::mutex_type _dicts_mutex alignas(mutex::alignment) {};
+        map<uint64_t, zstd::dictionary_ptr> _era_dicts {};
         mutable mutex::unique_lock::mutex_type _update_mutex alignas(mutex::alignment) {};
+        // protects the file-related fields of the chunks: generation, frames, compressed_size, and compression_level
+        mutable mutex::unique_lock::mutex_type _swap_mutex alignas(mutex::alignment) {};
         chunk_map _chunks {};
         // Active transaction data
         chunk_map _unmerged_chunks {};
         uint64_t _notify_end_offset = 0;
         uint64_t _notify_next_epoch = 0;
         vector<chunk_info> _truncated_chunks {};
-        static thread_local uint8_vector _read_buffer;
+        mutable storage::chunk_cache _chunk_cache {};
+        static thread_local storage::chunk_cache::data_ptr _read_chunk;
+        // Background recompression
+        struct recompressed_chunk {
+            uint64_t offset = 0;
+            cardano::block_hash data_hash {};
+            std::string tmp_path {};
+            uint64_t compressed_size = 0;
+            zstd::frame_list frames {};
+            uint64_t duration_ns = 0;
+        };
+        mutable std::atomic<uint64_t> _fast_compress_ns { 0 };
+        std::atomic_bool _recompress_stop { false };
+        // the chunk offsets and data hashes of the queued recompressions
+        map<uint64_t, cardano::block_hash> _recompress_queued {};
+        mutex::unique_lock::mutex_type _recompressed_mutex alignas(mutex::alignment) {};
+        vector<recompressed_chunk> _recompressed {};
+        recompression_stats _recompress_stats {};
+        // a single thread, so that the recompression never takes more than one core from the sync; must be destroyed first
+        io_pool _recompress_pool { 1 };
 
         void _maintenance();
+        void _recompress(const chunk_info &chunk);
+        void _schedule_recompression();
+        void _apply_recompressed();
+        void _load_dictionaries();
+        // copies the source's dictionary of an imported chunk so that the chunk remains decodable after a restart
+        void _import_dictionary(const chunk_registry &src_cr, const std::string &src_path);
+        std::string _block_segment_path(uint64_t segment_id) const;
+        chunk_map _load_state(const std::string &path);
+        // writes the blocks of the chunks that are not in the block index yet into a new segment and maps them from there
+        void _persist_blocks();
+        void _mark_unused_block_segments();
         void _node_export_chain(const std::filesystem::path &immutable_dir, const std::filesystem::path &volatile_dir, int prio_base=100) const;
         std::pair<chunk_info, std::exception_ptr> _parse(const uint64_t offset, const buffer &raw_data, const size_t compressed_size) const;
+        // updates the compression-related fields of the chunk
+        void _write_chunk(chunk_info &chunk, const buffer &data) const;
 
         epoch_info _epoch(const uint64_t epoch) const
         {
@@ -848,18 +980,17 @@ namespace daedalus_turbo {
                     if (track_changes)
                         _truncated_chunks.emplace_back(chunk_it->second);
                     auto next_chunk_it = std::next(chunk_it);
+                    _chunk_cache.erase(chunk_it->second.offset);
                     auto node = _chunks.extract(chunk_it);
                     auto &chunk = node.mapped();
                     chunk.blocks.resize(block_it - chunk.blocks.begin());
                     chunk.num_blocks = chunk.blocks.size();
                     chunk.data_size = chunk.blocks.back().end_offset() - chunk.offset;
-                    const auto old_path = full_path(chunk.rel_path());
+                    const auto old_path = chunk_path(chunk);
                     auto chunk_data = file::read_auto(old_path);
                     chunk_data.resize(chunk.data_size);
                     blake2b(chunk.data_hash, chunk_data);
-                    const auto compressed = zstd::compress(chunk_data);
-                    file::write(full_path(chunk.rel_path()), compressed);
-                    chunk.compressed_size = compressed.size();
+                    _write_chunk(chunk, chunk_data);
                     chunk.last_slot = chunk.blocks.back().slot;
                     chunk.last_block_hash = chunk.blocks.back().hash;
                     node.key() = chunk.end_offset() - 1;
@@ -869,6 +1000,7 @@ namespace daedalus_turbo {
                 while (chunk_it != _chunks.end()) {
                     if (track_changes)
                         _truncated_chunks.emplace_back(chunk_it->second);
+                    _chunk_cache.erase(chunk_it->second.offset);
                     chunk_it = _chunks.erase(chunk_it);
                 }
                 // reconfigure time if truncating back into Byron era
@@ -917,15 +1049,15 @@ namespace daedalus_turbo {
         void _my_rollback_tx()
         {
             for (auto chunk_it = _find_chunk_by_offset_no_throw(_transaction->start_offset()); chunk_it != _chunks.end(); ) {
-                _file_remover.mark(full_path(chunk_it->second.rel_path()));
+                _file_remover.mark(chunk_path(chunk_it->second));
                 chunk_it = _chunks.erase(chunk_it);
             }
             for (auto &&chunk: _truncated_chunks) {
-                const auto chunk_path = full_path(chunk.rel_path());
-                _file_remover.unmark(chunk_path);
+                const auto path = chunk_path(chunk);
+                _file_remover.unmark(path);
                 const auto [it, created] = _chunks.try_emplace(chunk.offset + chunk.data_size - 1, std::move(chunk));
                 if (!created)
-                    throw error(fmt::format("rollback failed: couldn't reinsert chunk {}", chunk_path));
+                    throw error(fmt::format("rollback failed: couldn't reinsert chunk {}", path));
             }
             _truncated_chunks.clear();
             _unmerged_chunks.clear();
@@ -936,11 +1068,16 @@ namespace daedalus_turbo {
             if (!std::filesystem::exists(_state_path_pre))
                 throw error(fmt::format("the prepared chunk_registry state file is missing: {}!", _state_path_pre));
             std::filesystem::rename(_state_path_pre, _state_path);
+            if (std::filesystem::exists(_state_path_legacy))
+                _file_remover.mark(_state_path_legacy);
+            _mark_unused_block_segments();
             for (const auto &chunk: _truncated_chunks)
-                _file_remover.mark(full_path(chunk.rel_path()));
+                _file_remover.mark(chunk_path(chunk));
             _truncated_chunks.clear();
             for (const auto &[last_byte_offset, chunk]: _chunks)
-                _file_remover.unmark(full_path(chunk.rel_path()));
+                _file_remover.unmark(chunk_path(chunk));
+            _apply_recompressed();
+            _schedule_recompression();
         }
 
         void _require_better_candidate_chain()
@@ -1090,11 +1227,7 @@ namespace daedalus_turbo {
             _transaction.reset();
         }
 
-        void _save_state(const std::string &path)
-        {
-            // the caller is responsible to hold a lock protecting access to the _chunks!
-            zpp::save(path, _chunks);
-        }
+        void _save_state(const std::string &path);
 
         void _do_truncate(const cardano::optional_point &new_tip, const bool track_changes)
         {
@@ -1167,10 +1300,7 @@ namespace daedalus_turbo {
         {
             if (chunk_it == _chunks.end())
                 throw error(fmt::format("internal error: a non-empty chunk_iterator is expected!"));
-            const auto &blocks = chunk_it->second.blocks;
-            const auto block_it = std::lower_bound(blocks.begin(), blocks.end(), offset,
-                [](const auto &b, const auto offset) { return b.end_offset() - 1 < offset; });
-            return block_it;
+            return chunk_it->second.blocks.lower_bound_offset(offset);
         }
 
         // can return the closest succeeding chunk if no chunk includes the block
@@ -1186,10 +1316,7 @@ namespace daedalus_turbo {
         {
             if (chunk_it == _chunks.end())
                 throw error(fmt::format("internal error: a non-empty chunk_iterator is expected!"));
-            const auto &blocks = chunk_it->second.blocks;
-            const auto block_it = std::lower_bound(blocks.begin(), blocks.end(), slot,
-                [](const auto &b, const auto &slot) { return b.slot < slot; });
-            return block_it;
+            return chunk_it->second.blocks.lower_bound_slot(slot);
         }
 
         bool _has_epoch(const uint64_t epoch, mutex::unique_lock &update_lk) const
@@ -211,6 +211,145 @@ suite chunk_registry_suite = [] {
             }
         };
 
+        "seekable chunks"_test = [&] {
+            recreate_tmp_data_dir();
+            chunk_registry cr { tmp_data_dir, chunk_registry::mode::store };
+            const auto blocks = cr.last_chunk()->blocks;
+            // truncation rewrites the last chunk with independent frames
+            cr.truncate(blocks.at(blocks.size() - 2).point());
+            const auto &chunk = cr.chunks().rbegin()->second;
+            expect(chunk.frames.size() > 1_ull);
+            const auto chunk_data = zstd::read<uint8_vector>(cr.full_path(chunk.rel_path()));
+            test_same(chunk.data_size, chunk_data.size());
+            size_t num_blocks = 0;
+            for (auto it = cr.find_block(chunk.blocks.front().point2()); it != cr.cend(); ++it, ++num_blocks) {
+                const uint8_vector exp_data { static_cast<buffer>(chunk_data).subbuf(it->offset - chunk.offset, it->size) };
+                expect(it.block_data() == exp_data);
+            }
+            test_same(chunk.blocks.size(), num_blocks);
+            const auto block_tuple_pv = cr.read(chunk.blocks.back().offset);
+            test_same(cbor::major_type::array, block_tuple_pv.get().type());
+            // the whole chunk has not been decompressed to serve the requests above
+            test_same(0, cr.chunk_cache().stat().num_chunks);
+        };
+
+        "background recompression"_test = [&] {
+            recreate_tmp_data_dir();
+            size_t num_chunks = 0;
+            cardano::block_hash last_hash {};
+            {
+                chunk_registry cr { tmp_data_dir, chunk_registry::mode::store };
+                const auto blocks = cr.last_chunk()->blocks;
+                cr.truncate(blocks.at(blocks.size() - 2).point());
+                const auto &chunk = cr.chunks().rbegin()->second;
+                test_same(chunk_registry::fast_compression_level(), chunk.compression_level);
+                const auto fast_size = chunk.compressed_size;
+                const auto fast_path = cr.chunk_path(chunk);
+                test_same(0, chunk.generation);
+                cr.finish_recompression();
+                test_same(chunk_registry::final_compression_level, chunk.compression_level);
+                expect(chunk.compressed_size < fast_size);
+                // the recompressed data goes into a new file, so the readers of the old frame table are not affected
+                test_same(1, chunk.generation);
+                expect(cr.chunk_path(chunk) != fast_path);
+                test_same(fast_size, std::filesystem::file_size(fast_path));
+                test_same(chunk.compressed_size, std::filesystem::file_size(cr.chunk_path(chunk)));
+                const auto stats = cr.recompression_stat();
+                test_same(1, stats.num_chunks);
+                test_same(fast_size, stats.size_before);
+                test_same(chunk.compressed_size, stats.size_after);
+                const auto chunk_data = zstd::read<uint8_vector>(cr.chunk_path(chunk));
+                const auto it = cr.find_block(chunk.blocks.back().point2());
+                expect(it.block_data() == uint8_vector { static_cast<buffer>(chunk_data).subbuf(chunk.blocks.back().offset - chunk.offset) });
+                num_chunks = cr.chunks().size();
+                last_hash = chunk.last_block_hash;
+            }
+            // the saved state refers to the file of the recompressed generation
+            chunk_registry cr { tmp_data_dir, chunk_registry::mode::store };
+            test_same(num_chunks, cr.chunks().size());
+            const auto &chunk = cr.chunks().rbegin()->second;
+            test_same(1, chunk.generation);
+            test_same(last_hash, chunk.last_block_hash);
+            test_same(chunk.compressed_size, std::filesystem::file_size(cr.chunk_path(chunk)));
+        };
+
+        "block index"_test = [&] {
+            recreate_tmp_data_dir();
+            std::optional<storage::block_info> mid_block {};
+            size_t num_blocks = 0;
+            {
+                chunk_registry cr { tmp_data_dir, chunk_registry::mode::store };
+                const auto blocks = cr.last_chunk()->blocks;
+                cr.truncate(blocks.at(blocks.size() - 2).point());
+                // the commit moves the blocks of all chunks into the memory-mapped block index
+                for (const auto &[last_byte_offset, chunk]: cr.chunks())
+                    expect(chunk.blocks.mapped());
+                mid_block = cr.find_block_by_offset(cr.num_bytes() / 2);
+                num_blocks = cr.num_blocks();
+            }
+            chunk_registry cr { tmp_data_dir, chunk_registry::mode::store };
+            test_same(num_blocks, cr.num_blocks());
+            for (const auto &[last_byte_offset, chunk]: cr.chunks())
+                expect(chunk.blocks.mapped());
+            expect(cr.find_block_by_offset(cr.num_bytes() / 2) == *mid_block);
+            expect(cr.find_block_by_slot(mid_block->slot, mid_block->hash) == *mid_block);
+            expect(cr.find_block(mid_block->point2()) != cr.cend());
+        };
+
+        "dictionaries"_test = [&] {
+            recreate_tmp_data_dir();
+            {
+                chunk_registry cr { tmp_data_dir, chunk_registry::mode::store };
+                cr.train_dictionaries(2);
+                const auto era = cr.last_chunk()->blocks.back().era;
+                const auto dict = cr.era_dictionary(era);
+                expect(static_cast<bool>(dict));
+                const auto blocks = cr.last_chunk()->blocks;
+                cr.truncate(blocks.at(blocks.size() - 2).point());
+                const auto &chunk = cr.chunks().rbegin()->second;
+                const auto compressed = file::read<uint8_vector>(cr.full_path(chunk.rel_path()));
+                test_same(dict->id(), zstd::dictionary_id(compressed));
+            }
+            chunk_registry cr { tmp_data_dir, chunk_registry::mode::store };
+            const auto &chunk = cr.chunks().rbegin()->second;
+            expect(static_cast<bool>(cr.era_dictionary(chunk.blocks.back().era)));
+            const auto chunk_data = zstd::read<uint8_vector>(cr.full_path(chunk.rel_path()));
+            test_same(chunk.data_size, chunk_data.size());
+            const auto it = cr.find_block(chunk.blocks.back().point2());
+            expect(it.block_data() == uint8_vector { static_cast<buffer>(chunk_data).subbuf(chunk.blocks.back().offset - chunk.offset) });
+        };
+
+        "import with dictionaries"_test = [&] {
+            recreate_tmp_data_dir();
+            const auto dst_dir = tmp_data_dir + "-import";
+            std::filesystem::remove_all(dst_dir);
+            uint32_t dict_id = 0;
+            {
+                chunk_registry src_cr { tmp_data_dir, chunk_registry::mode::store };
+                src_cr.train_dictionaries(2);
+                const auto blocks = src_cr.last_chunk()->blocks;
+                src_cr.truncate(blocks.at(blocks.size() - 2).point());
+                src_cr.finish_recompression();
+                const auto &chunk = src_cr.chunks().rbegin()->second;
+                dict_id = zstd::dictionary_id(file::read<uint8_vector>(src_cr.full_path(chunk.rel_path())));
+                expect(dict_id != 0);
+                chunk_registry dst_cr { dst_dir, chunk_registry::mode::store };
+                dst_cr.import(src_cr);
+            }
+            // the destination has its own copy of the dictionary, so it does not depend on the source's files
+            expect(std::filesystem::exists(fmt::format("{}/compressed/dict/{}.zdict", dst_dir, dict_id)));
+            std::filesystem::remove_all(tmp_data_dir);
+            chunk_registry cr { dst_dir, chunk_registry::mode::store };
+            const auto &chunk = cr.chunks().rbegin()->second;
+            const auto compressed = file::read<uint8_vector>(cr.full_path(chunk.rel_path()));
+            test_same(dict_id, zstd::dictionary_id(compressed));
+            const auto chunk_data = zstd::read<uint8_vector>(cr.full_path(chunk.rel_path()));
+            test_same(chunk.data_size, chunk_data.size());
+            const auto it = cr.find_block(chunk.blocks.back().point2());
+            expect(it.block_data() == uint8_vector { static_cast<buffer>(chunk_data).subbuf(chunk.blocks.back().offset - chunk.offset) });
+            std::filesystem::remove_all(dst_dir);
+        };
+
         "count_blocks_in_window"_test = [&] {
             chunk_registry src_cr { data_dir, chunk_registry::mode::store };
             expect(src_cr.count_blocks_in_window() == 9601_ull);
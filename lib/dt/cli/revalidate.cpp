@@ -62,7 +62,7 @@ namespace daedalus_turbo::cli::validate {
         {
             timer t { "validate chunks" };
             for (const auto &chunk: chunks) {
-                auto save_path = cr.full_path(chunk.rel_path());
+                auto save_path = cr.chunk_path(chunk);
                 sched.submit_void("parse", 0 + 100 * (_parse_progress.total - chunk.offset) / _parse_progress.total, [&cr, chunk, save_path]() {
                     try {
                         cr.add(chunk.offset, save_path);
@@ -73,7 +73,7 @@ namespace daedalus_turbo::cli::validate {
                         std::filesystem::copy_file(save_path, debug_path, std::filesystem::copy_options::overwrite_existing);
                         throw error(fmt::format("can't parse {}: {}", save_path, ex.what()));
                     }
-                });
+                }, {}, chunk.data_size);
             }
             sched.process(true);
         }
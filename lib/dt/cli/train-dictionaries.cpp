@@ -0,0 +1,29 @@
+/* This file is part of Daedalus Turbo project: https://github.com/sierkov/daedalus-turbo/
+ * Copyright (c) 2022-2023 Alex Sierkov (alex dot sierkov at gmail dot com)
+ * Copyright (c) 2024-2025 R2 Rationality OÜ (info at r2rationality dot com)
+ * This code is distributed under the license specified in:
+ * https://github.com/sierkov/daedalus-turbo/blob/main/LICENSE */
+#include <dt/cli.hpp>
+#include <dt/requirements.hpp>
+#include <dt/chunk-registry.hpp>
+
+namespace daedalus_turbo::cli::train_dictionaries {
+    struct cmd: command {
+        void configure(config &cmd) const override
+        {
+            cmd.name = "train-dictionaries";
+            cmd.desc = "train per-era compression dictionaries over a sample of the local chunks; only chunks written later use them";
+            cmd.args.expect({ "<data-dir>" });
+            cmd.opts.try_emplace("max-chunks", "the maximum number of chunks to sample per era", "64");
+        }
+
+        void run(const arguments &args, const options &opts) const override
+        {
+            const auto &data_dir = args.at(0);
+            requirements::check(data_dir);
+            chunk_registry cr { data_dir, chunk_registry::mode::store };
+            cr.train_dictionaries(std::stoull(opts.at("max-chunks").value()));
+        }
+    };
+    static auto instance = command::reg(std::make_shared<cmd>());
+}
@@ -0,0 +1,54 @@
+/* This file is part of Daedalus Turbo project: https://github.com/sierkov/daedalus-turbo/
+ * Copyright (c) 2022-2023 Alex Sierkov (alex dot sierkov at gmail dot com)
+ * Copyright (c) 2024-2025 R2 Rationality OÜ (info at r2rationality dot com)
+ * This code is distributed under the license specified in:
+ * https://github.com/sierkov/daedalus-turbo/blob/main/LICENSE */
+
+#include <random>
+#include <dt/common/batch-read.hpp>
+#include <dt/common/benchmark.hpp>
+#include <dt/file.hpp>
+
+using namespace daedalus_turbo;
+
+suite common_batch_read_bench_suite = [] {
+    "common::batch_read"_test = [] {
+        // the file is likely in the page cache, so the results show the overhead of the backends rather than the device limits
+        file::tmp tmp { "batch-read-bench.bin" };
+        {
+            uint8_vector data(256 << 20);
+            std::default_random_engine rnd { 1234 };
+            for (auto &b: data)
+                b = static_cast<uint8_t>(rnd());
+            file::write(tmp.path(), data);
+        }
+        const file::read_handle f { tmp.path() };
+        static constexpr size_t read_size = 4096;
+        static constexpr size_t batch_size = 4096;
+        std::vector<uint8_vector> bufs(batch_size);
+        std::vector<file::batch_reader::request> reqs {};
+        std::default_random_engine rnd { 5678 };
+        std::uniform_int_distribution<uint64_t> dist { 0, f.size() / read_size - 1 };
+        for (auto &buf: bufs) {
+            buf.resize(read_size);
+            reqs.emplace_back(&f, dist(rnd) * read_size, buf);
+        }
+        for (const bool use_uring: { true, false }) {
+            for (const size_t depth: { 1, 4, 16, 64 }) {
+                const file::batch_reader reader { depth, use_uring };
+                benchmark_r(fmt::format("{} 4KiB random reads, queue depth {}", reader.backend(), depth), 1e3, 16, [&] {
+                    reader.read(reqs);
+                    return reqs.size();
+                });
+            }
+        }
+        benchmark_r("read_stream 4KiB random reads", 1e3, 16, [&] {
+            file::read_stream rs { tmp.path() };
+            for (const auto &r: reqs) {
+                rs.seek(r.offset);
+                rs.read(r.data.data(), r.data.size());
+            }
+            return reqs.size();
+        });
+    };
+};
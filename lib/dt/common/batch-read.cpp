@@ -0,0 +1,557 @@
+/* This file is part of Daedalus Turbo project: https://github.com/sierkov/daedalus-turbo/
+ * Copyright (c) 2022-2023 Alex Sierkov (alex dot sierkov at gmail dot com)
+ * Copyright (c) 2024-2025 R2 Rationality OÜ (info at r2rationality dot com)
+ * This code is distributed under the license specified in:
+ * https://github.com/sierkov/daedalus-turbo/blob/main/LICENSE */
+
+#include <atomic>
+#include <condition_variable>
+#include <cstdlib>
+#include <cstring>
+#include <deque>
+#include <functional>
+#include <thread>
+#include <vector>
+#ifdef _WIN32
+#   define WIN32_LEAN_AND_MEAN
+#   include <windows.h>
+#else
+#   include <cerrno>
+#   include <fcntl.h>
+#   include <sys/stat.h>
+#   include <unistd.h>
+#endif
+#ifdef __linux__
+#   include <linux/io_uring.h>
+#   include <sys/mman.h>
+#   include <sys/syscall.h>
+#   include <sys/uio.h>
+#endif
+#include <dt/common/batch-read.hpp>
+#include <dt/common/env.hpp>
+#include <dt/logger.hpp>
+#include <dt/mutex.hpp>
+
+namespace daedalus_turbo::file {
+#ifdef _WIN32
+    read_handle::read_handle(const std::string &path): _path { path },
+        _h { CreateFileA(path.c_str(), GENERIC_READ, FILE_SHARE_READ | FILE_SHARE_DELETE, nullptr, OPEN_EXISTING, FILE_ATTRIBUTE_NORMAL, nullptr) }
+    {
+        if (_h == INVALID_HANDLE_VALUE) [[unlikely]]
+            throw error_sys(fmt::format("failed to open a file for reading {}", _path));
+        _report_open_file();
+    }
+
+    read_handle::~read_handle()
+    {
+        close();
+    }
+
+    void read_handle::close()
+    {
+        if (_h != INVALID_HANDLE_VALUE) {
+            CloseHandle(_h);
+            _h = INVALID_HANDLE_VALUE;
+            _open_files().fetch_sub(1, std::memory_order_relaxed);
+        }
+    }
+
+    read_handle::read_handle(read_handle &&o): _path { std::move(o._path) }, _h { o._h }
+    {
+        o._h = INVALID_HANDLE_VALUE;
+    }
+
+    void read_handle::read(uint64_t offset, std::span<uint8_t> buf) const
+    {
+        while (!buf.empty()) {
+            OVERLAPPED ov {};
+            ov.Offset = static_cast<DWORD>(offset);
+            ov.OffsetHigh = static_cast<DWORD>(offset >> 32);
+            DWORD num_read = 0;
+            const auto req_size = static_cast<DWORD>(std::min(buf.size(), static_cast<size_t>(1U << 30)));
+            if (!ReadFile(_h, buf.data(), req_size, &num_read, &ov) || num_read == 0) [[unlikely]]
+                throw error_sys(fmt::format("failed to read {} bytes at offset {} from {}", buf.size(), offset, _path));
+            offset += num_read;
+            buf = buf.subspan(num_read);
+        }
+    }
+
+    uint64_t read_handle::size() const
+    {
+        LARGE_INTEGER sz {};
+        if (!GetFileSizeEx(_h, &sz)) [[unlikely]]
+            throw error_sys(fmt::format("failed to determine the size of {}", _path));
+        return static_cast<uint64_t>(sz.QuadPart);
+    }
+#else
+    read_handle::read_handle(const std::string &path): _path { path }, _h { ::open(path.c_str(), O_RDONLY | O_CLOEXEC) }
+    {
+        if (_h < 0) [[unlikely]]
+            throw error_sys(fmt::format("failed to open a file for reading {}", _path));
+        _report_open_file();
+    }
+
+    read_handle::~read_handle()
+    {
+        close();
+    }
+
+    void read_handle::close()
+    {
+        if (_h >= 0) {
+            ::close(_h);
+            _h = -1;
+            _open_files().fetch_sub(1, std::memory_order_relaxed);
+        }
+    }
+
+    read_handle::read_handle(read_handle &&o): _path { std::move(o._path) }, _h { o._h }
+    {
+        o._h = -1;
+    }
+
+    void read_handle::read(uint64_t offset, std::span<uint8_t> buf) const
+    {
+        while (!buf.empty()) {
+            const auto num_read = ::pread(_h, buf.data(), buf.size(), static_cast<off_t>(offset));
+            if (num_read < 0 && errno == EINTR)
+                continue;
+            if (num_read <= 0) [[unlikely]]
+                throw error_sys(fmt::format("failed to read {} bytes at offset {} from {}", buf.size(), offset, _path));
+            offset += num_read;
+            buf = buf.subspan(num_read);
+        }
+    }
+
+    uint64_t read_handle::size() const
+    {
+        struct stat st {};
+        if (::fstat(_h, &st) != 0) [[unlikely]]
+            throw error_sys(fmt::format("failed to determine the size of {}", _path));
+        return static_cast<uint64_t>(st.st_size);
+    }
+#endif
+
+    struct batch_reader::impl {
+        explicit impl(const size_t queue_depth): _queue_depth { queue_depth }
+        {
+        }
+
+        virtual ~impl() =default;
+        virtual void read(std::span<const request> reqs) =0;
+        virtual std::string_view backend() const =0;
+
+        size_t queue_depth() const
+        {
+            return _queue_depth;
+        }
+    protected:
+        const size_t _queue_depth;
+    };
+
+    struct batch_reader::thread_impl: impl {
+        explicit thread_impl(const size_t queue_depth): impl { queue_depth }
+        {
+            // the calling thread performs the reads as well
+            for (size_t i = 1; i < _queue_depth; ++i)
+                _threads.emplace_back([this] { _run(); });
+        }
+
+        ~thread_impl() override
+        {
+            {
+                mutex::scoped_lock lk { _mutex };
+                _shutdown = true;
+            }
+            _cv.notify_all();
+            for (auto &t: _threads)
+                t.join();
+        }
+
+        void read(const std::span<const request> reqs) override
+        {
+            struct batch {
+                std::span<const request> reqs;
+                std::atomic_size_t next { 0 };
+                std::atomic_size_t active { 0 };
+                std::exception_ptr err {};
+                mutex::unique_lock::mutex_type mutex {};
+                std::condition_variable_any cv {};
+
+                void process()
+                {
+                    for (size_t i = next.fetch_add(1, std::memory_order_relaxed); i < reqs.size(); i = next.fetch_add(1, std::memory_order_relaxed)) {
+                        try {
+                            const auto &r = reqs[i];
+                            r.file->read(r.offset, r.data);
+                        } catch (...) {
+                            mutex::scoped_lock lk { mutex };
+                            if (!err)
+                                err = std::current_exception();
+                        }
+                    }
+                }
+            } b { reqs };
+            const auto num_helpers = std::min(_threads.size(), reqs.size() > 0 ? reqs.size() - 1 : 0);
+            b.active.store(num_helpers, std::memory_order_relaxed);
+            if (num_helpers) {
+                {
+                    mutex::scoped_lock lk { _mutex };
+                    for (size_t i = 0; i < num_helpers; ++i) {
+                        _jobs.emplace_back([&b] {
+                            b.process();
+                            mutex::scoped_lock lk { b.mutex };
+                            if (b.active.fetch_sub(1, std::memory_order_relaxed) == 1)
+                                b.cv.notify_all();
+                        });
+                    }
+                }
+                _cv.notify_all();
+            }
+            b.process();
+            {
+                mutex::unique_lock lk { b.mutex };
+                b.cv.wait(lk, [&] { return b.active.load(std::memory_order_relaxed) == 0; });
+            }
+            if (b.err)
+                std::rethrow_exception(b.err);
+        }
+
+        std::string_view backend() const override
+        {
+            return "threads";
+        }
+    private:
+        mutex::unique_lock::mutex_type _mutex alignas(mutex::alignment) {};
+        std::condition_variable_any _cv alignas(mutex::alignment) {};
+        std::deque<std::function<void ()>> _jobs {};
+        bool _shutdown = false;
+        std::vector<std::thread> _threads {};
+
+        void _run()
+        {
+            for (;;) {
+                std::function<void ()> job {};
+                {
+                    mutex::unique_lock lk { _mutex };
+                    _cv.wait(lk, [&] { return _shutdown || !_jobs.empty(); });
+                    if (_jobs.empty())
+                        break;
+                    job = std::move(_jobs.front());
+                    _jobs.pop_front();
+                }
+                job();
+            }
+        }
+    };
+
+#ifdef __linux__
+    namespace {
+        // A minimal io_uring binding through the raw system calls, so that no extra library is needed.
+        struct uring {
+            explicit uring(const unsigned entries)
+            {
+                io_uring_params p {};
+                _fd = static_cast<int>(::syscall(__NR_io_uring_setup, entries, &p));
+                if (_fd < 0)
+                    throw error_sys("io_uring_setup failed");
+                _sq_size = p.sq_off.array + p.sq_entries * sizeof(unsigned);
+                _cq_size = p.cq_off.cqes + p.cq_entries * sizeof(io_uring_cqe);
+                const bool single_mmap = p.features & IORING_FEAT_SINGLE_MMAP;
+                if (single_mmap)
+                    _sq_size = _cq_size = std::max(_sq_size, _cq_size);
+                _sq_ptr = _map(_sq_size, IORING_OFF_SQ_RING);
+                _cq_ptr = single_mmap ? _sq_ptr : _map(_cq_size, IORING_OFF_CQ_RING);
+                _sqes_size = p.sq_entries * sizeof(io_uring_sqe);
+                _sqes = static_cast<io_uring_sqe *>(_map(_sqes_size, IORING_OFF_SQES));
+                auto *sq = static_cast<uint8_t *>(_sq_ptr);
+                _sq_tail = reinterpret_cast<unsigned *>(sq + p.sq_off.tail);
+                _sq_mask = *reinterpret_cast<unsigned *>(sq + p.sq_off.ring_mask);
+                _sq_array = reinterpret_cast<unsigned *>(sq + p.sq_off.array);
+                auto *cq = static_cast<uint8_t *>(_cq_ptr);
+                _cq_head = reinterpret_cast<unsigned *>(cq + p.cq_off.head);
+                _cq_tail = reinterpret_cast<unsigned *>(cq + p.cq_off.tail);
+                _cq_mask = *reinterpret_cast<unsigned *>(cq + p.cq_off.ring_mask);
+                _cqes = reinterpret_cast<io_uring_cqe *>(cq + p.cq_off.cqes);
+                _entries = p.sq_entries;
+            }
+
+            ~uring()
+            {
+                if (_sqes)
+                    ::munmap(_sqes, _sqes_size);
+                if (_cq_ptr && _cq_ptr != _sq_ptr)
+                    ::munmap(_cq_ptr, _cq_size);
+                if (_sq_ptr)
+                    ::munmap(_sq_ptr, _sq_size);
+                if (_fd >= 0)
+                    ::close(_fd);
+            }
+
+            unsigned entries() const
+            {
+                return _entries;
+            }
+
+            // false once a failed batch could not be drained; such a ring must not be reused
+            bool usable() const
+            {
+                return _usable;
+            }
+
+            void read(const std::span<const batch_reader::request> reqs, const size_t max_inflight)
+            {
+                std::vector<iovec> iovs(reqs.size());
+                std::exception_ptr err {};
+                // queued requests are in the submission queue but have not been consumed by the kernel yet
+                size_t next = 0, queued = 0, inflight = 0, done = 0;
+                try {
+                    while (done < reqs.size()) {
+                        // only this thread uses the submission queue, so its tail needs no atomic read
+                        unsigned tail = *_sq_tail;
+                        while (queued + inflight < max_inflight && next < reqs.size()) {
+                            const auto &r = reqs[next];
+                            iovs[next] = iovec { r.data.data(), r.data.size() };
+                            const auto idx = tail & _sq_mask;
+                            auto &sqe = _sqes[idx];
+                            std::memset(&sqe, 0, sizeof(sqe));
+                            sqe.opcode = IORING_OP_READV;
+                            sqe.fd = r.file->native();
+                            sqe.off = r.offset;
+                            sqe.addr = reinterpret_cast<uint64_t>(&iovs[next]);
+                            sqe.len = 1;
+                            sqe.user_data = next;
+                            _sq_array[idx] = idx;
+                            ++tail;
+                            ++next;
+                            ++queued;
+                        }
+                        std::atomic_ref<unsigned> { *_sq_tail }.store(tail, std::memory_order_release);
+                        // the kernel may consume only a part of the queue, the rest is submitted with the next call;
+                        // it does not wait for completions in that case
+                        const auto consumed = _enter(static_cast<unsigned>(queued), 1);
+                        queued -= consumed;
+                        inflight += consumed;
+                        if (!inflight) [[unlikely]]
+                            throw error("io_uring_enter has not accepted any of the queued requests");
+                        done += _reap(reqs, inflight, &err);
+                    }
+                } catch (...) {
+                    // the kernel may still write into the buffers of the submitted requests, so wait for them before returning
+                    _drain(reqs, queued, inflight);
+                    throw;
+                }
+                // the buffers are not touched by the kernel anymore since all requests have completed
+                if (err)
+                    std::rethrow_exception(err);
+            }
+        private:
+            int _fd = -1;
+            void *_sq_ptr = nullptr;
+            void *_cq_ptr = nullptr;
+            size_t _sq_size = 0;
+            size_t _cq_size = 0;
+            size_t _sqes_size = 0;
+            io_uring_sqe *_sqes = nullptr;
+            unsigned *_sq_tail = nullptr;
+            unsigned *_sq_array = nullptr;
+            unsigned _sq_mask = 0;
+            unsigned *_cq_head = nullptr;
+            unsigned *_cq_tail = nullptr;
+            unsigned _cq_mask = 0;
+            io_uring_cqe *_cqes = nullptr;
+            unsigned _entries = 0;
+            bool _usable = true;
+
+            // returns the number of the submission queue entries consumed by the kernel
+            size_t _enter(const unsigned to_submit, const unsigned min_complete)
+            {
+                for (;;) {
+                    const auto res = ::syscall(__NR_io_uring_enter, _fd, to_submit, min_complete, IORING_ENTER_GETEVENTS, nullptr, 0);
+                    if (res >= 0)
+                        return static_cast<size_t>(res);
+                    if (errno != EINTR && errno != EAGAIN) [[unlikely]]
+                        throw error_sys("io_uring_enter failed");
+                }
+            }
+
+            // processes the available completions; with a null err, the failed requests are not retried
+            size_t _reap(const std::span<const batch_reader::request> reqs, size_t &inflight, std::exception_ptr *err)
+            {
+                size_t num_reaped = 0;
+                unsigned head = *_cq_head;
+                const unsigned cq_tail = std::atomic_ref<unsigned> { *_cq_tail }.load(std::memory_order_acquire);
+                for (; head != cq_tail; ++head) {
+                    const auto &cqe = _cqes[head & _cq_mask];
+                    const auto &r = reqs[cqe.user_data];
+                    // short reads, interrupted requests and unsupported operations are completed with a blocking read
+                    if (err && (cqe.res < 0 || static_cast<size_t>(cqe.res) != r.data.size())) [[unlikely]] {
+                        const size_t num_read = cqe.res > 0 ? static_cast<size_t>(cqe.res) : 0;
+                        try {
+                            r.file->read(r.offset + num_read, r.data.subspan(num_read));
+                        } catch (...) {
+                            if (!*err)
+                                *err = std::current_exception();
+                        }
+                    }
+                    --inflight;
+                    ++num_reaped;
+                }
+                std::atomic_ref<unsigned> { *_cq_head }.store(head, std::memory_order_release);
+                return num_reaped;
+            }
+
+            // Brings the ring back to the empty state after a failed batch so that no stale completions are seen by the next one.
+            void _drain(const std::span<const batch_reader::request> reqs, const size_t queued, size_t inflight) noexcept
+            {
+                // without SQPOLL the kernel reads the submission queue only inside of io_uring_enter,
+                // so the requests it has not consumed can be withdrawn
+                std::atomic_ref<unsigned> { *_sq_tail }.store(*_sq_tail - static_cast<unsigned>(queued), std::memory_order_release);
+                try {
+                    while (inflight) {
+                        if (!_reap(reqs, inflight, nullptr))
+                            _enter(0, 1);
+                    }
+                } catch (const std::exception &ex) {
+                    logger::warn("io_uring: failed to wait for {} in-flight reads: {}", inflight, ex.what());
+                    _usable = false;
+                }
+            }
+
+            void *_map(const size_t size, const uint64_t offset)
+            {
+                void *ptr = ::mmap(nullptr, size, PROT_READ | PROT_WRITE, MAP_SHARED | MAP_POPULATE, _fd, static_cast<off_t>(offset));
+                if (ptr == MAP_FAILED)
+                    throw error_sys("io_uring ring mmap failed");
+                return ptr;
+            }
+        };
+    }
+
+    // A ring has a single submitter, so each concurrent caller takes its own ring from the pool.
+    struct batch_reader::uring_impl: impl {
+        explicit uring_impl(const size_t queue_depth): impl { queue_depth }
+        {
+            // fails early if io_uring is not available, for example, when it is blocked by a seccomp policy
+            _free.emplace_back(std::make_unique<uring>(static_cast<unsigned>(_queue_depth)));
+        }
+
+        void read(const std::span<const request> reqs) override
+        {
+            if (reqs.empty())
+                return;
+            std::unique_ptr<uring> ring {};
+            {
+                mutex::scoped_lock lk { _mutex };
+                if (!_free.empty()) {
+                    ring = std::move(_free.back());
+                    _free.pop_back();
+                }
+            }
+            if (!ring) {
+                try {
+                    ring = std::make_unique<uring>(static_cast<unsigned>(_queue_depth));
+                } catch (const std::exception &ex) {
+                    // for example, when the rings of many concurrent callers have exhausted the locked memory limit
+                    if (!_fallback_reported.exchange(true, std::memory_order_relaxed))
+                        logger::warn("io_uring: failed to create another ring, the callers without one use blocking reads: {}", ex.what());
+                    _read_blocking(reqs);
+                    return;
+                }
+            }
+            std::exception_ptr err {};
+            try {
+                ring->read(reqs, std::min(_queue_depth, static_cast<size_t>(ring->entries())));
+            } catch (...) {
+                err = std::current_exception();
+            }
+            // a ring with requests that might still complete is closed, which makes the kernel cancel them
+            if (ring->usable()) {
+                mutex::scoped_lock lk { _mutex };
+                _free.emplace_back(std::move(ring));
+            }
+            if (err)
+                std::rethrow_exception(err);
+        }
+
+        std::string_view backend() const override
+        {
+            return "io_uring";
+        }
+    private:
+        mutex::unique_lock::mutex_type _mutex alignas(mutex::alignment) {};
+        std::vector<std::unique_ptr<uring>> _free {};
+        std::atomic_bool _fallback_reported { false };
+
+        // like the thread-based reads, completes all requests before reporting the first failure
+        static void _read_blocking(const std::span<const request> reqs)
+        {
+            std::exception_ptr err {};
+            for (const auto &r: reqs) {
+                try {
+                    r.file->read(r.offset, r.data);
+                } catch (...) {
+                    if (!err)
+                        err = std::current_exception();
+                }
+            }
+            if (err)
+                std::rethrow_exception(err);
+        }
+    };
+#endif
+
+    size_t batch_reader::default_queue_depth()
+    {
+        if (const auto env_depth = env_uint<size_t>("DT_IO_QUEUE_DEPTH", 0, max_queue_depth); env_depth && *env_depth)
+            return *env_depth;
+        return 32;
+    }
+
+    bool batch_reader::default_use_uring()
+    {
+        if (const char *env_uring_str = std::getenv("DT_IO_URING"); env_uring_str != nullptr)
+            return std::string_view { env_uring_str } != "0";
+        return true;
+    }
+
+    batch_reader &batch_reader::get()
+    {
+        static batch_reader reader {};
+        return reader;
+    }
+
+    batch_reader::batch_reader(const size_t queue_depth, [[maybe_unused]] const bool use_uring)
+    {
+        if (queue_depth == 0 || queue_depth > max_queue_depth)
+            throw error(fmt::format("batch_reader requires a queue depth from 1 to {} but got {}", max_queue_depth, queue_depth));
+#ifdef __linux__
+        if (use_uring) {
+            try {
+                _impl = std::make_unique<uring_impl>(queue_depth);
+            } catch (const std::exception &ex) {
+                logger::debug("io_uring is not available, falling back to the thread-based reads: {}", ex.what());
+            }
+        }
+#endif
+        if (!_impl)
+            _impl = std::make_unique<thread_impl>(queue_depth);
+    }
+
+    batch_reader::~batch_reader() =default;
+
+    void batch_reader::read(const std::span<const request> reqs) const
+    {
+        _impl->read(reqs);
+    }
+
+    std::string_view batch_reader::backend() const
+    {
+        return _impl->backend();
+    }
+
+    size_t batch_reader::queue_depth() const
+    {
+        return _impl->queue_depth();
+    }
+}
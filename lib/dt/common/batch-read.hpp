@@ -0,0 +1,83 @@
+/* This file is part of Daedalus Turbo project: https://github.com/sierkov/daedalus-turbo/
+ * Copyright (c) 2022-2023 Alex Sierkov (alex dot sierkov at gmail dot com)
+ * Copyright (c) 2024-2025 R2 Rationality OÜ (info at r2rationality dot com)
+ * This code is distributed under the license specified in:
+ * https://github.com/sierkov/daedalus-turbo/blob/main/LICENSE */
+#ifndef DAEDALUS_TURBO_COMMON_BATCH_READ_HPP
+#define DAEDALUS_TURBO_COMMON_BATCH_READ_HPP
+
+#include <memory>
+#include <span>
+#include <string>
+#include <string_view>
+#include "file.hpp"
+
+namespace daedalus_turbo::file {
+    // A file opened for positional reads, which do not change any shared state, so that
+    // any number of threads can read from the same handle without locking.
+    struct read_handle: protected stream {
+#       ifdef _WIN32
+            using native_type = void *;
+#       else
+            using native_type = int;
+#       endif
+
+        explicit read_handle(const std::string &path);
+        read_handle(read_handle &&o);
+        read_handle(const read_handle &) =delete;
+        ~read_handle();
+        // further reads fail once the handle is closed
+        void close();
+
+        // reads exactly buf.size() bytes starting at the offset
+        void read(uint64_t offset, std::span<uint8_t> buf) const;
+        uint64_t size() const;
+
+        const std::string &path() const
+        {
+            return _path;
+        }
+
+        native_type native() const
+        {
+            return _h;
+        }
+    private:
+        std::string _path;
+        native_type _h;
+    };
+
+    // Keeps up to queue_depth positional reads in flight: through io_uring on Linux when the kernel permits it
+    // and through a pool of threads issuing blocking reads otherwise. Many threads can share a single instance.
+    struct batch_reader {
+        struct request {
+            const read_handle *file = nullptr;
+            uint64_t offset = 0;
+            std::span<uint8_t> data {};
+        };
+
+        // the thread-based reads need a thread per unit of depth
+        static constexpr size_t max_queue_depth = 4096;
+
+        // 32 unless overridden with the DT_IO_QUEUE_DEPTH environment variable; zero keeps the default
+        static size_t default_queue_depth();
+        // io_uring is used unless the DT_IO_URING environment variable is set to 0
+        static bool default_use_uring();
+        static batch_reader &get();
+
+        explicit batch_reader(size_t queue_depth=default_queue_depth(), bool use_uring=default_use_uring());
+        ~batch_reader();
+        // returns once all requests have completed; throws if any of them failed or hit the end of its file
+        void read(std::span<const request> reqs) const;
+        // "io_uring" or "threads"
+        std::string_view backend() const;
+        size_t queue_depth() const;
+    private:
+        struct impl;
+        struct uring_impl;
+        struct thread_impl;
+        std::unique_ptr<impl> _impl;
+    };
+}
+
+#endif // !DAEDALUS_TURBO_COMMON_BATCH_READ_HPP
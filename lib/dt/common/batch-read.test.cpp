@@ -0,0 +1,64 @@
+/* This file is part of Daedalus Turbo project: https://github.com/sierkov/daedalus-turbo/
+ * Copyright (c) 2022-2023 Alex Sierkov (alex dot sierkov at gmail dot com)
+ * Copyright (c) 2024-2025 R2 Rationality OÜ (info at r2rationality dot com)
+ * This code is distributed under the license specified in:
+ * https://github.com/sierkov/daedalus-turbo/blob/main/LICENSE */
+
+#include <dt/common/batch-read.hpp>
+#include <dt/common/test.hpp>
+#include <dt/file.hpp>
+
+using namespace daedalus_turbo;
+
+suite common_batch_read_suite = [] {
+    "common::batch_read"_test = [] {
+        file::tmp tmp { "batch-read-test.bin" };
+        uint8_vector data(1 << 20);
+        for (size_t i = 0; i < data.size(); ++i)
+            data[i] = static_cast<uint8_t>(i * 7 + (i >> 8));
+        file::write(tmp.path(), data);
+        const file::read_handle f { tmp.path() };
+        "read_handle"_test = [&] {
+            test_same(data.size(), f.size());
+            uint8_vector buf(1000);
+            f.read(12345, buf);
+            expect(static_cast<buffer>(buf) == static_cast<buffer>(data).subbuf(12345, 1000));
+            expect(throws([&] { f.read(data.size() - 10, buf); }));
+            expect(throws([&] { file::read_handle { "/non-existing/batch-read.bin" }; }));
+        };
+        "queue depth limits"_test = [] {
+            expect(throws([] { file::batch_reader { 0 }; }));
+            expect(throws([] { file::batch_reader { file::batch_reader::max_queue_depth + 1 }; }));
+        };
+        for (const bool use_uring: { true, false }) {
+            for (const size_t depth: { 1, 4, 32 }) {
+                const file::batch_reader reader { depth, use_uring };
+                const auto name = fmt::format("{} queue depth {}", reader.backend(), depth);
+                "batch read"_test = [&] {
+                    vector<uint8_vector> bufs(1000);
+                    vector<file::batch_reader::request> reqs {};
+                    for (size_t i = 0; i < bufs.size(); ++i) {
+                        bufs[i].resize(1 + (i * 37) % 8192);
+                        reqs.emplace_back(&f, (i * 104729) % (data.size() - bufs[i].size()), bufs[i]);
+                    }
+                    reader.read(reqs);
+                    size_t num_ok = 0;
+                    for (const auto &r: reqs)
+                        num_ok += buffer { r.data } == static_cast<buffer>(data).subbuf(r.offset, r.data.size());
+                    test_same(name, reqs.size(), num_ok);
+                };
+                "errors"_test = [&] {
+                    uint8_vector ok_buf(100), bad_buf(100);
+                    const vector<file::batch_reader::request> reqs {
+                        { &f, 0, ok_buf },
+                        { &f, data.size() - 50, bad_buf }
+                    };
+                    expect(throws([&] { reader.read(reqs); })) << name;
+                    // a failed batch leaves the reader usable
+                    reader.read(std::span { reqs.data(), 1 });
+                    expect(static_cast<buffer>(ok_buf) == static_cast<buffer>(data).subbuf(0, 100)) << name;
+                };
+            }
+        }
+    };
+};
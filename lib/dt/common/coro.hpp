@@ -8,7 +8,9 @@
 #include <coroutine>
 #include <vector>
 #include <exception>
+#include <optional>
 #include <utility>
+#include <dt/common/error.hpp>
 
 namespace daedalus_turbo::coro {
     template<typename T>
@@ -96,4 +98,140 @@ namespace daedalus_turbo::coro {
         {
         }
     };
+
+    template<typename T>
+    struct task_result {
+        std::optional<T> value {};
+
+        template<typename U>
+        void return_value(U &&v)
+        {
+            value.emplace(std::forward<U>(v));
+        }
+    };
+
+    template<>
+    struct task_result<void> {
+        void return_void()
+        {
+        }
+    };
+
+    // A lazily started coroutine that can co_await other tasks. An awaiting coroutine is continued
+    // directly from the final suspension point of the awaited one, so chains of tasks do not grow the stack.
+    template<typename T=void>
+    struct task {
+        struct promise_type;
+        using handle_type = std::coroutine_handle<promise_type>;
+
+        struct promise_type: task_result<T> {
+            std::exception_ptr exception {};
+            std::coroutine_handle<> continuation {};
+
+            struct final_awaiter {
+                bool await_ready() const noexcept
+                {
+                    return false;
+                }
+
+                std::coroutine_handle<> await_suspend(handle_type h) const noexcept
+                {
+                    if (const auto c = h.promise().continuation; c)
+                        return c;
+                    return std::noop_coroutine();
+                }
+
+                void await_resume() const noexcept
+                {
+                }
+            };
+
+            task get_return_object()
+            {
+                return task { handle_type::from_promise(*this) };
+            }
+
+            std::suspend_always initial_suspend() noexcept
+            {
+                return {};
+            }
+
+            final_awaiter final_suspend() noexcept
+            {
+                return {};
+            }
+
+            void unhandled_exception()
+            {
+                exception = std::current_exception();
+            }
+        };
+
+        task(task &&t) noexcept:
+            _coro { std::exchange(t._coro, {}) }
+        {
+        }
+
+        task &operator=(task &&t) noexcept
+        {
+            if (this != &t) [[likely]] {
+                if (_coro) [[likely]]
+                    _coro.destroy();
+                _coro = std::exchange(t._coro, {});
+            }
+            return *this;
+        }
+
+        ~task()
+        {
+            if (_coro) [[likely]]
+                _coro.destroy();
+        }
+
+        handle_type handle() const noexcept
+        {
+            return _coro;
+        }
+
+        bool done() const noexcept
+        {
+            return !_coro || _coro.done();
+        }
+
+        // must be called only once the coroutine has completed; rethrows its exception if any
+        T result()
+        {
+            auto &p = _coro.promise();
+            if (p.exception)
+                std::rethrow_exception(p.exception);
+            if constexpr (!std::is_void_v<T>) {
+                if (!p.value) [[unlikely]]
+                    throw error("a result of an incomplete coroutine task has been requested!");
+                return std::move(*p.value);
+            }
+        }
+
+        bool await_ready() const noexcept
+        {
+            return false;
+        }
+
+        std::coroutine_handle<> await_suspend(std::coroutine_handle<> awaiting) noexcept
+        {
+            _coro.promise().continuation = awaiting;
+            return _coro;
+        }
+
+        T await_resume()
+        {
+            return result();
+        }
+    private:
+        handle_type _coro;
+
+        explicit task(handle_type h):
+            _coro { h }
+        {
+        }
+    };
 }
\ No newline at end of file
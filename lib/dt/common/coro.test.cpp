@@ -15,6 +15,23 @@ namespace {
         co_yield 22;
         co_yield 33;
     }
+
+    coro::task<int> add_one(const int x)
+    {
+        co_return x + 1;
+    }
+
+    coro::task<int> add_two(const int x)
+    {
+        const auto y = co_await add_one(x);
+        co_return co_await add_one(y);
+    }
+
+    coro::task<> fail()
+    {
+        throw error("Ha ha! I told ya!");
+        co_return;
+    }
 }
 
 suite coroutine_suite = [] {
@@ -26,4 +43,15 @@ suite coroutine_suite = [] {
         }
         test_same(std::vector<int> { 22, 33 }, v);
     };
+    "task"_test = [] {
+        auto t = add_two(20);
+        expect(!t.done());
+        t.handle().resume();
+        expect(t.done());
+        test_same(22, t.result());
+        auto f = fail();
+        f.handle().resume();
+        expect(f.done());
+        expect(throws([&] { f.result(); }));
+    };
 };
\ No newline at end of file
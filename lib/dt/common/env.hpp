@@ -0,0 +1,37 @@
+/* This file is part of Daedalus Turbo project: https://github.com/sierkov/daedalus-turbo/
+ * Copyright (c) 2022-2023 Alex Sierkov (alex dot sierkov at gmail dot com)
+ * Copyright (c) 2024-2025 R2 Rationality OÜ (info at r2rationality dot com)
+ * This code is distributed under the license specified in:
+ * https://github.com/sierkov/daedalus-turbo/blob/main/LICENSE */
+#ifndef DAEDALUS_TURBO_COMMON_ENV_HPP
+#define DAEDALUS_TURBO_COMMON_ENV_HPP
+
+#include <charconv>
+#include <cstdint>
+#include <cstdlib>
+#include <limits>
+#include <optional>
+#include <string_view>
+#include "error.hpp"
+#include "format.hpp"
+
+namespace daedalus_turbo {
+    // The value of an environment variable holding an unsigned integer or nothing if the variable is not set.
+    // Throws if the value is not a number in [min, max], so that a typo does not silently change the behavior.
+    template<typename T=uint64_t>
+    std::optional<T> env_uint(const char *name, const T min=0, const T max=std::numeric_limits<T>::max())
+    {
+        static_assert(std::numeric_limits<T>::is_integer && !std::numeric_limits<T>::is_signed);
+        const char *val_str = std::getenv(name);
+        if (val_str == nullptr)
+            return {};
+        const std::string_view val_sv { val_str };
+        T val {};
+        const auto [end, ec] = std::from_chars(val_sv.data(), val_sv.data() + val_sv.size(), val);
+        if (ec != std::errc {} || end != val_sv.data() + val_sv.size() || val < min || val > max) [[unlikely]]
+            throw error(fmt::format("the environment variable {} must be an integer from {} to {} but is '{}'", name, min, max, val_sv));
+        return val;
+    }
+}
+
+#endif // !DAEDALUS_TURBO_COMMON_ENV_HPP
@@ -0,0 +1,45 @@
+/* This file is part of Daedalus Turbo project: https://github.com/sierkov/daedalus-turbo/
+ * Copyright (c) 2022-2023 Alex Sierkov (alex dot sierkov at gmail dot com)
+ * Copyright (c) 2024-2025 R2 Rationality OÜ (info at r2rationality dot com)
+ * This code is distributed under the license specified in:
+ * https://github.com/sierkov/daedalus-turbo/blob/main/LICENSE */
+
+#include <dt/common/env.hpp>
+#include <dt/common/test.hpp>
+
+using namespace daedalus_turbo;
+
+namespace {
+    void my_setenv(const char *name, const char *val)
+    {
+#if _WIN32
+        std::string putexpr { fmt::format("{}={}", name, val != nullptr ? val : "") };
+        putenv(putexpr.c_str());
+#else
+        if (val != nullptr)
+            setenv(name, val, 1);
+        else
+            unsetenv(name);
+#endif
+    }
+}
+
+suite common_env_suite = [] {
+    "common::env"_test = [] {
+        "env_uint"_test = [] {
+            static constexpr auto name = "DT_TEST_ENV_UINT";
+            my_setenv(name, nullptr);
+            expect(!env_uint(name));
+            my_setenv(name, "123");
+            test_same(123, env_uint(name).value());
+            test_same(123, env_uint<uint16_t>(name, 1, 200).value());
+            expect(throws([] { env_uint<uint16_t>(name, 1, 100); }));
+            expect(throws([] { env_uint<uint16_t>(name, 124); }));
+            for (const auto *bad: { "", "-1", "12a", " 12", "0x10", "99999999999999999999999" }) {
+                my_setenv(name, bad);
+                expect(throws([] { env_uint(name); })) << bad;
+            }
+            my_setenv(name, nullptr);
+        };
+    };
+};
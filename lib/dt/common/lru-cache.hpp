@@ -0,0 +1,245 @@
+/* This file is part of Daedalus Turbo project: https://github.com/sierkov/daedalus-turbo/
+ * Copyright (c) 2022-2023 Alex Sierkov (alex dot sierkov at gmail dot com)
+ * Copyright (c) 2024-2025 R2 Rationality OÜ (info at r2rationality dot com)
+ * This code is distributed under the license specified in:
+ * https://github.com/sierkov/daedalus-turbo/blob/main/LICENSE */
+#ifndef DAEDALUS_TURBO_COMMON_LRU_CACHE_HPP
+#define DAEDALUS_TURBO_COMMON_LRU_CACHE_HPP
+
+#include <array>
+#include <atomic>
+#include <functional>
+#include <future>
+#include <list>
+#include <memory>
+#include <unordered_map>
+#include <dt/mutex.hpp>
+#include "bytes.hpp"
+
+namespace daedalus_turbo {
+    // A thread-safe LRU cache of immutable byte buffers limited by their total size.
+    // Every entry carries a version tag, such as a hash of its source, and a lookup with another tag replaces the entry.
+    // The cache is split into NumShards shards with their own locks and an equal part of the budget.
+    // Concurrent misses of the same key and tag wait for a single load and share its result or its exception.
+    // The returned data stays valid for as long as the caller holds the pointer, even if the entry has been evicted.
+    template<typename K, typename T, size_t NumShards=1, typename H=std::hash<K>>
+    struct lru_cache {
+        using data_ptr = std::shared_ptr<const uint8_vector>;
+        using loader = std::function<uint8_vector ()>;
+
+        struct stats {
+            uint64_t hits = 0;
+            uint64_t misses = 0;
+            uint64_t evictions = 0;
+            size_t num_chunks = 0;
+            uint64_t num_bytes = 0;
+
+            double hit_rate() const
+            {
+                return hits + misses > 0 ? static_cast<double>(hits) / static_cast<double>(hits + misses) : 0.0;
+            }
+        };
+
+        static constexpr size_t num_shards = NumShards;
+        static_assert(num_shards > 0);
+
+        explicit lru_cache(const uint64_t budget): _budget { budget }
+        {
+            for (auto &s: _shards)
+                s.budget = budget / num_shards;
+        }
+
+        // a miss counts only for the caller that runs the load; the callers waiting for it count as hits
+        data_ptr get(const K &k, const T &tag, const loader &load)
+        {
+            auto &s = _shard(k);
+            std::promise<data_ptr> loaded {};
+            bool leader = false;
+            {
+                mutex::unique_lock lk { s.mutex };
+                if (auto data = _find(s, k, tag))
+                    return data;
+                if (const auto it = s.loading.find(k); it != s.loading.end()) {
+                    // a load of another tag is not waited for, so the outdated data is never returned
+                    if (it->second.tag == tag) {
+                        auto res = it->second.result;
+                        lk.unlock();
+                        s.hits.fetch_add(1, std::memory_order_relaxed);
+                        return res.get();
+                    }
+                } else {
+                    s.loading.emplace(k, pending { tag, loaded.get_future().share() });
+                    leader = true;
+                }
+            }
+            s.misses.fetch_add(1, std::memory_order_relaxed);
+            data_ptr data {};
+            try {
+                data = std::make_shared<const uint8_vector>(load());
+            } catch (...) {
+                if (leader) {
+                    {
+                        mutex::scoped_lock lk { s.mutex };
+                        s.loading.erase(k);
+                    }
+                    loaded.set_exception(std::current_exception());
+                }
+                throw;
+            }
+            {
+                mutex::scoped_lock lk { s.mutex };
+                if (leader)
+                    s.loading.erase(k);
+                // data that does not fit into the shard's budget on its own is not cached
+                if (data->size() <= s.budget && !s.index.contains(k)) {
+                    s.entries.emplace_front(k, tag, data);
+                    s.index.emplace(k, s.entries.begin());
+                    s.num_bytes += data->size();
+                    _evict(s);
+                }
+            }
+            if (leader)
+                loaded.set_value(data);
+            return data;
+        }
+
+        // a cached entry or nullptr; a lookup without a loader does not count as a miss
+        data_ptr find(const K &k, const T &tag)
+        {
+            auto &s = _shard(k);
+            mutex::scoped_lock lk { s.mutex };
+            return _find(s, k, tag);
+        }
+
+        void erase(const K &k)
+        {
+            auto &s = _shard(k);
+            mutex::scoped_lock lk { s.mutex };
+            if (const auto it = s.index.find(k); it != s.index.end())
+                _erase(s, it->second);
+        }
+
+        void clear()
+        {
+            for (auto &s: _shards) {
+                mutex::scoped_lock lk { s.mutex };
+                s.index.clear();
+                s.entries.clear();
+                s.num_bytes = 0;
+            }
+        }
+
+        uint64_t budget() const
+        {
+            return _budget.load(std::memory_order_relaxed);
+        }
+
+        void budget(const uint64_t num_bytes)
+        {
+            _budget.store(num_bytes, std::memory_order_relaxed);
+            for (auto &s: _shards) {
+                mutex::scoped_lock lk { s.mutex };
+                s.budget = num_bytes / num_shards;
+                _evict(s);
+            }
+        }
+
+        stats stat() const
+        {
+            stats st {};
+            for (const auto &s: _shards) {
+                mutex::scoped_lock lk { s.mutex };
+                st.hits += s.hits.load(std::memory_order_relaxed);
+                st.misses += s.misses.load(std::memory_order_relaxed);
+                st.evictions += s.evictions;
+                st.num_chunks += s.entries.size();
+                st.num_bytes += s.num_bytes;
+            }
+            return st;
+        }
+
+        uint64_t hits() const
+        {
+            uint64_t sum = 0;
+            for (const auto &s: _shards)
+                sum += s.hits.load(std::memory_order_relaxed);
+            return sum;
+        }
+
+        uint64_t misses() const
+        {
+            uint64_t sum = 0;
+            for (const auto &s: _shards)
+                sum += s.misses.load(std::memory_order_relaxed);
+            return sum;
+        }
+    private:
+        struct entry {
+            K k;
+            T tag;
+            data_ptr data;
+        };
+        using entry_list = std::list<entry>;
+
+        struct pending {
+            T tag;
+            std::shared_future<data_ptr> result;
+        };
+
+        struct shard {
+            mutable mutex::unique_lock::mutex_type mutex alignas(mutex::alignment) {};
+            // the most recently used entries are at the front
+            entry_list entries {};
+            std::unordered_map<K, typename entry_list::iterator, H> index {};
+            std::unordered_map<K, pending, H> loading {};
+            uint64_t budget = 0;
+            uint64_t num_bytes = 0;
+            uint64_t evictions = 0;
+            std::atomic<uint64_t> hits { 0 };
+            std::atomic<uint64_t> misses { 0 };
+        };
+
+        std::atomic<uint64_t> _budget;
+        std::array<shard, num_shards> _shards {};
+
+        shard &_shard(const K &k)
+        {
+            if constexpr (num_shards == 1)
+                return _shards[0];
+            else
+                return _shards[H {}(k) % num_shards];
+        }
+
+        // the helpers below must be called with the shard's mutex taken
+        static data_ptr _find(shard &s, const K &k, const T &tag)
+        {
+            if (const auto it = s.index.find(k); it != s.index.end()) {
+                if (it->second->tag == tag) [[likely]] {
+                    s.entries.splice(s.entries.begin(), s.entries, it->second);
+                    s.hits.fetch_add(1, std::memory_order_relaxed);
+                    return it->second->data;
+                }
+                // the source has been rewritten since the data was cached
+                _erase(s, it->second);
+            }
+            return {};
+        }
+
+        static void _erase(shard &s, const typename entry_list::iterator it)
+        {
+            s.num_bytes -= it->data->size();
+            s.index.erase(it->k);
+            s.entries.erase(it);
+        }
+
+        static void _evict(shard &s)
+        {
+            while (s.num_bytes > s.budget) {
+                _erase(s, std::prev(s.entries.end()));
+                ++s.evictions;
+            }
+        }
+    };
+}
+
+#endif // !DAEDALUS_TURBO_COMMON_LRU_CACHE_HPP
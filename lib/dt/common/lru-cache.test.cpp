@@ -0,0 +1,102 @@
+/* This file is part of Daedalus Turbo project: https://github.com/sierkov/daedalus-turbo/
+ * Copyright (c) 2022-2023 Alex Sierkov (alex dot sierkov at gmail dot com)
+ * Copyright (c) 2024-2025 R2 Rationality OÜ (info at r2rationality dot com)
+ * This code is distributed under the license specified in:
+ * https://github.com/sierkov/daedalus-turbo/blob/main/LICENSE */
+
+#include <condition_variable>
+#include <thread>
+#include <vector>
+#include <dt/common/lru-cache.hpp>
+#include <dt/common/test.hpp>
+
+using namespace daedalus_turbo;
+
+suite common_lru_cache_suite = [] {
+    "common::lru_cache"_test = [] {
+        using cache_type = lru_cache<uint64_t, uint64_t, 4>;
+        "sharded budget"_test = [] {
+            cache_type cache { 400 };
+            for (uint64_t k = 0; k < 100; ++k)
+                cache.get(k, 0, [] { return uint8_vector(100); });
+            const auto st = cache.stat();
+            test_same(cache_type::num_shards, st.num_chunks);
+            test_same(100, st.num_chunks + st.evictions);
+            cache.budget(0);
+            test_same(0, cache.stat().num_chunks);
+        };
+        "erase"_test = [] {
+            cache_type cache { 1 << 20 };
+            cache.get(1, 0, [] { return uint8_vector(10); });
+            expect(cache.find(1, 0) != nullptr);
+            expect(cache.find(1, 1) == nullptr);
+            expect(cache.find(1, 0) == nullptr);
+            cache.get(1, 0, [] { return uint8_vector(10); });
+            cache.erase(1);
+            expect(cache.find(1, 0) == nullptr);
+        };
+        "single-flight load"_test = [] {
+            cache_type cache { 1 << 20 };
+            static constexpr size_t num_threads = 8;
+            std::atomic_size_t num_loads { 0 };
+            std::atomic_size_t num_started { 0 };
+            std::vector<cache_type::data_ptr> res(num_threads);
+            std::vector<std::thread> threads {};
+            for (size_t i = 0; i < num_threads; ++i) {
+                threads.emplace_back([&, i] {
+                    ++num_started;
+                    res[i] = cache.get(7, 0, [&] {
+                        ++num_loads;
+                        // give the other threads the time to miss the same key
+                        while (num_started.load() < num_threads)
+                            std::this_thread::yield();
+                        std::this_thread::sleep_for(std::chrono::milliseconds { 50 });
+                        return uint8_vector(10);
+                    });
+                });
+            }
+            for (auto &t: threads)
+                t.join();
+            test_same(1, num_loads.load());
+            for (const auto &d: res)
+                expect(d == res[0]);
+            test_same(1, cache.misses());
+            test_same(num_threads - 1, cache.hits());
+        };
+        "a failed load is shared and not cached"_test = [] {
+            cache_type cache { 1 << 20 };
+            std::mutex m {};
+            std::condition_variable cv {};
+            bool loading = false;
+            std::atomic_size_t num_failed { 0 };
+            std::thread leader { [&] {
+                try {
+                    cache.get(3, 0, [&]() -> uint8_vector {
+                        {
+                            std::scoped_lock lk { m };
+                            loading = true;
+                        }
+                        cv.notify_all();
+                        std::this_thread::sleep_for(std::chrono::milliseconds { 50 });
+                        throw error("load failed");
+                    });
+                } catch (const error &) {
+                    ++num_failed;
+                }
+            } };
+            {
+                std::unique_lock lk { m };
+                cv.wait(lk, [&] { return loading; });
+            }
+            try {
+                cache.get(3, 0, [] { return uint8_vector(10); });
+            } catch (const error &) {
+                ++num_failed;
+            }
+            leader.join();
+            test_same(2, num_failed.load());
+            test_same(0, cache.stat().num_chunks);
+            test_same(10, cache.get(3, 0, [] { return uint8_vector(10); })->size());
+        };
+    };
+};
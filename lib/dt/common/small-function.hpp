@@ -0,0 +1,142 @@
+/* This file is part of Daedalus Turbo project: https://github.com/sierkov/daedalus-turbo/
+ * Copyright (c) 2022-2023 Alex Sierkov (alex dot sierkov at gmail dot com)
+ * Copyright (c) 2024-2025 R2 Rationality OÜ (info at r2rationality dot com)
+ * This code is distributed under the license specified in:
+ * https://github.com/sierkov/daedalus-turbo/blob/main/LICENSE */
+#ifndef DAEDALUS_TURBO_COMMON_SMALL_FUNCTION_HPP
+#define DAEDALUS_TURBO_COMMON_SMALL_FUNCTION_HPP
+
+#include <cstddef>
+#include <functional>
+#include <new>
+#include <type_traits>
+#include <utility>
+#include "error.hpp"
+
+namespace daedalus_turbo {
+    template<typename Sig, size_t Capacity=48>
+    struct small_function;
+
+    // A move-only alternative to std::function that keeps callables of up to Capacity bytes
+    // in an inline buffer. Larger callables are still accepted but are allocated on the heap.
+    template<typename R, typename... Args, size_t Capacity>
+    struct small_function<R(Args...), Capacity> {
+        static constexpr size_t capacity = Capacity;
+
+        template<typename F>
+        static constexpr bool fits_inline = sizeof(F) <= Capacity && alignof(F) <= alignof(std::max_align_t)
+            && std::is_nothrow_move_constructible_v<F>;
+
+        small_function() noexcept =default;
+
+        template<typename F>
+            requires (!std::is_same_v<std::decay_t<F>, small_function> && std::is_invocable_r_v<R, std::decay_t<F> &, Args...>)
+        small_function(F &&f)
+        {
+            using func_type = std::decay_t<F>;
+            if constexpr (fits_inline<func_type>) {
+                new (_buf) func_type(std::forward<F>(f));
+                _ops = &_inline_ops<func_type>;
+            } else {
+                new (_buf) func_type *(new func_type(std::forward<F>(f)));
+                _ops = &_heap_ops<func_type>;
+            }
+        }
+
+        small_function(small_function &&o) noexcept
+        {
+            if (o._ops) {
+                o._ops->move(_buf, o._buf);
+                _ops = std::exchange(o._ops, nullptr);
+            }
+        }
+
+        small_function(const small_function &) =delete;
+
+        ~small_function()
+        {
+            reset();
+        }
+
+        small_function &operator=(small_function &&o) noexcept
+        {
+            if (this != &o) [[likely]] {
+                reset();
+                if (o._ops) {
+                    o._ops->move(_buf, o._buf);
+                    _ops = std::exchange(o._ops, nullptr);
+                }
+            }
+            return *this;
+        }
+
+        small_function &operator=(const small_function &) =delete;
+
+        R operator()(Args... args)
+        {
+            if (!_ops) [[unlikely]]
+                throw error("small_function: call of an empty function object!");
+            return _ops->invoke(_buf, std::forward<Args>(args)...);
+        }
+
+        explicit operator bool() const noexcept
+        {
+            return _ops != nullptr;
+        }
+
+        bool is_inline() const noexcept
+        {
+            return _ops && _ops->is_inline;
+        }
+
+        void reset() noexcept
+        {
+            if (_ops) {
+                _ops->destroy(_buf);
+                _ops = nullptr;
+            }
+        }
+    private:
+        struct ops {
+            R (*invoke)(void *, Args&&...);
+            void (*move)(void *dst, void *src) noexcept;
+            void (*destroy)(void *) noexcept;
+            bool is_inline;
+        };
+
+        template<typename F>
+        static constexpr ops _inline_ops {
+            [](void *p, Args&&... args) -> R {
+                return std::invoke(*std::launder(reinterpret_cast<F *>(p)), std::forward<Args>(args)...);
+            },
+            [](void *dst, void *src) noexcept {
+                auto *src_f = std::launder(reinterpret_cast<F *>(src));
+                new (dst) F(std::move(*src_f));
+                src_f->~F();
+            },
+            [](void *p) noexcept {
+                std::launder(reinterpret_cast<F *>(p))->~F();
+            },
+            true
+        };
+
+        template<typename F>
+        static constexpr ops _heap_ops {
+            [](void *p, Args&&... args) -> R {
+                return std::invoke(**std::launder(reinterpret_cast<F **>(p)), std::forward<Args>(args)...);
+            },
+            [](void *dst, void *src) noexcept {
+                new (dst) F *(*std::launder(reinterpret_cast<F **>(src)));
+            },
+            [](void *p) noexcept {
+                delete *std::launder(reinterpret_cast<F **>(p));
+            },
+            false
+        };
+
+        alignas(std::max_align_t) std::byte _buf[Capacity];
+        const ops *_ops = nullptr;
+    };
+}
+
+#endif // !DAEDALUS_TURBO_COMMON_SMALL_FUNCTION_HPP
@@ -0,0 +1,52 @@
+/* This file is part of Daedalus Turbo project: https://github.com/sierkov/daedalus-turbo/
+ * Copyright (c) 2022-2023 Alex Sierkov (alex dot sierkov at gmail dot com)
+ * Copyright (c) 2024-2025 R2 Rationality OÜ (info at r2rationality dot com)
+ * This code is distributed under the license specified in:
+ * https://github.com/sierkov/daedalus-turbo/blob/main/LICENSE */
+
+#include <array>
+#include <memory>
+#include <dt/common/small-function.hpp>
+#include <dt/common/test.hpp>
+
+using namespace daedalus_turbo;
+
+suite common_small_function_suite = [] {
+    "common::small_function"_test = [] {
+        "small callables are stored inline"_test = [] {
+            int x = 20;
+            small_function<int(int)> f { [&x](const int y) { return x + y; } };
+            expect(static_cast<bool>(f));
+            expect(f.is_inline());
+            test_same(22, f(2));
+        };
+        "large callables are stored on the heap"_test = [] {
+            std::array<uint64_t, 16> big {};
+            big[3] = 7;
+            small_function<uint64_t()> f { [big] { return big[3]; } };
+            expect(!f.is_inline());
+            test_same(7, f());
+        };
+        "move-only captures"_test = [] {
+            auto p = std::make_unique<int>(33);
+            small_function<int()> f { [p=std::move(p)] { return *p; } };
+            auto f2 = std::move(f);
+            expect(!f);
+            test_same(33, f2());
+            expect(throws([&] { f(); }));
+        };
+        "captures are destroyed exactly once"_test = [] {
+            const auto res = std::make_shared<int>(1);
+            {
+                small_function<void()> f { [res] {} };
+                test_same(2, res.use_count());
+                small_function<void()> f2 {};
+                f2 = std::move(f);
+                test_same(2, res.use_count());
+                f2.reset();
+                test_same(1, res.use_count());
+            }
+            test_same(1, res.use_count());
+        };
+    };
+};
@@ -231,42 +231,32 @@ namespace daedalus_turbo {
 
         void _find_used_txos_small(progress &p, scheduler &sched, std::vector<uint64_t> &txo_tasks, const index::reader_multi_mt<index::txo_use::item> &txo_use_idx)
         {
-            const size_t num_parts = sched.num_workers();
+            // sorted keys let each slice be searched in a single sequential pass
+            std::vector<std::pair<index::txo_use::item, transaction_output *>> keys {};
+            for (const auto tx_off: txo_tasks) {
+                auto &txo_item = transactions.at(tx_off);
+                for (auto &out: txo_item.outputs)
+                    keys.emplace_back(index::txo_use::item { txo_item.hash, out.out_idx }, &out);
+            }
+            std::sort(keys.begin(), keys.end(), [](const auto &a, const auto &b) { return a.first.index_less(b.first); });
+            std::vector<index::txo_use::item> search_items {};
+            search_items.reserve(keys.size());
+            for (const auto &[item, out]: keys)
+                search_items.emplace_back(item);
+            std::vector<std::atomic_size_t> use_counts(keys.size());
             std::atomic_size_t num_ready { 0 };
-            sched.on_result("search-txo-use", [&](const auto &res) {
-                if (res.type() == typeid(scheduled_task_error))
-                    return;
-                const auto task_n_reads = std::any_cast<size_t>(res);
-                num_disk_reads += task_n_reads;
-                num_idx_reads += task_n_reads;
+            const auto num_reads = txo_use_idx.find_batch(sched, search_items, [&](const size_t key_idx, const index::txo_use::item &use_item) {
+                if (use_counts[key_idx].fetch_add(1, std::memory_order_relaxed) > 0) [[unlikely]]
+                    throw error(fmt::format("internal error: multiple txo-use entries for the same tx output {}#{}!", use_item.hash, static_cast<size_t>(use_item.out_idx)));
+                auto &out = *keys[key_idx].second;
+                out.use_offset = use_item.offset;
+                out.use_size = use_item.size;
+                if (num_ready.fetch_add(1, std::memory_order_relaxed) % 1000 == 0)
+                    p.update("find spent txos", num_ready, keys.size());
             });
-            for (size_t i = 0; i < num_parts; ++i) {
-                const size_t start_idx = i * txo_tasks.size() / num_parts;
-                const size_t end_idx = (i + 1) * txo_tasks.size() / num_parts;
-                sched.submit("search-txo-use", 100, [this, start_idx, end_idx, &txo_tasks, &txo_use_idx, &p, &num_ready]() {
-                    auto txo_use_data = txo_use_idx.init_thread();
-                    index::txo_use::item search_item {};
-                    for (size_t j = start_idx; j < end_idx; ++j) {
-                        auto &txo_item = transactions.at(txo_tasks[j]);
-                        search_item.hash = txo_item.hash;
-                        for (auto &out: txo_item.outputs) {
-                            search_item.out_idx = out.out_idx;
-                            const auto [ use_count, use_item ] = txo_use_idx.find(search_item, txo_use_data);
-                            if (use_count > 0) {
-                                if (use_count > 1) [[unlikely]]
-                                    throw error(fmt::format("internal error: multiple txo-use entries for the same tx offset {}!", txo_tasks[j]));
-                                out.use_offset = use_item.offset;
-                                out.use_size = use_item.size;
-                            }
-                        }
-                        if (num_ready.fetch_add(1) % 1000 == 0) {
-                            p.update("find spent txos", num_ready, transactions.size());
-                        }
-                    }
-                    return txo_use_data.num_reads;
-                });
-            }
-            sched.process(true);
+            num_disk_reads += num_reads;
+            num_idx_reads += num_reads;
+            p.update("find spent txos", transactions.size(), transactions.size());
         }
 
         void _find_used_txos_large(progress &p, scheduler &sched, size_t num_txos, const index::reader_multi_mt<index::txo_use::item> &txo_use_idx)
@@ -311,10 +301,10 @@ namespace daedalus_turbo {
 
         reconstructor(chunk_registry &cr):
             _cr { cr },
-            _stake_ref_idx { _cr.indexer().reader_paths("stake-ref") },
-            _pay_ref_idx { _cr.indexer().reader_paths("pay-ref") },
-            _tx_idx { _cr.indexer().reader_paths("tx") },
-            _txo_use_idx { _cr.indexer().reader_paths("txo-use") }
+            _stake_ref_idx { _cr.indexer().reader_paths("stake-ref"), &_idx_cache },
+            _pay_ref_idx { _cr.indexer().reader_paths("pay-ref"), &_idx_cache },
+            _tx_idx { _cr.indexer().reader_paths("tx"), &_idx_cache },
+            _txo_use_idx { _cr.indexer().reader_paths("txo-use"), &_idx_cache }
         {
         }
 
@@ -346,8 +336,15 @@ namespace daedalus_turbo {
         {
             return _cr.find_block_by_offset(tx_offset);
         }
+
+        index::chunk_cache::stats index_cache_stats() const
+        {
+            return _idx_cache.stat();
+        }
     private:
         chunk_registry &_cr;
+        // hot chunks, such as those of exchange addresses, stay decompressed across lookups and requests
+        index::chunk_cache _idx_cache {};
         index::reader_multi<index::stake_ref::item> _stake_ref_idx;
         index::reader_multi<index::pay_ref::item> _pay_ref_idx;
         index::reader_multi<index::tx::item> _tx_idx;
@@ -372,6 +369,9 @@ namespace daedalus_turbo {
             hist.fill_raw_tx_data(_cr.sched(), _cr, *this, true);
             hist.compute_balances();
             hist.full_history = true;
+            const auto cache_st = _idx_cache.stat();
+            logger::debug("index chunk cache hits: {} misses: {} hit rate: {:0.1f}% evictions: {} cached: {} chunks {} MiB",
+                cache_st.hits, cache_st.misses, 100 * cache_st.hit_rate(), cache_st.evictions, cache_st.num_chunks, cache_st.num_bytes >> 20);
             return hist;
         }
     };
@@ -401,8 +401,8 @@ namespace daedalus_turbo {
             });
             for (auto &[chunk_offset, chunk_info]: chunk_tasks) {
                 sched.submit_void("parse-chunk", 100, [&]() {
-                    const auto data = zstd::read(cr.full_path(chunk_info.chunk.rel_path()));
-                    const buffer buf { data };
+                    const auto data = cr.read_chunk(chunk_info.chunk);
+                    const buffer buf { *data };
                     for (auto tx_ptr: chunk_info.tasks) {
                         auto &[tx_offset, tx_item] = *tx_ptr;
                         if (tx_offset < chunk_offset)
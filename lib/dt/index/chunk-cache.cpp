@@ -0,0 +1,26 @@
+/* This file is part of Daedalus Turbo project: https://github.com/sierkov/daedalus-turbo/
+ * Copyright (c) 2022-2023 Alex Sierkov (alex dot sierkov at gmail dot com)
+ * Copyright (c) 2024-2025 R2 Rationality OÜ (info at r2rationality dot com)
+ * This code is distributed under the license specified in:
+ * https://github.com/sierkov/daedalus-turbo/blob/main/LICENSE */
+
+#include <cstdlib>
+#include <dt/index/chunk-cache.hpp>
+
+namespace daedalus_turbo::index {
+    uint64_t chunk_cache::default_budget()
+    {
+        if (const char *env_budget_str = std::getenv("DT_INDEX_CACHE_MB"); env_budget_str != nullptr)
+            return std::stoull(env_budget_str) << 20;
+        return 128ULL << 20;
+    }
+
+    uint64_t chunk_cache::file_id(const std::string &path)
+    {
+        return std::hash<std::string> {}(path);
+    }
+
+    chunk_cache::chunk_cache(const uint64_t budget): lru_cache { budget }
+    {
+    }
+}
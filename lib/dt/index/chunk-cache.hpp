@@ -0,0 +1,44 @@
+/* This file is part of Daedalus Turbo project: https://github.com/sierkov/daedalus-turbo/
+ * Copyright (c) 2022-2023 Alex Sierkov (alex dot sierkov at gmail dot com)
+ * Copyright (c) 2024-2025 R2 Rationality OÜ (info at r2rationality dot com)
+ * This code is distributed under the license specified in:
+ * https://github.com/sierkov/daedalus-turbo/blob/main/LICENSE */
+#ifndef DAEDALUS_TURBO_INDEX_CHUNK_CACHE_HPP
+#define DAEDALUS_TURBO_INDEX_CHUNK_CACHE_HPP
+
+#include <string>
+#include <dt/blake2b.hpp>
+#include <dt/common/lru-cache.hpp>
+
+namespace daedalus_turbo::index {
+    struct chunk_cache_key {
+        uint64_t file_id = 0;
+        uint32_t part_idx = 0;
+        uint32_t chunk_idx = 0;
+
+        bool operator==(const chunk_cache_key &o) const =default;
+    };
+
+    struct chunk_cache_key_hash {
+        size_t operator()(const chunk_cache_key &k) const
+        {
+            return std::hash<uint64_t> {}(k.file_id ^ (static_cast<uint64_t>(k.part_idx) << 32 | k.chunk_idx) * 0x9E3779B97F4A7C15ULL);
+        }
+    };
+
+    // A cache of decompressed index chunks that can be shared by any number of index readers.
+    // Entries are keyed by the index file, partition and chunk and checked against the packed hash, since a rewritten index keeps its path.
+    // The shards let threads probing different chunks rarely contend.
+    struct chunk_cache: lru_cache<chunk_cache_key, blake2b_64_hash, 16, chunk_cache_key_hash> {
+        using key = chunk_cache_key;
+
+        // 128 MiB unless overridden with the DT_INDEX_CACHE_MB environment variable; zero disables caching
+        static uint64_t default_budget();
+        // the same path always maps to the same id, so independently opened readers of an index share its entries
+        static uint64_t file_id(const std::string &path);
+
+        explicit chunk_cache(uint64_t budget=default_budget());
+    };
+}
+
+#endif // !DAEDALUS_TURBO_INDEX_CHUNK_CACHE_HPP
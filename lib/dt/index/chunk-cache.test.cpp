@@ -0,0 +1,144 @@
+/* This file is part of Daedalus Turbo project: https://github.com/sierkov/daedalus-turbo/
+ * Copyright (c) 2022-2023 Alex Sierkov (alex dot sierkov at gmail dot com)
+ * Copyright (c) 2024-2025 R2 Rationality OÜ (info at r2rationality dot com)
+ * This code is distributed under the license specified in:
+ * https://github.com/sierkov/daedalus-turbo/blob/main/LICENSE */
+
+#include <dt/common/test.hpp>
+#include <dt/file.hpp>
+#include <dt/index/chunk-cache.hpp>
+#include <dt/index/common.hpp>
+
+using namespace daedalus_turbo;
+using namespace daedalus_turbo::index;
+
+namespace {
+    struct index_item {
+        uint64_t offset = 0;
+
+        bool index_less(const index_item &b) const
+        {
+            return offset < b.offset;
+        }
+
+        bool operator<(const index_item &b) const
+        {
+            return offset < b.offset;
+        }
+
+        bool operator==(const index_item &b) const
+        {
+            return offset == b.offset;
+        }
+    };
+
+    blake2b_64_hash make_hash(const uint8_t hash_byte)
+    {
+        blake2b_64_hash h {};
+        h.data()[0] = hash_byte;
+        return h;
+    }
+}
+
+suite index_chunk_cache_suite = [] {
+    "index::chunk_cache"_test = [] {
+        "hits and misses"_test = [] {
+            chunk_cache cache { 1 << 20 };
+            size_t num_loads = 0;
+            const auto load = [&] {
+                ++num_loads;
+                return uint8_vector(100);
+            };
+            const chunk_cache::key k { chunk_cache::file_id("a"), 1, 2 };
+            const auto d1 = cache.get(k, make_hash(0), load);
+            const auto d2 = cache.get(k, make_hash(0), load);
+            expect(d1 == d2);
+            cache.get({ chunk_cache::file_id("b"), 1, 2 }, make_hash(0), load);
+            test_same(2, num_loads);
+            const auto st = cache.stat();
+            test_same(1, st.hits);
+            test_same(2, st.misses);
+            test_same(2, st.num_chunks);
+            test_same(200, st.num_bytes);
+            expect(st.hit_rate() > 0.33 && st.hit_rate() < 0.34) << st.hit_rate();
+        };
+        "lru eviction by bytes"_test = [] {
+            // each shard gets 300 bytes
+            chunk_cache cache { 300 * chunk_cache::num_shards };
+            size_t num_loads = 0;
+            const auto load = [&] {
+                ++num_loads;
+                return uint8_vector(100);
+            };
+            for (uint32_t ci = 0; ci < 1000; ++ci)
+                cache.get({ 0, 0, ci }, make_hash(0), load);
+            test_same(1000, num_loads);
+            const auto st = cache.stat();
+            expect(st.num_bytes <= cache.budget()) << st.num_bytes;
+            test_same(st.num_chunks * 100, st.num_bytes);
+            test_same(1000, st.num_chunks + st.evictions);
+            // the most recent chunk is still there
+            cache.get({ 0, 0, 999 }, make_hash(0), load);
+            test_same(1000, num_loads);
+            cache.get({ 0, 0, 0 }, make_hash(0), load);
+            test_same(1001, num_loads);
+        };
+        "packed hash mismatch"_test = [] {
+            chunk_cache cache { 1 << 20 };
+            size_t num_loads = 0;
+            const auto load = [&] {
+                ++num_loads;
+                return uint8_vector(10);
+            };
+            cache.get({ 0, 0, 0 }, make_hash(1), load);
+            cache.get({ 0, 0, 0 }, make_hash(2), load);
+            test_same(2, num_loads);
+            test_same(1, cache.stat().num_chunks);
+        };
+        "zero budget"_test = [] {
+            chunk_cache cache { 0 };
+            const auto data = cache.get({ 0, 0, 0 }, make_hash(0), [] { return uint8_vector(100); });
+            test_same(100, data->size());
+            test_same(0, cache.stat().num_chunks);
+        };
+        "shared by readers"_test = [] {
+            file::tmp idx_path { "index-chunk-cache-test.data" };
+            static constexpr size_t num_items = 0x20000;
+            {
+                writer<index_item> idx { idx_path, 4 };
+                for (size_t i = 0; i < num_items; ++i)
+                    idx.emplace_part(i * 4 / num_items, i * 2);
+            }
+            chunk_cache cache { 64 << 20 };
+            const reader_mt<index_item> r1 { idx_path, reader_mt<index_item>::default_search_mode, &cache };
+            const reader_mt<index_item> r2 { idx_path, reader_mt<index_item>::default_search_mode, &cache };
+            const reader_mt<index_item> uncached { idx_path };
+            auto t1 = r1.init_thread();
+            auto t2 = r2.init_thread();
+            auto tu = uncached.init_thread();
+            size_t num_ok = 0, num_lookups = 0;
+            for (size_t i = 0; i < num_items * 2; i += 37) {
+                const index_item key { i };
+                const auto exp = uncached.find(key, tu);
+                num_ok += r1.find(key, t1) == exp;
+                num_ok += r2.find(key, t2) == exp;
+                num_lookups += 2;
+            }
+            test_same(num_lookups, num_ok);
+            // the second reader finds every chunk loaded by the first one
+            test_same(tu.num_reads, t1.num_reads);
+            test_same(0, t2.num_reads);
+            const auto st = cache.stat();
+            test_same(tu.num_reads, st.misses);
+            test_same(tu.num_reads, st.hits);
+            // sequential reads bypass the cache
+            index_item item {};
+            size_t num_read = 0;
+            auto ts = r1.init_thread();
+            while (r1.read(item, ts))
+                num_read += item.offset == num_read * 2;
+            test_same(num_items, num_read);
+            test_same(st.misses, cache.stat().misses);
+        };
+    };
+};
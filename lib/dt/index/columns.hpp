@@ -0,0 +1,232 @@
+/* This file is part of Daedalus Turbo project: https://github.com/sierkov/daedalus-turbo/
+ * Copyright (c) 2022-2023 Alex Sierkov (alex dot sierkov at gmail dot com)
+ * Copyright (c) 2024-2025 R2 Rationality OÜ (info at r2rationality dot com)
+ * This code is distributed under the license specified in:
+ * https://github.com/sierkov/daedalus-turbo/blob/main/LICENSE */
+#ifndef DAEDALUS_TURBO_INDEX_COLUMNS_HPP
+#define DAEDALUS_TURBO_INDEX_COLUMNS_HPP
+
+#include <array>
+#include <cstring>
+#include <span>
+#include <dt/common/bytes.hpp>
+#include <dt/common/error.hpp>
+
+namespace daedalus_turbo::index {
+    enum class column_type: uint8_t {
+        // a byte string stored as the length of the prefix shared with the previous item and the remaining bytes
+        prefix,
+        // a little-endian unsigned integer of up to 8 bytes stored as a zigzag varint of the difference from the previous item
+        delta,
+        // bytes stored one byte position after another, so that the bytes that rarely change form long runs
+        bytes
+    };
+
+    struct column {
+        size_t offset = 0;
+        size_t size = 0;
+        column_type type = column_type::bytes;
+    };
+
+    // An item type describing its fields as columns can be stored in the columnar chunk format.
+    // The bytes not covered by any column, such as bit-fields and padding, are stored as a single bytes column.
+    template<typename T>
+    concept has_index_columns = requires() {
+        { T::index_columns() };
+    };
+
+    namespace columns {
+        template<typename T>
+        struct layout {
+            static constexpr auto cols = T::index_columns();
+            static constexpr auto rest = [] {
+                std::array<bool, sizeof(T)> covered {};
+                for (const auto &c: cols) {
+                    for (size_t i = c.offset; i < c.offset + c.size; ++i)
+                        covered[i] = true;
+                }
+                std::pair<std::array<uint8_t, sizeof(T)>, size_t> res {};
+                for (size_t i = 0; i < sizeof(T); ++i) {
+                    if (!covered[i])
+                        res.first[res.second++] = static_cast<uint8_t>(i);
+                }
+                return res;
+            }();
+
+            static constexpr bool valid()
+            {
+                std::array<bool, sizeof(T)> covered {};
+                for (const auto &c: cols) {
+                    if (c.size == 0 || c.offset + c.size > sizeof(T) || c.size > 255)
+                        return false;
+                    if (c.type == column_type::delta && c.size > sizeof(uint64_t))
+                        return false;
+                    for (size_t i = c.offset; i < c.offset + c.size; ++i) {
+                        if (covered[i])
+                            return false;
+                        covered[i] = true;
+                    }
+                }
+                return true;
+            }
+            static_assert(valid(), "index columns must not overlap, must fit into the item, and delta columns must not exceed 8 bytes");
+        };
+
+        inline void write_varint(uint8_vector &out, uint64_t val)
+        {
+            while (val >= 0x80) {
+                out.emplace_back(static_cast<uint8_t>(val | 0x80));
+                val >>= 7;
+            }
+            out.emplace_back(static_cast<uint8_t>(val));
+        }
+
+        inline uint64_t read_varint(const buffer in, size_t &pos)
+        {
+            uint64_t val = 0;
+            for (size_t shift = 0; shift < 64; shift += 7) {
+                if (pos >= in.size()) [[unlikely]]
+                    throw error("columnar chunk: a truncated varint");
+                const auto b = in[pos++];
+                val |= static_cast<uint64_t>(b & 0x7F) << shift;
+                if (!(b & 0x80))
+                    return val;
+            }
+            throw error("columnar chunk: a varint is longer than 64 bits");
+        }
+
+        inline uint64_t load_uint(const uint8_t *p, const size_t sz)
+        {
+            uint64_t val = 0;
+            for (size_t i = 0; i < sz; ++i)
+                val |= static_cast<uint64_t>(p[i]) << (i * 8);
+            return val;
+        }
+
+        inline void store_uint(uint8_t *p, const size_t sz, const uint64_t val)
+        {
+            for (size_t i = 0; i < sz; ++i)
+                p[i] = static_cast<uint8_t>(val >> (i * 8));
+        }
+
+        // encodes the columns one after another; the decoder needs to know the number of items
+        template<has_index_columns T>
+        void encode(uint8_vector &out, const std::span<const T> items)
+        {
+            using L = layout<T>;
+            out.clear();
+            const auto item_bytes = [&](const size_t i) {
+                return reinterpret_cast<const uint8_t *>(&items[i]);
+            };
+            for (const auto &c: L::cols) {
+                switch (c.type) {
+                    case column_type::prefix: {
+                        // the shared lengths go first, since they compress better when kept together
+                        for (size_t i = 0; i < items.size(); ++i) {
+                            size_t shared = 0;
+                            if (i > 0) {
+                                const auto *prev = item_bytes(i - 1) + c.offset;
+                                const auto *cur = item_bytes(i) + c.offset;
+                                while (shared < c.size && prev[shared] == cur[shared])
+                                    ++shared;
+                            }
+                            out.emplace_back(static_cast<uint8_t>(shared));
+                        }
+                        const size_t lens_off = out.size() - items.size();
+                        for (size_t i = 0; i < items.size(); ++i) {
+                            const size_t shared = out[lens_off + i];
+                            const auto *cur = item_bytes(i) + c.offset;
+                            out.insert(out.end(), cur + shared, cur + c.size);
+                        }
+                        break;
+                    }
+                    case column_type::delta: {
+                        uint64_t prev = 0;
+                        for (size_t i = 0; i < items.size(); ++i) {
+                            const auto val = load_uint(item_bytes(i) + c.offset, c.size);
+                            const auto diff = static_cast<int64_t>(val - prev);
+                            write_varint(out, (static_cast<uint64_t>(diff) << 1) ^ static_cast<uint64_t>(diff >> 63));
+                            prev = val;
+                        }
+                        break;
+                    }
+                    case column_type::bytes:
+                        for (size_t b = c.offset; b < c.offset + c.size; ++b) {
+                            for (size_t i = 0; i < items.size(); ++i)
+                                out.emplace_back(item_bytes(i)[b]);
+                        }
+                        break;
+                    default:
+                        throw error(fmt::format("unsupported column type: {}", static_cast<int>(c.type)));
+                }
+            }
+            for (size_t ri = 0; ri < L::rest.second; ++ri) {
+                const auto b = L::rest.first[ri];
+                for (size_t i = 0; i < items.size(); ++i)
+                    out.emplace_back(item_bytes(i)[b]);
+            }
+        }
+
+        template<has_index_columns T>
+        void decode(const std::span<T> items, const buffer in)
+        {
+            using L = layout<T>;
+            const auto item_bytes = [&](const size_t i) {
+                return reinterpret_cast<uint8_t *>(&items[i]);
+            };
+            size_t pos = 0;
+            const auto take = [&](const size_t sz) {
+                if (in.size() - pos < sz) [[unlikely]]
+                    throw error(fmt::format("columnar chunk: need {} bytes at {} but have only {}", sz, pos, in.size() - pos));
+                const auto *p = in.data() + pos;
+                pos += sz;
+                return p;
+            };
+            for (const auto &c: L::cols) {
+                switch (c.type) {
+                    case column_type::prefix: {
+                        const auto *lens = take(items.size());
+                        for (size_t i = 0; i < items.size(); ++i) {
+                            const size_t shared = lens[i];
+                            if (shared > c.size || (i == 0 && shared > 0)) [[unlikely]]
+                                throw error(fmt::format("columnar chunk: invalid shared prefix length {} of item {}", shared, i));
+                            auto *cur = item_bytes(i) + c.offset;
+                            if (shared)
+                                memcpy(cur, item_bytes(i - 1) + c.offset, shared);
+                            memcpy(cur + shared, take(c.size - shared), c.size - shared);
+                        }
+                        break;
+                    }
+                    case column_type::delta: {
+                        uint64_t prev = 0;
+                        for (size_t i = 0; i < items.size(); ++i) {
+                            const auto zz = read_varint(in, pos);
+                            prev += (zz >> 1) ^ (~(zz & 1) + 1);
+                            store_uint(item_bytes(i) + c.offset, c.size, prev);
+                        }
+                        break;
+                    }
+                    case column_type::bytes:
+                        for (size_t b = c.offset; b < c.offset + c.size; ++b) {
+                            const auto *plane = take(items.size());
+                            for (size_t i = 0; i < items.size(); ++i)
+                                item_bytes(i)[b] = plane[i];
+                        }
+                        break;
+                    default:
+                        throw error(fmt::format("unsupported column type: {}", static_cast<int>(c.type)));
+                }
+            }
+            for (size_t ri = 0; ri < L::rest.second; ++ri) {
+                const auto b = L::rest.first[ri];
+                const auto *plane = take(items.size());
+                for (size_t i = 0; i < items.size(); ++i)
+                    item_bytes(i)[b] = plane[i];
+            }
+            if (pos != in.size()) [[unlikely]]
+                throw error(fmt::format("columnar chunk: {} bytes left after decoding {} items", in.size() - pos, items.size()));
+        }
+    }
+}
+
+#endif // !DAEDALUS_TURBO_INDEX_COLUMNS_HPP
@@ -0,0 +1,129 @@
+/* This file is part of Daedalus Turbo project: https://github.com/sierkov/daedalus-turbo/
+ * Copyright (c) 2022-2023 Alex Sierkov (alex dot sierkov at gmail dot com)
+ * Copyright (c) 2024-2025 R2 Rationality OÜ (info at r2rationality dot com)
+ * This code is distributed under the license specified in:
+ * https://github.com/sierkov/daedalus-turbo/blob/main/LICENSE */
+
+#include <random>
+#include <dt/common/test.hpp>
+#include <dt/file.hpp>
+#include <dt/index/common.hpp>
+
+using namespace daedalus_turbo;
+using namespace daedalus_turbo::index;
+
+namespace {
+    struct column_item {
+        blake2b_224_hash key {};
+        uint16_t out_idx = 0;
+        uint64_t offset = 0;
+        uint64_t size: 20 = 0;
+        uint64_t flags: 44 = 0;
+
+        bool operator<(const column_item &b) const
+        {
+            if (const int cmp = memcmp(key.data(), b.key.data(), key.size()); cmp != 0)
+                return cmp < 0;
+            return offset < b.offset;
+        }
+
+        bool index_less(const column_item &b) const
+        {
+            return memcmp(key.data(), b.key.data(), key.size()) < 0;
+        }
+
+        bool operator==(const column_item &b) const
+        {
+            return key == b.key;
+        }
+
+        bool same(const column_item &b) const
+        {
+            return key == b.key && out_idx == b.out_idx && offset == b.offset && size == b.size && flags == b.flags;
+        }
+
+        static constexpr auto index_columns()
+        {
+            return std::array {
+                column { offsetof(column_item, key), sizeof(column_item::key), column_type::prefix },
+                column { offsetof(column_item, offset), sizeof(column_item::offset), column_type::delta },
+                column { offsetof(column_item, out_idx), sizeof(column_item::out_idx), column_type::bytes }
+            };
+        }
+    };
+
+    vector<column_item> make_items(const size_t num_items, const size_t num_keys)
+    {
+        std::default_random_engine rnd { 12345 };
+        vector<column_item> items(num_items);
+        for (auto &item: items) {
+            const uint64_t key_no = rnd() % num_keys;
+            item.key = blake2b<blake2b_224_hash>(buffer::from(key_no));
+            item.out_idx = rnd() % 16;
+            item.offset = static_cast<uint64_t>(rnd()) << 10 | rnd() % 1024;
+            item.size = rnd() % 100000;
+            item.flags = rnd() % 3;
+        }
+        std::sort(items.begin(), items.end());
+        // the same offset twice gives a zero delta, and the largest one the longest varint
+        items[1].offset = items[0].offset;
+        items[2].offset = std::numeric_limits<uint64_t>::max();
+        return items;
+    }
+}
+
+suite index_columns_suite = [] {
+    "index::columns"_test = [] {
+        "round trip"_test = [] {
+            for (const size_t num_items: { 1, 2, 3, 100, 4096 }) {
+                auto items = make_items(std::max(num_items, size_t { 3 }), 50);
+                items.resize(num_items);
+                uint8_vector enc {};
+                columns::encode(enc, std::span<const column_item> { items });
+                vector<column_item> dec(items.size());
+                columns::decode(std::span<column_item> { dec }, enc);
+                size_t num_same = 0;
+                for (size_t i = 0; i < items.size(); ++i)
+                    num_same += dec[i].same(items[i]);
+                test_same(num_items, num_same);
+            }
+        };
+        "corrupted data"_test = [] {
+            const auto items = make_items(100, 10);
+            uint8_vector enc {};
+            columns::encode(enc, std::span<const column_item> { items });
+            vector<column_item> dec(items.size());
+            expect(throws([&] { columns::decode(std::span<column_item> { dec }, buffer { enc }.subbuf(0, enc.size() - 1)); }));
+            enc.emplace_back(0);
+            expect(throws([&] { columns::decode(std::span<column_item> { dec }, enc); }));
+            enc.pop_back();
+            // the first item has no predecessor to share a prefix with
+            enc[0] = 1;
+            expect(throws([&] { columns::decode(std::span<column_item> { dec }, enc); }));
+        };
+        "columnar and raw indices"_test = [] {
+            const auto items = make_items(0x12345, 0x800);
+            uint64_t sizes[2] {};
+            for (const bool columnar: { false, true }) {
+                file::tmp idx_path { fmt::format("index-columns-test-{}.data", columnar) };
+                {
+                    writer<column_item> idx { idx_path, 4 };
+                    idx.columnar(columnar);
+                    for (size_t i = 0; i < items.size(); ++i)
+                        idx.emplace_part(i * 4 / items.size(), items[i]);
+                }
+                sizes[columnar] = std::filesystem::file_size(idx_path.path());
+                reader<column_item> r { idx_path };
+                column_item item {};
+                size_t num_same = 0;
+                for (size_t i = 0; r.read(item); ++i)
+                    num_same += i < items.size() && item.same(items[i]);
+                test_same(items.size(), num_same);
+                const auto [cnt, found] = r.find(items[777]);
+                expect(cnt > 0);
+                expect(found == items[777]);
+            }
+            expect(sizes[1] < sizes[0]) << sizes[1] << sizes[0];
+        };
+    };
+};
@@ -7,7 +7,12 @@
 #include <random>
 #include <dt/common/benchmark.hpp>
 #include <dt/index/common.hpp>
+#include <dt/index/pay-ref.hpp>
+#include <dt/index/stake-ref.hpp>
+#include <dt/index/tx.hpp>
+#include <dt/index/txo-use.hpp>
 #include <dt/file.hpp>
+#include <dt/scheduler.hpp>
 
 namespace {
     using namespace daedalus_turbo;
@@ -33,6 +38,82 @@ namespace {
             return offset == b.offset;
         }
     };
+
+    // keys of even numbers are stored, so lookups of odd ones miss
+    template<typename T>
+    void bench_missing_keys(const std::string_view name, const auto &make_item)
+    {
+        const size_t num_items = 1 << 21;
+        // without the filters every lookup loads and decompresses a chunk, so a small sample is enough
+        const size_t num_missing = 1 << 14;
+        const size_t num_parts = 16;
+        double base_rate = 0;
+        for (const size_t filter_bits: { size_t { 0 }, chunk_filter::default_bits_per_item }) {
+            file::tmp idx_path { fmt::format("index-filter-bench-{}", name) };
+            {
+                std::vector<T> items {};
+                items.reserve(num_items / 2);
+                for (uint64_t i = 0; i < num_items; i += 2)
+                    items.emplace_back(make_item(i));
+                std::sort(items.begin(), items.end());
+                writer<T> idx { idx_path, num_parts };
+                idx.filter_bits(filter_bits);
+                for (size_t i = 0; i < items.size(); ++i)
+                    idx.emplace_part(i * num_parts / items.size(), items[i]);
+            }
+            const reader_mt<T> reader { idx_path };
+            auto t = reader.init_thread();
+            size_t num_lookups = 0;
+            const auto rate = benchmark_rate(fmt::format("{} missing-key search, filter bits per item: {}", name, filter_bits), 3, [&] {
+                for (uint64_t i = 0; i < num_missing; ++i)
+                    reader.find(make_item(i * 2 + 1), t);
+                num_lookups += num_missing;
+                return num_missing;
+            });
+            if (!filter_bits) {
+                base_rate = rate;
+            } else {
+                const auto fp_rate = static_cast<double>(num_lookups - t.num_filtered) / static_cast<double>(num_lookups);
+                std::clog << fmt::format("[{}] false-positive rate: {:.3f}%, speedup: {:.1f}x\n", name, fp_rate * 100, rate / base_rate);
+            }
+        }
+    }
+
+    // the file sizes show the effect of the columnar format and the sequential reads the cost of its decoding
+    template<typename T>
+    void bench_chunk_format(const std::string_view name, const auto &make_item)
+    {
+        const size_t num_items = 1 << 21;
+        std::vector<T> items {};
+        items.reserve(num_items);
+        for (uint64_t i = 0; i < num_items; ++i)
+            items.emplace_back(make_item(i));
+        std::sort(items.begin(), items.end());
+        uint64_t raw_size = 0;
+        for (const bool columnar: { false, true }) {
+            file::tmp idx_path { fmt::format("index-format-bench-{}", name) };
+            {
+                writer<T> idx { idx_path, default_parts };
+                idx.columnar(columnar);
+                for (size_t i = 0; i < items.size(); ++i)
+                    idx.emplace_part(i * default_parts / items.size(), items[i]);
+            }
+            const auto size = std::filesystem::file_size(idx_path.path());
+            const reader_mt<T> reader { idx_path };
+            benchmark_r(fmt::format("{} {} chunks sequential read", name, columnar ? "columnar" : "raw"), 1e6, 3, [&] {
+                auto t = reader.init_thread();
+                T item {};
+                size_t num_read = 0;
+                while (reader.read(item, t))
+                    ++num_read;
+                return num_read;
+            });
+            if (!columnar)
+                raw_size = size;
+            else
+                std::clog << fmt::format("[{}] raw: {} MiB, columnar: {} MiB, {:.1f}% smaller\n", name, raw_size >> 20, size >> 20, 100.0 - 100.0 * size / raw_size);
+        }
+    }
 }      
 
 suite index_common_bench_suite = [] {
@@ -127,6 +208,125 @@ suite index_common_bench_suite = [] {
             }
         }
 
+        {
+            file::tmp idx_path { "index-reader-mt-bench" };
+            size_t num_parts = 16;
+            size_t num_items = 1 << 24;
+            {
+                writer<index_item> idx { idx_path, num_parts };
+                const auto part_size = num_items / num_parts;
+                for (size_t i = 0; i < num_items; ++i)
+                    idx.emplace_part(i / part_size, i * 2, static_cast<uint16_t>(i % 13));
+            }
+            const reader_mt<index_item> reader { idx_path };
+            size_t sample_size = 1 << 18;
+            // random lookups miss the per-thread chunk caches, so each one loads a chunk from the file
+            for (size_t num_threads = 1; num_threads <= scheduler::default_worker_count(); num_threads *= 2) {
+                scheduler sched { num_threads };
+                benchmark_r(fmt::format("reader_mt random search, {} threads", num_threads), 1'000.0, 3, [&] {
+                    for (size_t ti = 0; ti < num_threads; ++ti) {
+                        sched.submit_void("search", 100, [&, ti] {
+                            auto t = reader.init_thread();
+                            std::default_random_engine rnd(ti);
+                            std::uniform_int_distribution<size_t> dist(0, num_items * 2);
+                            index_item item {};
+                            for (size_t i = 0; i < sample_size / num_threads; ++i) {
+                                item.offset = dist(rnd);
+                                reader.find(item, t);
+                            }
+                        });
+                    }
+                    sched.process(false);
+                    return sample_size;
+                });
+            }
+        }
+
+        "chunk filters"_test = [] {
+            bench_missing_keys<index::tx::item>("tx", [](const uint64_t i) {
+                return index::tx::item { blake2b<cardano::tx_hash>(buffer::from(i)) };
+            });
+            bench_missing_keys<index::txo_use::item>("txo-use", [](const uint64_t i) {
+                return index::txo_use::item { blake2b<cardano::tx_hash>(buffer::from(i / 4)), i % 4 };
+            });
+            bench_missing_keys<index::stake_ref::item>("stake-ref", [](const uint64_t i) {
+                return index::stake_ref::item { cardano::stake_ident { blake2b<cardano::key_hash>(buffer::from(i)), (i % 3) == 0 } };
+            });
+            bench_missing_keys<index::pay_ref::item>("pay-ref", [](const uint64_t i) {
+                return index::pay_ref::item { cardano::pay_ident { blake2b<cardano::key_hash>(buffer::from(i)), cardano::pay_ident::ident_type::SHELLEY_KEY } };
+            });
+        };
+
+        "chunk formats"_test = [] {
+            // realistic offsets grow with the transaction number, while the hashes are random
+            bench_chunk_format<index::tx::item>("tx", [](const uint64_t i) {
+                return index::tx::item { blake2b<cardano::tx_hash>(buffer::from(i)), i * 211, 100 + i % 400 };
+            });
+            bench_chunk_format<index::txo_use::item>("txo-use", [](const uint64_t i) {
+                return index::txo_use::item { blake2b<cardano::tx_hash>(buffer::from(i / 4)), i % 4, i * 211, 200 + i % 300 };
+            });
+            // popular stake keys and addresses, such as those of exchanges, have many references each
+            bench_chunk_format<index::stake_ref::item>("stake-ref", [](const uint64_t i) {
+                return index::stake_ref::item { cardano::stake_ident { blake2b<cardano::key_hash>(buffer::from(i % 0x10000)) }, i * 211, 200 + i % 300, i % 3 };
+            });
+            bench_chunk_format<index::pay_ref::item>("pay-ref", [](const uint64_t i) {
+                return index::pay_ref::item { cardano::pay_ident { blake2b<cardano::key_hash>(buffer::from(i % 0x10000)), cardano::pay_ident::ident_type::SHELLEY_KEY }, i * 211, 200 + i % 300, i % 3 };
+            });
+        };
+
+        "interpolation search"_test = [] {
+            {
+                std::default_random_engine rnd { 0 };
+                std::vector<uint64_t> vals(1 << 24);
+                for (auto &v: vals)
+                    v = rnd() << 32 | rnd();
+                std::sort(vals.begin(), vals.end());
+                std::vector<uint64_t> keys(1 << 20);
+                for (auto &k: keys)
+                    k = vals[rnd() % vals.size()];
+                benchmark_r("uniform u64 binary search", 1e6, 3, [&] {
+                    size_t sum = 0;
+                    for (const auto k: keys)
+                        sum += std::lower_bound(vals.begin(), vals.end(), k) - vals.begin();
+                    ankerl::nanobench::doNotOptimizeAway(sum);
+                    return keys.size();
+                });
+                benchmark_r("uniform u64 interpolation search", 1e6, 3, [&] {
+                    size_t sum = 0;
+                    for (const auto k: keys)
+                        sum += interpolation_search(vals.size(), k, [&](const size_t i) { return vals[i]; });
+                    ankerl::nanobench::doNotOptimizeAway(sum);
+                    return keys.size();
+                });
+            }
+            file::tmp idx_path { "index-interpolation-bench" };
+            const size_t num_items = 1 << 22;
+            {
+                std::vector<index::tx::item> items {};
+                items.reserve(num_items);
+                for (uint64_t i = 0; i < num_items; ++i)
+                    items.emplace_back(blake2b<cardano::tx_hash>(buffer::from(i)));
+                std::sort(items.begin(), items.end());
+                writer<index::tx::item> idx { idx_path, default_parts };
+                for (size_t i = 0; i < items.size(); ++i)
+                    idx.emplace_part(i * default_parts / items.size(), items[i]);
+            }
+            // lookups of neighbouring keys hit the cached chunk, so the timings show the search rather than the chunk loads
+            std::vector<index::tx::item> keys {};
+            for (uint64_t i = 0; i < num_items; i += 4)
+                keys.emplace_back(blake2b<cardano::tx_hash>(buffer::from(i)));
+            std::sort(keys.begin(), keys.end());
+            for (const auto mode: { search_mode::binary, search_mode::interpolation }) {
+                const reader_mt<index::tx::item> reader { idx_path, mode };
+                auto t = reader.init_thread();
+                benchmark_r(fmt::format("tx index search, {}", mode == search_mode::binary ? "binary" : "interpolation"), 1e5, 5, [&] {
+                    for (const auto &k: keys)
+                        reader.find(k, t);
+                    return keys.size();
+                });
+            }
+        };
+
         "multi-part indices"_test = [] {
             size_t num_parts = 8;
             size_t num_items = 0x39873;
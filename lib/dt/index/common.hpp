@@ -191,8 +191,8 @@ namespace daedalus_turbo::index {
         {
         }
 
-        virtual void merge(const std::string &/*task_group*/, size_t /*task_prio*/, const std::vector<std::string> &/*chunks*/,
-                const std::string &/*final_path*/, const std::function<void()> &/*on_complete*/)
+        // the merge is complete once the node ctx and all the nodes it spawns have completed
+        virtual void merge(task_graph::node_context &/*ctx*/, const std::vector<std::string> &/*chunks*/, const std::string &/*final_path*/)
         {
             throw error("merge not implemented");
         }
@@ -266,10 +266,9 @@ namespace daedalus_turbo::index {
             return { indexer_base::reader_path(slice_id) };
         }
 
-        void merge(const std::string &task_group, size_t task_prio, const std::vector<std::string> &chunks, const std::string &final_path,
-                   const std::function<void()> &on_complete) override
+        void merge(task_graph::node_context &ctx, const std::vector<std::string> &chunks, const std::string &final_path) override
         {
-            merge_one_step<T>(indexer_chunked<ChunkIndexer>::_sched, task_group, task_prio, chunks, final_path, on_complete);
+            merge_one_step<T>(ctx, chunks, final_path);
         }
 
         bool mergeable() const override
@@ -4,6 +4,7 @@
  * This code is distributed under the license specified in:
  * https://github.com/sierkov/daedalus-turbo/blob/main/LICENSE */
 
+#include <random>
 #include <dt/common/test.hpp>
 #include <dt/cardano.hpp>
 #include <dt/file.hpp>
@@ -33,6 +34,36 @@ namespace {
             return offset == b.offset;
         }
     };
+
+    struct hashed_item {
+        blake2b_256_hash key {};
+        uint64_t offset = 0;
+
+        bool operator<(const hashed_item &b) const
+        {
+            return memcmp(key.data(), b.key.data(), key.size()) < 0;
+        }
+
+        bool index_less(const hashed_item &b) const
+        {
+            return *this < b;
+        }
+
+        bool operator==(const hashed_item &b) const
+        {
+            return key == b.key;
+        }
+
+        uint64_t index_hash() const
+        {
+            return index::index_hash(key);
+        }
+
+        uint64_t index_prefix() const
+        {
+            return index::index_prefix(key);
+        }
+    };
 }
 
 suite index_common_suite = [] {
@@ -197,6 +228,165 @@ suite index_common_suite = [] {
             std::filesystem::remove(idx_path_2.path());
         };
 
+        "interpolation_search"_test = [] {
+            std::default_random_engine rnd { 12345 };
+            for (const bool skewed: { false, true }) {
+                vector<uint64_t> vals(10000);
+                for (auto &v: vals)
+                    v = skewed ? rnd() % 100 * rnd() % 1000 : rnd();
+                std::sort(vals.begin(), vals.end());
+                size_t num_ok = 0;
+                for (size_t i = 0; i < 10000; ++i) {
+                    const uint64_t x = i % 2 ? vals[rnd() % vals.size()] : rnd() % (vals.back() + 2);
+                    const size_t expected = std::lower_bound(vals.begin(), vals.end(), x) - vals.begin();
+                    num_ok += interpolation_search(vals.size(), x, [&](const size_t pos) { return vals[pos]; }) == expected;
+                }
+                test_same(10000, num_ok);
+            }
+            test_same(0, interpolation_search(0, 1, [](const size_t) { return uint64_t { 0 }; }));
+        };
+
+        "interpolation and binary search agree"_test = [] {
+            file::tmp idx_path { "index-interpolation-test" };
+            const size_t num_keys = 0x8000;
+            {
+                vector<hashed_item> items {};
+                for (uint64_t i = 0; i < num_keys; i += 2) {
+                    const auto key = blake2b<blake2b_256_hash>(buffer::from(i));
+                    // runs of equal keys that span chunks
+                    for (size_t j = 0, num_copies = i % 1000 == 0 ? 5000 : 1 + i % 3; j < num_copies; ++j)
+                        items.emplace_back(key, i);
+                }
+                std::sort(items.begin(), items.end(), [](const auto &a, const auto &b) { return a.index_less(b); });
+                writer<hashed_item> idx { idx_path, 8 };
+                for (size_t i = 0; i < items.size(); ++i)
+                    idx.emplace_part(items[i].key[0] / 32, items[i]);
+            }
+            const reader_mt<hashed_item> interp { idx_path, search_mode::interpolation };
+            const reader_mt<hashed_item> binary { idx_path, search_mode::binary };
+            auto interp_t = interp.init_thread();
+            auto binary_t = binary.init_thread();
+            size_t num_ok = 0;
+            for (uint64_t i = 0; i < num_keys; ++i) {
+                const hashed_item key { blake2b<blake2b_256_hash>(buffer::from(i)) };
+                const auto [interp_cnt, interp_item] = interp.find(key, interp_t);
+                const auto [binary_cnt, binary_item] = binary.find(key, binary_t);
+                num_ok += interp_cnt == binary_cnt && interp_item.offset == binary_item.offset && interp_cnt == (i % 2 ? 0 : i % 1000 == 0 ? 5000 : 1 + i % 3);
+            }
+            test_same(num_keys, num_ok);
+        };
+
+        "find_batch"_test = [] {
+            const size_t num_parts = 4;
+            const size_t num_slices = 3;
+            const size_t num_keys = 0x10000;
+            // file::tmp removes its file when destroyed, so the vector must not reallocate
+            vector<file::tmp> slices {};
+            slices.reserve(num_slices);
+            vector<std::string> paths {};
+            for (size_t si = 0; si < num_slices; ++si) {
+                auto &path = slices.emplace_back(fmt::format("index-find-batch-test-{}", si));
+                paths.emplace_back(path.path());
+                writer<index_item> idx { path, num_parts };
+                for (uint64_t k = 0; k < num_keys; ++k) {
+                    if (k % (si + 2) != 0)
+                        continue;
+                    // a long run of equal items spans several chunks
+                    const size_t num_copies = k == 0x8000 ? 10000 : 1 + k % 3;
+                    for (size_t i = 0; i < num_copies; ++i)
+                        idx.emplace_part(k * num_parts / num_keys, k, static_cast<uint16_t>(i));
+                }
+            }
+            const reader_multi_mt<index_item> reader { paths };
+            vector<index_item> keys {};
+            for (uint64_t k = 0; k < num_keys; k += 7)
+                keys.emplace_back(k);
+            // a repeated key
+            keys.emplace_back(keys.back());
+            vector<size_t> expected(keys.size());
+            {
+                auto t = reader.init_thread();
+                for (size_t ki = 0; ki < keys.size(); ++ki)
+                    expected[ki] = std::get<0>(reader.find(keys[ki], t));
+            }
+            {
+                auto t = reader.init_thread();
+                vector<size_t> found(keys.size());
+                size_t num_bad = 0;
+                reader.find_batch(keys, t, [&](const size_t ki, const index_item &item) {
+                    ++found[ki];
+                    num_bad += item.offset != keys[ki].offset;
+                });
+                expect(found == expected);
+                test_same(0, num_bad);
+            }
+            {
+                scheduler sched {};
+                vector<std::atomic_size_t> found(keys.size());
+                reader.find_batch(sched, keys, [&](const size_t ki, const index_item &) {
+                    found[ki].fetch_add(1, std::memory_order_relaxed);
+                });
+                size_t num_ok = 0;
+                for (size_t ki = 0; ki < keys.size(); ++ki)
+                    num_ok += found[ki].load() == expected[ki];
+                test_same(keys.size(), num_ok);
+            }
+            {
+                auto t = reader.init_thread();
+                const vector<index_item> unsorted { index_item { 10 }, index_item { 5 } };
+                expect(throws([&] { reader.find_batch(unsorted, t, [](const size_t, const index_item &) {}); }));
+            }
+        };
+
+        "find_batch across chunk boundaries"_test = [] {
+            static constexpr size_t chunk_size = 16;
+            file::tmp idx_path { "index-find-batch-chunks-test" };
+            {
+                writer<index_item> idx { idx_path, 1, chunk_size };
+                for (uint64_t k = 0; k < 1000; ++k) {
+                    // every 50th key has a run spanning two or three chunks, the rest may straddle a boundary
+                    const size_t num_copies = k % 50 == 0 ? 40 : 1 + k % 3;
+                    for (size_t i = 0; i < num_copies; ++i)
+                        idx.emplace_part(0, k, static_cast<uint16_t>(i));
+                }
+            }
+            const reader_mt<index_item> reader { idx_path };
+            const auto num_chunks = reader.chunk_list(0).size();
+            vector<index_item> keys {};
+            for (uint64_t k = 0; k <= 1000; ++k) {
+                keys.emplace_back(k);
+                // the repeated keys include those whose runs end in a later chunk
+                if (k % 10 == 0)
+                    keys.emplace_back(k);
+            }
+            vector<size_t> expected(keys.size());
+            {
+                auto t = reader.init_thread();
+                for (size_t ki = 0; ki < keys.size(); ++ki)
+                    expected[ki] = std::get<0>(reader.find(keys[ki], t));
+            }
+            auto t = reader.init_thread();
+            vector<size_t> found(keys.size());
+            size_t num_bad = 0;
+            reader.find_batch(keys, t, [&](const size_t ki, const index_item &item) {
+                ++found[ki];
+                num_bad += item.offset != keys[ki].offset;
+            });
+            expect(found == expected);
+            test_same(0, num_bad);
+            // without repeated keys, the search moves past the runs and loads each chunk once
+            vector<index_item> unique_keys {};
+            for (uint64_t k = 0; k < 1000; ++k)
+                unique_keys.emplace_back(k);
+            auto tu = reader.init_thread();
+            size_t num_found = 0;
+            reader.find_batch(unique_keys, tu, [&](const size_t, const index_item &) {
+                ++num_found;
+            });
+            test_same(reader.size(), num_found);
+            expect(tu.num_reads <= num_chunks) << tu.num_reads << num_chunks;
+        };
+
         "index metadata"_test = [] {
             file::tmp idx_path { "index-writer-test" };
             {
@@ -213,6 +403,43 @@ suite index_common_suite = [] {
             std::filesystem::remove(idx_path.path());
         };
 
+        "chunk filters"_test = [] {
+            const size_t num_items = 0x12345;
+            const size_t num_parts = 4;
+            for (const size_t filter_bits: { chunk_filter::default_bits_per_item, size_t { 0 } }) {
+                file::tmp idx_path { "index-filter-test" };
+                {
+                    writer<hashed_item> idx { idx_path, num_parts };
+                    idx.filter_bits(filter_bits);
+                    vector<hashed_item> items {};
+                    for (uint64_t i = 0; i < num_items; i += 2)
+                        items.emplace_back(blake2b<blake2b_256_hash>(buffer::from(i)), i);
+                    std::sort(items.begin(), items.end());
+                    for (const auto &item: items)
+                        idx.emplace_part(item.key[0] * num_parts / 256, item);
+                }
+                reader_mt<hashed_item> reader { idx_path };
+                test_same(filter_bits > 0, reader.has_filters());
+                auto t = reader.init_thread();
+                size_t num_found = 0, num_missing = 0;
+                for (uint64_t i = 0; i < num_items; ++i) {
+                    const auto [cnt, item] = reader.find(hashed_item { blake2b<blake2b_256_hash>(buffer::from(i)) }, t);
+                    if (i % 2 == 0)
+                        num_found += cnt == 1 && item.offset == i;
+                    else
+                        num_missing += cnt == 0;
+                }
+                test_same(num_items / 2 + num_items % 2, num_found);
+                test_same(num_items / 2, num_missing);
+                if (filter_bits) {
+                    // the expected false-positive rate with 10 bits per item is below 1%
+                    expect(t.num_filtered >= num_missing * 98 / 100) << t.num_filtered << num_missing;
+                } else {
+                    test_same(0, t.num_filtered);
+                }
+            }
+        };
+
         "schedule truncate"_test = [] {
             struct item {
                 uint8_t a = 0;
@@ -7,12 +7,18 @@
 #define DAEDALUS_TURBO_INDEX_IO_HPP
 
 #include <atomic>
+#include <bit>
+#include <limits>
 #include <memory>
 #include <queue>
 #include <dt/blake2b.hpp>
+#include <dt/common/batch-read.hpp>
 #include <dt/container.hpp>
+#include <dt/index/chunk-cache.hpp>
+#include <dt/index/columns.hpp>
 #include <dt/file.hpp>
 #include <dt/mutex.hpp>
+#include <dt/scheduler.hpp>
 #include <dt/zstd.hpp>
 
 namespace daedalus_turbo::index {
@@ -54,8 +60,125 @@ namespace daedalus_turbo::index {
         using std::priority_queue<merge_item<T>>::priority_queue;
     };
 
+    // Items whose index keys are cryptographic hashes can provide a 64-bit hash of their key.
+    // Index files of such items keep a Bloom filter per chunk, so absent keys are rejected without loading the chunk.
+    template<typename T>
+    concept has_index_hash = requires(const T &item) {
+        { item.index_hash() } -> std::convertible_to<uint64_t>;
+    };
+
+    // items of a sorted chunk share their leading bytes, so the filter uses the trailing ones
+    inline uint64_t index_hash(const buffer key, const uint64_t extra=0)
+    {
+        if (key.size() < sizeof(uint64_t)) [[unlikely]]
+            throw error(fmt::format("an index key hash requires at least {} bytes but got {}", sizeof(uint64_t), key.size()));
+        uint64_t h;
+        memcpy(&h, key.data() + key.size() - sizeof(h), sizeof(h));
+        return h ^ (extra * 0x9E3779B97F4A7C15ULL);
+    }
+
+    // Items whose index keys are uniformly distributed can provide the big-endian value of the leading key bytes,
+    // which lets readers locate keys by interpolation instead of binary search.
+    template<typename T>
+    concept has_index_prefix = requires(const T &item) {
+        { item.index_prefix() } -> std::convertible_to<uint64_t>;
+    };
+
+    // the big-endian order of the leading bytes matches the memcmp order of the keys
+    template<size_t SZ>
+    uint64_t index_prefix(const byte_array<SZ> &key)
+    {
+        static_assert(SZ >= sizeof(uint64_t));
+        uint64_t p;
+        memcpy(&p, key.data(), sizeof(p));
+        if constexpr (std::endian::native == std::endian::little)
+            p = std::byteswap(p);
+        return p;
+    }
+
+    // The first position in [0, size) whose value is not less than x, where value(i) is non-decreasing.
+    // Uniformly distributed values need only a couple of probes.
+    inline size_t interpolation_search(const size_t size, const uint64_t x, const auto &value)
+    {
+        if (size == 0 || x <= value(0))
+            return 0;
+        size_t lo = 0, hi = size - 1;
+        uint64_t lo_val = value(lo), hi_val = value(hi);
+        if (x > hi_val)
+            return size;
+        // the invariant is value(lo) < x <= value(hi);
+        // skewed values make interpolation slow, so it gives way to bisection after a few probes
+        for (size_t num_probes = 0; hi - lo > 1; ++num_probes) {
+            size_t pos;
+            if (num_probes < 4) {
+                const auto est = static_cast<double>(x - lo_val) / static_cast<double>(hi_val - lo_val) * static_cast<double>(hi - lo);
+                pos = std::clamp(lo + static_cast<size_t>(est), lo + 1, hi - 1);
+            } else {
+                pos = lo + (hi - lo) / 2;
+            }
+            const uint64_t pos_val = value(pos);
+            if (pos_val < x) {
+                lo = pos;
+                lo_val = pos_val;
+            } else {
+                hi = pos;
+                hi_val = pos_val;
+            }
+        }
+        return hi;
+    }
+
+    enum class search_mode { binary, interpolation };
+
+    struct chunk_filter {
+        static constexpr size_t default_bits_per_item = 10;
+        static constexpr size_t num_probes = 7;
+
+        static size_t num_words(const size_t num_items, const size_t bits_per_item)
+        {
+            return (num_items * bits_per_item + 63) / 64;
+        }
+
+        static void add(const std::span<uint64_t> words, const uint64_t h)
+        {
+            _probe(words.size(), h, [&](const uint64_t bit) {
+                words[bit >> 6] |= 1ULL << (bit & 63);
+                return true;
+            });
+        }
+
+        static bool may_contain(const std::span<const uint64_t> words, const uint64_t h)
+        {
+            return _probe(words.size(), h, [&](const uint64_t bit) {
+                return (words[bit >> 6] & (1ULL << (bit & 63))) != 0;
+            });
+        }
+    private:
+        static bool _probe(const size_t num_words, uint64_t h, const auto &visit)
+        {
+            if (num_words == 0) [[unlikely]]
+                return true;
+            // the splitmix64 finalizer
+            h = (h ^ (h >> 30)) * 0xBF58476D1CE4E5B9ULL;
+            h = (h ^ (h >> 27)) * 0x94D049BB133111EBULL;
+            h ^= h >> 31;
+            const uint64_t num_bits = num_words * 64;
+            const uint64_t h1 = h & 0xFFFFFFFFULL;
+            const uint64_t h2 = (h >> 32) | 1;
+            for (size_t i = 0; i < num_probes; ++i) {
+                if (!visit((h1 + i * h2) % num_bits))
+                    return false;
+            }
+            return true;
+        }
+    };
+
     static constexpr size_t max_parts = 256;
     static constexpr size_t default_parts = 16;
+    static constexpr std::string_view filter_magic { "DTFILTER" };
+    // indices without the columns section store each chunk as a raw array of items
+    static constexpr std::string_view columns_magic { "DTCOLUMN" };
+    static constexpr uint64_t chunk_format_columnar = 1;
 
     // Each partition can be written only from a single thread to minimize cross-thread synchronization
     template<typename T>
@@ -73,7 +196,7 @@ namespace daedalus_turbo::index {
         writer(const writer<T> &) =delete;
 
         writer(const std::string &path, size_t num_partitions = 1, size_t chunk_size=default_chunk_size)
-            : _parts(num_partitions), _bufs(num_partitions), _cnts(num_partitions),
+            : _parts(num_partitions), _bufs(num_partitions), _cnts(num_partitions), _filters(num_partitions),
                 _path { path },
                 _num_parts { num_partitions }, _chunk_size { chunk_size },
                 _os { _path + ".tmp" }
@@ -86,6 +209,7 @@ namespace daedalus_turbo::index {
 
         writer(writer<T> &&w)
             : _parts { std::move(w._parts) }, _bufs { std::move(w._bufs) }, _cnts { std::move(w._cnts) },
+                _filters { std::move(w._filters) }, _filter_bits { w._filter_bits }, _columnar { w._columnar },
                 _path { std::move(w._path) },
                 _num_parts { w._num_parts }, _chunk_size { w._chunk_size },
                 _commited { (bool)w._commited },_os { std::move(w._os) }, _free_off { (size_t)w._free_off }
@@ -155,10 +279,62 @@ namespace daedalus_turbo::index {
         {
             return _free_off;
         }
+
+        size_t chunk_size() const
+        {
+            return _chunk_size;
+        }
+
+        // 0 disables the chunk filters; must be called before any item is added
+        void filter_bits(const size_t bits_per_item)
+        {
+            for (const auto cnt: _cnts) {
+                if (cnt)
+                    throw error(fmt::format("filter_bits called for {} after items have been added!", _path));
+            }
+            _filter_bits = bits_per_item;
+        }
+
+        // Lets several threads write the chunks of a partition in any order once the number of its items is known.
+        // Must not be mixed with emplace_part for the same partition.
+        void presize_part(const size_t part_id, const size_t num_items)
+        {
+            mutex::scoped_lock lock { _write_mutex };
+            if (_cnts.at(part_id))
+                throw error(fmt::format("presize_part called for {} partition-{} after items have been added!", _path, part_id));
+            _cnts[part_id] = num_items;
+            _parts.at(part_id).resize((num_items + _chunk_size - 1) / _chunk_size);
+        }
+
+        // all chunks but the last one of a presized partition must have chunk_size items
+        void write_chunk(const size_t part_id, const size_t chunk_idx, const std::span<const T> items)
+        {
+            if (_commited)
+                throw error(fmt::format("writer::write_chunk {} has already been commited!", _path));
+            const auto cnt = _cnts.at(part_id);
+            const auto num_chunks = _parts.at(part_id).size();
+            if (chunk_idx >= num_chunks || items.size() != std::min(_chunk_size, cnt - chunk_idx * _chunk_size))
+                throw error(fmt::format("{} partition-{} has {} chunks and {} items: chunk {} cannot have {} items!",
+                    _path, part_id, num_chunks, cnt, chunk_idx, items.size()));
+            _write_chunk(part_id, chunk_idx, items);
+        }
+
+        // false stores chunks as raw arrays of items, which readers of any version understand; must be called before any item is added
+        void columnar(const bool enable)
+        {
+            for (const auto cnt: _cnts) {
+                if (cnt)
+                    throw error(fmt::format("columnar called for {} after items have been added!", _path));
+            }
+            _columnar = has_index_columns<T> && enable;
+        }
     protected:
         vector<vector<chunk_info<T>>> _parts;
         vector<vector<T>> _bufs;
         vector<size_t> _cnts;
+        vector<vector<uint64_t>> _filters;
+        size_t _filter_bits = has_index_hash<T> ? chunk_filter::default_bits_per_item : 0;
+        bool _columnar = has_index_columns<T>;
         map<std::string, uint8_vector> _meta {};
         std::string _path;
         size_t _num_parts, _chunk_size;
@@ -180,6 +356,15 @@ namespace daedalus_turbo::index {
             for (size_t i = 0; i < _num_parts; ++i)
                 _flush_part(i);
             mutex::scoped_lock lock { _write_mutex };
+            for (size_t pi = 0; pi < _num_parts; ++pi) {
+                const auto &part = _parts[pi];
+                for (size_t ci = 0; ci < part.size(); ++ci) {
+                    if (!part[ci].packed_size)
+                        throw error(fmt::format("{} partition-{} chunk {} has not been written!", _path, pi, ci));
+                    if (ci > 0 && part[ci].max_item < part[ci - 1].max_item)
+                        throw error(fmt::format("{} partition-{} chunks {} and {} are not ordered!", _path, pi, ci - 1, ci));
+                }
+            }
             uint64_t meta_off = _os.tellp();
             if (_meta.size() > 255)
                 throw error(fmt::format("internal error: only up to 255 meta items are supported but got: {}", _meta.size()));
@@ -205,6 +390,16 @@ namespace daedalus_turbo::index {
                 if (!chunk_list.empty())
                     meta_buf << buffer { reinterpret_cast<const uint8_t *>(chunk_list.data()), sizeof(chunk_list[0]) * chunk_list.size() };
             }
+            // optional trailing sections; the columns section must precede the filters
+            if (_columnar)
+                meta_buf << buffer { columns_magic } << buffer::from(chunk_format_columnar);
+            if (has_index_hash<T> && _filter_bits) {
+                const uint64_t bits_per_item = _filter_bits;
+                const uint64_t num_probes = chunk_filter::num_probes;
+                meta_buf << buffer { filter_magic } << buffer::from(bits_per_item) << buffer::from(num_probes);
+                for (const auto &filter: _filters)
+                    meta_buf << buffer { reinterpret_cast<const uint8_t *>(filter.data()), sizeof(filter[0]) * filter.size() };
+            }
             _os.write(meta_buf.data(), meta_buf.size());
             auto meta_hash = blake2b<blake2b_64_hash>(meta_buf);
             _os.write(&meta_hash, sizeof(meta_hash));
@@ -226,19 +421,49 @@ namespace daedalus_turbo::index {
                 auto &buf = _bufs.at(part_id);
                 if (part.size() > 0 && buf.at(cnt_todo - 1) < part.back().max_item)
                     throw error(fmt::format("{} partition-{} chunks {} and {} are not ordered!", _path, part_id, part.size() - 1, part.size()));
-                const buffer data { reinterpret_cast<uint8_t *>(buf.data()), cnt_todo * sizeof(T) };
-                thread_local uint8_vector comp_data {};
-                zstd::compress(comp_data, data, 3);
+                _write_chunk(part_id, part.size(), std::span<const T> { buf.data(), cnt_todo });
+            }
+        }
 
-                mutex::scoped_lock lock { _write_mutex };
-                size_t fact_off = _os.tellp();
-                if (fact_off != _free_off)
-                    throw error(fmt::format("internal error with {}: expected file position {} but got {}", _path, (size_t)_free_off, fact_off));
-                auto packed_hash = blake2b<blake2b_64_hash>(comp_data);
-                part.emplace_back(_free_off, comp_data.size(), buf.at(cnt_todo - 1), packed_hash);
-                _free_off += comp_data.size();
-                _os.write(comp_data.data(), comp_data.size());
+        void _write_chunk(const size_t part_id, const size_t chunk_idx, const std::span<const T> items)
+        {
+            buffer data { reinterpret_cast<const uint8_t *>(items.data()), items.size() * sizeof(T) };
+            if constexpr (has_index_columns<T>) {
+                if (_columnar) {
+                    thread_local uint8_vector col_data {};
+                    columns::encode(col_data, items);
+                    data = col_data;
+                }
+            }
+            thread_local uint8_vector comp_data {};
+            zstd::compress(comp_data, data, 3);
+            const auto packed_hash = blake2b<blake2b_64_hash>(comp_data);
+
+            mutex::scoped_lock lock { _write_mutex };
+            size_t fact_off = _os.tellp();
+            if (fact_off != _free_off)
+                throw error(fmt::format("internal error with {}: expected file position {} but got {}", _path, (size_t)_free_off, fact_off));
+            if constexpr (has_index_hash<T>) {
+                if (_filter_bits) {
+                    // all chunks but the last one are full, so the position of a chunk's filter follows from its index
+                    auto &filter = _filters.at(part_id);
+                    const auto filter_off = chunk_idx * chunk_filter::num_words(_chunk_size, _filter_bits);
+                    const auto filter_size = chunk_filter::num_words(items.size(), _filter_bits);
+                    if (filter.size() < filter_off + filter_size)
+                        filter.resize(filter_off + filter_size);
+                    const std::span<uint64_t> words { filter.data() + filter_off, filter_size };
+                    for (const auto &item: items)
+                        chunk_filter::add(words, item.index_hash());
+                }
             }
+            auto &part = _parts.at(part_id);
+            const chunk_info<T> chunk { _free_off, comp_data.size(), items.back(), packed_hash };
+            if (chunk_idx == part.size())
+                part.emplace_back(chunk);
+            else
+                part.at(chunk_idx) = chunk;
+            _free_off += comp_data.size();
+            _os.write(comp_data.data(), comp_data.size());
         }
     };
 
@@ -302,57 +527,79 @@ namespace daedalus_turbo::index {
         struct thread_data {
             vector<size_t> offsets {};
             vector<size_t> cache_chunk_idxs {};
-            vector<vector<T>> caches {};
+            // views of the current chunk of each partition backed by own_caches or by shared_caches
+            vector<std::span<const T>> caches {};
+            vector<vector<T>> own_caches {};
+            vector<chunk_cache::data_ptr> shared_caches {};
             uint8_vector read_buf {};
             size_t num_reads = 0;
             size_t next_part_idx = 0;
             size_t single_part_idx = max_parts;
+            // lookups rejected by the chunk filters
+            size_t num_filtered = 0;
+            // packed chunks of a sequentially read partition fetched ahead with a single batch of reads
+            size_t ahead_part_idx = max_parts;
+            size_t ahead_chunk_idx = 0;
+            vector<uint8_vector> ahead_bufs {};
         };
 
-        reader_mt(const std::string &path)
-            : _path { path }, _is { _path }
+        // the number of chunks requested at once by sequential reads
+        static constexpr size_t readahead_chunks = 16;
+
+        static constexpr search_mode default_search_mode = has_index_prefix<T> ? search_mode::interpolation : search_mode::binary;
+
+        // lookups share decompressed chunks with other threads and readers through the cache when one is given
+        reader_mt(const std::string &path, const search_mode mode=default_search_mode, chunk_cache *cache=nullptr)
+            : _path { path }, _fh { _path }, _interpolate { has_index_prefix<T> && mode == search_mode::interpolation },
+                _cache { cache }, _cache_file_id { chunk_cache::file_id(_path) }
         {
-            auto data_size = std::filesystem::file_size(_path);
-            if (data_size < sizeof(uint64_t))
+            auto data_size = _fh.size();
+            if (data_size < sizeof(uint64_t) + sizeof(blake2b_64_hash))
                 throw error(fmt::format("{} is too small - no metadata can be found", _path));
-            _is.seek(data_size - sizeof(uint64_t));
             uint64_t meta_off;
-            _is.read(&meta_off, sizeof(meta_off));
-            _is.seek(meta_off);
+            _fh.read(data_size - sizeof(uint64_t), std::span { reinterpret_cast<uint8_t *>(&meta_off), sizeof(meta_off) });
             blake2b_64_hash meta_hash {};
+            if (meta_off > data_size - sizeof(meta_off) - sizeof(meta_hash))
+                throw error(fmt::format("{}: metadata offset {} is outside of the file of size {}", _path, meta_off, data_size));
             uint64_t meta_buf_size = data_size - meta_off - sizeof(meta_off) - sizeof(meta_hash);
             uint8_vector meta_buf {};
             meta_buf.resize(meta_buf_size);
-            _is.read(meta_buf.data(), meta_buf_size);
-            _is.read(&meta_hash, sizeof(meta_hash));
+            _fh.read(meta_off, meta_buf);
+            _fh.read(meta_off + meta_buf_size, meta_hash);
             auto meta_hash_computed = blake2b<blake2b_64_hash>(meta_buf);
             if (meta_hash_computed != meta_hash)
                 throw error(fmt::format("{}: metadata hash mismatch computed: {} vs stored: {}", _path, meta_hash_computed, meta_hash));
-            _is.seek(meta_off);
-            _is.read(&_num_parts, sizeof(_num_parts));
+            size_t meta_pos = 0;
+            const auto read_meta = [&](void *dst, const size_t sz) {
+                if (meta_buf.size() - meta_pos < sz)
+                    throw error(fmt::format("{}: metadata is truncated", _path));
+                memcpy(dst, meta_buf.data() + meta_pos, sz);
+                meta_pos += sz;
+            };
+            read_meta(&_num_parts, sizeof(_num_parts));
             if (_num_parts == 0)
                 throw error(fmt::format("num_partitions is {} for {}!", _num_parts, _path));
             if (_num_parts > max_parts)
                 throw error(fmt::format("num_partitions: {} is greater than the preconfigured maximum: {}!", _num_parts, max_parts));
-            _is.read(&_chunk_size, sizeof(_chunk_size));
+            read_meta(&_chunk_size, sizeof(_chunk_size));
             uint8_t meta_cnt;
-            _is.read(&meta_cnt, sizeof(meta_cnt));
+            read_meta(&meta_cnt, sizeof(meta_cnt));
             while (meta_cnt > 0) {
                 uint8_t name_size;
-                _is.read(&name_size, sizeof(name_size));
+                read_meta(&name_size, sizeof(name_size));
                 std::string name {};
                 name.resize(name_size);
-                _is.read(name.data(), name_size);
+                read_meta(name.data(), name_size);
                 uint8_t data_size;
-                _is.read(&data_size, sizeof(data_size));
+                read_meta(&data_size, sizeof(data_size));
                 uint8_vector data {};
                 data.resize(data_size);
-                _is.read(data.data(), data_size);
+                read_meta(data.data(), data_size);
                 _meta[name] = std::move(data);
                 meta_cnt--;
             }
             _cnts.resize(_num_parts);
-            _is.read(_cnts.data(), sizeof(_cnts[0]) * _num_parts);
+            read_meta(_cnts.data(), sizeof(_cnts[0]) * _num_parts);
             _chunk_lists.resize(_num_parts);
             _max_items.resize(_num_parts);
             for (size_t p = 0; p < _num_parts; ++p) {
@@ -361,7 +608,7 @@ namespace daedalus_turbo::index {
                     size_t list_size = (chunk_cnt + _chunk_size - 1) / _chunk_size;
                     auto &chunk_list = _chunk_lists.at(p);
                     chunk_list.resize(list_size);
-                    _is.read(chunk_list.data(), sizeof(chunk_list[0]) * list_size);
+                    read_meta(chunk_list.data(), sizeof(chunk_list[0]) * list_size);
                     for (size_t ci = 1; ci < chunk_list.size(); ci++) {
                         if (chunk_list.at(ci).max_item < chunk_list.at(ci - 1).max_item)
                             throw error(fmt::format("index {}: partition-{} chunks {} and {} are not ordered!", _path, p, ci - 1, ci));
@@ -375,6 +622,48 @@ namespace daedalus_turbo::index {
                 if (_max_items.at(pi) < _max_items.at(pi - 1))
                     throw error(fmt::format("index {}: partitions {} and {} are not ordered!", _path, pi - 1, pi));
             }
+            if constexpr (has_index_prefix<T>) {
+                if (_interpolate) {
+                    _part_prefixes.reserve(_num_parts);
+                    for (const auto &item: _max_items)
+                        _part_prefixes.emplace_back(item.index_prefix());
+                    _chunk_prefixes.resize(_num_parts);
+                    for (size_t p = 0; p < _num_parts; ++p) {
+                        _chunk_prefixes[p].reserve(_chunk_lists[p].size());
+                        for (const auto &chunk: _chunk_lists[p])
+                            _chunk_prefixes[p].emplace_back(chunk.max_item.index_prefix());
+                    }
+                }
+            }
+            if (meta_buf.size() - meta_pos >= columns_magic.size() + sizeof(uint64_t)
+                    && buffer { meta_buf.data() + meta_pos, columns_magic.size() } == buffer { columns_magic }) {
+                meta_pos += columns_magic.size();
+                read_meta(&_chunk_format, sizeof(_chunk_format));
+                if (_chunk_format != chunk_format_columnar || !has_index_columns<T>)
+                    throw error(fmt::format("{}: unsupported chunk format {}", _path, _chunk_format));
+            }
+            if constexpr (has_index_hash<T>) {
+                if (meta_buf.size() - meta_pos >= filter_magic.size() + 2 * sizeof(uint64_t)
+                        && buffer { meta_buf.data() + meta_pos, filter_magic.size() } == buffer { filter_magic }) {
+                    meta_pos += filter_magic.size();
+                    uint64_t bits_per_item, num_probes;
+                    read_meta(&bits_per_item, sizeof(bits_per_item));
+                    read_meta(&num_probes, sizeof(num_probes));
+                    // filters built with different parameters cannot be checked, so such indices are searched without them
+                    if (bits_per_item > 0 && num_probes == chunk_filter::num_probes) {
+                        _filter_bits = bits_per_item;
+                        _filters.resize(_num_parts);
+                        for (size_t p = 0; p < _num_parts; ++p) {
+                            const auto cnt = _cnts.at(p);
+                            const auto num_full = cnt / _chunk_size;
+                            auto &filter = _filters.at(p);
+                            filter.resize(num_full * chunk_filter::num_words(_chunk_size, _filter_bits)
+                                + chunk_filter::num_words(cnt - num_full * _chunk_size, _filter_bits));
+                            read_meta(filter.data(), sizeof(filter[0]) * filter.size());
+                        }
+                    }
+                }
+            }
         }
 
         thread_data init_thread(size_t part_idx=max_parts) const
@@ -384,11 +673,15 @@ namespace daedalus_turbo::index {
                 t.offsets.resize(_num_parts);
                 t.cache_chunk_idxs.resize(_num_parts);
                 t.caches.resize(_num_parts);
+                t.own_caches.resize(_num_parts);
+                t.shared_caches.resize(_num_parts);
             } else {
                 t.single_part_idx = part_idx;
                 t.offsets.resize(1);
                 t.cache_chunk_idxs.resize(1);
                 t.caches.resize(1);
+                t.own_caches.resize(1);
+                t.shared_caches.resize(1);
             }
             return t;
         }
@@ -414,41 +707,42 @@ namespace daedalus_turbo::index {
             size_t match_size = 0;
             T match_item {};
             bool multi_match = false;
-            auto comp = [](const T &a, const T &b) { return a.index_less(b); };
-            auto part_it = std::lower_bound(_max_items.begin(), _max_items.end(), search_item, comp);
-            if (part_it != _max_items.end()) {
-                size_t part_idx = part_it - _max_items.begin();
+            const size_t part_idx = _bounds(_num_parts, search_item,
+                [&](const auto i) -> const T & { return _max_items[i]; },
+                [&](const auto i) { return _part_prefixes[i]; }).first;
+            if (part_idx < _num_parts) {
                 size_t t_part_idx = _thread_part_idx(part_idx, t);
                 auto &chunk_list = _chunk_lists.at(part_idx);
                 auto &cache_chunk_idx = t.cache_chunk_idxs.at(t_part_idx);
-                auto chunk_it = std::lower_bound(chunk_list.begin(), chunk_list.end(), search_item,
-                                                    [](const chunk_info<T> &el, const T &val) { return el.max_item.index_less(val); });
-                auto chunk_it_end = std::upper_bound(chunk_list.begin(), chunk_list.end(), search_item,
-                                                    [](const T &val, const chunk_info<T> &el) { return val.index_less(el.max_item); });
-                if (chunk_it != chunk_list.end()) {
-                    size_t new_cache_chunk_idx = chunk_it - chunk_list.begin();
+                const auto [chunk_idx, chunk_end_idx] = _bounds(chunk_list.size(), search_item,
+                    [&](const auto i) -> const T & { return chunk_list[i].max_item; },
+                    [&](const auto i) { return _chunk_prefixes[part_idx][i]; });
+                const auto cache_bounds = [&](const std::span<const T> cache) {
+                    return _bounds(cache.size(), search_item,
+                        [&](const auto i) -> const T & { return cache[i]; },
+                        [&](const auto i) { return cache[i].index_prefix(); });
+                };
+                if (chunk_idx != chunk_list.size() && _may_contain(part_idx, chunk_idx, search_item, t)) {
                     auto &cache = t.caches.at(t_part_idx);
-                    if (new_cache_chunk_idx != cache_chunk_idx || cache.size() == 0)
-                        _load_cache(part_idx, new_cache_chunk_idx, t);
-                    auto [it, it_end] = std::equal_range(cache.begin(), cache.end(), search_item, comp);
-                    if (it != it_end && *it == search_item) {
-                        match_item = *it;
-                        match_size = it_end - it;
-                        if (it_end == cache.end()) multi_match = true;
+                    if (chunk_idx != cache_chunk_idx || cache.size() == 0)
+                        _load_cache(part_idx, chunk_idx, t);
+                    const auto [lo, hi] = cache_bounds(cache);
+                    if (lo != hi && cache[lo] == search_item) {
+                        match_item = cache[lo];
+                        match_size = hi - lo;
+                        if (hi == cache.size()) multi_match = true;
                         // set the position for a potential call to next()
-                        t.offsets.at(t_part_idx) = cache_chunk_idx * _chunk_size + (it - cache.begin()) + 1;
+                        t.offsets.at(t_part_idx) = cache_chunk_idx * _chunk_size + lo + 1;
                     }
                 }
                 if (match_size > 0) {
                     if (multi_match) {
-                        match_size += (chunk_it_end - chunk_it - 1) * _chunk_size;
-                        if (chunk_it_end != chunk_list.end()) {
-                            size_t new_cache_chunk_idx = chunk_it_end - chunk_list.begin();
+                        match_size += (chunk_end_idx - chunk_idx - 1) * _chunk_size;
+                        if (chunk_end_idx != chunk_list.size()) {
                             auto &cache = t.caches.at(t_part_idx);
-                            if (new_cache_chunk_idx != cache_chunk_idx || cache.size() == 0)
-                                _load_cache(part_idx, new_cache_chunk_idx, t);
-                            auto it = std::upper_bound(cache.begin(), cache.end(), search_item, comp);
-                            match_size += it - cache.begin();
+                            if (chunk_end_idx != cache_chunk_idx || cache.size() == 0)
+                                _load_cache(part_idx, chunk_end_idx, t);
+                            match_size += cache_bounds(cache).second;
                         }
                     }
                     t.next_part_idx = part_idx;
@@ -457,6 +751,66 @@ namespace daedalus_turbo::index {
             return find_result { match_size, match_item };
         }
 
+        // Calls observer(key_idx, item) for every stored item equal to one of the keys, which must be sorted with index_less.
+        // The keys are merged against the index in a single pass, so each needed chunk is loaded once.
+        void find_batch(const std::span<const T> keys, thread_data &t, const auto &observer) const
+        {
+            const auto comp = [](const T &a, const T &b) { return a.index_less(b); };
+            size_t part_idx = 0, cur_part_idx = max_parts, cur_chunk_idx = 0, cur_pos = 0;
+            // where the matches of the previous key began if they continued into the following chunks
+            std::optional<std::pair<size_t, size_t>> run_start {};
+            for (size_t ki = 0; ki < keys.size(); ++ki) {
+                const auto &key = keys[ki];
+                if (ki > 0 && key.index_less(keys[ki - 1])) [[unlikely]]
+                    throw error(fmt::format("index {}: find_batch keys must be sorted but key #{} is less than its predecessor", _path, ki));
+                // a repeated key must see the run again from its beginning
+                if (run_start && !keys[ki - 1].index_less(key))
+                    std::tie(cur_chunk_idx, cur_pos) = *run_start;
+                run_start.reset();
+                part_idx = std::lower_bound(_max_items.begin() + part_idx, _max_items.end(), key, comp) - _max_items.begin();
+                if (part_idx == _num_parts)
+                    break;
+                if (part_idx != cur_part_idx) {
+                    cur_part_idx = part_idx;
+                    cur_chunk_idx = 0;
+                    cur_pos = 0;
+                }
+                const auto &chunk_list = _chunk_lists[part_idx];
+                const auto chunk_it = std::lower_bound(chunk_list.begin() + cur_chunk_idx, chunk_list.end(), key,
+                    [](const chunk_info<T> &el, const T &val) { return el.max_item.index_less(val); });
+                if (chunk_it == chunk_list.end())
+                    continue;
+                size_t chunk_idx = chunk_it - chunk_list.begin();
+                if (chunk_idx != cur_chunk_idx) {
+                    cur_chunk_idx = chunk_idx;
+                    cur_pos = 0;
+                }
+                if (!_may_contain(part_idx, chunk_idx, key, t))
+                    continue;
+                const size_t t_part_idx = _thread_part_idx(part_idx, t);
+                auto &cache = t.caches[t_part_idx];
+                if (t.cache_chunk_idxs[t_part_idx] != chunk_idx || cache.empty())
+                    _load_cache(part_idx, chunk_idx, t);
+                auto it = std::lower_bound(cache.begin() + cur_pos, cache.end(), key, comp);
+                cur_pos = it - cache.begin();
+                // a run of equal items can continue into the following chunks
+                for (;;) {
+                    for (; it != cache.end() && *it == key; ++it)
+                        observer(ki, *it);
+                    if (it != cache.end() || cache.empty() || !(cache.back() == key) || chunk_idx + 1 >= chunk_list.size())
+                        break;
+                    _load_cache(part_idx, ++chunk_idx, t);
+                    it = cache.begin();
+                }
+                // the following keys continue from the end of the run, which is in the chunk loaded last
+                if (chunk_idx != cur_chunk_idx) {
+                    run_start.emplace(cur_chunk_idx, cur_pos);
+                    cur_chunk_idx = chunk_idx;
+                    cur_pos = it - cache.begin();
+                }
+            }
+        }
+
         buffer get_meta(const std::string &name) const
         {
             auto it = _meta.find(name);
@@ -470,6 +824,11 @@ namespace daedalus_turbo::index {
             return _num_parts;
         }
 
+        bool has_filters() const
+        {
+            return !_filters.empty();
+        }
+
         size_t offset_part(size_t part_idx, thread_data &t) const
         {
             size_t t_part_idx = _thread_part_idx(part_idx, t);
@@ -491,6 +850,26 @@ namespace daedalus_turbo::index {
             offset = new_offset;
         }
 
+        // the position of the first item of the partition that is not less than the key according to operator<
+        size_t lower_bound_part(const size_t part_idx, const T &key, thread_data &t) const
+        {
+            const auto &chunk_list = _chunk_lists.at(part_idx);
+            const auto chunk_it = std::partition_point(chunk_list.begin(), chunk_list.end(), [&](const auto &c) { return c.max_item < key; });
+            if (chunk_it == chunk_list.end())
+                return _cnts.at(part_idx);
+            const size_t chunk_idx = chunk_it - chunk_list.begin();
+            const size_t t_part_idx = _thread_part_idx(part_idx, t);
+            const auto &cache = t.caches.at(t_part_idx);
+            if (t.cache_chunk_idxs.at(t_part_idx) != chunk_idx || cache.empty())
+                _load_cache(part_idx, chunk_idx, t);
+            return chunk_idx * _chunk_size + (std::lower_bound(cache.begin(), cache.end(), key) - cache.begin());
+        }
+
+        const vector<chunk_info<T>> &chunk_list(const size_t part_idx) const
+        {
+            return _chunk_lists.at(part_idx);
+        }
+
         void seek(size_t new_offset, thread_data &t) const
         {
             seek_part(0, new_offset, t);
@@ -519,8 +898,8 @@ namespace daedalus_turbo::index {
             auto &cache_chunk_idx = t.cache_chunk_idxs.at(t_part_idx);
             auto &cache = t.caches.at(t_part_idx);
             if (new_cache_chunk_idx != cache_chunk_idx || cache.size() == 0)
-                _load_cache(part_idx, new_cache_chunk_idx, t);
-            item = cache.at(off - new_cache_chunk_idx * _chunk_size);
+                _load_cache_ahead(part_idx, new_cache_chunk_idx, t);
+            item = cache[off - new_cache_chunk_idx * _chunk_size];
             off++;
             return true;
         }
@@ -533,10 +912,12 @@ namespace daedalus_turbo::index {
             return false;
         }
 
+        // Not synchronized with the reads, since they take no lock: the callers must ensure that no thread
+        // uses this reader or its thread_data during or after close().
+        // Otherwise, a read may hit a closed descriptor or one that has been reused for another file.
         void close()
         {
-            mutex::scoped_lock lock { _read_mutex };
-            _is.close();
+            _fh.close();
         }
     private:
         std::string _path;
@@ -546,8 +927,70 @@ namespace daedalus_turbo::index {
         vector<vector<chunk_info<T>>> _chunk_lists {};
         vector<size_t> _cnts {};
         vector<T> _max_items {};
-        mutable mutex::unique_lock::mutex_type _read_mutex alignas(mutex::alignment) {};
-        mutable file::read_stream _is;
+        // positional reads keep no shared state, so threads load chunks concurrently without locking
+        file::read_handle _fh;
+        vector<vector<uint64_t>> _filters {};
+        size_t _filter_bits = 0;
+        bool _interpolate = false;
+        vector<uint64_t> _part_prefixes {};
+        vector<vector<uint64_t>> _chunk_prefixes {};
+        chunk_cache *_cache = nullptr;
+        uint64_t _cache_file_id = 0;
+        // zero for the raw chunks written before the columnar format
+        uint64_t _chunk_format = 0;
+
+        // The positions in [0, size) of the first item not less than the key and of the first item greater than it.
+        // With interpolation, only the items sharing the key's prefix need full comparisons.
+        std::pair<size_t, size_t> _bounds(const size_t size, const T &key, const auto &item_at, const auto &prefix_at) const
+        {
+            size_t lo = 0, hi = size;
+            if constexpr (has_index_prefix<T>) {
+                if (_interpolate) {
+                    const uint64_t key_prefix = key.index_prefix();
+                    lo = interpolation_search(size, key_prefix, prefix_at);
+                    // distinct keys rarely share a prefix, so the end of the range is usually next to its start
+                    for (hi = lo; hi < size && hi - lo < 8 && prefix_at(hi) == key_prefix; )
+                        ++hi;
+                    if (hi - lo == 8 && hi < size && key_prefix != std::numeric_limits<uint64_t>::max())
+                        hi = interpolation_search(size, key_prefix + 1, prefix_at);
+                }
+            }
+            size_t upper_hi = hi;
+            while (lo < hi) {
+                const auto mid = lo + (hi - lo) / 2;
+                if (item_at(mid).index_less(key))
+                    lo = mid + 1;
+                else
+                    hi = mid;
+            }
+            size_t upper = lo;
+            while (upper < upper_hi) {
+                const auto mid = upper + (upper_hi - upper) / 2;
+                if (key.index_less(item_at(mid)))
+                    upper_hi = mid;
+                else
+                    upper = mid + 1;
+            }
+            return { lo, upper };
+        }
+
+        // the first chunk that may contain the item is the only one that needs a check, since equal items are stored contiguously
+        bool _may_contain(const size_t part_idx, const size_t chunk_idx, const T &item, thread_data &t) const
+        {
+            if constexpr (has_index_hash<T>) {
+                if (!_filters.empty()) {
+                    const auto &filter = _filters[part_idx];
+                    const auto full_words = chunk_filter::num_words(_chunk_size, _filter_bits);
+                    const auto off = chunk_idx * full_words;
+                    const std::span<const uint64_t> words { filter.data() + off, std::min(full_words, filter.size() - off) };
+                    if (!chunk_filter::may_contain(words, item.index_hash())) {
+                        ++t.num_filtered;
+                        return false;
+                    }
+                }
+            }
+            return true;
+        }
 
         static size_t _thread_part_idx(size_t part_idx, thread_data &t)
         {
@@ -559,32 +1002,85 @@ namespace daedalus_turbo::index {
             return part_idx;
         }
 
+        // random lookups go through the shared cache, whereas sequential reads bypass it so that scans do not evict the hot chunks
         void _load_cache(size_t part_idx, size_t new_chunk_idx, thread_data &t) const
         {
-            size_t t_part_idx = _thread_part_idx(part_idx, t);
-            auto &cache_chunk_idx = t.cache_chunk_idxs.at(t_part_idx);
-            cache_chunk_idx = new_chunk_idx;
-            auto &cache = t.caches.at(t_part_idx);
-            const auto &cnt = _cnts.at(part_idx);
-            const auto &chunk_list = _chunk_lists.at(part_idx);
-            const auto &chunk = chunk_list.at(new_chunk_idx);
-            size_t cache_offset = new_chunk_idx * _chunk_size;
-            if (cache_offset + _chunk_size <= cnt) cache.resize(_chunk_size);
-            else cache.resize(cnt - cache_offset);
+            const auto &chunk = _chunk_lists.at(part_idx).at(new_chunk_idx);
+            if (_cache) {
+                const size_t t_part_idx = _thread_part_idx(part_idx, t);
+                auto &shared = t.shared_caches.at(t_part_idx);
+                shared = _cache->get({ _cache_file_id, static_cast<uint32_t>(part_idx), static_cast<uint32_t>(new_chunk_idx) }, chunk.packed_hash, [&] {
+                    t.read_buf.resize(chunk.packed_size);
+                    _fh.read(chunk.file_offset, t.read_buf);
+                    uint8_vector data(sizeof(T) * _chunk_items(part_idx, new_chunk_idx));
+                    _unpack(part_idx, new_chunk_idx, t.read_buf, data, t);
+                    return data;
+                });
+                t.caches.at(t_part_idx) = { reinterpret_cast<const T *>(shared->data()), shared->size() / sizeof(T) };
+                t.cache_chunk_idxs.at(t_part_idx) = new_chunk_idx;
+                return;
+            }
             t.read_buf.resize(chunk.packed_size);
+            _fh.read(chunk.file_offset, t.read_buf);
+            _unpack_cache(part_idx, new_chunk_idx, t.read_buf, t);
+        }
 
-            {
-                mutex::scoped_lock lock { _read_mutex };
-                _is.seek(chunk.file_offset);
-                _is.read(t.read_buf.data(), t.read_buf.size());
+        // sequential reads need the following chunks soon, so they are requested together to keep the device's queue busy
+        void _load_cache_ahead(size_t part_idx, size_t new_chunk_idx, thread_data &t) const
+        {
+            const auto &chunk_list = _chunk_lists.at(part_idx);
+            if (t.ahead_part_idx != part_idx || new_chunk_idx < t.ahead_chunk_idx || new_chunk_idx >= t.ahead_chunk_idx + t.ahead_bufs.size()) {
+                const auto num_chunks = std::min(readahead_chunks, chunk_list.size() - new_chunk_idx);
+                t.ahead_part_idx = max_parts;
+                t.ahead_bufs.resize(num_chunks);
+                vector<file::batch_reader::request> reqs {};
+                reqs.reserve(num_chunks);
+                for (size_t i = 0; i < num_chunks; ++i) {
+                    const auto &chunk = chunk_list.at(new_chunk_idx + i);
+                    auto &buf = t.ahead_bufs[i];
+                    buf.resize(chunk.packed_size);
+                    reqs.emplace_back(&_fh, chunk.file_offset, buf);
+                }
+                file::batch_reader::get().read(reqs);
+                t.ahead_part_idx = part_idx;
+                t.ahead_chunk_idx = new_chunk_idx;
             }
-            auto packed_hash = blake2b<blake2b_64_hash>(t.read_buf);
+            _unpack_cache(part_idx, new_chunk_idx, t.ahead_bufs.at(new_chunk_idx - t.ahead_chunk_idx), t);
+        }
+
+        size_t _chunk_items(const size_t part_idx, const size_t chunk_idx) const
+        {
+            return std::min(_chunk_size, _cnts.at(part_idx) - chunk_idx * _chunk_size);
+        }
+
+        void _unpack_cache(size_t part_idx, size_t new_chunk_idx, const buffer packed, thread_data &t) const
+        {
+            size_t t_part_idx = _thread_part_idx(part_idx, t);
+            auto &cache = t.own_caches.at(t_part_idx);
+            cache.resize(_chunk_items(part_idx, new_chunk_idx));
+            _unpack(part_idx, new_chunk_idx, packed, { reinterpret_cast<uint8_t *>(cache.data()), sizeof(T) * cache.size() }, t);
+            t.caches.at(t_part_idx) = cache;
+            t.shared_caches.at(t_part_idx).reset();
+            t.cache_chunk_idxs.at(t_part_idx) = new_chunk_idx;
+        }
+
+        void _unpack(const size_t part_idx, const size_t chunk_idx, const buffer packed, const std::span<uint8_t> out, thread_data &t) const
+        {
+            const auto &chunk = _chunk_lists.at(part_idx).at(chunk_idx);
+            auto packed_hash = blake2b<blake2b_64_hash>(packed);
             if (packed_hash != chunk.packed_hash)
                 throw error(fmt::format("corrupted chunk data in index {} part {} chunk {} at offset {} size {} hash {} while expected hash {}",
-                        _path, part_idx, new_chunk_idx, chunk.file_offset, chunk.packed_size, packed_hash, chunk.packed_hash));
-            std::span<uint8_t> cache_buf { reinterpret_cast<uint8_t *>(cache.data()), sizeof(T) * cache.size() };
-            zstd::decompress(cache_buf, t.read_buf);
+                        _path, part_idx, chunk_idx, chunk.file_offset, chunk.packed_size, packed_hash, chunk.packed_hash));
             t.num_reads++;
+            if constexpr (has_index_columns<T>) {
+                if (_chunk_format == chunk_format_columnar) {
+                    thread_local uint8_vector col_data {};
+                    zstd::decompress(col_data, packed);
+                    columns::decode(std::span<T> { reinterpret_cast<T *>(out.data()), out.size() / sizeof(T) }, col_data);
+                    return;
+                }
+            }
+            zstd::decompress(out, packed);
         }
     };
 
@@ -660,11 +1156,11 @@ namespace daedalus_turbo::index {
             size_t single_part_no = max_parts;
         };
 
-        reader_multi_mt(const std::span<const std::string> &paths): _readers {}
+        reader_multi_mt(const std::span<const std::string> &paths, chunk_cache *cache=nullptr): _readers {}
         {
             _readers.reserve(paths.size());
             for (const auto &p: paths)
-                _readers.emplace_back(std::make_unique<reader_mt<T>>(p));
+                _readers.emplace_back(std::make_unique<reader_mt<T>>(p, reader_mt<T>::default_search_mode, cache));
         }
 
         thread_data init_thread(size_t part_no=max_parts) const
@@ -750,6 +1246,44 @@ namespace daedalus_turbo::index {
             return typename reader_mt<T>::find_result { total_match_count, first_item };
         }
 
+        // Calls observer(key_idx, item) for the matches of the sorted keys in every slice, one slice after another.
+        void find_batch(const std::span<const T> keys, thread_data &t, const auto &observer) const
+        {
+            t.num_reads = 0;
+            for (size_t ri = 0; ri < _readers.size(); ++ri) {
+                auto &data = *(t.data.at(ri));
+                _readers.at(ri)->find_batch(keys, data, observer);
+                t.num_reads += data.num_reads;
+            }
+        }
+
+        // Searches ranges of the sorted keys in every slice in parallel, so the observer must be safe to call concurrently.
+        // Returns the number of loaded chunks.
+        size_t find_batch(scheduler &sched, const std::span<const T> keys, const auto &observer) const
+        {
+            // uniformly distributed keys make equal key ranges a good approximation of the partitions
+            static constexpr size_t min_range_size = 1024;
+            const size_t num_ranges = std::max(size_t { 1 }, std::min(sched.num_workers(), keys.size() / min_range_size));
+            std::atomic_size_t num_reads { 0 };
+            for (const auto &reader: _readers) {
+                for (size_t i = 0; i < num_ranges; ++i) {
+                    const size_t start_idx = i * keys.size() / num_ranges;
+                    const size_t end_idx = (i + 1) * keys.size() / num_ranges;
+                    if (start_idx == end_idx)
+                        continue;
+                    sched.submit_void("index-find-batch", 100, [&, start_idx, end_idx] {
+                        auto t = reader->init_thread();
+                        reader->find_batch(keys.subspan(start_idx, end_idx - start_idx), t, [&](const size_t key_idx, const T &item) {
+                            observer(start_idx + key_idx, item);
+                        });
+                        num_reads.fetch_add(t.num_reads, std::memory_order_relaxed);
+                    });
+                }
+            }
+            sched.process(false);
+            return num_reads.load(std::memory_order_relaxed);
+        }
+
         bool read_part(size_t part_no, T &item, thread_data &t) const
         {
             size_t t_part_no = _thread_part_no(part_no, t);
@@ -829,8 +1363,8 @@ namespace daedalus_turbo::index {
 
     template<class T>
     struct reader_multi {
-        reader_multi(const std::span<const std::string> &paths)
-            : _reader { paths }, _data { _reader.init_thread() }
+        reader_multi(const std::span<const std::string> &paths, chunk_cache *cache=nullptr)
+            : _reader { paths, cache }, _data { _reader.init_thread() }
         {
         }
 
@@ -844,6 +1378,11 @@ namespace daedalus_turbo::index {
             return _reader.find(search_item, _data);
         }
 
+        void find_batch(const std::span<const T> keys, const auto &observer)
+        {
+            _reader.find_batch(keys, _data, observer);
+        }
+
         bool read(T &item)
         {
             return _reader.read(item, _data);
@@ -0,0 +1,91 @@
+/* This file is part of Daedalus Turbo project: https://github.com/sierkov/daedalus-turbo/
+ * Copyright (c) 2022-2023 Alex Sierkov (alex dot sierkov at gmail dot com)
+ * Copyright (c) 2024-2025 R2 Rationality OÜ (info at r2rationality dot com)
+ * This code is distributed under the license specified in:
+ * https://github.com/sierkov/daedalus-turbo/blob/main/LICENSE */
+
+#include <random>
+#include <dt/common/benchmark.hpp>
+#include <dt/file.hpp>
+#include <dt/index/merge.hpp>
+
+using namespace daedalus_turbo;
+using namespace daedalus_turbo::index;
+
+namespace {
+    struct merge_bench_item {
+        blake2b_256_hash hash {};
+        uint64_t offset = 0;
+
+        bool operator<(const merge_bench_item &b) const
+        {
+            if (const int cmp = memcmp(hash.data(), b.hash.data(), hash.size()); cmp != 0)
+                return cmp < 0;
+            return offset < b.offset;
+        }
+
+        bool index_less(const merge_bench_item &b) const
+        {
+            return memcmp(hash.data(), b.hash.data(), hash.size()) < 0;
+        }
+
+        bool operator==(const merge_bench_item &b) const
+        {
+            return hash == b.hash;
+        }
+
+        uint64_t index_hash() const
+        {
+            return index::index_hash(hash);
+        }
+    };
+}
+
+suite index_merge_bench_suite = [] {
+    "index::merge_one_step"_test = [] {
+        // a full sync ends with a merge of hundreds of slices into a single index;
+        // fewer partitions than workers show how well a single partition's merge is split
+        static constexpr size_t num_slices = 256;
+        static constexpr size_t num_parts = 2;
+        static constexpr size_t items_per_slice = 1 << 15;
+        const file::tmp_directory dir { "index-merge-bench" };
+        std::vector<std::string> slices {};
+        {
+            std::default_random_engine rnd { 12345 };
+            std::vector<merge_bench_item> items(items_per_slice);
+            for (size_t si = 0; si < num_slices; ++si) {
+                for (size_t i = 0; i < items.size(); ++i) {
+                    for (auto &b: items[i].hash)
+                        b = static_cast<uint8_t>(rnd());
+                    items[i].offset = (si * items_per_slice + i) * 256;
+                }
+                std::sort(items.begin(), items.end());
+                auto &path = slices.emplace_back(fmt::format("{}/slice-{}.idx", dir.path(), si));
+                writer<merge_bench_item> idx { path, num_parts };
+                for (const auto &item: items)
+                    idx.emplace_part(item.hash[0] * num_parts / 256, item);
+                idx.set_meta("max_offset", buffer::from(static_cast<uint64_t>((si + 1) * items_per_slice * 256)));
+            }
+        }
+        // task graphs need a second worker to wait on
+        scheduler sched { std::max(scheduler::default_worker_count(), static_cast<size_t>(2)) };
+        for (const size_t max_ranges: { static_cast<size_t>(1), merge_part_ranges(num_parts, sched.num_workers()) }) {
+            // merge_one_step removes its inputs, so every run works on a copy
+            std::vector<std::string> inputs {};
+            for (const auto &path: slices) {
+                auto &copy = inputs.emplace_back(path + ".copy");
+                std::filesystem::copy_file(path, copy, std::filesystem::copy_options::overwrite_existing);
+            }
+            const auto out_path = fmt::format("{}/merged.idx", dir.path());
+            benchmark_r(fmt::format("merge of {} slices, {} workers, up to {} ranges per partition", num_slices, sched.num_workers(), max_ranges), 1e5, 1, [&] {
+                task_graph g { sched, "index-merge" };
+                g.add([&](task_graph::node_context &ctx) {
+                    merge_one_step<merge_bench_item>(ctx, inputs, out_path, max_ranges);
+                });
+                g.run();
+                return num_slices * items_per_slice;
+            });
+            std::filesystem::remove(out_path);
+        }
+    };
+};
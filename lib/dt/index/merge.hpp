@@ -6,9 +6,11 @@
 #ifndef DAEDALUS_TURBO_INDEX_MERGE_HPP
 #define DAEDALUS_TURBO_INDEX_MERGE_HPP
 
+#include <map>
+#include <numeric>
 #include <dt/index/io.hpp>
 #include <dt/logger.hpp>
-#include <dt/scheduler.hpp>
+#include <dt/task-graph.hpp>
 
 namespace daedalus_turbo::index {
     template<typename T>
@@ -36,21 +38,160 @@ namespace daedalus_turbo::index {
         return max_offset;
     }
 
+    // Finding a range boundary loads a chunk of every input, so ranges are kept at least as large as that
+    // and never smaller than the following number of items.
+    static constexpr size_t merge_min_range_items = 1 << 18;
+
+    // enough ranges per partition to keep all workers busy even when there are fewer partitions than workers
+    inline size_t merge_part_ranges(const size_t num_parts, const size_t num_workers=scheduler::default_worker_count())
+    {
+        return std::max(static_cast<size_t>(1), (2 * num_workers + num_parts - 1) / std::max(num_parts, static_cast<size_t>(1)));
+    }
+
     template<typename T>
-    void merge_one_step(scheduler &sched, const std::string &task_group, size_t task_prio,
-        const std::vector<std::string> &chunks, const std::string &final_path,
-        const std::function<void()> &on_complete)
+    struct merge_ranges_state {
+        struct shared_chunk {
+            std::vector<T> items {};
+            std::atomic_size_t num_ready = 0;
+        };
+
+        // the position of the first item of each range in every input followed by the sizes of the inputs
+        std::vector<std::vector<size_t>> split_pos {};
+        // the output position of the first item of each range followed by the total number of items
+        std::vector<size_t> out_pos {};
+        // the output chunks that span several ranges
+        std::map<size_t, shared_chunk> shared_chunks {};
+    };
+
+    // Merges the range_idx-th key range of a partition. All output chunks but those spanning several ranges are written directly.
+    // Each range fills its part of a shared chunk, and the range that completes it writes it out.
+    template<typename T>
+    void merge_index_range(writer<T> &out_idx, const size_t part_idx, const std::vector<std::shared_ptr<reader_mt<T>>> &readers,
+        merge_ranges_state<T> &st, const size_t range_idx)
+    {
+        const auto &begin = st.split_pos.at(range_idx);
+        const auto &end = st.split_pos.at(range_idx + 1);
+        const auto chunk_size = out_idx.chunk_size();
+        const auto num_items = st.out_pos.back();
+        std::vector<typename reader_mt<T>::thread_data> reader_data {};
+        reader_data.reserve(readers.size());
+        std::vector<size_t> num_left(readers.size());
+        merge_queue<T> items_to_consider {};
+        for (size_t i = 0; i < readers.size(); ++i) {
+            reader_data.emplace_back(readers[i]->init_thread(part_idx));
+            num_left[i] = end[i] - begin[i];
+            if (num_left[i]) {
+                readers[i]->seek_part(part_idx, begin[i], reader_data[i]);
+                T val;
+                readers[i]->read_part(part_idx, val, reader_data[i]);
+                --num_left[i];
+                items_to_consider.emplace(std::move(val), i);
+            }
+        }
+        std::vector<T> buf {};
+        buf.reserve(chunk_size);
+        size_t buf_pos = st.out_pos.at(range_idx);
+        const auto flush = [&] {
+            const size_t chunk_idx = buf_pos / chunk_size;
+            const size_t chunk_items = std::min(chunk_size, num_items - chunk_idx * chunk_size);
+            if (buf.size() == chunk_items) {
+                out_idx.write_chunk(part_idx, chunk_idx, buf);
+            } else {
+                auto &chunk = st.shared_chunks.at(chunk_idx);
+                std::copy(buf.begin(), buf.end(), chunk.items.begin() + (buf_pos - chunk_idx * chunk_size));
+                if (chunk.num_ready.fetch_add(buf.size(), std::memory_order_acq_rel) + buf.size() == chunk_items)
+                    out_idx.write_chunk(part_idx, chunk_idx, chunk.items);
+            }
+            buf_pos += buf.size();
+            buf.clear();
+        };
+        while (!items_to_consider.empty()) {
+            merge_item next { items_to_consider.top() };
+            items_to_consider.pop();
+            buf.emplace_back(next.val);
+            if ((buf_pos + buf.size()) % chunk_size == 0)
+                flush();
+            if (num_left[next.stream_idx]) {
+                readers[next.stream_idx]->read_part(part_idx, next.val, reader_data[next.stream_idx]);
+                --num_left[next.stream_idx];
+                items_to_consider.emplace(std::move(next));
+            }
+        }
+        if (!buf.empty())
+            flush();
+    }
+
+    // Splits a partition into up to max_ranges key ranges at the chunk boundaries of the inputs and merges each in a separate child node.
+    // The exact position of every split in each input gives the output position of each range, so the chunks can be written in any order.
+    template<typename T>
+    void merge_index_part_ranges(task_graph::node_context &ctx, const std::shared_ptr<writer<T>> &out_idx, const size_t part_idx,
+        const std::vector<std::shared_ptr<reader_mt<T>>> &readers, const size_t max_ranges)
+    {
+        auto st = std::make_shared<merge_ranges_state<T>>();
+        size_t num_items = 0;
+        std::vector<size_t> sizes {};
+        std::vector<T> split_keys {};
+        for (const auto &r: readers) {
+            sizes.emplace_back(r->size_part(part_idx));
+            num_items += sizes.back();
+            for (const auto &chunk: r->chunk_list(part_idx))
+                split_keys.emplace_back(chunk.max_item);
+        }
+        const size_t min_range_items = std::max(merge_min_range_items, readers.size() * out_idx->chunk_size());
+        const size_t num_ranges = std::min(max_ranges, std::max(static_cast<size_t>(1), num_items / min_range_items));
+        if (num_ranges <= 1) {
+            merge_index_part(*out_idx, part_idx, readers);
+            return;
+        }
+        std::sort(split_keys.begin(), split_keys.end());
+        st->split_pos.emplace_back(readers.size(), 0);
+        {
+            std::vector<typename reader_mt<T>::thread_data> reader_data {};
+            reader_data.reserve(readers.size());
+            for (const auto &r: readers)
+                reader_data.emplace_back(r->init_thread(part_idx));
+            for (size_t ri = 1; ri < num_ranges; ++ri) {
+                const auto &key = split_keys[ri * split_keys.size() / num_ranges];
+                std::vector<size_t> pos(readers.size());
+                for (size_t i = 0; i < readers.size(); ++i)
+                    pos[i] = readers[i]->lower_bound_part(part_idx, key, reader_data[i]);
+                // many equal items can make neighbouring split keys land at the same positions
+                if (pos != st->split_pos.back())
+                    st->split_pos.emplace_back(std::move(pos));
+            }
+        }
+        st->split_pos.emplace_back(std::move(sizes));
+        for (const auto &pos: st->split_pos)
+            st->out_pos.emplace_back(std::accumulate(pos.begin(), pos.end(), static_cast<size_t>(0)));
+        out_idx->presize_part(part_idx, num_items);
+        const auto chunk_size = out_idx->chunk_size();
+        for (size_t ri = 1; ri + 1 < st->out_pos.size(); ++ri) {
+            if (const auto pos = st->out_pos[ri]; pos % chunk_size) {
+                const auto chunk_idx = pos / chunk_size;
+                st->shared_chunks[chunk_idx].items.resize(std::min(chunk_size, num_items - chunk_idx * chunk_size));
+            }
+        }
+        for (size_t ri = 0; ri + 1 < st->split_pos.size(); ++ri) {
+            ctx.spawn([out_idx, part_idx, readers, st, ri] {
+                merge_index_range(*out_idx, part_idx, readers, *st, ri);
+            });
+        }
+    }
+
+    // Merges the chunks within the graph node ctx. Each partition is merged by a separate child node
+    // and the output is committed by a child node depending on all of them.
+    // With max_part_ranges above one, large partitions are further split into key ranges merged concurrently.
+    template<typename T>
+    void merge_one_step(task_graph::node_context &ctx, const std::vector<std::string> &chunks, const std::string &final_path, size_t max_part_ranges=0)
     {
         if (chunks.empty()) {
             logger::trace("merge: no chunks for {} - ignoring", final_path);
-            on_complete();
             return;
         }
         if (chunks.size() == 1) {
             auto chunk = chunks.at(0);
             std::filesystem::rename(chunk, final_path);
             logger::trace("merged {} chunks into {}", chunk, final_path);
-            on_complete();
             return;
         }
         std::vector<std::shared_ptr<reader_mt<T>>> readers {};
@@ -63,28 +204,35 @@ namespace daedalus_turbo::index {
                 throw error(fmt::format("chunk {} has a partition count: {} different from the one found in other chunks: {}!",
                         chunks[i], reader->num_parts(), num_parts));
         }
+        if (!max_part_ranges)
+            max_part_ranges = merge_part_ranges(num_parts);
         auto out_idx = std::make_shared<index::writer<T>>(final_path, num_parts);
-        auto max_offset = std::make_shared<std::atomic<uint64_t>>(0);
-        sched.on_completion(task_group, num_parts, [out_idx, max_offset, readers, final_path, on_complete] {
-            out_idx->set_meta("max_offset", buffer::from(*max_offset));
+        auto part_max_offsets = std::make_shared<std::vector<uint64_t>>(num_parts);
+        std::vector<task_graph::node_id> parts {};
+        parts.reserve(num_parts);
+        for (size_t pi = 0; pi < num_parts; ++pi) {
+            if (max_part_ranges > 1) {
+                parts.emplace_back(ctx.spawn([pi, out_idx, readers, part_max_offsets, max_part_ranges](task_graph::node_context &part_ctx) {
+                    for (const auto &r: readers)
+                        (*part_max_offsets)[pi] = std::max((*part_max_offsets)[pi], r->get_meta("max_offset").template to<uint64_t>());
+                    merge_index_part_ranges(part_ctx, out_idx, pi, readers, max_part_ranges);
+                }));
+            } else {
+                parts.emplace_back(ctx.spawn([pi, out_idx, readers, part_max_offsets] {
+                    (*part_max_offsets)[pi] = merge_index_part(*out_idx, pi, readers);
+                }));
+            }
+        }
+        ctx.spawn([out_idx, part_max_offsets, readers, final_path] {
+            const auto max_offset = *std::max_element(part_max_offsets->begin(), part_max_offsets->end());
+            out_idx->set_meta("max_offset", buffer::from(max_offset));
             out_idx->commit();
             for (auto &r: readers) {
                 r->close();
                 std::filesystem::remove(r->path());
             }
             logger::trace("merged {} chunks into {}", readers.size(), final_path);
-            on_complete();
-        });
-        sched.on_result(task_group, [max_offset](auto &&res) {
-            auto part_max_offset = std::any_cast<uint64_t>(res);
-            if (part_max_offset > *max_offset)
-                *max_offset = part_max_offset;
-        });
-        for (size_t pi = 0; pi < num_parts; ++pi) {
-            sched.submit(task_group, task_prio, [pi, out_idx, readers]() {
-                return merge_index_part(*out_idx, pi, readers);
-            });
-        }
+        }, parts);
     }
 }
 
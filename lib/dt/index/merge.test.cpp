@@ -0,0 +1,110 @@
+/* This file is part of Daedalus Turbo project: https://github.com/sierkov/daedalus-turbo/
+ * Copyright (c) 2022-2023 Alex Sierkov (alex dot sierkov at gmail dot com)
+ * Copyright (c) 2024-2025 R2 Rationality OÜ (info at r2rationality dot com)
+ * This code is distributed under the license specified in:
+ * https://github.com/sierkov/daedalus-turbo/blob/main/LICENSE */
+
+#include <dt/common/test.hpp>
+#include <dt/file.hpp>
+#include <dt/index/merge.hpp>
+
+using namespace daedalus_turbo;
+using namespace daedalus_turbo::index;
+
+namespace {
+    struct merge_test_item {
+        uint64_t key = 0;
+        uint64_t slice_no = 0;
+
+        bool operator<(const merge_test_item &b) const
+        {
+            if (key != b.key)
+                return key < b.key;
+            return slice_no < b.slice_no;
+        }
+
+        bool index_less(const merge_test_item &b) const
+        {
+            return key < b.key;
+        }
+
+        bool operator==(const merge_test_item &b) const
+        {
+            return key == b.key;
+        }
+
+        uint64_t index_hash() const
+        {
+            return key * 0x9E3779B97F4A7C15ULL;
+        }
+    };
+
+    // merge_one_step removes its inputs, so each merge gets a fresh copy of them
+    std::vector<std::string> write_slices(const std::string &dir, const size_t num_slices, const size_t num_parts)
+    {
+        std::vector<std::string> paths {};
+        for (size_t si = 0; si < num_slices; ++si) {
+            auto &path = paths.emplace_back(fmt::format("{}/slice-{}.idx", dir, si));
+            writer<merge_test_item> idx { path, num_parts };
+            // the partitions differ in size, and runs of equal keys cross the chunk boundaries
+            for (size_t pi = 0; pi < num_parts; ++pi) {
+                const uint64_t num_keys = (pi + 1) * 0x10000;
+                for (uint64_t k = si % 3; k < num_keys; k += 1 + (k % 7 == 0 ? 0 : si % 4))
+                    idx.emplace_part(pi, pi * 0x1000000 + k / 5, si);
+            }
+            idx.set_meta("max_offset", buffer::from(static_cast<uint64_t>(si * 100)));
+        }
+        return paths;
+    }
+
+    std::vector<merge_test_item> read_all(const std::string &path)
+    {
+        std::vector<merge_test_item> items {};
+        reader<merge_test_item> r { path };
+        merge_test_item item {};
+        while (r.read(item))
+            items.emplace_back(item);
+        return items;
+    }
+}
+
+suite index_merge_ranges_suite = [] {
+    "index::merge_one_step"_test = [] {
+        static constexpr size_t num_slices = 9;
+        static constexpr size_t num_parts = 4;
+        scheduler sched { 4 };
+        std::vector<merge_test_item> exp {};
+        for (const size_t max_ranges: { 1, 7 }) {
+            const file::tmp_directory dir { "index-merge-ranges-test" };
+            const auto slices = write_slices(dir.path(), num_slices, num_parts);
+            const auto out_path = fmt::format("{}/merged.idx", dir.path());
+            task_graph g { sched, "index-merge" };
+            g.add([&](task_graph::node_context &ctx) {
+                merge_one_step<merge_test_item>(ctx, slices, out_path, max_ranges);
+            });
+            g.run();
+            for (const auto &path: slices)
+                expect(!std::filesystem::exists(path)) << path;
+            const auto act = read_all(out_path);
+            if (exp.empty()) {
+                exp = act;
+                expect(std::is_sorted(exp.begin(), exp.end()));
+                expect(exp.size() > 3 * merge_min_range_items) << exp.size();
+                continue;
+            }
+            test_same(exp.size(), act.size());
+            size_t num_same = 0;
+            for (size_t i = 0; i < std::min(exp.size(), act.size()); ++i)
+                num_same += exp[i].key == act[i].key && exp[i].slice_no == act[i].slice_no;
+            test_same(exp.size(), num_same);
+            const reader_mt<merge_test_item> r { out_path };
+            expect(r.has_filters());
+            test_same(static_cast<uint64_t>((num_slices - 1) * 100), r.get_meta("max_offset").to<uint64_t>());
+            auto t = r.init_thread();
+            size_t num_found = 0;
+            for (size_t i = 0; i < act.size(); i += 997)
+                num_found += std::get<0>(r.find(act[i], t)) > 0;
+            test_same((act.size() + 996) / 997, num_found);
+        }
+    };
+};
@@ -33,6 +33,24 @@ namespace daedalus_turbo::index::stake_ref {
         {
             return memcmp(&id, &b.id, sizeof(id)) == 0;
         }
+
+        uint64_t index_hash() const
+        {
+            return index::index_hash(id.hash, id.script);
+        }
+
+        uint64_t index_prefix() const
+        {
+            return index::index_prefix(id.hash);
+        }
+
+        static constexpr auto index_columns()
+        {
+            return std::array {
+                column { offsetof(item, id), sizeof(item::id), column_type::prefix },
+                column { offsetof(item, offset), sizeof(item::offset), column_type::delta }
+            };
+        }
     };
 
     struct chunk_indexer: chunk_indexer_multi_part<item> {
@@ -31,6 +31,23 @@ namespace daedalus_turbo::index::tx {
         {
             return memcmp(hash.data(), b.hash.data(), hash.size()) == 0;
         }
+
+        uint64_t index_hash() const
+        {
+            return index::index_hash(hash);
+        }
+
+        uint64_t index_prefix() const
+        {
+            return index::index_prefix(hash);
+        }
+
+        static constexpr auto index_columns()
+        {
+            return std::array {
+                column { offsetof(item, hash), sizeof(item::hash), column_type::prefix }
+            };
+        }
     };
     static_assert(sizeof(item) == 40);
 
@@ -37,6 +37,23 @@ namespace daedalus_turbo::index::txo_use {
             if (cmp != 0) return false;
             return out_idx == b.out_idx;
         }
+
+        uint64_t index_hash() const
+        {
+            return index::index_hash(hash, out_idx);
+        }
+
+        uint64_t index_prefix() const
+        {
+            return index::index_prefix(hash);
+        }
+
+        static constexpr auto index_columns()
+        {
+            return std::array {
+                column { offsetof(item, hash), sizeof(item::hash), column_type::prefix }
+            };
+        }
     };
 
     struct chunk_indexer: chunk_indexer_multi_part<item> {
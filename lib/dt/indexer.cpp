@@ -12,6 +12,7 @@
 #include <dt/index/txo-use.hpp>
 #include <dt/indexer.hpp>
 #include <dt/scheduler.hpp>
+#include <dt/task-graph.hpp>
 
 namespace daedalus_turbo::indexer {
     struct incremental::impl {
@@ -51,12 +52,20 @@ namespace daedalus_turbo::indexer {
             if (end_offset != indexed_bytes())
                 throw error(fmt::format("internal error: indexed size calculation is incorrect: {} vs {}", end_offset, indexed_bytes()));
             _cr.register_processor(_proc);
-            logger::info("indices have data up to offset {}", end_offset);
+            logger::info("indices have data up to offset {}, read amplification: {}", end_offset, read_amplification());
+            _cr.sched().set_background(scheduler::group_id(compaction_task_group));
+            _schedule_compaction();
         }
 
         ~impl()
         {
             _cr.remove_processor(_proc);
+            _compaction_stop = true;
+            // the compaction merges share the scheduler with other components, so wait only for them
+            logger::run_log_errors([&] {
+                while (_cr.sched().task_count(scheduler::group_id(compaction_task_group)) > 0)
+                    _cr.sched().process_once(false);
+            });
         }
 
         slice_list slices(std::optional<uint64_t> end_offset={}) const
@@ -87,6 +96,12 @@ namespace daedalus_turbo::indexer {
             return _slices.continuous_size();
         }
 
+        size_t read_amplification() const
+        {
+            mutex::scoped_lock lk { _slices_mutex };
+            return _slices.size();
+        }
+
         const indexer_map &indexers() const
         {
             return _indexers;
@@ -105,6 +120,16 @@ namespace daedalus_turbo::indexer {
             return chunk_indexers;
         }
     private:
+        struct compaction {
+            std::vector<merger::slice> inputs {};
+            merger::slice output {};
+        };
+
+        // Compaction merges share the workers and the memory budget of the sync but run only when no sync task is queued.
+        // Their group is in the background, so the sync's scheduler::process calls neither wait for them nor fail because of them.
+        static constexpr int64_t compaction_prio_base = -1'000'000'000'000'000LL;
+        static constexpr std::string_view compaction_task_group = "compact-index";
+
         chunk_registry &_cr;
         const indexer_map _indexers;
         const std::filesystem::path _idx_dir;
@@ -119,6 +144,13 @@ namespace daedalus_turbo::indexer {
         // rollback tracking
         std::vector<merger::slice> _slices_truncated {};
         std::vector<merger::slice> _slices_added {};
+        // compaction state, _slices_mutex guards all but the atomics
+        const merger::compaction_policy _compaction_policy = merger::compaction_policy::from_env();
+        bool _tx_active = false;
+        std::optional<compaction> _compaction_done {};
+        std::chrono::steady_clock::time_point _compaction_not_before {};
+        std::atomic_bool _compaction_running { false };
+        std::atomic_bool _compaction_stop { false };
         chunk_processor _proc {
             [this] { return _idx_end_offset(); },
             [this] { _idx_start_tx(); },
@@ -141,10 +173,12 @@ namespace daedalus_turbo::indexer {
             return m;
         }
 
-        void _merge_slice(const merger::slice &output_slice, const std::vector<std::string> &input_slices,
-            const int64_t prio_base, const std::function<void()> &on_merge)
+        void _merge_slice(const std::string &task_group, const merger::slice &output_slice, const std::vector<std::string> &input_slices,
+            const int64_t prio_base, const std::function<void()> &on_merge, const std::function<void(const std::string &)> &on_error={})
         {
-            const auto indices_awaited = std::make_shared<std::atomic_size_t>(_mergeable.size());
+            const auto priority = prio_base - static_cast<int64_t>(output_slice.offset);
+            task_graph g { _cr.sched(), task_group, priority };
+            std::vector<task_graph::node_id> merges {};
             for (const auto &idxr_name: _mergeable) {
                 auto idxr_ptr = _indexers.at(idxr_name).get();
                 std::vector<std::string> input_paths {};
@@ -153,17 +187,20 @@ namespace daedalus_turbo::indexer {
                         input_paths.emplace_back(idxr_ptr->reader_path(slice_id));
                 }
                 const auto output_path = idxr_ptr->reader_path(output_slice.slice_id);
-                const auto priority = prio_base - static_cast<int64_t>(output_slice.offset);
-                _cr.sched().submit_void("merge:schedule-" + output_path, priority, [this, idxr_ptr, output_path, priority, input_paths, indices_awaited, on_merge] {
-                    // merge tasks must have a higher priority + 50 so that the actual merge tasks free up file handles
-                    // and other tied resources quicker than they are consumed
-                    idxr_ptr->merge("merge:" + output_path, priority + 50, input_paths, output_path, [this, indices_awaited, output_path, priority, on_merge] {
-                        if (--(*indices_awaited) == 0) {
-                            _cr.sched().submit_void("merge:ready-" + output_path, priority, on_merge);
-                        }
-                    });
+                // the partition merges are spawned by this node and get a higher priority than the other indices' merge nodes
+                // so that they free up file handles and other tied resources quicker than they are consumed
+                merges.emplace_back(g.add([idxr_ptr, input_paths, output_path](task_graph::node_context &ctx) {
+                    idxr_ptr->merge(ctx, input_paths, output_path);
+                }));
+            }
+            g.add(on_merge, merges);
+            if (on_error) {
+                g.on_done([on_error](const auto &err) {
+                    if (err)
+                        on_error(*err);
                 });
             }
+            g.submit();
         }
 
         void _schedule_final_merge(mutex::unique_lock &epoch_slices_lk, const bool force=false)
@@ -195,7 +232,7 @@ namespace daedalus_turbo::indexer {
                 merger::slice output_slice { _merge_next_offset, total_size, max_slot };
                 _merge_next_offset += total_size;
                 epoch_slices_lk.unlock();
-                _merge_slice(output_slice, input_slices, -1'000'000LL, [this, output_slice] {
+                _merge_slice("merge:" + output_slice.slice_id, output_slice, input_slices, -1'000'000LL, [this, output_slice] {
                     // ensures notifications are sent only in their continuous order
                     std::vector<merger::slice> notify_slices {};
                     uint64_t merged_max_slot, merged_end_offset;
@@ -225,30 +262,35 @@ namespace daedalus_turbo::indexer {
 
         void _idx_truncate(const cardano::optional_point &new_tip, const bool track_changes)
         {
-            if (const auto max_end_offset = new_tip ? new_tip->end_offset : 0; max_end_offset < _slices.continuous_size()) {
+            if (const auto max_end_offset = new_tip ? new_tip->end_offset : 0; max_end_offset < indexed_bytes()) {
                 timer t { fmt::format("truncate indices to max offset {}", max_end_offset), logger::level::info };
                 std::vector<merger::slice> updated {};
-                for (auto it = _slices.begin(); it != _slices.end(); ) {
-                    const auto &s = it->second;
-                    if (s.end_offset() <= max_end_offset) {
-                        ++it;
-                    } else { // s.end_offset() > max_end_offset
-                        logger::trace("truncate index slice {}", s.slice_id);
-                        if (track_changes)
-                            _slices_truncated.emplace_back(s);
-                        if (s.offset < max_end_offset) {
-                            merger::slice new_slice { s.offset, std::min(s.size, max_end_offset - s.offset), new_tip->slot };
-                            updated.emplace_back(new_slice);
-                            for (auto &[name, idxr_ptr]: _indexers) {
-                                _cr.sched().submit_void("truncate:init-" + name, 25, [&idxr_ptr, s, new_slice, max_end_offset] {
-                                    idxr_ptr->schedule_truncate(s.slice_id, new_slice.slice_id, max_end_offset);
-                                });
+                {
+                    // truncation can happen outside of a transaction, so concurrently with a compaction
+                    mutex::scoped_lock lk { _slices_mutex };
+                    for (auto it = _slices.begin(); it != _slices.end(); ) {
+                        const auto &s = it->second;
+                        if (s.end_offset() <= max_end_offset) {
+                            ++it;
+                        } else { // s.end_offset() > max_end_offset
+                            logger::trace("truncate index slice {}", s.slice_id);
+                            if (track_changes)
+                                _slices_truncated.emplace_back(s);
+                            if (s.offset < max_end_offset) {
+                                merger::slice new_slice { s.offset, std::min(s.size, max_end_offset - s.offset), new_tip->slot };
+                                updated.emplace_back(new_slice);
+                                for (auto &[name, idxr_ptr]: _indexers) {
+                                    _cr.sched().submit_void("truncate:init-" + name, 25, [&idxr_ptr, s, new_slice, max_end_offset] {
+                                        idxr_ptr->schedule_truncate(s.slice_id, new_slice.slice_id, max_end_offset);
+                                    });
+                                }
                             }
+                            it = _slices.erase(it);
                         }
-                        it = _slices.erase(it);
                     }
                 }
                 _cr.sched().process(true);
+                mutex::scoped_lock lk { _slices_mutex };
                 for (auto &&new_slice: updated) {
                     _slices.add(new_slice);
                     if (track_changes)
@@ -259,12 +301,14 @@ namespace daedalus_turbo::indexer {
 
         uint64_t _idx_end_offset() const
         {
-            return _slices.continuous_size();
+            return indexed_bytes();
         }
 
         void _idx_start_tx()
         {
             _epoch_slices.clear();
+            mutex::scoped_lock lk { _slices_mutex };
+            _tx_active = true;
             _merge_next_offset = _slices.empty() ? 0 : _slices.rbegin()->second.end_offset();
         }
 
@@ -292,6 +336,7 @@ namespace daedalus_turbo::indexer {
                 _slices.add(s);
             }
             _slices_truncated.clear();
+            _end_tx();
         }
 
         void _idx_commit_tx()
@@ -305,6 +350,120 @@ namespace daedalus_turbo::indexer {
             }
             _slices_truncated.clear();
             _slices_added.clear();
+            _end_tx();
+        }
+
+        void _end_tx()
+        {
+            {
+                mutex::scoped_lock lk { _slices_mutex };
+                _tx_active = false;
+                if (_compaction_done)
+                    _apply_compaction();
+            }
+            _schedule_compaction();
+        }
+
+        // Merges the slices chosen by the compaction policy in the background. Merges remove their inputs,
+        // so they get hard links to the live slices, which stay readable until the compacted slice replaces them.
+        // The rate limit is enforced by delaying the next compaction until the previous one fits into it.
+        // There is no timer, so a compaction deferred by the limit starts only at the end of the next transaction.
+        void _schedule_compaction()
+        {
+            if (!_compaction_policy.enabled() || _compaction_stop || _compaction_running.exchange(true))
+                return;
+            compaction job {};
+            {
+                mutex::scoped_lock lk { _slices_mutex };
+                if (!_tx_active && std::chrono::steady_clock::now() >= _compaction_not_before)
+                    job.inputs = _compaction_policy.next(_slices);
+            }
+            if (job.inputs.empty()) {
+                _compaction_running = false;
+                return;
+            }
+            uint64_t max_slot = 0;
+            for (const auto &s: job.inputs)
+                max_slot = std::max(max_slot, s.max_slot);
+            job.output = merger::slice { job.inputs.front().offset, job.inputs.back().end_offset() - job.inputs.front().offset, max_slot };
+            std::vector<std::string> input_slices {};
+            uint64_t input_bytes = 0;
+            for (const auto &s: job.inputs) {
+                const auto &link_id = input_slices.emplace_back("compact-" + s.slice_id);
+                for (const auto &idxr_name: _mergeable) {
+                    const auto idxr_ptr = _indexers.at(idxr_name).get();
+                    const auto link_path = idxr_ptr->reader_path(link_id);
+                    std::filesystem::remove(link_path);
+                    if (const auto sz = idxr_ptr->disk_size(s.slice_id); sz > 0) {
+                        input_bytes += sz;
+                        std::error_code ec {};
+                        std::filesystem::create_hard_link(idxr_ptr->reader_path(s.slice_id), link_path, ec);
+                        if (ec)
+                            std::filesystem::copy_file(idxr_ptr->reader_path(s.slice_id), link_path);
+                    }
+                }
+            }
+            logger::info("compacting {} index slices into {}: {} MB", job.inputs.size(), job.output.slice_id, input_bytes >> 20);
+            const auto started = std::chrono::steady_clock::now();
+            _merge_slice(std::string { compaction_task_group }, job.output, input_slices, compaction_prio_base, [this, job, input_bytes, started] {
+                {
+                    mutex::scoped_lock lk { _slices_mutex };
+                    if (_compaction_policy.max_rate)
+                        _compaction_not_before = started + std::chrono::milliseconds(input_bytes * 1000 / _compaction_policy.max_rate);
+                    _compaction_done.emplace(job);
+                    // slices cannot change under a transaction, so its end applies the compaction
+                    if (_tx_active)
+                        return;
+                    _apply_compaction();
+                }
+                _schedule_compaction();
+            }, [this, job, input_slices](const std::string &err) {
+                logger::warn("compaction of the index slices into {} has failed: {}", job.output.slice_id, err);
+                mutex::scoped_lock lk { _slices_mutex };
+                const auto out_it = _slices.find(job.output.offset);
+                const bool output_live = out_it != _slices.end() && out_it->second.slice_id == job.output.slice_id;
+                // the inputs are hard links, so removing them and the partial output does not affect the live slices
+                for (const auto &idxr_name: _mergeable) {
+                    const auto idxr_ptr = _indexers.at(idxr_name).get();
+                    std::error_code ec {};
+                    for (const auto &link_id: input_slices)
+                        std::filesystem::remove(idxr_ptr->reader_path(link_id), ec);
+                    const auto output_path = idxr_ptr->reader_path(job.output.slice_id);
+                    std::filesystem::remove(output_path + ".tmp", ec);
+                    if (!output_live)
+                        std::filesystem::remove(output_path, ec);
+                }
+                // the next transaction's end retries the compaction
+                _compaction_running = false;
+            });
+        }
+
+        // requires _slices_mutex to be locked and no active transaction
+        void _apply_compaction()
+        {
+            const auto job = std::move(*_compaction_done);
+            _compaction_done.reset();
+            // a truncation could have replaced some of the inputs in the meantime
+            bool intact = true;
+            for (const auto &s: job.inputs) {
+                const auto it = _slices.find(s.offset);
+                intact &= it != _slices.end() && it->second.slice_id == s.slice_id;
+            }
+            if (intact) {
+                const auto old_amp = _slices.size();
+                for (const auto &s: job.inputs)
+                    _slices.erase(s.offset);
+                _slices.add(job.output);
+                _save_json_slices(_index_state_path);
+                logger::info("compacted {} index slices into {}: read amplification {} -> {}", job.inputs.size(), job.output.slice_id, old_amp, _slices.size());
+            } else {
+                logger::info("discarding compacted index slice {} since its inputs have changed", job.output.slice_id);
+            }
+            for (const auto &s: intact ? job.inputs : std::vector { job.output }) {
+                for (auto &[name, idxr_ptr]: _indexers)
+                    _cr.remover().mark(idxr_ptr->reader_path(s.slice_id));
+            }
+            _compaction_running = false;
         }
 
         void _idx_on_chunk_add(const storage::chunk_info &chunk, const cardano::parsed_block_list &blocks) const
@@ -325,7 +484,7 @@ namespace daedalus_turbo::indexer {
                 input_slices.emplace_back(fmt::format("update-{}", chunk_ptr->offset));
             }
             merger::slice output_slice { info.start_offset(), info.end_offset() - info.start_offset(), info.last_slot(), fmt::format("epoch-{}", epoch) };
-            _merge_slice(output_slice, input_slices, -2'000'000LL, [this, epoch, output_slice] {
+            _merge_slice("merge:" + output_slice.slice_id, output_slice, input_slices, -2'000'000LL, [this, epoch, output_slice] {
                 mutex::unique_lock lk { _epoch_slices_mutex };
                 _epoch_slices.emplace(epoch, output_slice);
                 _schedule_final_merge(lk);
@@ -378,6 +537,11 @@ namespace daedalus_turbo::indexer {
         return _impl->idx_dir();
     }
 
+    size_t incremental::read_amplification() const
+    {
+        return _impl->read_amplification();
+    }
+
     std::string incremental::storage_dir(const std::string &data_dir)
     {
         return chunk_registry::init_db_dir(data_dir + "/index").string();
@@ -49,6 +49,8 @@ namespace daedalus_turbo::indexer {
         slice_path_list reader_paths(const std::string &name) const;
         const indexer_map &indexers() const;
         const std::filesystem::path &idx_dir() const;
+        // the number of slices a lookup probes in each index
+        size_t read_amplification() const;
     protected:
         struct impl;
         std::unique_ptr<impl> _impl;
@@ -6,8 +6,11 @@
 #ifndef DAEDALUS_TURBO_INDEXER_MERGER_HPP
 #define DAEDALUS_TURBO_INDEXER_MERGER_HPP
 
+#include <cstdlib>
+#include <limits>
 #include <map>
 #include <string>
+#include <vector>
 #include <dt/common/error.hpp>
 #include <dt/json.hpp>
 
@@ -97,6 +100,68 @@ namespace daedalus_turbo::indexer::merger {
             return slot;
         }
     };
+
+    // Levelled compaction of the merged slices: each level holds slices ratio times larger than the previous one,
+    // and ratio adjacent slices of the same level are merged into one of the next level.
+    // So, readers probe at most ratio - 1 slices per level, and each indexed byte is rewritten once per level.
+    struct compaction_policy {
+        uint64_t ratio = 4;
+        uint64_t base_size = part_size;
+        // larger slices are never merged again, since each merge rewrites them in full
+        uint64_t max_size = part_size << 4;
+        // the average rate of merged index bytes per second, zero means unlimited
+        uint64_t max_rate = 64ULL << 20;
+
+        static compaction_policy from_env()
+        {
+            compaction_policy p {};
+            if (const char *env_ratio_str = std::getenv("DT_INDEX_COMPACTION_RATIO"); env_ratio_str != nullptr)
+                p.ratio = std::stoull(env_ratio_str);
+            if (const char *env_rate_str = std::getenv("DT_INDEX_COMPACTION_MBPS"); env_rate_str != nullptr)
+                p.max_rate = std::stoull(env_rate_str) << 20;
+            return p;
+        }
+
+        bool enabled() const
+        {
+            return ratio >= 2;
+        }
+
+        size_t level(const uint64_t size) const
+        {
+            size_t lvl = 0;
+            for (uint64_t level_size = base_size; size >= level_size; level_size *= ratio) {
+                ++lvl;
+                if (level_size > std::numeric_limits<uint64_t>::max() / ratio)
+                    break;
+            }
+            return lvl;
+        }
+
+        // the oldest ratio slices of the newest long enough run of adjacent same-level slices or an empty list
+        std::vector<slice> next(const tree &slices) const
+        {
+            std::vector<slice> res {};
+            if (!enabled())
+                return res;
+            std::vector<slice> run {};
+            const auto close_run = [&] {
+                if (run.size() >= ratio)
+                    res.assign(run.begin(), run.begin() + ratio);
+                run.clear();
+            };
+            for (const auto &[offset, s]: slices) {
+                if (!run.empty() && (run.back().end_offset() != s.offset || level(run.back().size) != level(s.size)))
+                    close_run();
+                if (s.size >= max_size)
+                    close_run();
+                else
+                    run.emplace_back(s);
+            }
+            close_run();
+            return res;
+        }
+    };
 }
 
 #endif // !DAEDALUS_TURBO_INDEXER_MERGER_HPP
\ No newline at end of file
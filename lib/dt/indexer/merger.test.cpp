@@ -0,0 +1,78 @@
+/* This file is part of Daedalus Turbo project: https://github.com/sierkov/daedalus-turbo/
+ * Copyright (c) 2022-2023 Alex Sierkov (alex dot sierkov at gmail dot com)
+ * Copyright (c) 2024-2025 R2 Rationality OÜ (info at r2rationality dot com)
+ * This code is distributed under the license specified in:
+ * https://github.com/sierkov/daedalus-turbo/blob/main/LICENSE */
+
+#include <dt/common/test.hpp>
+#include <dt/indexer/merger.hpp>
+
+using namespace daedalus_turbo;
+using namespace daedalus_turbo::indexer;
+
+namespace {
+    merger::tree make_tree(const std::initializer_list<uint64_t> sizes)
+    {
+        merger::tree t {};
+        uint64_t offset = 0;
+        for (const auto sz: sizes) {
+            t.add({ offset, sz, 0 });
+            offset += sz;
+        }
+        return t;
+    }
+
+    void compact(merger::tree &t, const merger::compaction_policy &p)
+    {
+        for (auto inputs = p.next(t); !inputs.empty(); inputs = p.next(t)) {
+            for (const auto &s: inputs)
+                t.erase(s.offset);
+            t.add({ inputs.front().offset, inputs.back().end_offset() - inputs.front().offset, 0 });
+        }
+    }
+}
+
+suite indexer_merger_suite = [] {
+    "indexer::merger"_test = [] {
+        "compaction levels"_test = [] {
+            const merger::compaction_policy p { 4, 100, 100000, 0 };
+            test_same(0, p.level(0));
+            test_same(0, p.level(99));
+            test_same(1, p.level(100));
+            test_same(1, p.level(399));
+            test_same(2, p.level(400));
+            test_same(3, p.level(1600));
+            expect(p.level(std::numeric_limits<uint64_t>::max()) < 64);
+        };
+        "compaction choice"_test = [] {
+            const merger::compaction_policy p { 4, 100, 1000, 0 };
+            expect(p.next(make_tree({ 100, 100, 100 })).empty());
+            // the newest long enough run is chosen, and only ratio slices of it
+            {
+                const auto inputs = p.next(make_tree({ 400, 400, 400, 400, 100, 100, 100, 100, 100, 10 }));
+                test_same(4, inputs.size());
+                test_same(1600, inputs.front().offset);
+                test_same(2000, inputs.back().end_offset());
+            }
+            // slices of different levels and the ones too large to merge break runs
+            expect(p.next(make_tree({ 100, 100, 400, 100, 100 })).empty());
+            expect(p.next(make_tree({ 1000, 1000, 1000, 1000 })).empty());
+            test_same(4, p.next(make_tree({ 100, 100, 100, 100 })).size());
+            const merger::compaction_policy disabled { 0, 100, 1000, 0 };
+            expect(disabled.next(make_tree({ 100, 100, 100, 100 })).empty());
+        };
+        "read amplification"_test = [] {
+            // with each new part-sized slice, the number of slices grows only logarithmically
+            const merger::compaction_policy p { 4, 100, 1ULL << 40, 0 };
+            merger::tree t {};
+            for (uint64_t i = 0; i < 1000; ++i) {
+                t.add({ i * 100, 100, 0 });
+                compact(t, p);
+                expect(t.size() <= (p.level(t.continuous_size()) + 1) * (p.ratio - 1)) << i << t.size();
+            }
+            test_same(100'000, t.continuous_size());
+            // 1000 = 3*256 + 3*64 + 2*16 + 2*4
+            test_same(10, t.size());
+        };
+    };
+};
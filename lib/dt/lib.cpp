@@ -9,6 +9,6 @@
 #include <dt/scheduler.hpp>
 
 namespace daedalus_turbo {
-    thread_local uint8_vector chunk_registry::_read_buffer {};
+    thread_local storage::chunk_cache::data_ptr chunk_registry::_read_chunk {};
     const size_t index::two_step_merge_num_files = file::max_open_files / (scheduler::default_worker_count() * 2);
 }
\ No newline at end of file
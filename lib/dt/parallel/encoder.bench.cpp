@@ -0,0 +1,62 @@
+/* This file is part of Daedalus Turbo project: https://github.com/sierkov/daedalus-turbo/
+ * Copyright (c) 2022-2023 Alex Sierkov (alex dot sierkov at gmail dot com)
+ * Copyright (c) 2024-2025 R2 Rationality OÜ (info at r2rationality dot com)
+ * This code is distributed under the license specified in:
+ * https://github.com/sierkov/daedalus-turbo/blob/main/LICENSE */
+
+#include <dt/common/benchmark.hpp>
+#include <dt/memory.hpp>
+#include <dt/parallel/encoder.hpp>
+
+using namespace daedalus_turbo;
+using namespace daedalus_turbo::parallel;
+
+namespace {
+    // about the number and the size of the UTxO partitions in a Cardano Node ledger export
+    static constexpr size_t num_chunks = 256;
+    static constexpr size_t chunk_size = 4 << 20;
+
+    encoder<uint8_vector> make_encoder()
+    {
+        encoder<uint8_vector> enc {};
+        for (size_t i = 0; i < num_chunks; ++i) {
+            enc.add([i](auto buf) {
+                buf.resize(chunk_size);
+                for (size_t j = 0; j < buf.size(); j += 64)
+                    buf[j] = static_cast<uint8_t>(i + j);
+                return buf;
+            });
+        }
+        return enc;
+    }
+}
+
+suite parallel_encoder_bench_suite = [] {
+    "parallel::encoder"_test = [] {
+        auto &sched = scheduler::get();
+        file::tmp_directory tmp_dir { "bench-parallel-encoder" };
+        const auto path = fmt::format("{}/data.bin", tmp_dir.path());
+        // the peak memory use only grows, so the streaming goes first
+        const auto start_mb = memory::max_usage_mb();
+        double stream_sec, full_sec;
+        {
+            timer t { "run_save" };
+            auto enc = make_encoder();
+            enc.run_save(sched, "bench-parallel-encoder", path, 1000, false, 64 << 20);
+            stream_sec = t.stop(false);
+        }
+        const auto stream_mb = memory::max_usage_mb() - start_mb;
+        {
+            timer t { "run and save" };
+            auto enc = make_encoder();
+            enc.run(sched, "bench-parallel-encoder");
+            enc.save(path);
+            full_sec = t.stop(false);
+        }
+        const auto full_mb = memory::max_usage_mb() - start_mb;
+        std::clog << fmt::format("[parallel::encoder] {} MB in {} chunks: run and save: peak +{} MB in {:.3f} sec;"
+            " run_save with a 64 MB buffer: peak +{} MB in {:.3f} sec\n",
+            (num_chunks * chunk_size) >> 20, num_chunks, full_mb, full_sec, stream_mb, stream_sec);
+        expect(stream_mb * 4 < full_mb) << stream_mb << full_mb;
+    };
+};
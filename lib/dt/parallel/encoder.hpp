@@ -9,9 +9,11 @@
 
 #include <algorithm>
 #include <functional>
+#include <numeric>
 #include <vector>
 #include <dt/common/bytes.hpp>
 #include <dt/common/file.hpp>
+#include <dt/mutex.hpp>
 #include <dt/parallel/encoder.hpp>
 #include <dt/progress.hpp>
 #include <dt/scheduler.hpp>
@@ -39,6 +41,17 @@ namespace daedalus_turbo::parallel {
             _buffers.emplace_back();
         }
 
+        // gives access to the encoded data between run and save
+        [[nodiscard]] const uint8_vector &at(const size_t idx) const
+        {
+            return _buffers.at(idx);
+        }
+
+        [[nodiscard]] uint8_vector &at(const size_t idx)
+        {
+            return _buffers.at(idx);
+        }
+
         void run(scheduler &sched, const std::string &task_group, int prio=1000, bool report_progress=false)
         {
             sched.wait_all_done(task_group, _tasks.size(),
@@ -80,6 +93,32 @@ namespace daedalus_turbo::parallel {
             std::filesystem::rename(tmp_path, path);
         }
 
+        // encodes the chunks and writes them to the file in order without keeping all of them in memory:
+        // the encoded chunks wait for the earlier ones only while they take less than max_buffered bytes,
+        // so the peak memory use is about max_buffered plus a chunk per worker
+        void run_save(scheduler &sched, const std::string &task_group, const std::string &path, int prio=1000,
+            bool report_progress=false, const size_t max_buffered=default_max_buffered)
+        {
+            const auto tmp_path = fmt::format("{}.tmp", path);
+            timer t { fmt::format("encoding and writing serialized data to {}", path), logger::level::debug };
+            {
+                file::write_stream ws { tmp_path };
+                stream_state st { ws, std::max(sched.num_workers(), size_t { 1 }), max_buffered };
+                st.ready.resize(_tasks.size());
+                sched.wait_all_done(task_group, _tasks.size(),
+                    [&] {
+                        mutex::scoped_lock lk { st.mutex };
+                        _submit_more(sched, task_group, prio, st);
+                    },
+                    [this, &task_group, report_progress](auto &&, auto done, auto errs) {
+                        if (report_progress)
+                            progress::get().update(task_group, done - errs, _tasks.size());
+                    }
+                );
+            }
+            std::filesystem::rename(tmp_path, path);
+        }
+
         [[nodiscard]] uint8_vector flat() const
         {
             uint8_vector res {};
@@ -89,6 +128,93 @@ namespace daedalus_turbo::parallel {
             return res;
         }
     private:
+        static constexpr size_t default_max_buffered = 256 << 20;
+
+        struct stream_state {
+            file::write_stream &ws;
+            const size_t max_in_flight;
+            const size_t max_buffered;
+            mutex::unique_lock::mutex_type mutex alignas(mutex::alignment) {};
+            std::vector<bool> ready {};
+            size_t next_submit = 0;
+            size_t next_write = 0;
+            size_t in_flight = 0;
+            size_t buffered = 0;
+            bool writing = false;
+            bool failed = false;
+        };
+
+        uint8_vector _encode(const size_t idx)
+        {
+            if constexpr (std::is_same_v<ENC, void>) {
+                return _tasks[idx]();
+            } else {
+                return _tasks[idx](_init_fn());
+            }
+        }
+
+        // the mutex must be held by the caller
+        void _submit_more(scheduler &sched, const std::string &task_group, const int prio, stream_state &st)
+        {
+            // the earliest unwritten chunk is always in flight, so a stop here is resumed once it completes
+            while (st.next_submit < _tasks.size() && (st.failed || (st.in_flight < st.max_in_flight && st.buffered < st.max_buffered))) {
+                ++st.in_flight;
+                sched.submit_void(task_group, prio, [this, &sched, &task_group, prio, &st, idx=st.next_submit++] {
+                    _stream_task(sched, task_group, prio, st, idx);
+                });
+            }
+        }
+
+        void _stream_task(scheduler &sched, const std::string &task_group, const int prio, stream_state &st, const size_t idx)
+        {
+            mutex::unique_lock lk { st.mutex };
+            try {
+                // after a failure, the remaining tasks only let wait_all_done count them
+                if (!st.failed) {
+                    lk.unlock();
+                    auto buf = _encode(idx);
+                    lk.lock();
+                    st.buffered += buf.size();
+                    _buffers[idx] = std::move(buf);
+                    st.ready[idx] = true;
+                    _write_ready(lk, st);
+                }
+            } catch (...) {
+                if (!lk.owns_lock())
+                    lk.lock();
+                st.failed = true;
+                --st.in_flight;
+                _submit_more(sched, task_group, prio, st);
+                throw;
+            }
+            --st.in_flight;
+            _submit_more(sched, task_group, prio, st);
+        }
+
+        // writes the contiguous encoded chunks in a single thread at a time and frees their memory
+        void _write_ready(mutex::unique_lock &lk, stream_state &st)
+        {
+            if (st.writing)
+                return;
+            st.writing = true;
+            try {
+                while (st.next_write < _tasks.size() && st.ready[st.next_write] && !st.failed) {
+                    auto buf = std::move(_buffers[st.next_write]);
+                    lk.unlock();
+                    st.ws.write(buf);
+                    lk.lock();
+                    st.buffered -= buf.size();
+                    ++st.next_write;
+                }
+            } catch (...) {
+                if (!lk.owns_lock())
+                    lk.lock();
+                st.writing = false;
+                throw;
+            }
+            st.writing = false;
+        }
+
         init_func _init_fn;
         std::vector<encode_func> _tasks {};
         std::vector<uint8_vector> _buffers {};
@@ -0,0 +1,58 @@
+/* This file is part of Daedalus Turbo project: https://github.com/sierkov/daedalus-turbo/
+ * Copyright (c) 2022-2023 Alex Sierkov (alex dot sierkov at gmail dot com)
+ * Copyright (c) 2024-2025 R2 Rationality OÜ (info at r2rationality dot com)
+ * This code is distributed under the license specified in:
+ * https://github.com/sierkov/daedalus-turbo/blob/main/LICENSE */
+
+#include <dt/common/test.hpp>
+#include <dt/parallel/encoder.hpp>
+
+using namespace daedalus_turbo;
+using namespace daedalus_turbo::parallel;
+
+namespace {
+    encoder<uint8_vector> make_encoder(const size_t num_chunks, const size_t fail_idx=std::numeric_limits<size_t>::max())
+    {
+        encoder<uint8_vector> enc {};
+        for (size_t i = 0; i < num_chunks; ++i) {
+            enc.add([i, fail_idx](auto buf) {
+                if (i == fail_idx)
+                    throw error(fmt::format("chunk {} has failed", i));
+                // chunks of different sizes finish out of order
+                buf.resize((i * 7919) % 1000);
+                for (size_t j = 0; j < buf.size(); ++j)
+                    buf[j] = static_cast<uint8_t>(i + j);
+                return buf;
+            });
+        }
+        return enc;
+    }
+}
+
+suite parallel_encoder_suite = [] {
+    "parallel::encoder"_test = [] {
+        auto &sched = scheduler::get();
+        file::tmp_directory tmp_dir { "test-parallel-encoder" };
+        const auto exp_path = fmt::format("{}/exp.bin", tmp_dir.path());
+        {
+            auto enc = make_encoder(1000);
+            enc.run(sched, "test-parallel-encoder");
+            enc.save(exp_path);
+        }
+        const auto exp = file::read(exp_path);
+        "run_save"_test = [&] {
+            for (const size_t max_buffered: { size_t { 1 }, size_t { 10'000 }, size_t { 1 } << 30 }) {
+                const auto path = fmt::format("{}/act-{}.bin", tmp_dir.path(), max_buffered);
+                auto enc = make_encoder(1000);
+                enc.run_save(sched, "test-parallel-encoder", path, 1000, false, max_buffered);
+                expect(file::read(path) == exp) << max_buffered;
+            }
+        };
+        "run_save failure"_test = [&] {
+            const auto path = fmt::format("{}/failed.bin", tmp_dir.path());
+            auto enc = make_encoder(1000, 500);
+            expect(throws([&] { enc.run_save(sched, "test-parallel-encoder", path, 1000, false, 10'000); }));
+            expect(!std::filesystem::exists(path));
+        };
+    };
+};
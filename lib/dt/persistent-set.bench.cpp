@@ -0,0 +1,80 @@
+/* This file is part of Daedalus Turbo project: https://github.com/sierkov/daedalus-turbo/
+ * Copyright (c) 2022-2023 Alex Sierkov (alex dot sierkov at gmail dot com)
+ * Copyright (c) 2024-2025 R2 Rationality OÜ (info at r2rationality dot com)
+ * This code is distributed under the license specified in:
+ * https://github.com/sierkov/daedalus-turbo/blob/main/LICENSE */
+
+#include <random>
+#include <unordered_set>
+#include <dt/cardano/common/types.hpp>
+#include <dt/common/benchmark.hpp>
+#include <dt/persistent-set.hpp>
+#include <dt/static-map.hpp>
+#include <dt/timer.hpp>
+
+namespace {
+    using namespace daedalus_turbo;
+    using namespace daedalus_turbo::cardano;
+
+    static constexpr size_t num_pools = 3'000;
+    static constexpr size_t num_stake_ids = 1'300'000;
+    static constexpr size_t num_redelegs = 10'000;
+
+    stake_ident make_stake_id(const uint64_t no)
+    {
+        return { blake2b<key_hash>(buffer::from(no)), false };
+    }
+
+    pool_hash make_pool_id(const uint64_t no)
+    {
+        return blake2b<pool_hash>(buffer::from(no));
+    }
+
+    // the same steps as the inverse delegation maps go through at an epoch boundary:
+    // a copy of the active map becomes the mark snapshot and then the active map keeps changing
+    template<typename S>
+    void bench_rotation(const std::string_view name)
+    {
+        std::default_random_engine rnd { 12345 };
+        daedalus_turbo::map<pool_hash, S> active {};
+        daedalus_turbo::vector<pool_hash> delegs_of {};
+        for (uint64_t i = 0; i < num_stake_ids; ++i) {
+            const auto &pool_id = delegs_of.emplace_back(make_pool_id(rnd() % num_pools));
+            active[pool_id].emplace(make_stake_id(i));
+        }
+        static_map<pool_hash, S> mark {};
+        timer t_copy { "copy" };
+        mark = active;
+        const auto copy_sec = t_copy.stop(false);
+        timer t_redeleg { "redelegate" };
+        for (size_t i = 0; i < num_redelegs; ++i) {
+            const auto stake_no = rnd() % num_stake_ids;
+            const auto stake_id = make_stake_id(stake_no);
+            active.at(delegs_of[stake_no]).erase(stake_id);
+            delegs_of[stake_no] = make_pool_id(rnd() % num_pools);
+            active[delegs_of[stake_no]].emplace(stake_id);
+        }
+        const auto redeleg_sec = t_redeleg.stop(false);
+        size_t mark_size = 0;
+        for (const auto &[pool_id, delegs]: mark)
+            mark_size += delegs.size();
+        std::clog << fmt::format("[{}] {} pools, {} stake ids: mark copy: {:.3f} sec, {} redelegations: {:.3f} sec\n",
+            name, num_pools, num_stake_ids, copy_sec, num_redelegs, redeleg_sec);
+        expect(mark_size == num_stake_ids);
+    }
+}
+
+suite persistent_set_bench_suite = [] {
+    "persistent_set"_test = [] {
+        "epoch-boundary copy"_test = [] {
+            bench_rotation<std::unordered_set<stake_ident>>("unordered_set");
+            bench_rotation<persistent_set<stake_ident>>("persistent_set");
+        };
+        benchmark_r("persistent_set emplace", 1e5, 3, [] {
+            persistent_set<stake_ident> s {};
+            for (uint64_t i = 0; i < num_stake_ids / 10; ++i)
+                s.emplace(make_stake_id(i));
+            return s.size();
+        });
+    };
+};
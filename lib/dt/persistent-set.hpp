@@ -0,0 +1,290 @@
+#pragma once
+#ifndef DAEDALUS_TURBO_PERSISTENT_SET_HPP
+#define DAEDALUS_TURBO_PERSISTENT_SET_HPP
+/* This file is part of Daedalus Turbo project: https://github.com/sierkov/daedalus-turbo/
+ * Copyright (c) 2022-2023 Alex Sierkov (alex dot sierkov at gmail dot com)
+ * Copyright (c) 2024-2025 R2 Rationality OÜ (info at r2rationality dot com)
+ * This code is distributed under the license specified in:
+ * https://github.com/sierkov/daedalus-turbo/blob/main/LICENSE */
+
+#include <algorithm>
+#include <bit>
+#include <memory>
+#include <dt/container.hpp>
+#include <dt/zpp.hpp>
+
+namespace daedalus_turbo {
+    // A hash set whose copies share their unchanged nodes, so a copy takes constant time
+    // and a change to either copy duplicates only the path from the root to the changed value.
+    // It is a compressed hash-array mapped prefix tree (CHAMP): each node keeps a bitmap of its slots holding values
+    // and another one of its slots holding sub-nodes. Sub-nodes with a single value are always inlined into the parent,
+    // so the same contents always have the same shape and the same iteration order.
+    // The copies can be read concurrently but not modified while another thread copies or modifies the same set.
+    template<typename T, typename H=std::hash<T>>
+    struct persistent_set {
+    private:
+        struct node;
+        using node_ptr = std::shared_ptr<node>;
+    public:
+        using value_type = T;
+
+        struct const_iterator {
+            using difference_type = std::ptrdiff_t;
+            using value_type = T;
+
+            const_iterator() =default;
+
+            explicit const_iterator(const node *root)
+            {
+                if (root) {
+                    _stack.emplace_back(root, 0);
+                    _next_valid();
+                }
+            }
+
+            bool operator==(const const_iterator &o) const
+            {
+                return _stack == o._stack;
+            }
+
+            const T &operator*() const
+            {
+                const auto &[n, pos] = _stack.back();
+                return n->values[pos];
+            }
+
+            const T *operator->() const
+            {
+                return &**this;
+            }
+
+            const_iterator &operator++()
+            {
+                ++_stack.back().second;
+                _next_valid();
+                return *this;
+            }
+
+            const_iterator operator++(int)
+            {
+                auto copy = *this;
+                ++(*this);
+                return copy;
+            }
+        private:
+            // the positions within a node go over its values first and then over its sub-nodes
+            vector<std::pair<const node *, size_t>> _stack {};
+
+            void _next_valid()
+            {
+                while (!_stack.empty()) {
+                    auto &[n, pos] = _stack.back();
+                    if (pos < n->values.size())
+                        return;
+                    if (const auto node_idx = pos - n->values.size(); node_idx < n->nodes.size()) {
+                        ++pos;
+                        _stack.emplace_back(n->nodes[node_idx].get(), 0);
+                    } else {
+                        _stack.pop_back();
+                    }
+                }
+            }
+        };
+
+        // the values are stored in the iteration order, which depends only on the contents
+        static constexpr auto serialize(auto &archive, auto &self)
+        {
+            if constexpr (std::remove_cvref_t<decltype(archive)>::kind() == ::zpp::bits::kind::out) {
+                const vector<T> values(self.begin(), self.end());
+                return archive(values);
+            } else {
+                vector<T> values {};
+                if (const auto res = archive(values); ::zpp::bits::failure(res)) [[unlikely]]
+                    return res;
+                self.clear();
+                for (const auto &v: values)
+                    self.emplace(v);
+                return ::zpp::bits::errc {};
+            }
+        }
+
+        persistent_set() =default;
+
+        persistent_set(const std::initializer_list<T> values)
+        {
+            for (const auto &v: values)
+                emplace(v);
+        }
+
+        bool operator==(const persistent_set &o) const
+        {
+            if (_size != o._size)
+                return false;
+            if (_root == o._root)
+                return true;
+            for (const auto &v: *this) {
+                if (!o.contains(v))
+                    return false;
+            }
+            return true;
+        }
+
+        const_iterator begin() const
+        {
+            return const_iterator { _root.get() };
+        }
+
+        const_iterator end() const
+        {
+            return {};
+        }
+
+        size_t size() const
+        {
+            return _size;
+        }
+
+        bool empty() const
+        {
+            return _size == 0;
+        }
+
+        void clear()
+        {
+            _root.reset();
+            _size = 0;
+        }
+
+        bool contains(const T &v) const
+        {
+            const auto hash = _hash(v);
+            const node *n = _root.get();
+            for (size_t level = 0; n; ++level) {
+                if (level == max_level)
+                    return std::binary_search(n->values.begin(), n->values.end(), v);
+                const auto bit = _bit(hash, level);
+                if (n->data_map & bit)
+                    return n->values[_index(n->data_map, bit)] == v;
+                if (!(n->node_map & bit))
+                    return false;
+                n = n->nodes[_index(n->node_map, bit)].get();
+            }
+            return false;
+        }
+
+        // returns false if the value is already there
+        bool emplace(const T &v)
+        {
+            if (contains(v))
+                return false;
+            _insert(_root, v, _hash(v), 0);
+            ++_size;
+            return true;
+        }
+
+        size_t erase(const T &v)
+        {
+            if (!contains(v))
+                return 0;
+            if (--_size == 0)
+                _root.reset();
+            else
+                _erase(_root, v, _hash(v), 0);
+            return 1;
+        }
+    private:
+        static constexpr size_t bits_per_level = 5;
+        // the nodes at this level hold the values with the same full hash sorted
+        static constexpr size_t max_level = 64 / bits_per_level;
+
+        struct node {
+            uint32_t data_map = 0;
+            uint32_t node_map = 0;
+            vector<T> values {};
+            vector<node_ptr> nodes {};
+        };
+
+        node_ptr _root {};
+        size_t _size = 0;
+
+        static uint64_t _hash(const T &v)
+        {
+            return H {}(v);
+        }
+
+        static uint32_t _bit(const uint64_t hash, const size_t level)
+        {
+            return uint32_t { 1 } << ((hash >> (level * bits_per_level)) & 0x1F);
+        }
+
+        static size_t _index(const uint32_t map, const uint32_t bit)
+        {
+            return std::popcount(map & (bit - 1));
+        }
+
+        // a node referenced by another copy is duplicated before a change
+        static node &_own(node_ptr &n)
+        {
+            if (!n)
+                n = std::make_shared<node>();
+            else if (n.use_count() > 1)
+                n = std::make_shared<node>(*n);
+            return *n;
+        }
+
+        // the value must not be in the set
+        static void _insert(node_ptr &n, const T &v, const uint64_t hash, const size_t level)
+        {
+            auto &nd = _own(n);
+            if (level == max_level) {
+                nd.values.insert(std::lower_bound(nd.values.begin(), nd.values.end(), v), v);
+                return;
+            }
+            const auto bit = _bit(hash, level);
+            if (nd.node_map & bit) {
+                _insert(nd.nodes[_index(nd.node_map, bit)], v, hash, level + 1);
+            } else if (nd.data_map & bit) {
+                // two values in the same slot move together into a new sub-node
+                const auto val_idx = _index(nd.data_map, bit);
+                node_ptr sub {};
+                _insert(sub, nd.values[val_idx], _hash(nd.values[val_idx]), level + 1);
+                _insert(sub, v, hash, level + 1);
+                nd.values.erase(nd.values.begin() + val_idx);
+                nd.data_map ^= bit;
+                nd.nodes.insert(nd.nodes.begin() + _index(nd.node_map, bit), std::move(sub));
+                nd.node_map |= bit;
+            } else {
+                nd.values.insert(nd.values.begin() + _index(nd.data_map, bit), v);
+                nd.data_map |= bit;
+            }
+        }
+
+        // the value must be in the set, and the set must have other values
+        static void _erase(node_ptr &n, const T &v, const uint64_t hash, const size_t level)
+        {
+            auto &nd = _own(n);
+            if (level == max_level) {
+                nd.values.erase(std::lower_bound(nd.values.begin(), nd.values.end(), v));
+                return;
+            }
+            const auto bit = _bit(hash, level);
+            if (nd.data_map & bit) {
+                nd.values.erase(nd.values.begin() + _index(nd.data_map, bit));
+                nd.data_map ^= bit;
+                return;
+            }
+            const auto node_idx = _index(nd.node_map, bit);
+            auto &sub = nd.nodes[node_idx];
+            _erase(sub, v, hash, level + 1);
+            if (sub->nodes.empty() && sub->values.size() == 1) {
+                auto last = std::move(sub->values.front());
+                nd.nodes.erase(nd.nodes.begin() + node_idx);
+                nd.node_map ^= bit;
+                nd.values.insert(nd.values.begin() + _index(nd.data_map, bit), std::move(last));
+                nd.data_map |= bit;
+            }
+        }
+    };
+}
+
+#endif // !DAEDALUS_TURBO_PERSISTENT_SET_HPP
@@ -0,0 +1,110 @@
+/* This file is part of Daedalus Turbo project: https://github.com/sierkov/daedalus-turbo/
+ * Copyright (c) 2022-2023 Alex Sierkov (alex dot sierkov at gmail dot com)
+ * Copyright (c) 2024-2025 R2 Rationality OÜ (info at r2rationality dot com)
+ * This code is distributed under the license specified in:
+ * https://github.com/sierkov/daedalus-turbo/blob/main/LICENSE */
+
+#include <random>
+#include <dt/common/test.hpp>
+#include <dt/persistent-set.hpp>
+
+using namespace daedalus_turbo;
+
+namespace {
+    // keeps only a few bits of the value, so that many values share their full hash
+    struct weak_hash {
+        size_t operator()(const uint64_t v) const noexcept
+        {
+            return v & 0xFFF;
+        }
+    };
+
+    template<typename S>
+    std::set<uint64_t> to_set(const S &s)
+    {
+        std::set<uint64_t> res {};
+        for (const auto v: s)
+            res.emplace(v);
+        return res;
+    }
+}
+
+suite persistent_set_suite = [] {
+    "persistent_set"_test = [] {
+        "basic operations"_test = [] {
+            persistent_set<uint64_t> s {};
+            expect(s.empty());
+            expect(s.begin() == s.end());
+            expect(s.emplace(22));
+            expect(!s.emplace(22));
+            expect(s.emplace(33));
+            test_same(2, s.size());
+            expect(s.contains(22));
+            expect(!s.contains(44));
+            test_same(std::set<uint64_t> { 22, 33 }, to_set(s));
+            test_same(1, s.erase(22));
+            test_same(0, s.erase(22));
+            test_same(std::set<uint64_t> { 33 }, to_set(s));
+            s.clear();
+            expect(s.empty());
+        };
+        "matches std::set"_test = [] {
+            std::default_random_engine rnd { 12345 };
+            persistent_set<uint64_t> act {};
+            persistent_set<uint64_t, weak_hash> act_weak {};
+            std::set<uint64_t> exp {};
+            for (size_t i = 0; i < 100'000; ++i) {
+                const uint64_t v = rnd() % 20'000;
+                if (rnd() % 3 != 0) {
+                    test_same(exp.emplace(v).second, act.emplace(v));
+                    act_weak.emplace(v);
+                } else {
+                    test_same(exp.erase(v), act.erase(v));
+                    act_weak.erase(v);
+                }
+            }
+            test_same(exp.size(), act.size());
+            test_same(exp, to_set(act));
+            test_same(exp.size(), act_weak.size());
+            test_same(exp, to_set(act_weak));
+            for (uint64_t v = 0; v < 20'000; ++v) {
+                test_same(exp.contains(v), act.contains(v));
+                test_same(exp.contains(v), act_weak.contains(v));
+            }
+        };
+        "copies are independent"_test = [] {
+            persistent_set<uint64_t> s {};
+            for (uint64_t i = 0; i < 10'000; ++i)
+                s.emplace(i);
+            const auto copy = s;
+            expect(copy == s);
+            for (uint64_t i = 0; i < 10'000; i += 2)
+                s.erase(i);
+            s.emplace(10'000);
+            test_same(10'000, copy.size());
+            test_same(5'001, s.size());
+            expect(copy.contains(0));
+            expect(!copy.contains(10'000));
+            expect(!s.contains(0));
+            expect(!(copy == s));
+            auto copy2 = copy;
+            copy2.emplace(10'000);
+            test_same(10'001, copy2.size());
+            test_same(10'000, copy.size());
+        };
+        "canonical shape"_test = [] {
+            // the same contents reached in different ways serialize the same
+            persistent_set<uint64_t> a {}, b {};
+            for (uint64_t i = 0; i < 1'000; ++i)
+                a.emplace(i);
+            for (uint64_t i = 2'000; i > 0; --i)
+                b.emplace(i - 1);
+            for (uint64_t i = 1'000; i < 2'000; ++i)
+                b.erase(i);
+            expect(a == b);
+            test_same(daedalus_turbo::zpp::serialize(a), daedalus_turbo::zpp::serialize(b));
+            const auto c = daedalus_turbo::zpp::deserialize<persistent_set<uint64_t>>(daedalus_turbo::zpp::serialize(a));
+            expect(c == a);
+        };
+    };
+};
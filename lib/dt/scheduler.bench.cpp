@@ -77,6 +77,25 @@ suite scheduler_bench_suite = [] {
                 });
             }
         };
+        "worker scaling"_test = [] {
+            static constexpr size_t num_tasks = 200'000;
+            for (size_t num_workers = 1; num_workers <= std::max(scheduler::default_worker_count(), size_t { 1 }); num_workers *= 2) {
+                scheduler s { num_workers };
+                benchmark_r(fmt::format("small tasks - {} workers", s.num_workers()), 10'000.0, 3, [&]() {
+                    std::atomic_size_t total = 0;
+                    for (size_t i = 0; i < num_tasks; ++i) {
+                        s.submit_void("small", static_cast<int64_t>(i % 16), [&total, i] {
+                            uint64_t h = i;
+                            for (size_t j = 0; j < 256; ++j)
+                                h = h * 0x9E3779B97F4A7C15ULL + j;
+                            total.fetch_add(h & 1, std::memory_order_relaxed);
+                        });
+                    }
+                    expect(s.process_ok(false));
+                    return num_tasks;
+                });
+            }
+        };
         benchmark_r(fmt::format("empty_tasks"), 100'000.0, 3, [&]() {
             static constexpr size_t num_tasks = 100'000;
             for (size_t i = 0; i < num_tasks; ++i) {
@@ -86,5 +105,35 @@ suite scheduler_bench_suite = [] {
             expect(sched.process_ok());
             return num_tasks;
         });
+        "typed vs any results"_test = [&] {
+            static constexpr size_t num_tasks = 100'000;
+            benchmark_r("results - std::any", 100'000.0, 3, [&]() {
+                size_t sum = 0;
+                sched.on_result("any-results", [&](auto &&res) {
+                    sum += std::any_cast<size_t>(res);
+                });
+                for (size_t i = 0; i < num_tasks; ++i) {
+                    sched.submit("any-results", 0, [i] {
+                        return i;
+                    });
+                }
+                expect(sched.process_ok());
+                return num_tasks;
+            });
+            benchmark_r("results - typed", 100'000.0, 3, [&]() {
+                static const auto tg = scheduler::group_id("typed-results");
+                size_t sum = 0;
+                sched.on_result<size_t>(tg, [&](size_t &&res) {
+                    sum += res;
+                });
+                for (size_t i = 0; i < num_tasks; ++i) {
+                    sched.submit(tg, 0, [i] {
+                        return i;
+                    });
+                }
+                expect(sched.process_ok());
+                return num_tasks;
+            });
+        };
     };
 };
\ No newline at end of file
@@ -7,8 +7,9 @@
 #include <atomic>
 #include <condition_variable>
 #include <cstdlib>
+#include <deque>
+#include <limits>
 #include <list>
-#include <queue>
 #include <source_location>
 //#include <thread>
 #include <unordered_map>
@@ -37,14 +38,82 @@ namespace fmt {
 }
 
 namespace daedalus_turbo {
+    namespace {
+        struct task_group_registry {
+            task_group_id intern(const std::string_view name)
+            {
+                mutex::scoped_lock lk { _mutex };
+                if (const auto it = _ids.find(name); it != _ids.end())
+                    return it->second;
+                const auto id = static_cast<task_group_id>(_names.size());
+                // std::deque never relocates its elements, so the views used as keys stay valid
+                const auto &stored_name = _names.emplace_back(name);
+                _ids.emplace(stored_name, id);
+                return id;
+            }
+
+            const std::string &name(const task_group_id id) const
+            {
+                mutex::scoped_lock lk { _mutex };
+                if (id >= _names.size()) [[unlikely]]
+                    throw error(fmt::format("unknown task group id: {}", id));
+                return _names[id];
+            }
+        private:
+            mutable mutex::unique_lock::mutex_type _mutex alignas(mutex::alignment) {};
+            std::deque<std::string> _names {};
+            std::unordered_map<std::string_view, task_group_id> _ids {};
+        };
+
+        task_group_registry &registry()
+        {
+            static task_group_registry reg {};
+            return reg;
+        }
+
+        scheduled_observer any_observer(const std::function<void (std::any &&)> &observer)
+        {
+            return { typeid(std::any), [observer](void *res) {
+                observer(std::move(*static_cast<std::any *>(res)));
+            } };
+        }
+
+        scheduled_delivery any_delivery(std::any &&res)
+        {
+            return [res=std::move(res)](const scheduled_observer_list &observers) mutable {
+                for (const auto &o: observers) {
+                    if (o.type != typeid(std::any)) [[unlikely]]
+                        throw error(fmt::format("a std::any result cannot be passed to an observer of type {}", o.type.name()));
+                    o.action(&res);
+                }
+            };
+        }
+
+        scheduled_delivery error_delivery(std::any &&err)
+        {
+            // typed observers are not notified about failed tasks
+            return [err=std::move(err)](const scheduled_observer_list &observers) mutable {
+                for (const auto &o: observers) {
+                    if (o.type == typeid(std::any))
+                        o.action(&err);
+                }
+            };
+        }
+    }
+
     struct scheduler::impl {
         explicit impl(const size_t user_num_workers)
-            : _num_workers { _find_num_workers(user_num_workers) }
+            : _num_workers { _find_num_workers(user_num_workers) },
+              // also ensures that the task group registry outlives static scheduler instances
+              _wait_task_group { scheduler::group_id("__WAIT_FOR_TASKS__") },
+              _mem_budget { scheduler::default_memory_budget() }
         {
             if (_num_workers == 0)
                 throw error("the number of worker threads must be greater than zero!");
-            logger::info("scheduler started, worker count: {}", _num_workers);
-            _worker_tasks.resize(_num_workers);
+            logger::info("scheduler started, worker count: {} memory budget: {} MiB", _num_workers, _mem_budget >> 20);
+            _queues.reserve(_num_workers);
+            for (size_t i = 0; i < _num_workers; ++i)
+                _queues.emplace_back(std::make_unique<worker_queue>(i));
             map<boost::thread::id, size_t> ids {};
             // One worker is a special case handled by the process method itself
             if (_num_workers == 1) {
@@ -58,22 +127,43 @@ namespace daedalus_turbo {
                 }
             }
             _worker_ids = ids;
+            if (const char *trace_path = std::getenv("DT_TRACE"); trace_path != nullptr && *trace_path) {
+                _trace_path = trace_path;
+                trace_start(default_trace_capacity);
+            }
         }
 
         ~impl()
         {
             _destroy = true;
-            _tasks_cv.notify_all();
+            {
+                mutex::scoped_lock idle_lk { _idle_mutex };
+                _idle_cv.notify_all();
+            }
             _results_cv.notify_all();
             for (auto &w: _workers)
                 w.join();
             _workers.clear();
+            if (_trace_path) {
+                logger::run_log_errors([&] {
+                    trace_stop(*_trace_path);
+                });
+            }
+            {
+                auto &wait_stats = _stat(_wait_task_group);
+                for (const auto &q: _queues)
+                    wait_stats.cpu_time += q->wait_time;
+            }
 
-            logger::debug("scheduler's peak RAM use: {} MB", memory::max_usage_mb());
+            logger::debug("scheduler's peak RAM use: {} MB memory budget: {} MB", memory::max_usage_mb(), _mem_budget >> 20);
             logger::debug("scheduler's cumulative cpu utilization statistics by task group:");
-            task_stats_map grouped_stats {};
+            std::unordered_map<std::string, task_stat> grouped_stats {};
             double total_cpu_time = 0;
-            for (const auto &[task_name, stats]: _task_stats) {
+            for (task_group_id tg = 0; tg < _task_stats.size(); ++tg) {
+                const auto &stats = _task_stats[tg];
+                if (!stats.submitted && stats.cpu_time == 0.0)
+                    continue;
+                const auto &task_name = scheduler::group_name(tg);
                 const auto pos = task_name.find(':');
                 auto [it, created] = grouped_stats.try_emplace(std::string { pos == task_name.npos ? task_name : task_name.substr(0, pos) }, stats);
                 if (!created) {
@@ -98,7 +188,7 @@ namespace daedalus_turbo {
             return _num_workers;
         }
 
-        size_t num_observers(const std::string &task_group) const
+        size_t num_observers(const task_group_id task_group) const
         {
             mutex::scoped_lock ob_lk { _observers_mutex };
             const auto it = _observers.find(task_group);
@@ -112,82 +202,196 @@ namespace daedalus_turbo {
 
         size_t cancel(const cancel_predicate &pred)
         {
-            size_t num_cancelled = 0;
-            mutex::unique_lock tasks_lock { _tasks_mutex };
-            task_queue new_tasks {};
-            while (!_tasks.empty()) {
-                auto task = _tasks.top();
-                _tasks.pop();
-                if (pred(task.task_group, task.param)) {
-                    --_task_stats[task.task_group].queued;
-                    ++num_cancelled;
-                } else {
-                    new_tasks.emplace(std::move(task));
+            std::vector<task_group_id> cancelled {};
+            uint64_t admitted_cost = 0;
+            const auto match = [&](const queued_task &task) {
+                // the continuations of suspended coroutine tasks belong to already running tasks
+                if (!task.resumed && pred(scheduler::group_name(task.task_group), task.param)) {
+                    cancelled.emplace_back(task.task_group);
+                    if (task.mem_admitted)
+                        admitted_cost += task.mem_cost;
+                    return true;
+                }
+                return false;
+            };
+            for (auto &q: _queues) {
+                mutex::scoped_lock q_lk { q->tasks_mutex };
+                if (std::erase_if(q->tasks, match)) {
+                    std::make_heap(q->tasks.begin(), q->tasks.end());
+                    q->update_top_priority();
+                }
+            }
+            // the tasks waiting for memory are not included in _num_queued
+            _num_queued.fetch_sub(cancelled.size());
+            {
+                mutex::scoped_lock mem_lk { _mem_mutex };
+                if (std::erase_if(_mem_waiting, match))
+                    std::make_heap(_mem_waiting.begin(), _mem_waiting.end());
+            }
+            if (!cancelled.empty()) {
+                mutex::scoped_lock stats_lk { _stats_mutex };
+                for (const auto task_group: cancelled) {
+                    auto &stats = _stat(task_group);
+                    --stats.queued;
+                    if (!stats.background)
+                        _num_foreground.fetch_sub(1);
+                }
+                _num_pending.fetch_sub(cancelled.size());
+            }
+            if (admitted_cost)
+                _mem_release(admitted_cost);
+            return cancelled.size();
+        }
+
+        void submit(const task_group_id task_group, const int64_t priority, scheduled_action &&action, std::optional<std::any> &&param, const uint64_t mem_cost)
+        {
+            {
+                mutex::scoped_lock stats_lk { _stats_mutex };
+                auto &stats = _stat(task_group);
+                ++stats.submitted;
+                ++stats.queued;
+                if (!stats.background)
+                    _num_foreground.fetch_add(1);
+                _num_pending.fetch_add(1);
+            }
+            _enqueue(queued_task { priority, task_group, std::move(action), std::move(param), mem_cost, false, false, _trace_now() });
+        }
+
+        void trace_start(const size_t events_per_worker)
+        {
+            if (events_per_worker == 0)
+                throw error("the trace capacity must be greater than zero!");
+            _trace_on.store(false);
+            for (auto &q: _queues) {
+                mutex::scoped_lock q_lk { q->tasks_mutex };
+                q->trace.clear();
+                q->trace.reserve(events_per_worker);
+                q->trace_capacity = events_per_worker;
+                q->trace_next = 0;
+                q->trace_lost = 0;
+            }
+            _trace_base_ns.store(std::chrono::duration_cast<std::chrono::nanoseconds>(std::chrono::steady_clock::now().time_since_epoch()).count());
+            _trace_on.store(true);
+        }
+
+        void trace_stop(const std::string &path)
+        {
+            _trace_on.store(false);
+            std::string out {};
+            auto out_it = std::back_inserter(out);
+            out += "{\"displayTimeUnit\":\"ms\",\"traceEvents\":[";
+            struct group_time {
+                uint64_t wait_ns = 0;
+                uint64_t run_ns = 0;
+            };
+            std::map<std::string, group_time> group_times {};
+            size_t num_events = 0, num_lost = 0;
+            for (size_t w_idx = 0; w_idx < _queues.size(); ++w_idx) {
+                auto &q = *_queues[w_idx];
+                std::vector<trace_event> events {};
+                {
+                    mutex::scoped_lock q_lk { q.tasks_mutex };
+                    events = std::move(q.trace);
+                    q.trace.clear();
+                    num_lost += q.trace_lost;
+                }
+                fmt::format_to(out_it, "{}{{\"name\":\"thread_name\",\"ph\":\"M\",\"pid\":1,\"tid\":{},\"args\":{{\"name\":\"worker-{}\"}}}}",
+                    w_idx ? "," : "", w_idx, w_idx);
+                for (const auto &ev: events) {
+                    const auto &name = scheduler::group_name(ev.task_group);
+                    const auto wait_ns = ev.start_ns - std::min(ev.submit_ns, ev.start_ns);
+                    auto &gt = group_times[name.substr(0, name.find(':'))];
+                    gt.wait_ns += wait_ns;
+                    gt.run_ns += ev.end_ns - ev.start_ns;
+                    // Chrome trace timestamps are in microseconds
+                    fmt::format_to(out_it, ",{{\"name\":\"{}\",\"cat\":\"task\",\"ph\":\"X\",\"pid\":1,\"tid\":{},\"ts\":{:.3f},\"dur\":{:.3f},"
+                        "\"args\":{{\"priority\":{},\"submit_us\":{:.3f},\"queue_wait_us\":{:.3f}}}}}",
+                        _trace_escape(name), w_idx, ev.start_ns / 1e3, (ev.end_ns - ev.start_ns) / 1e3,
+                        ev.priority, ev.submit_ns / 1e3, wait_ns / 1e3);
+                    ++num_events;
                 }
             }
-            _tasks = std::move(new_tasks);
-            return num_cancelled;
+            out += "]}\n";
+            file::write(path, out);
+            logger::info("scheduler trace: {} task executions written to {}, {} overwritten in the ring buffers", num_events, path, num_lost);
+            for (const auto &[name, gt]: group_times)
+                logger::info("trace: task: {} queue wait: {:0.3f} sec run: {:0.3f} sec", name, gt.wait_ns / 1e9, gt.run_ns / 1e9);
+        }
+
+        void resume(const int64_t priority, const task_group_id task_group, scheduled_action &&action, const uint64_t mem_cost)
+        {
+            // the memory cost of a coroutine task has been admitted before its first step
+            _enqueue(queued_task { priority, task_group, std::move(action), {}, mem_cost, mem_cost != 0, true, _trace_now() });
+        }
+
+        uint64_t memory_budget() const
+        {
+            mutex::scoped_lock mem_lk { _mem_mutex };
+            return _mem_budget;
         }
 
-        void submit(const std::string &task_group, int64_t priority, const std::function<std::any ()> &action, std::optional<std::any> param={})
+        void memory_budget(const uint64_t num_bytes)
         {
-            mutex::unique_lock tasks_lock { _tasks_mutex };
-            _tasks.emplace(priority, task_group, action, std::move(param));
-            auto [ it, created ] = _task_stats.emplace(task_group, task_stat { 1, 1 });
-            if (!created) {
-                ++it->second.submitted;
-                ++it->second.queued;
+            {
+                mutex::scoped_lock mem_lk { _mem_mutex };
+                _mem_budget = num_bytes;
             }
-            tasks_lock.unlock();
-            _tasks_cv.notify_one();
+            // a bigger budget may let some of the waiting tasks in
+            _mem_release(0);
+        }
+
+        uint64_t memory_admitted() const
+        {
+            mutex::scoped_lock mem_lk { _mem_mutex };
+            return _mem_admitted;
         }
 
-        void on_result(const std::string &task_group, const std::function<void (std::any &&)> &observer, bool replace_if_exists=false)
+        void on_result(const task_group_id task_group, scheduled_observer &&observer, const bool replace_if_exists=false)
         {
             if (task_count(task_group) != 0)
-                throw error(fmt::format("observers for task '{}' must be configured before task submission!", task_group));
+                throw error(fmt::format("observers for task '{}' must be configured before task submission!", scheduler::group_name(task_group)));
+            // each observer reports its own errors so that a failing one does not prevent the others from being notified
+            observer.action = [action=std::move(observer.action)](void *res) {
+                logger::run_log_errors([&] {
+                    action(res);
+                });
+            };
             const mutex::scoped_lock lock { _observers_mutex };
-            auto [ it, created ] = _observers.emplace(task_group, 0);
+            auto [ it, created ] = _observers.try_emplace(task_group);
             if (!created && replace_if_exists)
                 it->second.clear();
-            it->second.emplace_front(observer);
+            it->second.emplace_front(std::move(observer));
         }
 
-        void on_completion(const std::string &task_group, size_t task_count, const std::function<void()> &action)
+        void on_completion(const task_group_id task_group, size_t task_count, const std::function<void()> &action)
         {
             mutex::scoped_lock lk { _completion_mutex };
             const auto [it, created] = _completion_actions.try_emplace(task_group, action, task_count);
             if (!created)
-                throw error(fmt::format("duplicate completion handler for {}", task_group));
+                throw error(fmt::format("duplicate completion handler for {}", scheduler::group_name(task_group)));
         }
 
-        void clear_observers(const std::string &task_group)
+        void clear_observers(const task_group_id task_group)
         {
             mutex::scoped_lock ob_lk { _observers_mutex };
             _observers.erase(task_group);
         }
 
-        size_t task_count(const std::string &task_group)
+        void set_background(const task_group_id task_group)
         {
-            size_t cnt = 0;
-            {
-                mutex::scoped_lock lock { _tasks_mutex };
-                auto it = _task_stats.find(task_group);
-                if (it != _task_stats.end())
-                    cnt = it->second.queued;
-            }
-            return cnt;
+            mutex::scoped_lock lock { _stats_mutex };
+            _stat(task_group).background = true;
+        }
+
+        size_t task_count(const task_group_id task_group)
+        {
+            mutex::scoped_lock lock { _stats_mutex };
+            return task_group < _task_stats.size() ? _task_stats[task_group].queued : 0;
         }
 
         size_t task_count()
         {
-            size_t cnt = 0;
-            {
-                mutex::scoped_lock lock{ _tasks_mutex };
-                for (const auto &[task_name, stats]: _task_stats)
-                    cnt += stats.queued;
-            }
-            return cnt;
+            return _num_pending.load();
         }
 
         bool process_ok(bool report_status=true, const std::source_location &loc=std::source_location::current())
@@ -226,6 +430,15 @@ namespace daedalus_turbo {
                 throw error("some scheduled tasks have failed, please consult logs for more details");
         }
 
+        bool execute_once(const std::chrono::milliseconds wait_interval)
+        {
+            const auto w_id = _get_worker_id();
+            if (!w_id)
+                return false;
+            _worker_try_execute(*w_id, wait_interval);
+            return true;
+        }
+
         void process_once(bool report_status=true)
         {
             // to ensure that result observers are always called from one thread
@@ -247,14 +460,14 @@ namespace daedalus_turbo {
                 const auto wait_start = std::chrono::system_clock::now();
                 auto next_warn = wait_start + report_period;
                 std::atomic_size_t done_parts = 0;
-                on_result(task_group, [&done_parts, &errors, process_res](auto &&res) {
+                on_result(scheduler::group_id(task_group), any_observer([&done_parts, &errors, process_res](auto &&res) {
                     ++done_parts;
                     if (res.type() != typeid(scheduled_task_error)) [[likely]] {
                         process_res(std::move(res), done_parts.load(), errors.load());
                     } else {
                         ++errors;
                     }
-                }, true);
+                }), true);
                 submit_tasks();
                 const auto process_results = !_process_running.load();
                 while (done_parts < task_count) {
@@ -287,43 +500,138 @@ namespace daedalus_turbo {
             size_t todo = 0;
             size_t done = 0;
         };
-        using task_queue = std::priority_queue<scheduled_task>;
+        struct queued_task {
+            int64_t priority;
+            task_group_id task_group;
+            scheduled_action action;
+            std::optional<std::any> param {};
+            uint64_t mem_cost = 0;
+            bool mem_admitted = false;
+            bool resumed = false;
+            // nanoseconds since the start of tracing, zero if tracing is off
+            uint64_t submit_ns = 0;
+
+            bool operator<(const queued_task &t) const noexcept
+            {
+                return priority < t.priority;
+            }
+        };
+        struct trace_event {
+            uint64_t submit_ns;
+            uint64_t start_ns;
+            uint64_t end_ns;
+            int64_t priority;
+            task_group_id task_group;
+        };
+
+        // a binary heap maintained with std::push_heap/pop_heap since std::priority_queue cannot release move-only items
+        using task_queue = std::vector<queued_task>;
+
+        struct queued_result {
+            int64_t priority;
+            task_group_id task_group;
+            scheduled_delivery delivery;
+            double cpu_time;
+
+            bool operator<(const queued_result &r) const noexcept
+            {
+                return priority < r.priority;
+            }
+        };
+
+        // Each worker owns a priority queue and takes tasks from it first. An idle worker steals
+        // from the queue with the highest-priority task so that the priority order holds globally.
+        struct worker_queue {
+            static constexpr int64_t no_priority = std::numeric_limits<int64_t>::min();
+
+            mutable mutex::unique_lock::mutex_type tasks_mutex alignas(mutex::alignment) {};
+            task_queue tasks {};
+            std::atomic<int64_t> top_priority { no_priority };
+            // a stack since a task can execute other tasks in the single-worker mode
+            std::vector<task_group_id> active_tasks {};
+            // a ring buffer of the completed tasks, filled only while tracing is on
+            std::vector<trace_event> trace {};
+            size_t trace_capacity = 0;
+            size_t trace_next = 0;
+            size_t trace_lost = 0;
+            // the fields below are accessed only by the owning worker
+            double wait_time = 0.0;
+            uint64_t victim_seed;
+
+            explicit worker_queue(const size_t worker_idx): victim_seed { worker_idx * 0x9E3779B97F4A7C15ULL + 1 }
+            {
+            }
+
+            // must be called with the mutex taken
+            void update_top_priority()
+            {
+                top_priority.store(tasks.empty() ? no_priority : tasks.front().priority, std::memory_order_relaxed);
+            }
+
+            size_t next_victim(const size_t num_workers)
+            {
+                // xorshift64 is enough to spread the probes evenly over the other queues
+                victim_seed ^= victim_seed << 13;
+                victim_seed ^= victim_seed >> 7;
+                victim_seed ^= victim_seed << 17;
+                return victim_seed % num_workers;
+            }
+        };
+        using worker_queue_list = std::vector<std::unique_ptr<worker_queue>>;
 
         struct task_stat {
             size_t submitted = 0;
             size_t queued = 0;
             size_t completed = 0;
             double cpu_time = 0.0;
+            bool background = false;
         };
-        using task_stats_map = std::unordered_map<std::string, task_stat>;
+        using task_stats_list = std::vector<task_stat>;
 
-        mutable mutex::unique_lock::mutex_type _tasks_mutex alignas(mutex::alignment) {};
-        std::condition_variable_any _tasks_cv alignas(mutex::alignment) {};
-        task_queue _tasks {};
-        task_stats_map _task_stats {};
+        worker_queue_list _queues {};
+        std::atomic_size_t _num_queued alignas(mutex::alignment) { 0 };
+        std::atomic_size_t _next_queue alignas(mutex::alignment) { 0 };
+        mutable mutex::unique_lock::mutex_type _idle_mutex alignas(mutex::alignment) {};
+        std::condition_variable_any _idle_cv alignas(mutex::alignment) {};
+        std::atomic_size_t _num_idle { 0 };
 
-        using observer_list = std::list<std::function<void (std::any &&)>>;
-        using observer_map = std::unordered_map<std::string, observer_list>;
+        // tasks with a memory cost that does not fit into the budget wait here, ordered like the worker queues
+        mutable mutex::unique_lock::mutex_type _mem_mutex alignas(mutex::alignment) {};
+        task_queue _mem_waiting {};
+        uint64_t _mem_admitted = 0;
+
+        mutable mutex::unique_lock::mutex_type _stats_mutex alignas(mutex::alignment) {};
+        task_stats_list _task_stats {};
+        std::atomic_size_t _num_pending alignas(mutex::alignment) { 0 };
+        // the pending tasks of the groups that are not in the background; process() waits only for them
+        std::atomic_size_t _num_foreground alignas(mutex::alignment) { 0 };
+
+        using observer_map = std::unordered_map<task_group_id, scheduled_observer_list>;
         mutable mutex::unique_lock::mutex_type _observers_mutex alignas(mutex::alignment) {};
         observer_map _observers {};
 
         mutex::unique_lock::mutex_type _results_mutex alignas(mutex::alignment) {};
         std::condition_variable_any _results_cv alignas(mutex::alignment) {};
-        std::priority_queue<scheduled_result> _results {};
+        std::vector<queued_result> _results {};
         std::atomic_bool _results_processed = false;
 
         mutex::unique_lock::mutex_type _completion_mutex alignas(mutex::alignment) {};
-        std::map<std::string, completion_action> _completion_actions {};
+        std::unordered_map<task_group_id, completion_action> _completion_actions {};
 
         std::vector<boost::thread> _workers {};
         static_map<boost::thread::id, size_t> _worker_ids {};
-        std::vector<std::optional<std::string>> _worker_tasks {};
         const size_t _num_workers;
+        const task_group_id _wait_task_group;
+        uint64_t _mem_budget;
         std::atomic_size_t _num_active = 0;
         std::atomic_bool _destroy { false };
         std::atomic_bool _success { true };
         std::atomic_bool _process_running { false };
         std::atomic_bool _wait_all_done_running { false };
+        std::atomic_bool _trace_on { false };
+        // an atomic, since the workers that have seen tracing on may still read it while trace_start resets it
+        std::atomic<int64_t> _trace_base_ns { 0 };
+        std::optional<std::string> _trace_path {};
         std::atomic<std::chrono::time_point<std::chrono::system_clock>> _report_next_time { std::chrono::system_clock::now() + default_update_interval };
 
         static size_t _find_num_workers(size_t user_num_workers)
@@ -337,6 +645,53 @@ namespace daedalus_turbo {
             return user_num_workers;
         }
 
+        // must be called with _stats_mutex taken
+        bool _background(const task_group_id task_group)
+        {
+            mutex::scoped_lock stats_lk { _stats_mutex };
+            return _stat(task_group).background;
+        }
+
+        task_stat &_stat(const task_group_id task_group)
+        {
+            if (task_group >= _task_stats.size()) [[unlikely]]
+                _task_stats.resize(task_group + 1);
+            return _task_stats[task_group];
+        }
+
+        uint64_t _trace_now() const
+        {
+            if (!_trace_on.load())
+                return 0;
+            // never zero, since zero marks the tasks submitted before tracing has been turned on
+            const auto now_ns = std::chrono::duration_cast<std::chrono::nanoseconds>(std::chrono::steady_clock::now().time_since_epoch()).count();
+            return static_cast<uint64_t>(std::max(now_ns - _trace_base_ns.load(), int64_t { 0 })) + 1;
+        }
+
+        // must be called with the worker queue's mutex taken
+        void _trace_record(worker_queue &q, trace_event &&ev)
+        {
+            if (q.trace.size() < q.trace_capacity) {
+                q.trace.emplace_back(std::move(ev));
+            } else {
+                q.trace[q.trace_next] = std::move(ev);
+                q.trace_next = (q.trace_next + 1) % q.trace_capacity;
+                ++q.trace_lost;
+            }
+        }
+
+        static std::string _trace_escape(const std::string &name)
+        {
+            std::string res {};
+            for (const auto c: name) {
+                if (c == '"' || c == '\\')
+                    res += '\\';
+                if (static_cast<unsigned char>(c) >= 0x20)
+                    res += c;
+            }
+            return res;
+        }
+
         std::optional<size_t> _get_worker_id() const
         {
             const auto w_it = _worker_ids.find(boost::this_thread::get_id());
@@ -352,18 +707,29 @@ namespace daedalus_turbo {
             if (now >= prev_next_time) {
                 const auto next_next_time = now + default_update_interval;
                 if (_report_next_time.compare_exchange_strong(prev_next_time, next_next_time)) {
-                    size_t num_tasks = 0;
+                    const size_t num_tasks = _num_pending.load();
                     std::map<std::string, size_t> active_tasks {};
-                    {
-                        mutex::scoped_lock tasks_lk { _tasks_mutex };
-                        for (const auto &[task_name, stats]: _task_stats)
-                            num_tasks += stats.queued;
-                        for (const auto &task_name: _worker_tasks) {
-                            if (task_name)
-                                ++active_tasks[*task_name];
+                    for (const auto &q: _queues) {
+                        std::string task_name {};
+                        {
+                            mutex::scoped_lock q_lk { q->tasks_mutex };
+                            for (const auto tg: q->active_tasks) {
+                                if (!task_name.empty())
+                                    task_name += '/';
+                                task_name += scheduler::group_name(tg);
+                            }
                         }
+                        if (!task_name.empty())
+                            ++active_tasks[task_name];
+                    }
+                    uint64_t mem_admitted, mem_waiting;
+                    {
+                        mutex::scoped_lock mem_lk { _mem_mutex };
+                        mem_admitted = _mem_admitted;
+                        mem_waiting = _mem_waiting.size();
                     }
-                    logger::debug("scheduler tasks total: {} active: {}", num_tasks, active_tasks);
+                    logger::debug("scheduler tasks total: {} active: {} memory admitted: {} MiB waiting for memory: {}",
+                        num_tasks, active_tasks, mem_admitted >> 20, mem_waiting);
                     progress::get().inform();
                 }
             }
@@ -377,21 +743,24 @@ namespace daedalus_turbo {
             if (_results_processed.compare_exchange_strong(must_be_false, true)) {
                 try {
                     while (!_results.empty()) {
-                        std::optional<std::string> completion_task_group {};
+                        std::optional<task_group_id> completion_task_group {};
                         // ensure that the result object is destroyed before completion actions are called
                         {
-                            auto res = _results.top();
-                            _results.pop();
+                            std::pop_heap(_results.begin(), _results.end());
+                            auto res = std::move(_results.back());
+                            _results.pop_back();
                             results_lock.unlock();
                             completion_task_group = res.task_group;
+                            bool background = false;
                             {
-                                mutex::scoped_lock tasks_lock { _tasks_mutex };
-                                auto it = _task_stats.find(res.task_group);
-                                if (it == _task_stats.end())
-                                    throw error(fmt::format("internal error: unknown task: {}", res.task_group));
-                                --it->second.queued;
-                                ++it->second.completed;
-                                it->second.cpu_time += res.cpu_time;
+                                mutex::scoped_lock stats_lk { _stats_mutex };
+                                if (res.task_group >= _task_stats.size())
+                                    throw error(fmt::format("internal error: unknown task: {}", scheduler::group_name(res.task_group)));
+                                auto &stats = _task_stats[res.task_group];
+                                --stats.queued;
+                                ++stats.completed;
+                                stats.cpu_time += res.cpu_time;
+                                background = stats.background;
                             }
                             {
                                 mutex::unique_lock observers_lock { _observers_mutex };
@@ -399,13 +768,14 @@ namespace daedalus_turbo {
                                 if (it != _observers.end()) {
                                     observers_lock.unlock();
                                     // assumes that the observer list for a task group is configured before task submission
-                                    for (const auto &observer: it->second) {
-                                        logger::run_log_errors([&] {
-                                            observer(std::move(res.result));
-                                        });
-                                    }
+                                    logger::run_log_errors([&] {
+                                        res.delivery(it->second);
+                                    });
                                 }
                             }
+                            if (!background)
+                                _num_foreground.fetch_sub(1);
+                            _num_pending.fetch_sub(1);
                         }
                         {
                             if (!completion_task_group)
@@ -436,66 +806,213 @@ namespace daedalus_turbo {
             }
         }
 
-        void _add_result(int64_t priority, const std::string &task_group, std::any &&res, double cpu_time)
+        void _add_result(const int64_t priority, const task_group_id task_group, scheduled_delivery &&delivery, const double cpu_time)
         {
             mutex::unique_lock results_lock { _results_mutex };
-            _results.emplace(priority, task_group, res, cpu_time);
+            _results.emplace_back(priority, task_group, std::move(delivery), cpu_time);
+            std::push_heap(_results.begin(), _results.end());
             results_lock.unlock();
             _results_cv.notify_one();
         }
 
-        bool _worker_try_execute(size_t worker_idx, const std::optional<std::chrono::milliseconds> wait_interval_ms)
+        void _wake_idle_worker()
+        {
+            // _num_queued is incremented before _num_idle is checked, and a worker increments _num_idle before it rechecks
+            // _num_queued, so at least one side always sees the other and no wake-up can be lost
+            if (_num_idle.load() > 0) {
+                mutex::scoped_lock idle_lk { _idle_mutex };
+                _idle_cv.notify_one();
+            }
+        }
+
+        void _enqueue(queued_task &&task)
+        {
+            // tasks submitted by a worker stay in its own queue to keep the data they need in its cache
+            // all other submissions are spread round-robin so that no single queue becomes a hot spot
+            const auto w_id = _get_worker_id();
+            auto &q = *_queues[w_id ? *w_id : _next_queue.fetch_add(1, std::memory_order_relaxed) % _num_workers];
+            {
+                mutex::scoped_lock q_lk { q.tasks_mutex };
+                q.tasks.emplace_back(std::move(task));
+                std::push_heap(q.tasks.begin(), q.tasks.end());
+                q.update_top_priority();
+            }
+            _num_queued.fetch_add(1);
+            _wake_idle_worker();
+        }
+
+        // must be called with _mem_mutex taken
+        bool _mem_fits(const uint64_t mem_cost) const
+        {
+            // a task is always admitted when nothing else is, so that a task bigger than the budget still runs
+            return _mem_admitted == 0 || _mem_admitted + mem_cost <= _mem_budget;
+        }
+
+        // Either charges the task's cost to the budget or moves the task to the waiting list.
+        bool _mem_admit(std::optional<queued_task> &task)
+        {
+            mutex::scoped_lock mem_lk { _mem_mutex };
+            // a task may not overtake the waiting ones of the same or higher priority, otherwise big tasks would starve
+            if ((_mem_waiting.empty() || _mem_waiting.front().priority < task->priority) && _mem_fits(task->mem_cost)) {
+                _mem_admitted += task->mem_cost;
+                task->mem_admitted = true;
+                return true;
+            }
+            _mem_waiting.emplace_back(std::move(*task));
+            std::push_heap(_mem_waiting.begin(), _mem_waiting.end());
+            task.reset();
+            return false;
+        }
+
+        void _mem_release(const uint64_t mem_cost)
+        {
+            std::vector<queued_task> admitted {};
+            {
+                mutex::scoped_lock mem_lk { _mem_mutex };
+                _mem_admitted -= mem_cost;
+                while (!_mem_waiting.empty() && _mem_fits(_mem_waiting.front().mem_cost)) {
+                    std::pop_heap(_mem_waiting.begin(), _mem_waiting.end());
+                    auto &task = admitted.emplace_back(std::move(_mem_waiting.back()));
+                    _mem_waiting.pop_back();
+                    _mem_admitted += task.mem_cost;
+                    task.mem_admitted = true;
+                }
+            }
+            for (auto &task: admitted)
+                _enqueue(std::move(task));
+        }
+
+        std::optional<queued_task> _try_pop(worker_queue &q)
         {
-            static std::string wait_task_name { "__WAIT_FOR_TASKS__" };
+            mutex::scoped_lock q_lk { q.tasks_mutex };
+            if (q.tasks.empty())
+                return {};
+            std::pop_heap(q.tasks.begin(), q.tasks.end());
+            std::optional<queued_task> task { std::move(q.tasks.back()) };
+            q.tasks.pop_back();
+            q.update_top_priority();
+            _num_queued.fetch_sub(1);
+            return task;
+        }
+
+        std::optional<queued_task> _pop_task(const size_t worker_idx)
+        {
+            auto &own = *_queues[worker_idx];
+            while (_num_queued.load() > 0) {
+                // compare the own queue against a random one, so a higher-priority task waiting elsewhere is not starved
+                auto *best = &own;
+                auto best_prio = own.top_priority.load(std::memory_order_relaxed);
+                if (_num_workers > 1) {
+                    auto &other = *_queues[own.next_victim(_num_workers)];
+                    if (const auto prio = other.top_priority.load(std::memory_order_relaxed); prio > best_prio) {
+                        best = &other;
+                        best_prio = prio;
+                    }
+                }
+                // the own queue is empty and the random probe missed, so scan all queues
+                if (best_prio == worker_queue::no_priority) {
+                    for (size_t i = 1; i < _num_workers; ++i) {
+                        auto &other = *_queues[(worker_idx + i) % _num_workers];
+                        if (const auto prio = other.top_priority.load(std::memory_order_relaxed); prio > best_prio) {
+                            best = &other;
+                            best_prio = prio;
+                        }
+                    }
+                }
+                if (best_prio == worker_queue::no_priority)
+                    break;
+                if (auto task = _try_pop(*best); task)
+                    return task;
+                // another worker has been faster, try again
+            }
+            return {};
+        }
+
+        std::optional<queued_task> _wait_for_task(const size_t worker_idx, const std::chrono::milliseconds wait_interval)
+        {
+            if (auto task = _pop_task(worker_idx); task)
+                return task;
+            auto &own = *_queues[worker_idx];
             const auto sleep_start_time = std::chrono::system_clock::now();
-            mutex::unique_lock lock { _tasks_mutex };
-            _tasks_cv.wait_for(lock, *wait_interval_ms, [&] {
-                return !_tasks.empty() || _destroy;
-            });
-            _task_stats[wait_task_name].cpu_time += std::chrono::duration<double> { std::chrono::system_clock::now() - sleep_start_time }.count();
+            {
+                mutex::unique_lock idle_lk { _idle_mutex };
+                ++_num_idle;
+                _idle_cv.wait_for(idle_lk, wait_interval, [&] {
+                    return _num_queued.load() > 0 || _destroy;
+                });
+                --_num_idle;
+            }
+            own.wait_time += std::chrono::duration<double> { std::chrono::system_clock::now() - sleep_start_time }.count();
+            if (_destroy)
+                return {};
+            return _pop_task(worker_idx);
+        }
+
+        bool _worker_try_execute(size_t worker_idx, const std::optional<std::chrono::milliseconds> wait_interval_ms)
+        {
+            auto task = _wait_for_task(worker_idx, *wait_interval_ms);
             if (_destroy)
                 return false;
-            if (!_tasks.empty()) {
-                auto &worker_task = _worker_tasks[worker_idx];
-                const auto prev_task = worker_task;
-                if (!prev_task)
+            if (task && task->mem_cost && !task->mem_admitted && !_mem_admit(task))
+                return true;
+            if (task) {
+                auto &q = *_queues[worker_idx];
+                bool nested = false;
+                {
+                    mutex::scoped_lock q_lk { q.tasks_mutex };
+                    nested = !q.active_tasks.empty();
+                    q.active_tasks.emplace_back(task->task_group);
+                }
+                if (!nested)
                     ++_num_active;
-                std::any task_res {};
+                const auto trace_submit_ns = task->submit_ns;
+                const auto trace_start_ns = _trace_now();
+                scheduled_delivery delivery {};
                 // need to create copies since the task will be destroyed before reporting its result.
-                std::optional<int64_t> res_prio {};
-                std::optional<std::string> res_task_group {};
+                const auto res_prio = task->priority;
+                const auto res_task_group = task->task_group;
+                const auto mem_cost = task->mem_cost;
                 const auto start_time = std::chrono::system_clock::now();
                 // ensure that the task instance is destroyed before its results are reported
                 {
-                    auto task = _tasks.top();
-                    _tasks.pop();
-                    if (prev_task)
-                        worker_task = fmt::format("{}/{}", *prev_task, task.task_group);
-                    else
-                        worker_task = task.task_group;
-                    lock.unlock();
-                    res_prio = task.priority;
-                    res_task_group = task.task_group;
                     try {
-                        task_res = task.task();
+                        delivery = task->action();
                     } catch (const std::exception &ex) {
-                        _success = false;
-                        logger::warn("worker-{} task {} std::exception: {}", worker_idx, task.task_group, ex.what());
-                        task_res = std::make_any<scheduled_task_error>(std::source_location::current(), std::move(task), "task: '{}' error: '{}' of type: '{}'!", task.task_group, ex.what(), typeid(ex).name());
+                        if (!_background(res_task_group))
+                            _success = false;
+                        const auto &task_name = scheduler::group_name(res_task_group);
+                        logger::warn("worker-{} task {} std::exception: {}", worker_idx, task_name, ex.what());
+                        delivery = error_delivery(std::make_any<scheduled_task_error>(std::source_location::current(),
+                            scheduled_task { res_prio, task_name, {}, std::move(task->param) },
+                            "task: '{}' error: '{}' of type: '{}'!", task_name, ex.what(), typeid(ex).name()));
                     } catch (...) {
-                        _success = false;
-                        logger::warn("worker-{} task {} unknown exception", worker_idx, task.task_group);
-                        task_res = std::make_any<scheduled_task_error>(std::source_location::current(), std::move(task), "task: '{}' unknown exception", task.task_group);
+                        if (!_background(res_task_group))
+                            _success = false;
+                        const auto &task_name = scheduler::group_name(res_task_group);
+                        logger::warn("worker-{} task {} unknown exception", worker_idx, task_name);
+                        delivery = error_delivery(std::make_any<scheduled_task_error>(std::source_location::current(),
+                            scheduled_task { res_prio, task_name, {}, std::move(task->param) },
+                            "task: '{}' unknown exception", task_name));
                     }
+                    task.reset();
                 }
                 const auto cpu_time = std::chrono::duration<double> { std::chrono::system_clock::now() - start_time }.count();
-                lock.lock();
-                worker_task = prev_task;
-                lock.unlock();
-                if (!(res_prio && res_task_group))
-                    throw scheduler_error("internal error: result priority or task group are not defined!");
-                _add_result(*res_prio, *res_task_group, std::move(task_res), cpu_time);
-                if (!prev_task)
+                {
+                    mutex::scoped_lock q_lk { q.tasks_mutex };
+                    q.active_tasks.pop_back();
+                    if (trace_start_ns)
+                        _trace_record(q, trace_event { trace_submit_ns, trace_start_ns, _trace_now(), res_prio, res_task_group });
+                }
+                if (delivery) {
+                    if (mem_cost)
+                        _mem_release(mem_cost);
+                    _add_result(res_prio, res_task_group, std::move(delivery), cpu_time);
+                } else {
+                    // a suspended coroutine task: its result and memory release come with its last step
+                    mutex::scoped_lock stats_lk { _stats_mutex };
+                    _stat(res_task_group).cpu_time += cpu_time;
+                }
+                if (!nested)
                     --_num_active;
             }
             return true;
@@ -534,11 +1051,7 @@ namespace daedalus_turbo {
             for (;;) {
                 {
                     mutex::scoped_lock results_lk { _results_mutex };
-                    mutex::scoped_lock tasks_lk { _tasks_mutex };
-                    size_t num_tasks = 0;
-                    for (const auto &[task_name, stats]: _task_stats)
-                        num_tasks += stats.queued;
-                    if (num_tasks == 0 && _results.empty() && !_results_processed.load())
+                    if (_num_foreground.load() == 0 && _results.empty() && !_results_processed.load())
                         break;
                 }
                 _process_once(report_status, _num_workers == 1, true);
@@ -555,6 +1068,16 @@ namespace daedalus_turbo {
 
     scheduler::~scheduler() =default;
 
+    task_group_id scheduler::group_id(const std::string_view name)
+    {
+        return registry().intern(name);
+    }
+
+    const std::string &scheduler::group_name(const task_group_id id)
+    {
+        return registry().name(id);
+    }
+
     size_t scheduler::num_workers() const
     {
         return _impl->num_workers();
@@ -562,7 +1085,7 @@ namespace daedalus_turbo {
 
     size_t scheduler::num_observers(const std::string &task_group) const
     {
-        return _impl->num_observers(task_group);
+        return _impl->num_observers(group_id(task_group));
     }
 
     size_t scheduler::active_workers() const
@@ -575,39 +1098,61 @@ namespace daedalus_turbo {
         return _impl->cancel(pred);
     }
 
-    void scheduler::submit(const std::string &task_group, int64_t priority, const std::function<std::any ()> &action, std::optional<std::any> param)
+    uint64_t scheduler::default_memory_budget()
+    {
+        if (const char *env_budget_str = std::getenv("DT_RAM_BUDGET_MB"); env_budget_str != nullptr) {
+            if (const uint64_t env_budget = std::stoull(env_budget_str); env_budget != 0)
+                return env_budget << 20;
+        }
+        return (static_cast<uint64_t>(memory::physical_mb()) * 3 / 4) << 20;
+    }
+
+    void scheduler::submit(const std::string &task_group, int64_t priority, const std::function<std::any ()> &action, std::optional<std::any> param, const uint64_t mem_cost)
     {
-        _impl->submit(task_group, priority, action, param);
+        _submit(group_id(task_group), priority, [action]() -> scheduled_delivery {
+            return any_delivery(action());
+        }, std::move(param), mem_cost);
     }
 
-    void scheduler::submit_void(const std::string &task_group, int64_t priority, const std::function<void ()> &action, std::optional<std::any> param)
+    void scheduler::submit_void(const std::string &task_group, int64_t priority, const std::function<void ()> &action, std::optional<std::any> param, const uint64_t mem_cost)
     {
-        submit(
-                task_group, priority,
-                [action] {
-                    action();
-                    return true;
-                },
-                std::move(param)
-        );
+        _submit(group_id(task_group), priority, [action]() -> scheduled_delivery {
+            action();
+            return &_deliver_void;
+        }, std::move(param), mem_cost);
     }
 
     void scheduler::on_result(const std::string &task_group, const std::function<void (std::any &&)> &observer, bool replace_if_exists)
     {
-        _impl->on_result(task_group, observer, replace_if_exists);
+        _on_result(group_id(task_group), any_observer(observer), replace_if_exists);
     }
 
     void scheduler::on_completion(const std::string &task_group, size_t task_count, const std::function<void()> &action)
+    {
+        _impl->on_completion(group_id(task_group), task_count, action);
+    }
+
+    void scheduler::on_completion(const task_group_id task_group, const size_t task_count, const std::function<void()> &action)
     {
         _impl->on_completion(task_group, task_count, action);
     }
 
     void scheduler::clear_observers(const std::string &task_group)
     {
-        _impl->clear_observers(task_group);
+        _impl->clear_observers(group_id(task_group));
+    }
+
+    void scheduler::set_background(const task_group_id task_group)
+    {
+        _impl->set_background(task_group);
     }
 
     size_t scheduler::task_count(const std::string &task_group)
+    {
+        return _impl->task_count(group_id(task_group));
+    }
+
+    size_t scheduler::task_count(const task_group_id task_group)
     {
         return _impl->task_count(task_group);
     }
@@ -627,6 +1172,11 @@ namespace daedalus_turbo {
         _impl->process(report_status, loc);
     }
 
+    bool scheduler::execute_once(const std::chrono::milliseconds wait_interval)
+    {
+        return _impl->execute_once(wait_interval);
+    }
+
     void scheduler::process_once(const bool report_status)
     {
         _impl->process_once(report_status);
@@ -637,4 +1187,93 @@ namespace daedalus_turbo {
     {
         return _impl->wait_all_done(task_group, task_count, submit_tasks, process_res);
     }
-}
\ No newline at end of file
+
+    void scheduler::trace_start(const size_t events_per_worker)
+    {
+        _impl->trace_start(events_per_worker);
+    }
+
+    void scheduler::trace_stop(const std::string &path)
+    {
+        _impl->trace_stop(path);
+    }
+
+    void scheduler::_deliver_void(const scheduled_observer_list &observers)
+    {
+        for (const auto &o: observers) {
+            if (o.type != typeid(std::any)) [[unlikely]]
+                throw error(fmt::format("a void result cannot be passed to an observer of type {}", o.type.name()));
+            // submit_void has always reported true to its std::any observers
+            std::any res { true };
+            o.action(&res);
+        }
+    }
+
+    uint64_t scheduler::memory_budget() const
+    {
+        return _impl->memory_budget();
+    }
+
+    void scheduler::memory_budget(const uint64_t num_bytes)
+    {
+        _impl->memory_budget(num_bytes);
+    }
+
+    uint64_t scheduler::memory_admitted() const
+    {
+        return _impl->memory_admitted();
+    }
+
+    struct scheduler::coro_step {
+        std::coroutine_handle<> suspended {};
+        coro_start start {};
+    };
+
+    scheduler::coro_step *&scheduler::_coro_current()
+    {
+        // a stack of steps, since a worker can execute other tasks from within a task in the single-worker mode
+        static thread_local coro_step *current = nullptr;
+        return current;
+    }
+
+    void scheduler::_coro_suspend(const std::coroutine_handle<> h, coro_start &&start)
+    {
+        auto *step = _coro_current();
+        if (!step) [[unlikely]]
+            throw error("scheduled_event can be awaited only by coroutine tasks submitted with scheduler::submit_coro");
+        step->suspended = h;
+        step->start = std::move(start);
+    }
+
+    scheduled_delivery scheduler::_coro_step(const std::shared_ptr<coro_root> &root, const std::coroutine_handle<> h)
+    {
+        coro_step step {};
+        auto &current = _coro_current();
+        auto *prev = std::exchange(current, &step);
+        h.resume();
+        current = prev;
+        if (step.start) {
+            // the awaited operation is started only now, since once it completes, another worker may continue
+            // the coroutine and this thread must no longer touch the coroutine frame
+            step.start([this, root, h=step.suspended] {
+                _impl->resume(root->priority, root->task_group, [this, root, h]() -> scheduled_delivery {
+                    return _coro_step(root, h);
+                }, root->mem_cost);
+            });
+            return {};
+        }
+        if (!root->done()) [[unlikely]]
+            throw error(fmt::format("coroutine task {} has suspended on an awaitable other than scheduled_event", group_name(root->task_group)));
+        return root->finish();
+    }
+
+    void scheduler::_submit(const task_group_id task_group, const int64_t priority, scheduled_action &&action, std::optional<std::any> param, const uint64_t mem_cost)
+    {
+        _impl->submit(task_group, priority, std::move(action), std::move(param), mem_cost);
+    }
+
+    void scheduler::_on_result(const task_group_id task_group, scheduled_observer &&observer, const bool replace_if_exists)
+    {
+        _impl->on_result(task_group, std::move(observer), replace_if_exists);
+    }
+}
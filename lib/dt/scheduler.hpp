@@ -8,12 +8,21 @@
 
 #include <any>
 #include <chrono>
+#include <coroutine>
 #include <functional>
+#include <list>
+#include <typeindex>
+#include <variant>
+#include <dt/common/coro.hpp>
 #include <dt/common/format.hpp>
+#include <dt/common/small-function.hpp>
 
 namespace daedalus_turbo {
     typedef fmt_error scheduler_error;
 
+    // An interned task group name. Ids are process-wide and never reused, so callers can cache them in static variables.
+    using task_group_id = uint32_t;
+
     struct scheduled_task {
         int64_t priority;
         std::string task_group;
@@ -46,43 +55,50 @@ namespace daedalus_turbo {
         scheduled_task _task;
     };
 
-    struct scheduled_result {
-        int64_t priority = 0;
-        std::string task_group {};
-        std::any result {};
-        double cpu_time = 0.0;
-
-        bool operator<(const scheduled_result &r) const noexcept
-        {
-            return priority < r.priority;
-        }
+    struct scheduled_observer {
+        std::type_index type;
+        std::function<void (void *)> action;
     };
+    using scheduled_observer_list = std::list<scheduled_observer>;
+    // Delivers a task's result to the observers of its group. Created by a worker and called by the result-processing thread.
+    // An empty delivery means that a coroutine task has been suspended and will report its result later.
+    using scheduled_delivery = small_function<void (const scheduled_observer_list &), 32>;
+    using scheduled_action = small_function<scheduled_delivery (), 64>;
 
     struct scheduler {
         using cancel_predicate = std::function<bool(const std::string &, const std::optional<std::any> &param)>;
 
         static constexpr std::chrono::milliseconds default_wait_interval { 10 };
         static constexpr std::chrono::milliseconds default_update_interval { 5000 };
+        static constexpr size_t default_trace_capacity = 1 << 16;
 
         static size_t default_worker_count()
         {
             return std::thread::hardware_concurrency();
         }
 
+        // Three quarters of the physical RAM unless overridden with the DT_RAM_BUDGET_MB environment variable.
+        static uint64_t default_memory_budget();
+
         static scheduler &get()
         {
             static scheduler sched {};
             return sched;
         }
 
+        static task_group_id group_id(std::string_view name);
+        static const std::string &group_name(task_group_id id);
+
         explicit scheduler(size_t user_num_workers=scheduler::default_worker_count());
         ~scheduler();
         size_t num_workers() const;
         size_t num_observers(const std::string &task_group) const;
         size_t active_workers() const;
         size_t cancel(const cancel_predicate &pred);
-        void submit(const std::string &task_group, int64_t priority, const std::function<std::any ()> &action, std::optional<std::any> param={});
-        void submit_void(const std::string &task_group, int64_t priority, const std::function<void ()> &action, std::optional<std::any> param={});
+        // mem_cost is the estimated peak number of bytes a task needs. Tasks with a non-zero cost are started only while
+        // the total cost of the running ones fits into the memory budget, so a task with a cost must not wait for other such tasks.
+        void submit(const std::string &task_group, int64_t priority, const std::function<std::any ()> &action, std::optional<std::any> param={}, uint64_t mem_cost=0);
+        void submit_void(const std::string &task_group, int64_t priority, const std::function<void ()> &action, std::optional<std::any> param={}, uint64_t mem_cost=0);
         void on_result(const std::string &task_group, const std::function<void (std::any &&)> &observer, bool replace_if_exists=false);
         void on_completion(const std::string &task_group, size_t task_count, const std::function<void()> &action);
         void clear_observers(const std::string &task_group);
@@ -91,11 +107,210 @@ namespace daedalus_turbo {
         bool process_ok(bool report_status=true, const std::source_location &loc=std::source_location::current());
         void process(bool report_status=true, const std::source_location &loc=std::source_location::current());
         void process_once(bool report_statues=true);
+        // When called from a worker thread, executes the next queued task, if any, in the calling thread,
+        // so that a task waiting for other tasks can help with them. Returns false outside of the worker pool.
+        bool execute_once(std::chrono::milliseconds wait_interval=default_wait_interval);
         void wait_all_done(const std::string &task_group, size_t task_count,
             const std::function<void ()> &submit_tasks, const std::function<void (std::any &&, size_t, size_t)> &process_res=[](auto &&, auto, auto) {});
+
+        // The typed path: no string hashing, no std::function and no std::any as long as the action fits
+        // into scheduled_action's inline buffer and its result fits into scheduled_delivery's.
+        // Failed tasks are reported only to std::any observers as scheduled_task_error.
+        template<typename F>
+        void submit(const task_group_id task_group, const int64_t priority, F &&action, const uint64_t mem_cost=0)
+        {
+            using result_type = std::invoke_result_t<std::decay_t<F> &>;
+            _submit(task_group, priority, [action=std::forward<F>(action)]() mutable -> scheduled_delivery {
+                if constexpr (std::is_void_v<result_type>) {
+                    action();
+                    return &_deliver_void;
+                } else {
+                    return [res=action()](const scheduled_observer_list &observers) mutable {
+                        _deliver(observers, res);
+                    };
+                }
+            }, {}, mem_cost);
+        }
+
+        template<typename T>
+        void on_result(const task_group_id task_group, const std::function<void (T &&)> &observer, const bool replace_if_exists=false)
+        {
+            _on_result(task_group, scheduled_observer { typeid(T), [observer](void *res) {
+                observer(std::move(*static_cast<T *>(res)));
+            } }, replace_if_exists);
+        }
+
+        // A coroutine task releases its worker whenever it co_awaits a scheduled_event and continues on any worker
+        // once the event happens. Its result is delivered like the one of a typed task. mem_cost stays charged
+        // to the memory budget until the coroutine completes.
+        template<typename T>
+        void submit_coro(const task_group_id task_group, const int64_t priority, coro::task<T> &&task, const uint64_t mem_cost=0)
+        {
+            const auto h = task.handle();
+            std::shared_ptr<coro_root> root = std::make_shared<coro_task<T>>(task_group, priority, mem_cost, std::move(task));
+            _submit(task_group, priority, [this, root=std::move(root), h]() -> scheduled_delivery {
+                return _coro_step(root, h);
+            }, {}, mem_cost);
+        }
+
+        void on_completion(task_group_id task_group, size_t task_count, const std::function<void()> &action);
+        // process() neither waits for the tasks of a background group nor fails because of them;
+        // must be called before the first task of the group is submitted
+        void set_background(task_group_id task_group);
+        size_t task_count(task_group_id task_group);
+
+        uint64_t memory_budget() const;
+        void memory_budget(uint64_t num_bytes);
+        // the total memory cost of the admitted but not yet completed tasks
+        uint64_t memory_admitted() const;
+
+        // Records the submit, start and end times of each task execution in a ring buffer per worker, keeping
+        // the latest events_per_worker ones. Setting the DT_TRACE environment variable to a path enables tracing
+        // from the start and writes the trace there when the scheduler is destroyed.
+        void trace_start(size_t events_per_worker=default_trace_capacity);
+        // stops tracing and writes the recorded events as a Chrome trace JSON viewable in ui.perfetto.dev
+        void trace_stop(const std::string &path);
     private:
+        template<typename T>
+        friend struct scheduled_event;
+        // starts the awaited operation and receives the callback that continues the suspended coroutine
+        using coro_start = std::function<void (std::function<void ()> &&)>;
+
+        // the state shared by all execution steps of a coroutine task
+        struct coro_root {
+            task_group_id task_group;
+            int64_t priority;
+            uint64_t mem_cost;
+
+            coro_root(const task_group_id tg, const int64_t prio, const uint64_t cost): task_group { tg }, priority { prio }, mem_cost { cost }
+            {
+            }
+
+            virtual ~coro_root() =default;
+            virtual bool done() const noexcept =0;
+            virtual scheduled_delivery finish() =0;
+        };
+
+        template<typename T>
+        struct coro_task final: coro_root {
+            coro::task<T> task;
+
+            coro_task(const task_group_id tg, const int64_t prio, const uint64_t cost, coro::task<T> &&t)
+                : coro_root { tg, prio, cost }, task { std::move(t) }
+            {
+            }
+
+            bool done() const noexcept override
+            {
+                return task.done();
+            }
+
+            scheduled_delivery finish() override
+            {
+                if constexpr (std::is_void_v<T>) {
+                    task.result();
+                    return &_deliver_void;
+                } else {
+                    return [res=task.result()](const scheduled_observer_list &observers) mutable {
+                        _deliver(observers, res);
+                    };
+                }
+            }
+        };
+        struct coro_step;
+
         struct impl;
         std::unique_ptr<impl> _impl;
+
+        template<typename T>
+        static void _deliver(const scheduled_observer_list &observers, T &res)
+        {
+            for (const auto &o: observers) {
+                if (o.type == typeid(T)) {
+                    o.action(&res);
+                } else if (o.type == typeid(std::any)) {
+                    if constexpr (std::is_copy_constructible_v<T>) {
+                        std::any any_res { res };
+                        o.action(&any_res);
+                    } else {
+                        throw error(fmt::format("a result of type {} cannot be passed to a std::any observer", typeid(T).name()));
+                    }
+                } else {
+                    throw error(fmt::format("a result of type {} cannot be passed to an observer of type {}", typeid(T).name(), o.type.name()));
+                }
+            }
+        }
+
+        static void _deliver_void(const scheduled_observer_list &observers);
+        static coro_step *&_coro_current();
+        static void _coro_suspend(std::coroutine_handle<> h, coro_start &&start);
+        scheduled_delivery _coro_step(const std::shared_ptr<coro_root> &root, std::coroutine_handle<> h);
+        void _submit(task_group_id task_group, int64_t priority, scheduled_action &&action, std::optional<std::any> param={}, uint64_t mem_cost=0);
+        void _on_result(task_group_id task_group, scheduled_observer &&observer, bool replace_if_exists);
+    };
+
+    // An awaitable for coroutine tasks. start is called only after the coroutine has been suspended and must ensure
+    // that the completion is called exactly once, from any thread. The coroutine then continues on a scheduler worker.
+    template<typename T=void>
+    struct scheduled_event {
+        using value_type = std::conditional_t<std::is_void_v<T>, std::monostate, T>;
+
+        struct completion {
+            template<typename... Args>
+            void operator()(Args &&...args) const
+            {
+                _event->_value.emplace(std::forward<Args>(args)...);
+                _resume();
+            }
+
+            void fail(std::exception_ptr ex) const
+            {
+                _event->_error = std::move(ex);
+                _resume();
+            }
+        private:
+            friend scheduled_event;
+            scheduled_event *_event;
+            std::function<void ()> _resume;
+
+            completion(scheduled_event *event, std::function<void ()> &&resume): _event { event }, _resume { std::move(resume) }
+            {
+            }
+        };
+        using start_type = std::function<void (const completion &)>;
+
+        explicit scheduled_event(start_type &&start): _start { std::move(start) }
+        {
+        }
+
+        bool await_ready() const noexcept
+        {
+            return false;
+        }
+
+        void await_suspend(const std::coroutine_handle<> h)
+        {
+            scheduler::_coro_suspend(h, [this](std::function<void ()> &&resume) {
+                const completion c { this, std::move(resume) };
+                try {
+                    _start(c);
+                } catch (...) {
+                    c.fail(std::current_exception());
+                }
+            });
+        }
+
+        T await_resume()
+        {
+            if (_error)
+                std::rethrow_exception(_error);
+            if constexpr (!std::is_void_v<T>)
+                return std::move(*_value);
+        }
+    private:
+        start_type _start;
+        std::optional<value_type> _value {};
+        std::exception_ptr _error {};
     };
 }
 
@@ -8,12 +8,43 @@
 #include <vector>
 #include <string>
 #include <dt/common/test.hpp>
+#include <dt/file.hpp>
 #include <dt/scheduler.hpp>
 #include <dt/util.hpp>
 
 using namespace std::literals;
 using namespace daedalus_turbo;
 
+namespace {
+    // completes the event from a thread outside of the scheduler
+    scheduled_event<int> delayed_value(const int v)
+    {
+        return scheduled_event<int> { [v](const auto &done) {
+            std::thread { [v, done] {
+                std::this_thread::sleep_for(std::chrono::milliseconds { 50 });
+                done(v);
+            } }.detach();
+        } };
+    }
+
+    coro::task<int> sum_delayed(std::atomic_size_t &num_running, std::atomic_size_t &max_running, const int a, const int b)
+    {
+        const auto x = co_await delayed_value(a);
+        const auto now_running = ++num_running;
+        for (auto prev_max = max_running.load(); prev_max < now_running && !max_running.compare_exchange_weak(prev_max, now_running); ) {
+        }
+        const auto y = co_await delayed_value(b);
+        --num_running;
+        co_return x + y;
+    }
+
+    coro::task<int> failing_delayed()
+    {
+        co_await delayed_value(1);
+        throw error("Ha ha! I told ya!");
+    }
+}
+
 suite scheduler_suite = [] {
     "scheduler"_test = [] {
         "chained_scheduling"_test = [] {
@@ -176,6 +207,30 @@ suite scheduler_suite = [] {
             s.process();
             expect(true);
         };
+        "background groups"_test = [] {
+            scheduler s { 2 };
+            const auto bg_group = scheduler::group_id("test-background");
+            s.set_background(bg_group);
+            std::atomic_bool release { false }, bg_done { false };
+            s.submit(bg_group, -100, [&] {
+                while (!release)
+                    std::this_thread::sleep_for(std::chrono::milliseconds { 1 });
+                bg_done = true;
+            });
+            s.submit(bg_group, -100, [] {
+                throw error("background failure");
+            });
+            std::atomic_size_t num_fg { 0 };
+            s.submit_void("test-foreground", 100, [&] { ++num_fg; });
+            // neither waits for the blocked background task nor fails because of the other one
+            expect(s.process_ok());
+            test_same(1, num_fg.load());
+            expect(!bg_done);
+            release = true;
+            while (s.task_count(bg_group) > 0)
+                s.process_once(false);
+            expect(bg_done.load());
+        };
         "clear_observers"_test = [] {
             scheduler s {};
             std::optional<size_t> num_before {};
@@ -227,6 +282,152 @@ suite scheduler_suite = [] {
                 expect(num_completions == 1_ull);
             };
         };
+        "typed tasks"_test = [] {
+            scheduler s {};
+            static const auto tg = scheduler::group_id("typed-sum");
+            test_same(tg, scheduler::group_id("typed-sum"));
+            test_same(std::string { "typed-sum" }, scheduler::group_name(tg));
+            uint64_t typed_sum = 0;
+            size_t any_calls = 0;
+            s.on_result<uint64_t>(tg, [&](uint64_t &&res) {
+                typed_sum += res;
+            });
+            s.on_result("typed-sum", [&](auto &&res) {
+                if (res.type() == typeid(uint64_t))
+                    ++any_calls;
+            });
+            for (uint64_t i = 1; i <= 100; ++i) {
+                s.submit(tg, 100, [i] {
+                    return i;
+                });
+            }
+            expect(s.task_count(tg) == 100_ull);
+            expect(s.task_count("typed-sum") == 100_ull);
+            s.process();
+            test_same(5050, typed_sum);
+            test_same(100, any_calls);
+        };
+        "typed tasks with move-only results"_test = [] {
+            scheduler s {};
+            const auto tg = scheduler::group_id("typed-unique");
+            int total = 0;
+            s.on_result<std::unique_ptr<int>>(tg, [&](std::unique_ptr<int> &&res) {
+                total += *res;
+            });
+            for (int i = 0; i < 10; ++i) {
+                s.submit(tg, 100, [i] {
+                    return std::make_unique<int>(i);
+                });
+            }
+            s.process();
+            test_same(45, total);
+        };
+        "typed task errors"_test = [] {
+            scheduler s {};
+            const auto tg = scheduler::group_id("typed-bad-actor");
+            size_t num_ok = 0, num_err = 0, num_completed = 0;
+            s.on_result<int>(tg, [&](int &&) {
+                ++num_ok;
+            });
+            s.on_result("typed-bad-actor", [&](auto &&res) {
+                if (res.type() == typeid(scheduled_task_error))
+                    ++num_err;
+            });
+            s.on_completion(tg, 2, [&] {
+                ++num_completed;
+            });
+            s.submit(tg, 100, [] {
+                return 1;
+            });
+            s.submit(tg, 100, []() -> int {
+                throw error("Ha ha! I told ya!");
+            });
+            expect(!s.process_ok());
+            test_same(1, num_ok);
+            test_same(1, num_err);
+            test_same(1, num_completed);
+        };
+        "memory budget"_test = [] {
+            scheduler s { 4 };
+            s.memory_budget(100);
+            std::atomic_size_t in_use { 0 }, max_in_use { 0 }, num_done { 0 };
+            std::atomic_bool big_alone { false };
+            for (size_t i = 0; i < 20; ++i) {
+                s.submit_void("mem-task", 100, [&] {
+                    const auto now_in_use = in_use.fetch_add(40) + 40;
+                    for (auto prev_max = max_in_use.load(); prev_max < now_in_use && !max_in_use.compare_exchange_weak(prev_max, now_in_use); ) {
+                    }
+                    std::this_thread::sleep_for(std::chrono::milliseconds { 20 });
+                    in_use.fetch_sub(40);
+                    ++num_done;
+                }, {}, 40);
+            }
+            // bigger than the whole budget but still must be executed, alone
+            s.submit_void("mem-task", 50, [&] {
+                big_alone = in_use.load() == 0;
+                ++num_done;
+            }, {}, 1000);
+            // tasks without a cost are not limited
+            for (size_t i = 0; i < 8; ++i)
+                s.submit_void("mem-free-task", 10, [&] { ++num_done; });
+            s.process();
+            test_same(29, num_done.load());
+            expect(max_in_use.load() <= 80_ull);
+            expect(big_alone.load());
+            test_same(0, s.memory_admitted());
+        };
+        "coroutine tasks"_test = [] {
+            scheduler s { 2 };
+            static const auto tg = scheduler::group_id("coro-sum");
+            std::atomic_size_t num_running { 0 }, max_running { 0 };
+            int sum = 0;
+            s.on_result<int>(tg, [&](int &&res) {
+                sum += res;
+            });
+            // the coroutines wait in parallel even though there are only two workers
+            const auto start = std::chrono::system_clock::now();
+            for (int i = 0; i < 32; ++i)
+                s.submit_coro(tg, 100, sum_delayed(num_running, max_running, i, 1));
+            expect(s.task_count(tg) == 32_ull);
+            s.process();
+            test_same(32 * 31 / 2 + 32, sum);
+            expect(max_running.load() > 2_ull);
+            expect(std::chrono::system_clock::now() - start < std::chrono::seconds { 1 });
+        };
+        "coroutine task errors"_test = [] {
+            scheduler s { 2 };
+            static const auto tg = scheduler::group_id("coro-bad-actor");
+            size_t num_err = 0;
+            s.on_result("coro-bad-actor", [&](auto &&res) {
+                if (res.type() == typeid(scheduled_task_error))
+                    ++num_err;
+            });
+            s.submit_coro(tg, 100, failing_delayed());
+            expect(!s.process_ok());
+            test_same(1, num_err);
+        };
+        "trace"_test = [] {
+            file::tmp trace_path { "scheduler-trace.json" };
+            scheduler s { 2 };
+            s.trace_start(8);
+            for (size_t i = 0; i < 20; ++i) {
+                s.submit_void("trace-task", static_cast<int64_t>(i), [] {
+                    std::this_thread::sleep_for(std::chrono::milliseconds { 1 });
+                });
+            }
+            s.process();
+            s.trace_stop(trace_path.path());
+            const auto trace = file::read<std::string>(trace_path.path());
+            expect(trace.starts_with("{\"displayTimeUnit\""));
+            expect(trace.find("\"name\":\"worker-1\"") != trace.npos);
+            size_t num_events = 0;
+            for (auto pos = trace.find("\"name\":\"trace-task\""); pos != trace.npos; pos = trace.find("\"name\":\"trace-task\"", pos + 1))
+                ++num_events;
+            // each worker keeps only the latest 8 events
+            expect(num_events <= std::min(size_t { 20 }, s.num_workers() * 8));
+            expect(num_events >= 8_ull);
+            expect(trace.find("\"queue_wait_us\"") != trace.npos);
+        };
         "cancel"_test = [] {
             scheduler s { 2 };
             std::atomic_size_t num_cancelled = 0;
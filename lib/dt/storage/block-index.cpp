@@ -0,0 +1,133 @@
+/* This file is part of Daedalus Turbo project: https://github.com/sierkov/daedalus-turbo/
+ * Copyright (c) 2022-2023 Alex Sierkov (alex dot sierkov at gmail dot com)
+ * Copyright (c) 2024-2025 R2 Rationality OÜ (info at r2rationality dot com)
+ * This code is distributed under the license specified in:
+ * https://github.com/sierkov/daedalus-turbo/blob/main/LICENSE */
+
+#include <array>
+#include <cstring>
+#include <filesystem>
+#include <optional>
+#include <boost/interprocess/file_mapping.hpp>
+#include <boost/interprocess/mapped_region.hpp>
+#include <dt/file.hpp>
+#include <dt/storage/block-index.hpp>
+
+namespace daedalus_turbo::storage {
+    namespace {
+        static constexpr std::string_view index_magic { "DTBLKIDX" };
+
+        struct index_header {
+            char magic[8];
+            uint32_t version;
+            uint32_t row_size;
+            uint64_t num_blocks;
+            uint64_t reserved;
+        };
+        static_assert(sizeof(index_header) == 32);
+
+        // keeps all columns 8-byte aligned
+        constexpr uint64_t padded_size(const uint64_t sz)
+        {
+            return (sz + 7) & ~static_cast<uint64_t>(7);
+        }
+
+        struct index_layout {
+            uint64_t offsets_pos;
+            uint64_t slots_pos;
+            uint64_t rows_pos;
+            uint64_t file_size;
+
+            explicit index_layout(const uint64_t num_blocks):
+                offsets_pos { sizeof(index_header) },
+                slots_pos { offsets_pos + num_blocks * sizeof(uint64_t) },
+                rows_pos { slots_pos + padded_size(num_blocks * sizeof(uint32_t)) },
+                file_size { rows_pos + num_blocks * sizeof(block_info) }
+            {
+            }
+        };
+    }
+
+    struct block_index::impl {
+        boost::interprocess::file_mapping mapping;
+        boost::interprocess::mapped_region region;
+
+        explicit impl(const std::string &path):
+            mapping { path.c_str(), boost::interprocess::read_only },
+            region { mapping, boost::interprocess::read_only }
+        {
+        }
+    };
+
+    void block_index::write(const std::string &path, const std::span<const std::span<const block_info>> runs)
+    {
+        uint64_t num_blocks = 0;
+        for (const auto &run: runs)
+            num_blocks += run.size();
+        const index_layout layout { num_blocks };
+        index_header hdr {};
+        std::memcpy(hdr.magic, index_magic.data(), sizeof(hdr.magic));
+        hdr.version = format_version;
+        hdr.row_size = sizeof(block_info);
+        hdr.num_blocks = num_blocks;
+        file::write_stream ws { path, 1 << 20 };
+        ws.write(&hdr, sizeof(hdr));
+        std::optional<uint64_t> prev_offset {};
+        for (const auto &run: runs) {
+            for (const auto &b: run) {
+                if (prev_offset && *prev_offset >= b.offset) [[unlikely]]
+                    throw error(fmt::format("block index {}: blocks must be ordered by their offsets but {} follows {}", path, b.offset, *prev_offset));
+                prev_offset = b.offset;
+                ws.write(&b.offset, sizeof(b.offset));
+            }
+        }
+        for (const auto &run: runs) {
+            for (const auto &b: run)
+                ws.write(&b.slot, sizeof(b.slot));
+        }
+        static constexpr std::array<uint8_t, 8> zeros {};
+        ws.write(zeros.data(), layout.rows_pos - layout.slots_pos - num_blocks * sizeof(uint32_t));
+        for (const auto &run: runs)
+            ws.write(run.data(), run.size() * sizeof(block_info));
+    }
+
+    void block_index::write(const std::string &path, const std::span<const block_info> blocks)
+    {
+        const std::array<std::span<const block_info>, 1> runs { blocks };
+        write(path, runs);
+    }
+
+    block_index::block_index(const std::string &path): _path { path }
+    {
+        const auto file_size = std::filesystem::file_size(path);
+        if (file_size < sizeof(index_header)) [[unlikely]]
+            throw error(fmt::format("block index {} is truncated: {} bytes", path, file_size));
+        index_header hdr {};
+        if (file_size > sizeof(index_header)) {
+            _impl = std::make_unique<impl>(path);
+            if (_impl->region.get_size() != file_size) [[unlikely]]
+                throw error(fmt::format("block index {}: mapped {} bytes instead of {}", path, _impl->region.get_size(), file_size));
+            std::memcpy(&hdr, _impl->region.get_address(), sizeof(hdr));
+        } else {
+            // an empty index, which cannot be mapped on some platforms
+            file::read_stream rs { path };
+            rs.read(&hdr, sizeof(hdr));
+        }
+        if (std::string_view { hdr.magic, sizeof(hdr.magic) } != index_magic) [[unlikely]]
+            throw error(fmt::format("block index {} has an invalid magic", path));
+        if (hdr.version != format_version || hdr.row_size != sizeof(block_info)) [[unlikely]]
+            throw error(fmt::format("block index {} has an unsupported version {} or row size {}", path, hdr.version, hdr.row_size));
+        const index_layout layout { hdr.num_blocks };
+        if (layout.file_size != file_size) [[unlikely]]
+            throw error(fmt::format("block index {}: the file size {} does not match the expected {}", path, file_size, layout.file_size));
+        _size = hdr.num_blocks;
+        if (_impl) {
+            const auto *base = static_cast<const uint8_t *>(_impl->region.get_address());
+            _offsets = reinterpret_cast<const uint64_t *>(base + layout.offsets_pos);
+            _slots = reinterpret_cast<const uint32_t *>(base + layout.slots_pos);
+            _rows = reinterpret_cast<const block_info *>(base + layout.rows_pos);
+        }
+    }
+
+    block_index::~block_index() =default;
+}
@@ -0,0 +1,249 @@
+/* This file is part of Daedalus Turbo project: https://github.com/sierkov/daedalus-turbo/
+ * Copyright (c) 2022-2023 Alex Sierkov (alex dot sierkov at gmail dot com)
+ * Copyright (c) 2024-2025 R2 Rationality OÜ (info at r2rationality dot com)
+ * This code is distributed under the license specified in:
+ * https://github.com/sierkov/daedalus-turbo/blob/main/LICENSE */
+#ifndef DAEDALUS_TURBO_STORAGE_BLOCK_INDEX_HPP
+#define DAEDALUS_TURBO_STORAGE_BLOCK_INDEX_HPP
+
+#include <algorithm>
+#include <memory>
+#include <span>
+#include <string>
+#include <dt/cardano/common/common.hpp>
+#include <dt/container.hpp>
+
+namespace daedalus_turbo::storage {
+    using block_info = cardano::block_info;
+    static_assert(sizeof(block_info) == 88);
+    static_assert(std::is_trivially_copyable_v<block_info>);
+
+    // An immutable memory-mapped file with the metadata of a run of blocks ordered by their offsets.
+    // The offsets and slots are stored as separate columns, so that binary searches touch only a few pages,
+    // and the complete records are stored as fixed-size rows, so that they can be referenced in place.
+    // The pages are loaded by the OS on demand, so opening an index costs the same regardless of its size.
+    struct block_index {
+        static constexpr uint32_t format_version = 1;
+
+        static void write(const std::string &path, std::span<const std::span<const block_info>> runs);
+        static void write(const std::string &path, std::span<const block_info> blocks);
+
+        explicit block_index(const std::string &path);
+        ~block_index();
+
+        const std::string &path() const
+        {
+            return _path;
+        }
+
+        size_t size() const
+        {
+            return _size;
+        }
+
+        const uint64_t *offsets() const
+        {
+            return _offsets;
+        }
+
+        const uint32_t *slots() const
+        {
+            return _slots;
+        }
+
+        const block_info *rows() const
+        {
+            return _rows;
+        }
+    private:
+        struct impl;
+        std::unique_ptr<impl> _impl;
+        std::string _path;
+        size_t _size = 0;
+        const uint64_t *_offsets = nullptr;
+        const uint32_t *_slots = nullptr;
+        const block_info *_rows = nullptr;
+    };
+    using block_index_ptr = std::shared_ptr<const block_index>;
+
+    // The blocks of a chunk: either a range of a memory-mapped block_index or, for the chunks that have not been
+    // persisted yet, an owned vector. Modifications other than shrinking convert a mapped range into an owned vector.
+    struct block_list {
+        using value_type = block_info;
+        using const_iterator = const block_info *;
+        using iterator = const_iterator;
+        using const_reverse_iterator = std::reverse_iterator<const_iterator>;
+        using reverse_iterator = const_reverse_iterator;
+
+        block_list() =default;
+
+        block_list(std::initializer_list<block_info> blocks): _owned { blocks }
+        {
+        }
+
+        block_list(block_index_ptr index, const size_t first, const size_t size):
+            _index { std::move(index) }, _first { first }, _size { size }
+        {
+            if (_first + _size > _index->size()) [[unlikely]]
+                throw error(fmt::format("block range [{}, {}) is outside of the block index {} with {} blocks",
+                    _first, _first + _size, _index->path(), _index->size()));
+        }
+
+        constexpr static auto serialize(auto &archive, auto &self)
+        {
+            if constexpr (std::remove_cvref_t<decltype(archive)>::kind() == ::zpp::bits::kind::out) {
+                if (self._index)
+                    return archive(vector<block_info> { self.begin(), self.end() });
+                return archive(self._owned);
+            } else {
+                self._index.reset();
+                self._first = 0;
+                self._size = 0;
+                return archive(self._owned);
+            }
+        }
+
+        bool mapped() const
+        {
+            return static_cast<bool>(_index);
+        }
+
+        const block_index_ptr &index() const
+        {
+            return _index;
+        }
+
+        // the position of the first block in the mapped index
+        size_t first_row() const
+        {
+            return _first;
+        }
+
+        const block_info *data() const
+        {
+            return _index ? _index->rows() + _first : _owned.data();
+        }
+
+        size_t size() const
+        {
+            return _index ? _size : _owned.size();
+        }
+
+        bool empty() const
+        {
+            return size() == 0;
+        }
+
+        const_iterator begin() const
+        {
+            return data();
+        }
+
+        const_iterator end() const
+        {
+            return data() + size();
+        }
+
+        const_reverse_iterator rbegin() const
+        {
+            return const_reverse_iterator { end() };
+        }
+
+        const_reverse_iterator rend() const
+        {
+            return const_reverse_iterator { begin() };
+        }
+
+        const block_info &operator[](const size_t idx) const
+        {
+            return data()[idx];
+        }
+
+        const block_info &at(const size_t idx) const
+        {
+            if (idx >= size()) [[unlikely]]
+                throw error(fmt::format("block index {} is out of range: the list has only {} blocks", idx, size()));
+            return data()[idx];
+        }
+
+        const block_info &front() const
+        {
+            return at(0);
+        }
+
+        const block_info &back() const
+        {
+            return at(size() - 1);
+        }
+
+        // the first block with a slot not less than the given one
+        const_iterator lower_bound_slot(const uint64_t slot) const
+        {
+            if (_index) {
+                const auto *slots = _index->slots() + _first;
+                return begin() + (std::lower_bound(slots, slots + _size, slot, [](const auto s, const auto target) { return s < target; }) - slots);
+            }
+            return std::lower_bound(begin(), end(), slot, [](const auto &b, const auto target) { return b.slot < target; });
+        }
+
+        // the first block that ends after the given offset
+        const_iterator lower_bound_offset(const uint64_t offset) const
+        {
+            if (_index) {
+                const auto *offsets = _index->offsets() + _first;
+                auto idx = static_cast<size_t>(std::upper_bound(offsets, offsets + _size, offset) - offsets);
+                if (idx > 0 && begin()[idx - 1].end_offset() > offset)
+                    --idx;
+                return begin() + idx;
+            }
+            return std::lower_bound(begin(), end(), offset, [](const auto &b, const auto target) { return b.end_offset() <= target; });
+        }
+
+        template<typename... Args>
+        const block_info &emplace_back(Args &&...args)
+        {
+            _own();
+            return _owned.emplace_back(std::forward<Args>(args)...);
+        }
+
+        void resize(const size_t new_size)
+        {
+            if (_index && new_size <= _size) {
+                _size = new_size;
+                return;
+            }
+            _own();
+            _owned.resize(new_size);
+        }
+
+        void clear()
+        {
+            _index.reset();
+            _first = 0;
+            _size = 0;
+            _owned.clear();
+        }
+
+        bool operator==(const block_list &o) const
+        {
+            return std::equal(begin(), end(), o.begin(), o.end());
+        }
+    private:
+        block_index_ptr _index {};
+        size_t _first = 0;
+        size_t _size = 0;
+        vector<block_info> _owned {};
+
+        void _own()
+        {
+            if (_index) {
+                _owned.assign(begin(), end());
+                _index.reset();
+                _first = 0;
+                _size = 0;
+            }
+        }
+    };
+}
+
+#endif // !DAEDALUS_TURBO_STORAGE_BLOCK_INDEX_HPP
@@ -0,0 +1,96 @@
+/* This file is part of Daedalus Turbo project: https://github.com/sierkov/daedalus-turbo/
+ * Copyright (c) 2022-2023 Alex Sierkov (alex dot sierkov at gmail dot com)
+ * Copyright (c) 2024-2025 R2 Rationality OÜ (info at r2rationality dot com)
+ * This code is distributed under the license specified in:
+ * https://github.com/sierkov/daedalus-turbo/blob/main/LICENSE */
+
+#include <dt/common/test.hpp>
+#include <dt/file.hpp>
+#include <dt/storage/block-index.hpp>
+#include <dt/zpp.hpp>
+
+using namespace daedalus_turbo;
+
+namespace {
+    storage::block_list make_blocks(const size_t num_blocks)
+    {
+        storage::block_list blocks {};
+        uint64_t offset = 1000;
+        for (size_t i = 0; i < num_blocks; ++i) {
+            storage::block_info b {};
+            b.offset = offset;
+            b.size = 100 + i % 7;
+            // every third block shares the slot of the previous one
+            b.slot = 10 + (i - i / 3) * 2;
+            b.height = i;
+            b.era = 6;
+            b.hash.data()[0] = i & 0xFF;
+            b.hash.data()[1] = i >> 8;
+            blocks.emplace_back(b);
+            offset += b.size;
+        }
+        return blocks;
+    }
+}
+
+suite storage_block_index_suite = [] {
+    "storage::block_index"_test = [] {
+        file::tmp_directory tmp_dir { "test-block-index" };
+        const auto blocks = make_blocks(1000);
+        const auto path = fmt::format("{}/blocks.bin", tmp_dir.path());
+        storage::block_index::write(path, std::span { blocks.data(), blocks.size() });
+        const auto idx = std::make_shared<const storage::block_index>(path);
+        "columns"_test = [&] {
+            test_same(blocks.size(), idx->size());
+            for (size_t i = 0; i < blocks.size(); ++i) {
+                expect(idx->offsets()[i] == blocks[i].offset);
+                expect(idx->slots()[i] == blocks[i].slot);
+                expect(idx->rows()[i] == blocks[i]);
+                expect(idx->rows()[i].height == blocks[i].height);
+            }
+        };
+        "search"_test = [&] {
+            const storage::block_list mapped { idx, 100, 500 };
+            storage::block_list owned {};
+            for (const auto &b: std::span { blocks.data() + 100, 500 })
+                owned.emplace_back(b);
+            expect(mapped.mapped());
+            expect(!owned.mapped());
+            expect(mapped == owned);
+            for (uint64_t slot = 0; slot < 2000; slot += 3)
+                test_same(owned.lower_bound_slot(slot) - owned.begin(), mapped.lower_bound_slot(slot) - mapped.begin());
+            for (uint64_t off = 0; off < 110'000; off += 17)
+                test_same(owned.lower_bound_offset(off) - owned.begin(), mapped.lower_bound_offset(off) - mapped.begin());
+        };
+        "modifications"_test = [&] {
+            storage::block_list mapped { idx, 0, 10 };
+            mapped.resize(5);
+            expect(mapped.mapped());
+            test_same(5, mapped.size());
+            mapped.emplace_back(blocks[5]);
+            expect(!mapped.mapped());
+            test_same(6, mapped.size());
+            expect(mapped.back() == blocks[5]);
+        };
+        "serialize"_test = [&] {
+            const storage::block_list mapped { idx, 10, 20 };
+            const auto copy = daedalus_turbo::zpp::deserialize<storage::block_list>(daedalus_turbo::zpp::serialize(mapped));
+            expect(!copy.mapped());
+            expect(copy == mapped);
+        };
+        "empty"_test = [&] {
+            const auto empty_path = fmt::format("{}/empty.bin", tmp_dir.path());
+            storage::block_index::write(empty_path, std::span<const storage::block_info> {});
+            const storage::block_index empty_idx { empty_path };
+            test_same(0, empty_idx.size());
+        };
+        "corrupt"_test = [&] {
+            const auto bad_path = fmt::format("{}/bad.bin", tmp_dir.path());
+            auto data = file::read(path);
+            data.resize(data.size() - 1);
+            file::write(bad_path, data);
+            expect(throws([&] { storage::block_index { bad_path }; }));
+            expect(throws([&] { storage::block_list { idx, 900, 101 }; }));
+        };
+    };
+};
@@ -0,0 +1,36 @@
+/* This file is part of Daedalus Turbo project: https://github.com/sierkov/daedalus-turbo/
+ * Copyright (c) 2022-2023 Alex Sierkov (alex dot sierkov at gmail dot com)
+ * Copyright (c) 2024-2025 R2 Rationality OÜ (info at r2rationality dot com)
+ * This code is distributed under the license specified in:
+ * https://github.com/sierkov/daedalus-turbo/blob/main/LICENSE */
+#ifndef DAEDALUS_TURBO_STORAGE_CHUNK_CACHE_HPP
+#define DAEDALUS_TURBO_STORAGE_CHUNK_CACHE_HPP
+
+#include <dt/common/lru-cache.hpp>
+#include <dt/storage/chunk-info.hpp>
+
+namespace daedalus_turbo::storage {
+    // A cache of decompressed chunks shared by all readers of a chunk registry.
+    // Entries are keyed by the chunk offset and checked against the data hash, since a truncated chunk keeps its offset.
+    struct chunk_cache: lru_cache<uint64_t, cardano::block_hash> {
+        using lru_cache::get;
+        using lru_cache::find;
+
+        // 256 MiB unless overridden with the DT_CHUNK_CACHE_MB environment variable; zero disables caching
+        static uint64_t default_budget();
+
+        explicit chunk_cache(uint64_t budget=default_budget());
+
+        data_ptr get(const chunk_info &chunk, const loader &load)
+        {
+            return get(chunk.offset, chunk.data_hash, load);
+        }
+
+        data_ptr find(const chunk_info &chunk)
+        {
+            return find(chunk.offset, chunk.data_hash);
+        }
+    };
+}
+
+#endif // !DAEDALUS_TURBO_STORAGE_CHUNK_CACHE_HPP
@@ -0,0 +1,79 @@
+/* This file is part of Daedalus Turbo project: https://github.com/sierkov/daedalus-turbo/
+ * Copyright (c) 2022-2023 Alex Sierkov (alex dot sierkov at gmail dot com)
+ * Copyright (c) 2024-2025 R2 Rationality OÜ (info at r2rationality dot com)
+ * This code is distributed under the license specified in:
+ * https://github.com/sierkov/daedalus-turbo/blob/main/LICENSE */
+
+#include <dt/common/test.hpp>
+#include <dt/storage/chunk-cache.hpp>
+
+using namespace daedalus_turbo;
+
+namespace {
+    storage::chunk_info make_chunk(const uint64_t offset, const size_t size, const uint8_t hash_byte=0)
+    {
+        storage::chunk_info chunk {};
+        chunk.offset = offset;
+        chunk.data_size = size;
+        chunk.data_hash.data()[0] = hash_byte;
+        return chunk;
+    }
+}
+
+suite storage_chunk_cache_suite = [] {
+    "storage::chunk_cache"_test = [] {
+        "hits and misses"_test = [] {
+            storage::chunk_cache cache { 1000 };
+            size_t num_loads = 0;
+            const auto load = [&] {
+                ++num_loads;
+                return uint8_vector(100);
+            };
+            const auto c1 = make_chunk(0, 100);
+            const auto d1 = cache.get(c1, load);
+            const auto d2 = cache.get(c1, load);
+            expect(d1 == d2);
+            test_same(1, num_loads);
+            test_same(1, cache.hits());
+            test_same(1, cache.misses());
+        };
+        "lru eviction by bytes"_test = [] {
+            storage::chunk_cache cache { 300 };
+            size_t num_loads = 0;
+            const auto load = [&] {
+                ++num_loads;
+                return uint8_vector(100);
+            };
+            for (uint64_t off = 0; off < 400; off += 100)
+                cache.get(make_chunk(off, 100), load);
+            test_same(4, num_loads);
+            auto st = cache.stat();
+            test_same(3, st.num_chunks);
+            test_same(300, st.num_bytes);
+            test_same(1, st.evictions);
+            // chunk 0 has been evicted, chunk 300 is still there
+            cache.get(make_chunk(300, 100), load);
+            test_same(4, num_loads);
+            cache.get(make_chunk(0, 100), load);
+            test_same(5, num_loads);
+        };
+        "data hash mismatch"_test = [] {
+            storage::chunk_cache cache { 1000 };
+            size_t num_loads = 0;
+            const auto load = [&] {
+                ++num_loads;
+                return uint8_vector(10);
+            };
+            cache.get(make_chunk(0, 10, 1), load);
+            cache.get(make_chunk(0, 10, 2), load);
+            test_same(2, num_loads);
+            test_same(1, cache.stat().num_chunks);
+        };
+        "too big chunks are not cached"_test = [] {
+            storage::chunk_cache cache { 50 };
+            const auto data = cache.get(make_chunk(0, 100), [] { return uint8_vector(100); });
+            test_same(100, data->size());
+            test_same(0, cache.stat().num_chunks);
+        };
+    };
+};
@@ -9,16 +9,14 @@
 #include <string>
 #include <dt/cardano/common/common.hpp>
 #include <dt/common/format.hpp>
+#include <dt/storage/block-index.hpp>
+#include <dt/zstd.hpp>
 
 namespace daedalus_turbo::cardano {
     struct block_container;
 }
 
 namespace daedalus_turbo::storage {
-    using block_info = cardano::block_info;
-    static_assert(sizeof(block_info) == 88);
-    using block_list = vector<block_info>;
-
     struct chunk_info {
         size_t data_size = 0;
         size_t compressed_size = 0;
@@ -31,6 +29,12 @@ namespace daedalus_turbo::storage {
         uint64_t offset = 0;
         // fields that are not serialized to json:
         block_list blocks {};
+        // empty when the data is a single compressed frame
+        zstd::frame_list frames {};
+        // zero when unknown, for example, for chunks compressed by peers
+        uint8_t compression_level = 0;
+        // incremented by each recompression, so that a frame table never refers to the file of another generation
+        uint8_t generation = 0;
 
         constexpr static auto serialize(auto &archive, auto &self)
         {
@@ -49,6 +53,8 @@ namespace daedalus_turbo::storage {
 
         [[nodiscard]] std::string rel_path() const
         {
+            if (generation)
+                return fmt::format("chunk/{}.{}.zstd", data_hash, generation);
             return rel_path_from_hash(data_hash);
         }
 
@@ -84,6 +90,26 @@ namespace daedalus_turbo::storage {
             return offset + data_size;
         }
 
+        struct frame_span {
+            uint64_t offset = 0; // chunk-relative offset of the first decompressed byte
+            uint64_t compressed_offset = 0;
+            uint64_t compressed_size = 0;
+        };
+
+        // the compressed frames covering the chunk-relative data range
+        [[nodiscard]] frame_span frames_for(const uint64_t rel_offset, const uint64_t size) const
+        {
+            if (frames.empty() || rel_offset + size > data_size) [[unlikely]]
+                throw error(fmt::format("chunk {}: no frames cover the data range [{}, {})", rel_path(), rel_offset, rel_offset + size));
+            auto first_it = std::upper_bound(frames.begin(), frames.end(), rel_offset,
+                [](const uint64_t off, const auto &f) { return off < f.offset; });
+            --first_it;
+            const auto last_it = std::lower_bound(first_it, frames.end(), rel_offset + size,
+                [](const auto &f, const uint64_t off) { return f.offset < off; });
+            const uint64_t compressed_end = last_it != frames.end() ? last_it->compressed_offset : compressed_size;
+            return { first_it->offset, first_it->compressed_offset, compressed_end - first_it->compressed_offset };
+        }
+
         static chunk_info from_json(const json::object &j)
         {
             chunk_info chunk {};
@@ -22,6 +22,8 @@ suite storage_chunk_info_suite = [] {
             expect(chunk.rel_path() == "chunk/0000000000000000000000000000000000000000000000000000000000000000.zstd");
             chunk.data_hash = cardano::block_hash::from_hex("1111111111111111111111111111111111111111111111111111111111111111");
             expect(chunk.rel_path() == "chunk/1111111111111111111111111111111111111111111111111111111111111111.zstd");
+            chunk.generation = 1;
+            expect(chunk.rel_path() == "chunk/1111111111111111111111111111111111111111111111111111111111111111.1.zstd");
         };
         "end_offset"_test = [] {
             storage::chunk_info chunk {};
@@ -31,5 +33,31 @@ suite storage_chunk_info_suite = [] {
             chunk.offset = 78;
             expect(chunk.end_offset() == 100_ull);
         };
+        "frames_for"_test = [] {
+            storage::chunk_info chunk {};
+            chunk.data_size = 300;
+            chunk.compressed_size = 150;
+            expect(throws([&] { chunk.frames_for(0, 10); }));
+            chunk.frames = { { 0, 0 }, { 100, 40 }, { 200, 90 } };
+            {
+                const auto span = chunk.frames_for(0, 100);
+                test_same(0, span.offset);
+                test_same(0, span.compressed_offset);
+                test_same(40, span.compressed_size);
+            }
+            {
+                const auto span = chunk.frames_for(150, 100);
+                test_same(100, span.offset);
+                test_same(40, span.compressed_offset);
+                test_same(110, span.compressed_size);
+            }
+            {
+                const auto span = chunk.frames_for(299, 1);
+                test_same(200, span.offset);
+                test_same(90, span.compressed_offset);
+                test_same(60, span.compressed_size);
+            }
+            expect(throws([&] { chunk.frames_for(250, 51); }));
+        };
     };
 };
\ No newline at end of file
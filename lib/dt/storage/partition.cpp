@@ -89,49 +89,64 @@ namespace daedalus_turbo::storage {
         return parts;
     }
 
+    static coro::task<uint64_t> parse_partition(const chunk_registry &cr, const partition &part, const size_t part_no,
+        const std::function<void(std::any &, const cardano::block_base &blk)> &on_block,
+        const std::function<std::any(size_t, const partition &)> &on_part_init,
+        const std::function<void(std::any &&, size_t, const partition &)> &on_part_done)
+    {
+        auto tmp = on_part_init(part_no, part);
+        for (const auto *chunk: part) {
+            // the worker is released while the chunk is being read
+            const auto data = co_await io_pool::get().read(cr.chunk_path(*chunk));
+            cbor::zero2::decoder dec { data };
+            while (!dec.done()) {
+                auto &block_tuple = dec.read();
+                const cardano::block_container blk { numeric_cast<uint64_t>(chunk->offset + block_tuple.data_begin() - data.data()), block_tuple, cr.config() };
+                try {
+                    on_block(tmp, *blk);
+                } catch (const std::exception &ex) {
+                    throw error(fmt::format("failed to parse block at slot: {} hash: {}: {}", blk->slot(), blk->hash(), ex.what()));
+                }
+            }
+        }
+        try {
+            on_part_done(std::move(tmp), part_no, part);
+        } catch (const std::exception &ex) {
+            throw error(fmt::format("failed to complete partition [{}:{}]: {}", part.offset(), part.end_offset(), ex.what()));
+        }
+        co_return part.size();
+    }
+
     void parse_parallel(const chunk_registry &cr, const partition_map &pm,
         const std::function<void(std::any &, const cardano::block_base &blk)> &on_block,
         const std::function<std::any(size_t, const partition &)> &on_part_init,
         const std::function<void(std::any &&, size_t, const partition &)> &on_part_done,
         const std::optional<std::string> &progress_tag)
     {
+        static const auto parse_tg = scheduler::group_id("parse-chunk");
         std::optional<progress_guard> pg {};
         if (progress_tag)
             pg.emplace({ *progress_tag });
         const uint64_t total_size = cr.num_bytes();
-        std::atomic_size_t parsed_size { 0 };
+        uint64_t parsed_size = 0;
         auto &sched = cr.sched();
-        for (size_t part_no = 0; part_no < pm.size(); ++part_no) {
-            sched.submit_void("parse-chunk", -static_cast<int64_t>(part_no), [&, part_no] {
-                const auto &part = pm.at(part_no);
-                auto tmp = on_part_init(part_no, part);
-                for (const auto *chunk: part) {
-                    auto canon_path = cr.full_path(chunk->rel_path());
-                    const auto data = file::read(canon_path);
-                    cbor::zero2::decoder dec { data };
-                    while (!dec.done()) {
-                        auto &block_tuple = dec.read();
-                        const cardano::block_container blk { numeric_cast<uint64_t>(chunk->offset + block_tuple.data_begin() - data.data()), block_tuple, cr.config() };
-                        try {
-                            on_block(tmp, *blk);
-                        } catch (const std::exception &ex) {
-                            throw error(fmt::format("failed to parse block at slot: {} hash: {}: {}", blk->slot(), blk->hash(), ex.what()));
-                        }
-                    }
-                }
-                try {
-                    on_part_done(std::move(tmp), part_no, part);
-                } catch (const std::exception &ex) {
-                    throw error(fmt::format("failed to complete partition [{}:{}]: {}", part.offset(), part.end_offset(), ex.what()));
-                }
-                if (progress_tag) {
-                    const auto done = parsed_size.fetch_add(part.size(), std::memory_order::relaxed) + part.size();
-                    auto &p = progress::get();
-                    p.update(*progress_tag, done, total_size);
-                    p.inform();
-                }
+        if (progress_tag) {
+            // observers are called from a single thread
+            sched.on_result<uint64_t>(parse_tg, [&](uint64_t &&part_size) {
+                parsed_size += part_size;
+                auto &p = progress::get();
+                p.update(*progress_tag, parsed_size, total_size);
+                p.inform();
             });
         }
+        for (size_t part_no = 0; part_no < pm.size(); ++part_no) {
+            // the chunks of a partition are parsed one at a time
+            size_t max_chunk_size = 0;
+            for (const auto *chunk: pm.at(part_no))
+                max_chunk_size = std::max(max_chunk_size, chunk->data_size);
+            sched.submit_coro(parse_tg, -static_cast<int64_t>(part_no),
+                parse_partition(cr, pm.at(part_no), part_no, on_block, on_part_init, on_part_done), max_chunk_size);
+        }
         sched.process();
     }
 
@@ -6,6 +6,7 @@
 #ifndef DAEDALUS_TURBO_STORAGE_PARTITION_HPP
 #define DAEDALUS_TURBO_STORAGE_PARTITION_HPP
 
+#include <dt/async-io.hpp>
 #include <dt/chunk-registry.hpp>
 
 namespace daedalus_turbo::storage {
@@ -167,6 +168,39 @@ namespace daedalus_turbo::storage {
         uint64_t size = 0;
     };
 
+    // A coroutine, so that the worker is released while a chunk is being read. Returns the number of parsed bytes.
+    template<typename T>
+    coro::task<uint64_t> parse_partition(const chunk_registry &cr, const partition &part, const size_t part_no,
+        const std::function<void(T&, const cardano::block_container &blk)> &on_block,
+        const std::function<T(size_t, const partition &)> &on_part_init,
+        const std::function<void(T &&, size_t, const partition &)> &on_part_done)
+    {
+        write_vector data {};
+        auto tmp = on_part_init(part_no, part);
+        for (const auto *chunk: part) {
+            const auto canon_path = cr.chunk_path(*chunk);
+            co_await io_pool::get().run([&] {
+                zstd::read(canon_path, data);
+            });
+            cbor::zero2::decoder dec { data };
+            while (!dec.done()) {
+                auto &block_tuple = dec.read();
+                cardano::block_container blk { chunk->offset + numeric_cast<uint64_t>(block_tuple.data_begin() - data.data()), block_tuple, cr.config() };
+                try {
+                    on_block(tmp, blk);
+                } catch (const std::exception &ex) {
+                    throw error(fmt::format("failed to parse block at slot: {} hash: {}: {}", blk->slot(), blk->hash(), ex.what()));
+                }
+            }
+        }
+        try {
+            on_part_done(std::move(tmp), part_no, part);
+        } catch (const std::exception &ex) {
+            throw error(fmt::format("failed to complete partition [{}:{}]: {}", part.offset(), part.end_offset(), ex.what()));
+        }
+        co_return part.size();
+    }
+
     template<typename T>
     void parse_parallel(const chunk_registry &cr, const partition_map &pm,
         const std::function<void(T&, const cardano::block_container &blk)> &on_block,
@@ -174,6 +208,7 @@ namespace daedalus_turbo::storage {
         const std::function<void(T &&, size_t, const partition &)> &on_part_done,
         const std::optional<std::string> &progress_tag={})
     {
+        static const auto parse_tg = scheduler::group_id("parse-chunk");
         std::optional<progress_guard> pg {};
         if (progress_tag)
             pg.emplace({ *progress_tag });
@@ -182,40 +217,25 @@ namespace daedalus_turbo::storage {
                 sum += chunk->data_size;
             return sum;
         });
-        std::atomic_size_t parsed_size { 0 };
+        uint64_t parsed_size = 0;
         auto &sched = cr.sched();
-        for (size_t part_no = 0; part_no < pm.size(); ++part_no) {
-            sched.submit_void("parse-chunk", -static_cast<int64_t>(part_no), [&, part_no] {
-                write_vector data {};
-                const auto &part = pm.at(part_no);
-                auto tmp = on_part_init(part_no, part);
-                for (const auto *chunk: part) {
-                    const auto canon_path = cr.full_path(chunk->rel_path());
-                    zstd::read(canon_path, data);
-                    cbor::zero2::decoder dec { data };
-                    while (!dec.done()) {
-                        auto &block_tuple = dec.read();
-                        cardano::block_container blk { chunk->offset + numeric_cast<uint64_t>(block_tuple.data_begin() - data.data()), block_tuple, cr.config() };
-                        try {
-                            on_block(tmp, blk);
-                        } catch (const std::exception &ex) {
-                            throw error(fmt::format("failed to parse block at slot: {} hash: {}: {}", blk->slot(), blk->hash(), ex.what()));
-                        }
-                    }
-                }
-                try {
-                    on_part_done(std::move(tmp), part_no, part);
-                } catch (const std::exception &ex) {
-                    throw error(fmt::format("failed to complete partition [{}:{}]: {}", part.offset(), part.end_offset(), ex.what()));
-                }
-                if (progress_tag) {
-                    const auto done = parsed_size.fetch_add(part.size(), std::memory_order::relaxed) + part.size();
-                    auto &p = progress::get();
-                    p.update(*progress_tag, done, total_size);
-                    p.inform();
-                }
+        if (progress_tag) {
+            // observers are called from a single thread
+            sched.on_result<uint64_t>(parse_tg, [&](uint64_t &&part_size) {
+                parsed_size += part_size;
+                auto &p = progress::get();
+                p.update(*progress_tag, parsed_size, total_size);
+                p.inform();
             });
         }
+        for (size_t part_no = 0; part_no < pm.size(); ++part_no) {
+            // the chunks of a partition are parsed one at a time
+            size_t max_chunk_size = 0;
+            for (const auto *chunk: pm.at(part_no))
+                max_chunk_size = std::max(max_chunk_size, chunk->data_size);
+            sched.submit_coro(parse_tg, -static_cast<int64_t>(part_no),
+                parse_partition(cr, pm.at(part_no), part_no, on_block, on_part_init, on_part_done), max_chunk_size);
+        }
         sched.process();
     }
 
@@ -138,6 +138,7 @@ namespace daedalus_turbo::sync::p2p {
         client_manager &_client_manager;
         std::filesystem::path _raw_dir;
         uint8_vector _last_chunk {};
+        std::optional<uint64_t> _last_chunk_era {};
         std::optional<uint64_t> _last_chunk_id {};
         uint64_t _next_chunk_offset = 0;
         mutex::unique_lock::mutex_type _invalid_mutex alignas(mutex::alignment) {};
@@ -183,15 +184,20 @@ namespace daedalus_turbo::sync::p2p {
             }
         }
 
-        void _add_chunk(uint8_vector uncompressed, std::optional<uint8_vector> compressed={})
+        void _add_chunk(uint8_vector uncompressed, std::optional<uint8_vector> compressed={}, const std::optional<uint64_t> era={})
         {
             const auto chunk_offset = _next_chunk_offset;
-            _next_chunk_offset += uncompressed.size();
-            _parent.local_chain().sched().submit_void("parse", 100, [this, uncompressed=std::move(uncompressed), compressed=std::move(compressed), chunk_offset=chunk_offset]() mutable {
-                if (!compressed)
-                    compressed.emplace(zstd::compress(uncompressed, 3));
-                _parent.local_chain().add_compressed(chunk_offset, std::move(*compressed), std::move(uncompressed));
-            });
+            const auto chunk_size = uncompressed.size();
+            _next_chunk_offset += chunk_size;
+            _parent.local_chain().sched().submit_void("parse", 100, [this, uncompressed=std::move(uncompressed), compressed=std::move(compressed), chunk_offset=chunk_offset, era]() mutable {
+                // the compression level of the data from peers is unknown
+                int compression_level = 0;
+                if (!compressed) {
+                    compression_level = chunk_registry::fast_compression_level();
+                    compressed.emplace(_parent.local_chain().compress_chunk(uncompressed, era, compression_level));
+                }
+                _parent.local_chain().add_compressed(chunk_offset, std::move(*compressed), std::move(uncompressed), compression_level);
+            }, {}, chunk_size);
         }
 
         void _save_last_chunk()
@@ -199,7 +205,7 @@ namespace daedalus_turbo::sync::p2p {
             if (!_last_chunk.empty()) {
                 auto uncompressed = std::move(_last_chunk);
                 _last_chunk.clear();
-                _add_chunk(std::move(uncompressed));
+                _add_chunk(std::move(uncompressed), {}, _last_chunk_era);
             }
         }
 
@@ -214,6 +220,7 @@ namespace daedalus_turbo::sync::p2p {
                 _last_chunk_id = blk_chunk_id;
             }
             _last_chunk << blk.raw();
+            _last_chunk_era = blk->era();
         }
     };
 
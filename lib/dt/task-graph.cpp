@@ -0,0 +1,307 @@
+/* This file is part of Daedalus Turbo project: https://github.com/sierkov/daedalus-turbo/
+ * Copyright (c) 2022-2023 Alex Sierkov (alex dot sierkov at gmail dot com)
+ * Copyright (c) 2024-2025 R2 Rationality OÜ (info at r2rationality dot com)
+ * This code is distributed under the license specified in:
+ * https://github.com/sierkov/daedalus-turbo/blob/main/LICENSE */
+
+#include <condition_variable>
+#include <deque>
+#include <exception>
+#include <optional>
+#include <dt/mutex.hpp>
+#include <dt/task-graph.hpp>
+
+namespace daedalus_turbo {
+    struct task_graph::impl: std::enable_shared_from_this<impl> {
+        impl(scheduler &sched, const std::string &task_group, const int64_t prio_base)
+            : _sched { sched }, _task_group { scheduler::group_id(task_group) }, _prio_base { prio_base }
+        {
+        }
+
+        node_id add(action_type &&action, const std::vector<node_id> &preds, const uint64_t cost, const std::optional<node_id> parent={})
+        {
+            mutex::scoped_lock lk { _mutex };
+            if (_submitted && !parent)
+                throw error(fmt::format("task graph {}: nodes cannot be added after submit, spawn them from a running node", scheduler::group_name(_task_group)));
+            if (parent && _nodes[*parent].sealed)
+                throw error(fmt::format("task graph {}: node {} can spawn children only while its action runs", scheduler::group_name(_task_group), *parent));
+            const node_id id = _nodes.size();
+            for (const auto p_id: preds) {
+                if (p_id >= id)
+                    throw error(fmt::format("task graph {}: node {} cannot depend on an unknown node {}", scheduler::group_name(_task_group), id, p_id));
+                if (_nodes[p_id].parent != parent)
+                    throw error(fmt::format("task graph {}: a spawned node can depend only on its siblings", scheduler::group_name(_task_group)));
+            }
+            // std::deque::emplace_back does not invalidate references to the existing elements
+            auto &n = _nodes.emplace_back(std::move(action), cost);
+            for (const auto p_id: preds) {
+                if (auto &p = _nodes[p_id]; !p.done) {
+                    p.succs.emplace_back(id);
+                    ++n.preds_left;
+                }
+            }
+            // the children are ranked and submitted once the parent's action has returned and all of them are known
+            if (parent) {
+                auto &p = _nodes[*parent];
+                ++p.parts_left;
+                p.children.emplace_back(id);
+                n.parent = parent;
+            }
+            ++_num_pending;
+            return id;
+        }
+
+        size_t size() const
+        {
+            mutex::scoped_lock lk { _mutex };
+            return _nodes.size();
+        }
+
+        int64_t priority(const node_id id) const
+        {
+            mutex::scoped_lock lk { _mutex };
+            if (!_submitted)
+                throw error(fmt::format("task graph {}: priorities are known only after submit", scheduler::group_name(_task_group)));
+            return _prio_base + _nodes.at(id).rank;
+        }
+
+        void submit()
+        {
+            std::vector<std::pair<node_id, int64_t>> ready {};
+            {
+                mutex::scoped_lock lk { _mutex };
+                if (_submitted)
+                    throw error(fmt::format("task graph {} has already been submitted", scheduler::group_name(_task_group)));
+                _submitted = true;
+                // node ids are a topological order since predecessors must be added first
+                for (node_id id = _nodes.size(); id > 0; --id) {
+                    auto &n = _nodes[id - 1];
+                    int64_t max_succ_rank = 0;
+                    for (const auto s_id: n.succs)
+                        max_succ_rank = std::max(max_succ_rank, _nodes[s_id].rank);
+                    n.rank = static_cast<int64_t>(n.cost) + max_succ_rank;
+                }
+                for (node_id id = 0; id < _nodes.size(); ++id) {
+                    if (!_nodes[id].preds_left)
+                        ready.emplace_back(id, _prio_base + _nodes[id].rank);
+                }
+            }
+            if (ready.empty()) {
+                _done_cv.notify_all();
+                if (auto handler = std::exchange(_on_done, {}))
+                    handler(std::optional<std::string> {});
+            }
+            for (const auto &[id, prio]: ready)
+                _submit(id, prio);
+        }
+
+        void on_done(done_handler &&handler)
+        {
+            mutex::scoped_lock lk { _mutex };
+            if (_submitted)
+                throw error(fmt::format("task graph {}: the done handler must be set before submit", scheduler::group_name(_task_group)));
+            _on_done = std::move(handler);
+        }
+
+        void wait()
+        {
+            if (_sched.num_workers() < 2)
+                throw error(fmt::format("task graph {}: waiting requires at least two worker threads", scheduler::group_name(_task_group)));
+            mutex::unique_lock lk { _mutex };
+            if (!_submitted)
+                throw error(fmt::format("task graph {} must be submitted before waiting for it", scheduler::group_name(_task_group)));
+            // a waiting worker executes the queued tasks instead of being parked until the graph completes
+            while (_num_pending != 0) {
+                lk.unlock();
+                const auto executed = _sched.execute_once(std::chrono::milliseconds { 1 });
+                lk.lock();
+                if (!executed)
+                    _done_cv.wait(lk, [&] { return _num_pending == 0; });
+            }
+            if (_error)
+                throw error(*_error);
+        }
+    private:
+        struct node {
+            action_type action;
+            uint64_t cost;
+            std::vector<node_id> succs {};
+            std::optional<node_id> parent {};
+            // the spawned nodes waiting for the own action to return
+            std::vector<node_id> children {};
+            int64_t rank = 0;
+            size_t preds_left = 0;
+            // the own action plus the spawned children
+            size_t parts_left = 1;
+            // set once the own action has returned, so no more children can be spawned
+            bool sealed = false;
+            bool done = false;
+        };
+
+        scheduler &_sched;
+        const task_group_id _task_group;
+        const int64_t _prio_base;
+        mutable mutex::unique_lock::mutex_type _mutex alignas(mutex::alignment) {};
+        std::condition_variable _done_cv {};
+        std::deque<node> _nodes {};
+        size_t _num_pending = 0;
+        bool _submitted = false;
+        std::optional<std::string> _error {};
+        done_handler _on_done {};
+
+        void _submit(const node_id id, const int64_t prio)
+        {
+            _sched.submit(_task_group, prio, [self=shared_from_this(), id] {
+                self->_run(id);
+            });
+        }
+
+        void _run(const node_id id)
+        {
+            action_type action {};
+            bool skip;
+            {
+                mutex::scoped_lock lk { _mutex };
+                action = std::move(_nodes[id].action);
+                skip = _error.has_value();
+            }
+            std::exception_ptr ex {};
+            // the successors of a failed node are not executed but are still marked as complete so that waiters are released
+            if (!skip) {
+                try {
+                    node_context ctx { shared_from_this(), id };
+                    action(ctx);
+                } catch (const std::exception &e) {
+                    ex = std::current_exception();
+                    _set_error(fmt::format("task graph {} node {} has failed: {}", scheduler::group_name(_task_group), id, e.what()));
+                } catch (...) {
+                    ex = std::current_exception();
+                    _set_error(fmt::format("task graph {} node {} has failed with an unknown exception", scheduler::group_name(_task_group), id));
+                }
+            }
+            // release the captured resources before the successors start
+            action = {};
+            _submit_children(id);
+            _finish(id);
+            if (ex)
+                std::rethrow_exception(ex);
+        }
+
+        void _submit_children(const node_id id)
+        {
+            std::vector<std::pair<node_id, int64_t>> ready {};
+            {
+                mutex::scoped_lock lk { _mutex };
+                auto &p = _nodes[id];
+                p.sealed = true;
+                // the successors of the parent wait for the children, so they inherit the rest of its critical path
+                const auto tail_rank = p.rank - static_cast<int64_t>(p.cost);
+                // children depend only on their earlier siblings, so the reverse order is a reverse topological one
+                for (auto it = p.children.rbegin(); it != p.children.rend(); ++it) {
+                    auto &c = _nodes[*it];
+                    int64_t max_succ_rank = tail_rank;
+                    for (const auto s_id: c.succs)
+                        max_succ_rank = std::max(max_succ_rank, _nodes[s_id].rank);
+                    c.rank = static_cast<int64_t>(c.cost) + max_succ_rank;
+                }
+                for (const auto c_id: p.children) {
+                    if (!_nodes[c_id].preds_left)
+                        ready.emplace_back(c_id, _prio_base + _nodes[c_id].rank);
+                }
+                p.children = {};
+            }
+            for (const auto &[c_id, prio]: ready)
+                _submit(c_id, prio);
+        }
+
+        void _set_error(std::string &&msg)
+        {
+            mutex::scoped_lock lk { _mutex };
+            if (!_error)
+                _error = std::move(msg);
+        }
+
+        void _finish(const node_id id)
+        {
+            std::vector<std::pair<node_id, int64_t>> ready {};
+            bool all_done = false;
+            done_handler on_done {};
+            std::optional<std::string> err {};
+            {
+                mutex::scoped_lock lk { _mutex };
+                for (std::optional<node_id> cur = id; cur; ) {
+                    auto &n = _nodes[*cur];
+                    if (--n.parts_left)
+                        break;
+                    n.done = true;
+                    --_num_pending;
+                    for (const auto s_id: n.succs) {
+                        auto &s = _nodes[s_id];
+                        if (!--s.preds_left)
+                            ready.emplace_back(s_id, _prio_base + s.rank);
+                    }
+                    n.succs.clear();
+                    cur = n.parent;
+                }
+                all_done = _num_pending == 0;
+                if (all_done) {
+                    on_done = std::exchange(_on_done, {});
+                    err = _error;
+                }
+            }
+            if (all_done) {
+                _done_cv.notify_all();
+                if (on_done)
+                    on_done(err);
+            }
+            for (const auto &[s_id, prio]: ready)
+                _submit(s_id, prio);
+        }
+    };
+
+    task_graph::node_context::node_context(const std::shared_ptr<impl> &g, const node_id id): _graph { g }, _id { id }
+    {
+    }
+
+    task_graph::node_id task_graph::node_context::_spawn(action_type &&action, const std::vector<node_id> &preds, const uint64_t cost)
+    {
+        return _graph->add(std::move(action), preds, cost, _id);
+    }
+
+    task_graph::task_graph(scheduler &sched, const std::string &task_group, const int64_t prio_base)
+        : _impl { std::make_shared<impl>(sched, task_group, prio_base) }
+    {
+    }
+
+    task_graph::~task_graph() =default;
+
+    size_t task_graph::size() const
+    {
+        return _impl->size();
+    }
+
+    int64_t task_graph::priority(const node_id id) const
+    {
+        return _impl->priority(id);
+    }
+
+    void task_graph::on_done(done_handler &&handler)
+    {
+        _impl->on_done(std::move(handler));
+    }
+
+    void task_graph::submit()
+    {
+        _impl->submit();
+    }
+
+    void task_graph::wait()
+    {
+        _impl->wait();
+    }
+
+    task_graph::node_id task_graph::_add(action_type &&action, const std::vector<node_id> &preds, const uint64_t cost)
+    {
+        return _impl->add(std::move(action), preds, cost);
+    }
+}
@@ -0,0 +1,94 @@
+/* This file is part of Daedalus Turbo project: https://github.com/sierkov/daedalus-turbo/
+ * Copyright (c) 2022-2023 Alex Sierkov (alex dot sierkov at gmail dot com)
+ * Copyright (c) 2024-2025 R2 Rationality OÜ (info at r2rationality dot com)
+ * This code is distributed under the license specified in:
+ * https://github.com/sierkov/daedalus-turbo/blob/main/LICENSE */
+#ifndef DAEDALUS_TURBO_TASK_GRAPH_HPP
+#define DAEDALUS_TURBO_TASK_GRAPH_HPP
+
+#include <functional>
+#include <memory>
+#include <vector>
+#include <dt/scheduler.hpp>
+
+namespace daedalus_turbo {
+    // A dependency graph of scheduler tasks. A node is submitted to the scheduler as soon as all its predecessors
+    // have completed, directly from the worker that completed the last of them.
+    // Node priorities are prio_base plus the cost of the longest path from the node to a sink,
+    // so that the tasks on the critical path are picked up first.
+    struct task_graph {
+        using node_id = size_t;
+        struct impl;
+
+        // Passed to node actions. Allows a node to add child nodes once it knows the amount of work.
+        // The children start once the parent's action has returned. Their priorities are computed as for the top-level nodes
+        // with the rest of the parent's critical path added. The parent node is considered complete only after all its children have completed.
+        struct node_context {
+            node_context(const std::shared_ptr<impl> &g, node_id id);
+
+            // preds may refer only to other children of the same node
+            template<typename F>
+            node_id spawn(F &&action, const std::vector<node_id> &preds={}, const uint64_t cost=1)
+            {
+                return _spawn(_make_action(std::forward<F>(action)), preds, cost);
+            }
+
+            node_id id() const
+            {
+                return _id;
+            }
+        private:
+            std::shared_ptr<impl> _graph;
+            node_id _id;
+
+            node_id _spawn(std::function<void (node_context &)> &&action, const std::vector<node_id> &preds, uint64_t cost);
+        };
+        using action_type = std::function<void (node_context &)>;
+        using done_handler = std::function<void (const std::optional<std::string> &error)>;
+
+        task_graph(scheduler &sched, const std::string &task_group, int64_t prio_base=0);
+        ~task_graph();
+
+        // preds must have been added before; cost is in arbitrary units shared by all nodes of the graph
+        template<typename F>
+        node_id add(F &&action, const std::vector<node_id> &preds={}, const uint64_t cost=1)
+        {
+            return _add(_make_action(std::forward<F>(action)), preds, cost);
+        }
+
+        size_t size() const;
+        int64_t priority(node_id id) const;
+        // called by the worker completing the last node with the error of the first failed node, if any;
+        // allows to learn the outcome of a graph that is not waited for; must be set before submit
+        void on_done(done_handler &&handler);
+        // computes the node priorities and submits the nodes without predecessors
+        void submit();
+        // blocks until all nodes have completed, throws if any of them has failed
+        // can be called from within a scheduler task, in which case the worker executes queued tasks while waiting
+        void wait();
+
+        void run()
+        {
+            submit();
+            wait();
+        }
+    private:
+        std::shared_ptr<impl> _impl;
+
+        template<typename F>
+        static action_type _make_action(F &&action)
+        {
+            if constexpr (std::is_invocable_v<F &, node_context &>) {
+                return std::forward<F>(action);
+            } else {
+                return [act=std::forward<F>(action)](node_context &) mutable {
+                    act();
+                };
+            }
+        }
+
+        node_id _add(action_type &&action, const std::vector<node_id> &preds, uint64_t cost);
+    };
+}
+
+#endif // !DAEDALUS_TURBO_TASK_GRAPH_HPP
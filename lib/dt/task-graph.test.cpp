@@ -0,0 +1,185 @@
+/* This file is part of Daedalus Turbo project: https://github.com/sierkov/daedalus-turbo/
+ * Copyright (c) 2022-2023 Alex Sierkov (alex dot sierkov at gmail dot com)
+ * Copyright (c) 2024-2025 R2 Rationality OÜ (info at r2rationality dot com)
+ * This code is distributed under the license specified in:
+ * https://github.com/sierkov/daedalus-turbo/blob/main/LICENSE */
+
+#include <atomic>
+#include <dt/common/test.hpp>
+#include <dt/task-graph.hpp>
+
+using namespace daedalus_turbo;
+
+suite task_graph_suite = [] {
+    "task_graph"_test = [] {
+        "dependencies"_test = [] {
+            scheduler s {};
+            std::atomic_size_t step { 0 };
+            std::atomic_size_t a_step { 0 }, b_step { 0 }, c_step { 0 }, d_step { 0 };
+            task_graph g { s, "graph-diamond" };
+            const auto a = g.add([&] { a_step = ++step; });
+            const auto b = g.add([&] { b_step = ++step; }, { a });
+            const auto c = g.add([&] { c_step = ++step; }, { a });
+            g.add([&] { d_step = ++step; }, { b, c });
+            g.run();
+            expect(s.process_ok());
+            test_same(1, a_step.load());
+            expect(b_step > a_step);
+            expect(c_step > a_step);
+            test_same(4, d_step.load());
+        };
+        "critical path priorities"_test = [] {
+            scheduler s {};
+            task_graph g { s, "graph-priorities", 100 };
+            const auto a = g.add([] {});
+            const auto b = g.add([] {}, { a }, 10);
+            const auto c = g.add([] {}, { b });
+            const auto x = g.add([] {});
+            const auto y = g.add([] {}, { a, x });
+            g.run();
+            expect(s.process_ok());
+            test_same(112, g.priority(a));
+            test_same(111, g.priority(b));
+            test_same(101, g.priority(c));
+            test_same(102, g.priority(x));
+            test_same(101, g.priority(y));
+        };
+        "spawned children"_test = [] {
+            scheduler s {};
+            std::atomic_size_t num_parts { 0 };
+            size_t parts_seen = 0;
+            bool committed = false;
+            task_graph g { s, "graph-spawn" };
+            const auto m = g.add([&](task_graph::node_context &ctx) {
+                std::vector<task_graph::node_id> parts {};
+                for (size_t i = 0; i < 16; ++i)
+                    parts.emplace_back(ctx.spawn([&] { ++num_parts; }));
+                ctx.spawn([&] {
+                    parts_seen = num_parts.load();
+                    committed = true;
+                }, parts);
+            });
+            size_t seen_by_successor = 0;
+            g.add([&] {
+                expect(committed);
+                seen_by_successor = num_parts.load();
+            }, { m });
+            g.run();
+            expect(s.process_ok());
+            test_same(16, parts_seen);
+            test_same(16, seen_by_successor);
+        };
+        "spawned priorities"_test = [] {
+            scheduler s {};
+            task_graph g { s, "graph-spawn-priorities", 100 };
+            std::vector<task_graph::node_id> parts {};
+            task_graph::node_id commit = 0, nested = 0;
+            const auto m = g.add([&](task_graph::node_context &ctx) {
+                parts.emplace_back(ctx.spawn([] {}, {}, 4));
+                parts.emplace_back(ctx.spawn([&](task_graph::node_context &part_ctx) {
+                    nested = part_ctx.spawn([] {});
+                }));
+                commit = ctx.spawn([] {}, parts, 2);
+            }, {}, 5);
+            g.add([] {}, { m }, 3);
+            g.run();
+            expect(s.process_ok());
+            test_same(108, g.priority(m));
+            // the children precede the parent's successor and the commit
+            test_same(105, g.priority(commit));
+            test_same(109, g.priority(parts.at(0)));
+            test_same(106, g.priority(parts.at(1)));
+            test_same(106, g.priority(nested));
+        };
+        "failed nodes"_test = [] {
+            scheduler s {};
+            std::atomic_size_t num_runs { 0 };
+            task_graph g { s, "graph-failure" };
+            const auto a = g.add([] { throw error("Ha ha! I told ya!"); });
+            const auto b = g.add([&] { ++num_runs; }, { a });
+            g.add([&] { ++num_runs; }, { b });
+            g.add([&] { ++num_runs; });
+            expect(throws([&] { g.run(); }));
+            expect(!s.process_ok());
+            expect(num_runs.load() <= 1_ull);
+        };
+        "wait from within a task"_test = [] {
+            scheduler s {};
+            std::atomic_size_t num_runs { 0 };
+            s.submit_void("graph-parent", 100, [&] {
+                task_graph g { s, "graph-nested" };
+                std::vector<task_graph::node_id> first {};
+                for (size_t i = 0; i < 8; ++i)
+                    first.emplace_back(g.add([&] { ++num_runs; }));
+                g.add([&] { ++num_runs; }, first);
+                g.run();
+            });
+            expect(s.process_ok());
+            test_same(9, num_runs.load());
+        };
+        "waiting worker executes the nodes"_test = [] {
+            scheduler s { 2 };
+            std::atomic_bool graph_done { false }, blocker_timed_out { false };
+            std::atomic_size_t num_foreign { 0 };
+            // keeps the other worker busy until the graph completes
+            s.submit_void("graph-blocker", 200, [&] {
+                const auto start = std::chrono::system_clock::now();
+                while (!graph_done) {
+                    if (std::chrono::system_clock::now() - start > std::chrono::seconds { 5 }) {
+                        blocker_timed_out = true;
+                        break;
+                    }
+                    std::this_thread::sleep_for(std::chrono::milliseconds { 1 });
+                }
+            });
+            s.submit_void("graph-parent", 100, [&] {
+                const auto parent_id = std::this_thread::get_id();
+                task_graph g { s, "graph-helped" };
+                std::vector<task_graph::node_id> first {};
+                for (size_t i = 0; i < 8; ++i) {
+                    first.emplace_back(g.add([&] {
+                        if (std::this_thread::get_id() != parent_id)
+                            ++num_foreign;
+                    }));
+                }
+                g.add([] {}, first);
+                g.run();
+                graph_done = true;
+            });
+            expect(s.process_ok());
+            expect(!blocker_timed_out);
+            test_same(0, num_foreign.load());
+        };
+        "done handler"_test = [] {
+            scheduler s {};
+            std::atomic_size_t num_runs { 0 };
+            std::optional<std::optional<std::string>> ok_res {}, fail_res {};
+            {
+                task_graph g { s, "graph-done-ok" };
+                g.add([&](task_graph::node_context &ctx) {
+                    for (size_t i = 0; i < 4; ++i)
+                        ctx.spawn([&] { ++num_runs; });
+                });
+                g.on_done([&](const auto &err) { ok_res.emplace(err); });
+                g.submit();
+            }
+            {
+                task_graph g { s, "graph-done-fail" };
+                const auto a = g.add([] { throw error("Ha ha! I told ya!"); });
+                g.add([&] { ++num_runs; }, { a });
+                g.on_done([&](const auto &err) { fail_res.emplace(err); });
+                g.submit();
+            }
+            s.process_ok();
+            test_same(4, num_runs.load());
+            expect(ok_res && !*ok_res);
+            expect(fail_res && *fail_res && (*fail_res)->find("I told ya") != std::string::npos);
+        };
+        "empty graph"_test = [] {
+            scheduler s {};
+            task_graph g { s, "graph-empty" };
+            g.run();
+            test_same(0, g.size());
+        };
+    };
+};
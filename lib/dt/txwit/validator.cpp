@@ -811,18 +811,15 @@ namespace daedalus_turbo::txwit {
                 sched.wait_all_done(task_id, part.utxos.num_parts, [&] {
                     for (size_t pi = 0; pi < part.utxos.num_parts; ++pi) {
                         sched.submit_void(task_id, 2000, [&, pi] {
-                            auto &utxo_part =  const_cast<txo_map &>(_st.utxos()).partition(pi);
+                            auto &utxo_part =  const_cast<utxo_store &>(_st.utxos()).partition(pi);
                             auto &ue_part = part.utxos.partition(pi);
                             for (auto &&[txo_id, txo_data]: ue_part) {
                                 if (txo_data) {
-                                    if (auto [it, created] = utxo_part.try_emplace(txo_id, std::move(txo_data)); !created) [[unlikely]]
-                                        logger::warn("txwit: epoch: {} a non-unique TXO {}!", part.epoch, it->first);
+                                    if (!utxo_part.try_emplace(txo_id, txo_data)) [[unlikely]]
+                                        logger::warn("txwit: epoch: {} a non-unique TXO {}!", part.epoch, txo_id);
                                 } else {
-                                    if (auto it = utxo_part.find(txo_id); it != utxo_part.end()) [[likely]] {
-                                        utxo_part.erase(it);
-                                    } else {
+                                    if (!utxo_part.erase(txo_id)) [[unlikely]]
                                         throw error(fmt::format("epoch: {} request to remove an unknown TXO {}!", part.epoch, txo_id));
-                                    }
                                 }
                             }
                         });
@@ -836,10 +833,10 @@ namespace daedalus_turbo::txwit {
                 // process inputs before they are moved into the plutus::context
                 for (auto &[id, data]: tx.inputs) {
                     if (!data) {
-                        const auto it = utxos.find(id);
-                        if (it == utxos.end()) [[unlikely]]
+                        auto txo_data = utxos.find(id);
+                        if (!txo_data) [[unlikely]]
                             throw error(fmt::format("tx {} references an unknown TXO {}!", tx.tx_id, id));
-                        data = it->second;
+                        data = std::move(*txo_data);
                     }
                     tx.balances.in_coin += data.coin;
                     for (const auto &[policy_id, assets]: data.assets) {
@@ -855,10 +852,10 @@ namespace daedalus_turbo::txwit {
                 }
                 for (auto &[id, data]: tx.ref_inputs) {
                     if (!data) {
-                        const auto it = utxos.find(id);
-                        if (it == utxos.end()) [[unlikely]]
+                        auto txo_data = utxos.find(id);
+                        if (!txo_data) [[unlikely]]
                             throw error(fmt::format("tx {} references an unknown TXO {}!", tx.tx_id, id));
-                        data = it->second;
+                        data = std::move(*txo_data);
                     }
                     if (data.script_ref) {
                         if (data.script_ref->type() == script_type::native)
@@ -1044,7 +1041,7 @@ namespace daedalus_turbo::txwit {
                 if (first_epoch != part.epoch || last_epoch != part.epoch) [[unlikely]]
                     throw error(fmt::format("batch: {} contains data from multiple epochs: {}, {}, {}", batch_no, part.epoch, first_epoch, last_epoch));
 
-                const auto canon_path = cr.full_path(chunk.rel_path());
+                const auto canon_path = cr.chunk_path(chunk);
                 const auto data = zstd::read(canon_path);
                 cbor::zero2::decoder dec { data };
                 while (!dec.done()) {
@@ -1112,6 +1109,9 @@ namespace daedalus_turbo::txwit {
             const auto ex_ptr = logger::run_log_errors([&] {
                 std::shared_ptr<parallel::ordered_queue> part_q = std::make_shared<parallel::ordered_queue>();
                 for (size_t bi = 0; bi < batches.size(); ++bi) {
+                    uint64_t batch_size = 0;
+                    for (const auto *c_ptr: batches[bi])
+                        batch_size += c_ptr->data_size;
                     sched.submit_void(task_id, -static_cast<int64_t>(bi), [&, bi] {
                         try {
                             if (!part_c.cancel()) {
@@ -1136,7 +1136,7 @@ namespace daedalus_turbo::txwit {
                             const auto msg = fmt::format("batch {}: pre-processing failed: {} chunks: {}", bi, ex.what(), chunk_info);
                             throw error(msg);
                         }
-                    }, bi);
+                    }, bi, batch_size);
                 }
                 // let the running consumer tasks to finish
                 sched.process(true);
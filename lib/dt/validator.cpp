@@ -4,6 +4,7 @@
  * This code is distributed under the license specified in:
  * https://github.com/sierkov/daedalus-turbo/blob/main/LICENSE */
 
+#include <cstdlib>
 #include <dt/cardano/common/common.hpp>
 #include <dt/cardano/ledger/state.hpp>
 #include <dt/cardano/ledger/updates.hpp>
@@ -14,6 +15,7 @@
 #include <dt/index/utxo.hpp>
 #include <dt/index/vrf.hpp>
 #include <dt/mutex.hpp>
+#include <dt/task-graph.hpp>
 #include <dt/validator.hpp>
 #include <dt/zpp.hpp>
 
@@ -22,12 +24,15 @@ namespace daedalus_turbo::validator {
 
     snapshot snapshot::from_json(const json::value &j)
     {
-        return snapshot {
+        snapshot snap {
             json::value_to<uint64_t>(j.at("epoch")),
             json::value_to<uint64_t>(j.at("endOffset")),
             json::value_to<uint64_t>(j.at("lastSlot")),
             json::value_to<bool>(j.at("exportable"))
         };
+        if (const auto *base = j.as_object().if_contains("baseEndOffset"); base)
+            snap.base_end_offset = json::value_to<uint64_t>(*base);
+        return snap;
     }
 
     snapshot::snapshot(const cardano::ledger::state &st)
@@ -42,12 +47,20 @@ namespace daedalus_turbo::validator {
 
     json::object snapshot::to_json() const
     {
-        return json::object {
+        json::object j {
             { "epoch", epoch },
             { "endOffset", end_offset },
             { "lastSlot", last_slot },
             { "exportable", exportable }
         };
+        if (base_end_offset)
+            j.emplace("baseEndOffset", *base_end_offset);
+        return j;
+    }
+
+    bool snapshot_set::is_base(const uint64_t end_offset) const
+    {
+        return std::any_of(begin(), end(), [&](const auto &snap) { return snap.base_end_offset == end_offset; });
     }
 
     snapshot_set::const_iterator snapshot_set::next_excessive() const
@@ -60,14 +73,17 @@ namespace daedalus_turbo::validator {
         --end_it;
         --end_it;
         for (auto it = begin(); it != end_it; ++it) {
+            // the bases must stay while their deltas are there
+            if (is_base(it->end_offset))
+                continue;
             // The score is the number of epochs till the next snapshot.
             // The lower score, the less important the snapshot is.
             // <= is used so that an earlier snapshot with the same score is kept
             if (const auto score = std::next(it)->epoch - it->epoch; !min || score <= min->second)
                 min.emplace(it, score);
         }
-        if (!min) [[unlikely]]
-            throw error("internal error: couldn't identify the least useful snapshot!");
+        if (!min)
+            return end();
         return min->first;
     }
 
@@ -106,9 +122,9 @@ namespace daedalus_turbo::validator {
         impl(chunk_registry &cr)
         : _cr { cr },
             _validate_dir { chunk_registry::init_db_dir((_cr.data_dir() / "validate").string()) },
-            _state_path { (_validate_dir / "state.json").string() },
-            _state_pre_path { (_validate_dir / "state-pre.json").string() },
-            _state { _cr.config(), _cr.sched() }
+            _state_path { (_validate_dir / fmt::format("state-v{}.json", cardano::ledger::state::zpp_version)).string() },
+            _state_pre_path { (_validate_dir / fmt::format("state-v{}-pre.json", cardano::ledger::state::zpp_version)).string() },
+            _state { _cr.config(), _cr.sched(), _utxo_config(_validate_dir) }
         {
             _load_state();
             _cr.register_processor(_proc);
@@ -349,7 +365,7 @@ namespace daedalus_turbo::validator {
                     _state.save_node(path, snap_tip, prio_base);
                 } else {
                     cardano::ledger::state snap_state { _cr.config(), _cr.sched() };
-                    snap_state.load_zpp(_storage_path("ledger", best_snap->end_offset));
+                    load_snapshot(snap_state, *best_snap);
                     const auto snap_tip = _cr.find_block_by_offset(best_snap->end_offset - 1).point();
                     snap_state.save_node(path, snap_tip, prio_base);
                 }
@@ -368,9 +384,12 @@ namespace daedalus_turbo::validator {
             return _snapshots;
         }
 
-        void load_snapshot(cardano::ledger::state &st, const snapshot &snap) const
+        void load_snapshot(cardano::ledger::state &st, const snapshot &snap, const bool as_base=false) const
         {
-            st.load_zpp(_storage_path("ledger", snap.end_offset));
+            if (snap.base_end_offset)
+                st.load_zpp(_storage_path("ledger", *snap.base_end_offset), _storage_path("ledger", snap.end_offset), as_base);
+            else
+                st.load_zpp(_storage_path("ledger", snap.end_offset), as_base);
             if (st.end_offset() != snap.end_offset)
                 throw error(fmt::format("loaded state does not match the recorded end offset: {} != {}", st.end_offset(), snap.end_offset));
             if (st.end_offset() != st.valid_end_offset())
@@ -380,10 +399,27 @@ namespace daedalus_turbo::validator {
         static constexpr uint64_t snapshot_hifreq_end_offset_range = static_cast<uint64_t>(1) << 30;
         static constexpr uint64_t snapshot_hifreq_distance = static_cast<uint64_t>(1) << 27;
         static constexpr uint64_t snapshot_normal_distance = indexer::merger::part_size * 2;
+        // the number of delta snapshots after which the next one is a full one, a new base
+        static constexpr size_t snapshot_max_deltas = 8;
 
         using timed_update_list = vector<index::timed_update::item>;
         using epoch_task_map = map<uint64_t, cardano::slot_range>;
 
+        struct epoch_updates {
+            updates_t updates {};
+            std::optional<uint64_t> min_offset {};
+            std::shared_ptr<vector<index::vrf::item>> vrf_updates = std::make_shared<vector<index::vrf::item>>();
+        };
+
+        // keeps the cold UTxO runs next to the snapshots unless DT_UTXO_COLD_DIR says otherwise
+        static utxo_store_config_ptr _utxo_config(const std::filesystem::path &validate_dir)
+        {
+            const auto &defaults = utxo_store_config::get();
+            if (std::getenv("DT_UTXO_COLD_DIR"))
+                return defaults;
+            return std::make_shared<const utxo_store_config>(defaults->hot_budget, validate_dir / "utxo");
+        }
+
         chunk_registry &_cr;
         const std::filesystem::path _validate_dir;
         const std::string _state_path;
@@ -425,6 +461,9 @@ namespace daedalus_turbo::validator {
                 const auto j_snapshots = json::load(_state_path).as_array();
                 for (const auto &j_s: j_snapshots) {
                     const auto snap = snapshot::from_json(j_s.as_object());
+                    // the bases precede their deltas
+                    if (snap.base_end_offset && !_snapshots.contains(snapshot { 0, *snap.base_end_offset, 0, false }))
+                        continue;
                     if (const auto snap_path = _storage_path("ledger", snap.end_offset); std::filesystem::exists(snap_path)) {
                         _snapshots.emplace(std::move(snap));
                         known_files.insert(snap_path);
@@ -433,6 +472,7 @@ namespace daedalus_turbo::validator {
                 if (!_snapshots.empty())
                     end_offset = _load_state_snapshot(*_snapshots.rbegin());
             }
+            // includes the snapshots of the older layouts, whose snapshot lists have different names
             for (auto &e: std::filesystem::directory_iterator(_validate_dir)) {
                 const auto canon_path = std::filesystem::weakly_canonical(e.path()).string();
                 if (e.is_regular_file() && !known_files.contains(canon_path))
@@ -451,13 +491,14 @@ namespace daedalus_turbo::validator {
 
         uint64_t _load_state_snapshot(const snapshot &snap)
         {
-            load_snapshot(_state, snap);
+            load_snapshot(_state, snap, true);
             return _state.end_offset();
         }
 
         std::string _storage_path(const std::string_view &prefix, uint64_t end_offset) const
         {
-            return std::filesystem::weakly_canonical(_validate_dir / fmt::format("{}-{:013}.bin", prefix, end_offset)).string();
+            // versioned so that the deletion of an older snapshot cannot hit a newer one with the same end offset
+            return std::filesystem::weakly_canonical(_validate_dir / fmt::format("{}-v{}-{:013}.bin", prefix, cardano::ledger::state::zpp_version, end_offset)).string();
         }
 
         void _save_reserve_snapshot()
@@ -470,11 +511,38 @@ namespace daedalus_turbo::validator {
                 subchain_list tmp_sc {};
                 tmp_sc.add(subchain { 0, _state.end_offset(), last_block.height, last_block.height,
                     first_block.slot, first_block.hash, last_block.slot, last_block.hash });
-                _state.save_zpp(_storage_path("ledger-reserve", _state.end_offset()), std::make_unique<subchain_list>(std::move(tmp_sc)));
-                _reserve_snapshot.emplace(_state);
+                _reserve_snapshot.emplace(_save_snapshot(_storage_path("ledger-reserve", _state.end_offset()),
+                    std::make_unique<subchain_list>(std::move(tmp_sc))));
             }
         }
 
+        // a delta needs its base to be kept and is made only when there are not too many deltas of that base already
+        bool _can_save_delta() const
+        {
+            const auto base = _state.zpp_base();
+            if (!base)
+                return false;
+            const auto is_reserve = [&](const uint64_t end_offset) {
+                return _reserve_snapshot && _reserve_snapshot->end_offset == end_offset;
+            };
+            if (!_snapshots.contains(snapshot { 0, *base, 0, false }) && !is_reserve(*base))
+                return false;
+            auto num_deltas = std::count_if(_snapshots.begin(), _snapshots.end(), [&](const auto &snap) { return snap.base_end_offset == base; });
+            if (_reserve_snapshot && _reserve_snapshot->base_end_offset == base)
+                ++num_deltas;
+            return static_cast<size_t>(num_deltas) < snapshot_max_deltas;
+        }
+
+        snapshot _save_snapshot(const std::string &path, std::unique_ptr<subchain_list> tmp_sc={})
+        {
+            snapshot snap { _state };
+            if (_can_save_delta())
+                snap.base_end_offset = _state.save_zpp_delta(path, std::move(tmp_sc));
+            else
+                _state.save_zpp(path, std::move(tmp_sc));
+            return snap;
+        }
+
         void _save_state_snapshot()
         {
             logger::debug("initiating the saving of the validator state snapshot epoch: {} end_offset: {}", _state.epoch(), _state.end_offset());
@@ -483,9 +551,8 @@ namespace daedalus_turbo::validator {
                     logger::level::info };
             logger::debug("saving VRF state");
             logger::debug("saving the validator state");
-            _state.save_zpp(_storage_path("ledger", _state.end_offset()));
+            auto latest = _save_snapshot(_storage_path("ledger", _state.end_offset()));
             logger::debug("recording the new snapshot");
-            snapshot latest { _state };
             _snapshots.emplace(std::move(latest));
         }
 
@@ -525,7 +592,7 @@ namespace daedalus_turbo::validator {
                     throw error("internal error: a chunk that doesn't begin right after the snapshot's end");
                 for (; it != _cr.chunks().end(); ++it) {
                     const auto &chunk = it->second;
-                    const auto chunk_path = _cr.full_path(it->second.rel_path());
+                    const auto chunk_path = _cr.chunk_path(it->second);
                     for (const auto slot: { chunk.first_slot, chunk.last_slot }) {
                         const auto chunk_slot = _cr.make_slot(slot);
                         const auto [task_it, task_created] = _next_tasks.try_emplace(chunk_slot.epoch(), slot);
@@ -555,7 +622,7 @@ namespace daedalus_turbo::validator {
                             }
                         }
                         my_on_chunk_add(chunk, true);
-                    });
+                    }, {}, chunk.data_size);
                 }
                 _cr.sched().process(true);
             }
@@ -633,29 +700,7 @@ namespace daedalus_turbo::validator {
             return min_chunk_id;
         }
 
-        void _load_utxo_updates(updates_t &updates, const uint64_t epoch, const uint64_t min_offset, const std::string &name, const index::chunk_list &updated_chunks)
-        {
-            index::chunk_list relevant_chunks {};
-            for (const uint64_t c_id: updated_chunks) {
-                if (c_id >= min_offset)
-                    relevant_chunks.emplace_back(c_id);
-            }
-            if (!relevant_chunks.empty()) {
-                const std::string task_group = fmt::format("ledger-state:load-utxo-updates:epoch-{}", epoch);
-                updates.utxos.resize(relevant_chunks.size());
-                _cr.sched().wait_all_done(task_group, relevant_chunks.size(), [&] {
-                    for (size_t ci = 0; ci < relevant_chunks.size(); ++ci) {
-                        const auto chunk_path = fmt::format("{}.bin", _cr.indexer().indexers().at(name)->chunk_path("update", relevant_chunks[ci]));
-                        _cr.sched().submit_void(task_group, 1000, [ci, chunk_path, &updates] {
-                            zpp::load_zstd(updates.utxos[ci], chunk_path);
-                            std::filesystem::remove(chunk_path);
-                        });
-                    }
-                });
-            }
-        }
-
-        void _apply_ledger_state_updates_for_epoch(uint64_t e, const cardano::slot_range &slots, bool fast)
+        void _apply_ledger_state_updates_for_epoch(const uint64_t e, epoch_updates &eu, const bool fast)
         {
             timer te { fmt::format("apply_ledger_state_updates for epoch {}", e) };
             try {
@@ -663,21 +708,12 @@ namespace daedalus_turbo::validator {
                 const auto last_offset = _state.end_offset();
                 if (!last_offset || last_epoch < e)
                     _state.start_epoch(e);
-
-                std::optional<uint64_t> min_epoch_offset;
-                {
-                    updates_t updates {};
-                    min_epoch_offset = _gather_updates<index::block_fees::indexer>(updates.blocks, "block-fees", slots, last_offset);
-                    if (!min_epoch_offset)
-                        return;
-                    _gather_updates<index::timed_update::indexer>(updates.timed, "timed-update", slots, last_offset);
-                    _load_utxo_updates(updates, e, last_offset, "utxo", dynamic_cast<index::utxo::indexer &>(*_cr.indexer().indexers().at("utxo")).chunks(slots));
-                    _state.process_updates(std::move(updates));
-                }
-
-                const auto vrf_chunks = dynamic_cast<index::vrf::indexer &>(*_cr.indexer().indexers().at("vrf")).chunks(slots);
-                if (!vrf_chunks.empty())
-                    _process_vrf_update_chunks(*min_epoch_offset, vrf_chunks, fast);
+                if (!eu.min_offset)
+                    return;
+                _state.process_updates(std::move(eu.updates));
+                if (!eu.vrf_updates->empty())
+                    _process_vrf_updates(*eu.min_offset, eu.vrf_updates, fast);
+                eu.vrf_updates.reset();
 
                 if (_cr.tx()->target && _state.params().protocol_ver.major >= 3) {
                     if (const auto target_slot = _cr.make_slot(_cr.tx()->target->slot); target_slot.epoch() >= 2) {
@@ -701,25 +737,66 @@ namespace daedalus_turbo::validator {
             }
         }
 
+        // Each epoch is a chain of load nodes followed by an apply node depending on the loads and on the previous epoch's apply node.
+        // The loading of the next epoch's updates overlaps with the application of the current one but does not run further ahead
+        // to keep the memory use bounded.
         void _apply_ledger_state_updates(const epoch_task_map &tasks, const indexer::slice_list &/*slices*/, const bool fast)
         {
             const auto first_epoch = tasks.begin()->first;
             const auto last_epoch = tasks.rbegin()->first;
             timer t { fmt::format("validator::_apply_ledger_state_updates first_epoch: {} last_epoch: {} fast: {}", first_epoch, last_epoch, fast), logger::level::debug };
+            // chunks do not span epochs, so the current end offset filters out the already applied chunks of the first epoch
+            // and none of the chunks of the later ones
+            const auto min_offset = _state.end_offset();
+            const auto &indexers = _cr.indexer().indexers();
+            map<uint64_t, epoch_updates> epochs {};
+            task_graph g { _cr.sched(), "ledger-state:apply-updates", 1000 };
+            std::optional<task_graph::node_id> prev_apply {}, prev_prev_apply {};
             // add extra snapshots closer to the tip since rollbacks are more likely there
             for (const auto &[e, slots]: tasks) {
-                timer te { fmt::format("apply ledger updates for epoch: {}", e) };
-                try {
-                    _apply_ledger_state_updates_for_epoch(e, slots, fast);
-                    logger::info("applied ledger updates for epoch: {} end offset: {} utxos: {}", _state.epoch(), _state.end_offset(), _state.utxos().size());
-                } catch (const std::exception &ex) {
-                    logger::error("failed to process epoch {} updates: {}", e, ex.what());
-                    throw error(fmt::format("failed to process epoch {} updates: {}", e, ex.what()));
-                } catch (...) {
-                    logger::error("failed to process epoch {} updates: unknown exception", e);
-                    throw;
+                auto &eu = epochs[e];
+                std::vector<task_graph::node_id> load_deps {};
+                if (prev_prev_apply)
+                    load_deps.emplace_back(*prev_prev_apply);
+                std::vector<task_graph::node_id> apply_deps {};
+                apply_deps.emplace_back(g.add([this, &eu, &slots, min_offset] {
+                    eu.min_offset = _gather_updates<index::block_fees::indexer>(eu.updates.blocks, "block-fees", slots, min_offset);
+                }, load_deps));
+                apply_deps.emplace_back(g.add([this, &eu, &slots, min_offset] {
+                    _gather_updates<index::timed_update::indexer>(eu.updates.timed, "timed-update", slots, min_offset);
+                }, load_deps));
+                for (const uint64_t chunk_id: dynamic_cast<index::utxo::indexer &>(*indexers.at("utxo")).chunks(slots)) {
+                    if (chunk_id < min_offset)
+                        continue;
+                    const auto ci = eu.updates.utxos.size();
+                    eu.updates.utxos.emplace_back();
+                    const auto chunk_path = fmt::format("{}.bin", indexers.at("utxo")->chunk_path("update", chunk_id));
+                    apply_deps.emplace_back(g.add([&eu, ci, chunk_path] {
+                        zpp::load_zstd(eu.updates.utxos[ci], chunk_path);
+                        std::filesystem::remove(chunk_path);
+                    }, load_deps));
                 }
+                apply_deps.emplace_back(g.add([this, &indexers, &eu, &slots] {
+                    _load_vrf_updates(*eu.vrf_updates, dynamic_cast<index::vrf::indexer &>(*indexers.at("vrf")).chunks(slots));
+                }, load_deps));
+                if (prev_apply)
+                    apply_deps.emplace_back(*prev_apply);
+                prev_prev_apply = prev_apply;
+                prev_apply = g.add([this, e, &eu, fast] {
+                    timer te { fmt::format("apply ledger updates for epoch: {}", e) };
+                    try {
+                        _apply_ledger_state_updates_for_epoch(e, eu, fast);
+                        logger::info("applied ledger updates for epoch: {} end offset: {} utxos: {}", _state.epoch(), _state.end_offset(), _state.utxos().size());
+                    } catch (const std::exception &ex) {
+                        logger::error("failed to process epoch {} updates: {}", e, ex.what());
+                        throw error(fmt::format("failed to process epoch {} updates: {}", e, ex.what()));
+                    } catch (...) {
+                        logger::error("failed to process epoch {} updates: unknown exception", e);
+                        throw;
+                    }
+                }, apply_deps);
             }
+            g.run();
         }
 
         void _validate_epoch_leaders(const uint64_t epoch, const uint64_t epoch_min_offset, const std::shared_ptr<vector<index::vrf::item>> &vrf_updates_ptr,
@@ -762,37 +839,38 @@ namespace daedalus_turbo::validator {
                 _cr.report_progress("validate", { new_valid_tip->slot, new_valid_tip->end_offset });
         }
 
-        void _process_vrf_update_chunks(uint64_t epoch_min_offset, const vector<uint64_t> &chunks, const bool fast)
+        void _load_vrf_updates(vector<index::vrf::item> &vrf_updates, const vector<uint64_t> &chunks)
         {
-            const auto epoch = _state.epoch();
-            timer t { fmt::format("processed VRF nonce updates for epoch {}", epoch) };
-            const auto vrf_updates_ptr = std::make_shared<vector<index::vrf::item>>();
             for (const uint64_t chunk_id: chunks) {
                 const auto chunk_path = fmt::format("{}.bin", _cr.indexer().indexers().at("vrf")->chunk_path("update", chunk_id));
                 vector<index::vrf::item> chunk_updates {};
                 zpp::load_zstd(chunk_updates, chunk_path);
-                vrf_updates_ptr->reserve(vrf_updates_ptr->size() + chunk_updates.size());
+                vrf_updates.reserve(vrf_updates.size() + chunk_updates.size());
                 for (const auto &u: chunk_updates)
-                    vrf_updates_ptr->emplace_back(u);
+                    vrf_updates.emplace_back(u);
             }
-            if (!vrf_updates_ptr->empty()) {
-                std::sort(vrf_updates_ptr->begin(), vrf_updates_ptr->end());
-                if (!fast) {
-                    const auto pool_dist_ptr = std::make_shared<operating_pool_map>(_state.pool_stake_dist());
-                    const auto &nonce_epoch = _state.vrf_state().nonce_epoch();
-                    const auto &uc_nonce = _state.vrf_state().uc_nonce();
-                    const auto &uc_leader = _state.vrf_state().uc_leader();
-                    static constexpr size_t batch_size = 250;
-                    static std::string task_name { validate_leaders_task };
-                    for (size_t start = 0; start < vrf_updates_ptr->size(); start += batch_size) {
-                        auto end = std::min(start + batch_size, vrf_updates_ptr->size());
-                        _cr.sched().submit_void(task_name, -static_cast<int64_t>(epoch), [this, epoch, epoch_min_offset, vrf_updates_ptr, pool_dist_ptr, nonce_epoch, uc_nonce, uc_leader, start, end] {
-                            _validate_epoch_leaders(epoch, epoch_min_offset, vrf_updates_ptr, pool_dist_ptr, nonce_epoch, uc_nonce, uc_leader, start, end);
-                        }, chunk_offset_t { epoch_min_offset });
-                    }
+            std::sort(vrf_updates.begin(), vrf_updates.end());
+        }
+
+        void _process_vrf_updates(uint64_t epoch_min_offset, const std::shared_ptr<vector<index::vrf::item>> &vrf_updates_ptr, const bool fast)
+        {
+            const auto epoch = _state.epoch();
+            timer t { fmt::format("processed VRF nonce updates for epoch {}", epoch) };
+            if (!fast) {
+                const auto pool_dist_ptr = std::make_shared<operating_pool_map>(_state.pool_stake_dist());
+                const auto &nonce_epoch = _state.vrf_state().nonce_epoch();
+                const auto &uc_nonce = _state.vrf_state().uc_nonce();
+                const auto &uc_leader = _state.vrf_state().uc_leader();
+                static constexpr size_t batch_size = 250;
+                static std::string task_name { validate_leaders_task };
+                for (size_t start = 0; start < vrf_updates_ptr->size(); start += batch_size) {
+                    auto end = std::min(start + batch_size, vrf_updates_ptr->size());
+                    _cr.sched().submit_void(task_name, -static_cast<int64_t>(epoch), [this, epoch, epoch_min_offset, vrf_updates_ptr, pool_dist_ptr, nonce_epoch, uc_nonce, uc_leader, start, end] {
+                        _validate_epoch_leaders(epoch, epoch_min_offset, vrf_updates_ptr, pool_dist_ptr, nonce_epoch, uc_nonce, uc_leader, start, end);
+                    }, chunk_offset_t { epoch_min_offset });
                 }
-                _state.vrf_process_updates(*vrf_updates_ptr);
             }
+            _state.vrf_process_updates(*vrf_updates_ptr);
         }
     };
 
@@ -20,6 +20,8 @@ namespace daedalus_turbo::validator {
         uint64_t end_offset;
         uint64_t last_slot;
         bool exportable;
+        // set for the delta snapshots, which can be loaded only together with their base
+        std::optional<uint64_t> base_end_offset {};
 
         static snapshot from_json(const json::value &j);
         snapshot(const cardano::ledger::state &st);
@@ -28,7 +30,8 @@ namespace daedalus_turbo::validator {
 
         bool operator==(const snapshot &o) const
         {
-            return epoch == o.epoch && end_offset == o.end_offset && last_slot == o.last_slot && exportable == o.exportable;
+            return epoch == o.epoch && end_offset == o.end_offset && last_slot == o.last_slot && exportable == o.exportable
+                && base_end_offset == o.base_end_offset;
         }
 
         bool operator<(const snapshot &b) const
@@ -44,6 +47,7 @@ namespace daedalus_turbo::validator {
         using const_iterator = typename set<snapshot>::const_iterator;
         using best_predicate_t = std::function<bool(const snapshot &)>;
 
+        bool is_base(uint64_t end_offset) const;
         const_iterator next_excessive() const;
         void remove_excessive(const action_t &on_remove, const action_t &on_keep);
         const snapshot *best(const best_predicate_t &pred) const;
@@ -74,8 +78,11 @@ namespace fmt {
     struct formatter<daedalus_turbo::validator::snapshot>: formatter<uint64_t> {
         template<typename FormatContext>
         auto format(const daedalus_turbo::validator::snapshot &v, FormatContext &ctx) const -> decltype(ctx.out()) {
-            return fmt::format_to(ctx.out(), "epoch: {} last_slot: {} end_offset: {} {}",
+            auto out = fmt::format_to(ctx.out(), "epoch: {} last_slot: {} end_offset: {} {}",
                 v.epoch, v.last_slot, v.end_offset, v.exportable ? "exportable" : "");
+            if (v.base_end_offset)
+                out = fmt::format_to(out, " delta of: {}", *v.base_end_offset);
+            return out;
         }
     };
 }
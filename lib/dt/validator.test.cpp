@@ -112,5 +112,21 @@ suite validator_suite = [] {
             test_same(std::set<uint64_t> { 5, 200 }, removed);
             test_same(std::set<uint64_t> { 20, 250, 450, 518, 519 }, kept);
         };
+        "excessive snapshot with deltas"_test = [&] {
+            validator::snapshot_set s {};
+            s.emplace(5, 5 * 10000, 5 * 432000, false);
+            for (const uint64_t epoch: { 20, 200, 250, 450, 518, 519 }) {
+                validator::snapshot snap { epoch, epoch * 10000, epoch * 432000, false };
+                snap.base_end_offset = 5 * 10000;
+                s.emplace(std::move(snap));
+            }
+            expect(s.is_base(5 * 10000));
+            expect(!s.is_base(20 * 10000));
+            // the base is the least useful one by its score but must be kept
+            std::set<uint64_t> removed {}, kept {};
+            s.remove_excessive([&](const auto &s) { removed.emplace(s.epoch); }, [&](const auto &s) { kept.emplace(s.epoch); });
+            test_same(std::set<uint64_t> { 200, 450 }, removed);
+            test_same(std::set<uint64_t> { 5, 20, 250, 518, 519 }, kept);
+        };
     };
 };
\ No newline at end of file
@@ -6,15 +6,13 @@
 #ifndef DAEDALUS_TURBO_ZSTD_STREAM_HPP
 #define DAEDALUS_TURBO_ZSTD_STREAM_HPP
 
-extern "C" {
-#   include <zstd.h>
-#   include <zstd_errors.h>
-};
 #include <dt/common/file.hpp>
+#include <dt/zstd.hpp>
 
 namespace daedalus_turbo::zstd {
     struct read_stream {
-        read_stream(const std::string &path):
+        // without an explicit dictionary, the one recorded in the frame is looked up among the known dictionaries
+        read_stream(const std::string &path, const dictionary_ptr &dict={}):
             _fs { path },
             _zstd_ds { ZSTD_createDStream() },
             _in_buf(ZSTD_DStreamInSize()),
@@ -26,6 +24,8 @@ namespace daedalus_turbo::zstd {
                 throw error(fmt::format("failed to create a ZSTD decompression stream: {}", ZSTD_getErrorName(res)));
             if (!_read_from_file()) [[unlikely]]
                 throw error(fmt::format("failed to read the initial ZSTD data from {}", path));
+            // must follow ZSTD_initDStream since it resets the dictionary
+            _set_dictionary(path, dict);
             switch (const auto sz = ZSTD_getFrameContentSize(_in_buf.data(), _zstd_in_buf.size); sz) {
                 [[unlikely]] case ZSTD_CONTENTSIZE_UNKNOWN:
                     throw error(fmt::format("ZSTD content size is unknown: {}!", path));
@@ -71,6 +71,29 @@ namespace daedalus_turbo::zstd {
         write_vector _in_buf;
         ZSTD_inBuffer _zstd_in_buf;
         size_t _size = 0;
+        // the stream references the dictionary, so it must outlive the stream
+        dictionary_ptr _dict {};
+
+        void _set_dictionary(const std::string &path, const dictionary_ptr &dict)
+        {
+            const auto dict_id = dictionary_id(buffer { _in_buf.data(), _zstd_in_buf.size });
+            if (!dict_id) {
+                if (dict) [[unlikely]]
+                    throw error(fmt::format("ZSTD data in {} is not compressed with the dictionary {}", path, dict->id()));
+                return;
+            }
+            if (dict) {
+                if (dict->id() != dict_id) [[unlikely]]
+                    throw error(fmt::format("ZSTD data in {} needs the dictionary {} but got {}", path, dict_id, dict->id()));
+                _dict = dict;
+            } else {
+                _dict = dictionaries::get().find(dict_id);
+                if (!_dict) [[unlikely]]
+                    throw error(fmt::format("ZSTD data in {} needs the unknown dictionary {}", path, dict_id));
+            }
+            if (const auto res = ZSTD_DCtx_refDDict(_zstd_ds, _dict->ddict()); ZSTD_isError(res)) [[unlikely]]
+                throw error(fmt::format("failed to load the ZSTD dictionary {}: {}", dict_id, ZSTD_getErrorName(res)));
+        }
 
         bool _read_from_file()
         {
@@ -81,6 +104,16 @@ namespace daedalus_turbo::zstd {
             return true;
         }
     };
+
+    template<typename T=write_vector>
+    inline void read_steam(const std::string &path, T &out, const dictionary_ptr &dict={})
+    {
+        zstd::read_stream f { path, dict };
+        out.resize(f.size());
+        const auto nread = f.try_read(out);
+        if (nread != f.size()) [[unlikely]]
+            throw error(fmt::format("failed to read the advertized size {}: got only {} bytes!", out.size(), nread));
+    }
 }
 
 #endif // !DAEDALUS_TURBO_ZSTD_HPP
\ No newline at end of file
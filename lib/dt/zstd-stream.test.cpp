@@ -41,5 +41,35 @@ suite zstd_stream_suite = [] {
                 s.try_read(data);
             }));
         };
+        "dictionary"_test = [] {
+            std::vector<std::string> texts {};
+            for (size_t i = 0; i < 2000; ++i)
+                texts.emplace_back(fmt::format("{{\"slot\":{},\"block\":\"{:016X}\",\"inputs\":[{},{}]}}", i * 20, i * 0xC2B2AE3D27D4EB4FULL, i % 5, i % 11));
+            std::vector<buffer> samples {};
+            for (const auto &t: texts)
+                samples.emplace_back(t);
+            const auto dict = zstd::dictionary::train(samples, 4096);
+            const auto other_dict = zstd::dictionary::train(std::vector<buffer> { samples.begin(), samples.begin() + 1000 }, 2048);
+            uint8_vector orig {};
+            for (const auto &t: texts)
+                orig << buffer { t };
+            const file::tmp tmp { "zstd-stream-dict.zstd" };
+            uint8_vector compressed {};
+            zstd::compress(compressed, orig, 3, zstd::max_zstd_buffer, dict);
+            file::write(tmp.path(), compressed);
+            uint8_vector data {};
+            zstd::read_steam(tmp.path(), data, dict);
+            test_same(orig, data);
+            expect(throws([&] { zstd::read_stream s { tmp.path(), other_dict }; }));
+            // without an explicit dictionary, the frame's one must be known
+            expect(throws([&] { zstd::read_stream s { tmp.path() }; }));
+            zstd::dictionaries::get().add(dict);
+            data.clear();
+            zstd::read_steam(tmp.path(), data);
+            test_same(orig, data);
+            // data without a dictionary must not be read with one
+            file::write(tmp.path(), zstd::compress(orig, 3));
+            expect(throws([&] { zstd::read_stream s { tmp.path(), dict }; }));
+        };
     };
 };
\ No newline at end of file
@@ -0,0 +1,88 @@
+/* This file is part of Daedalus Turbo project: https://github.com/sierkov/daedalus-turbo/
+ * Copyright (c) 2022-2023 Alex Sierkov (alex dot sierkov at gmail dot com)
+ * Copyright (c) 2024-2025 R2 Rationality OÜ (info at r2rationality dot com)
+ * This code is distributed under the license specified in:
+ * https://github.com/sierkov/daedalus-turbo/blob/main/LICENSE */
+
+extern "C" {
+#   include <zdict.h>
+};
+#include <filesystem>
+#include <dt/common/numeric-cast.hpp>
+#include <dt/zstd.hpp>
+
+namespace daedalus_turbo::zstd {
+    dictionary_ptr dictionary::train(const std::vector<buffer> &samples, const size_t max_size)
+    {
+        uint8_vector sample_data {};
+        std::vector<size_t> sample_sizes {};
+        sample_sizes.reserve(samples.size());
+        for (const auto &s: samples) {
+            sample_data << s;
+            sample_sizes.emplace_back(s.size());
+        }
+        uint8_vector dict_data(max_size);
+        const auto dict_size = ZDICT_trainFromBuffer(dict_data.data(), dict_data.size(), sample_data.data(), sample_sizes.data(), numeric_cast<unsigned>(sample_sizes.size()));
+        if (ZDICT_isError(dict_size))
+            throw error(fmt::format("failed to train a zstd dictionary from {} samples: {}", samples.size(), ZDICT_getErrorName(dict_size)));
+        dict_data.resize(dict_size);
+        return std::make_shared<const dictionary>(std::move(dict_data));
+    }
+
+    dictionary::dictionary(uint8_vector &&bytes):
+        _bytes { std::move(bytes) },
+        _id { static_cast<uint32_t>(ZDICT_getDictID(_bytes.data(), _bytes.size())) },
+        _ddict { ZSTD_createDDict(_bytes.data(), _bytes.size()) }
+    {
+        if (!_id) {
+            if (_ddict)
+                ZSTD_freeDDict(_ddict);
+            throw error("the data is not a zstd dictionary!");
+        }
+        if (!_ddict)
+            throw error(fmt::format("failed to prepare the zstd dictionary {} for decompression", _id));
+    }
+
+    dictionary::~dictionary()
+    {
+        ZSTD_freeDDict(_ddict);
+    }
+
+    dictionaries &dictionaries::get()
+    {
+        static dictionaries dicts {};
+        return dicts;
+    }
+
+    void dictionaries::add(const dictionary_ptr &dict)
+    {
+        mutex::scoped_lock lk { _mutex };
+        _dicts.try_emplace(dict->id(), dict);
+    }
+
+    dictionary_ptr dictionaries::find(const uint32_t id) const
+    {
+        mutex::scoped_lock lk { _mutex };
+        if (const auto it = _dicts.find(id); it != _dicts.end())
+            return it->second;
+        return {};
+    }
+
+    std::map<uint32_t, dictionary_ptr> dictionaries::load_dir(const std::string &dir)
+    {
+        std::map<uint32_t, dictionary_ptr> res {};
+        if (!std::filesystem::exists(dir))
+            return res;
+        for (const auto &entry: std::filesystem::directory_iterator { dir }) {
+            if (!entry.is_regular_file() || entry.path().extension() != ".zdict")
+                continue;
+            auto dict = std::make_shared<const dictionary>(file::read<uint8_vector>(entry.path().string()));
+            if (auto known = find(dict->id()); known)
+                dict = std::move(known);
+            else
+                add(dict);
+            res.try_emplace(dict->id(), std::move(dict));
+        }
+        return res;
+    }
+}
@@ -6,13 +6,72 @@
 #ifndef DAEDALUS_TURBO_ZSTD_HPP
 #define DAEDALUS_TURBO_ZSTD_HPP
 
+#include <map>
+#include <memory>
+#include <vector>
 #include <dt/common/bytes.hpp>
 #include <dt/common/file.hpp>
-#include <dt/zstd-stream.hpp>
+#include <dt/mutex.hpp>
+
+extern "C" {
+#   include <zstd.h>
+#   include <zstd_errors.h>
+};
 
 namespace daedalus_turbo::zstd {
     static constexpr size_t max_zstd_buffer = static_cast<size_t>(1) << 28;
 
+    // A trained dictionary. Compressed frames record the id of their dictionary, so the decompression finds it by id.
+    struct dictionary {
+        // the size recommended by the zstd documentation
+        static constexpr size_t default_size = 110 << 10;
+
+        static std::shared_ptr<const dictionary> train(const std::vector<buffer> &samples, size_t max_size=default_size);
+
+        explicit dictionary(uint8_vector &&bytes);
+        dictionary(const dictionary &) =delete;
+        ~dictionary();
+
+        uint32_t id() const
+        {
+            return _id;
+        }
+
+        const uint8_vector &bytes() const
+        {
+            return _bytes;
+        }
+
+        const ZSTD_DDict *ddict() const
+        {
+            return _ddict;
+        }
+    private:
+        uint8_vector _bytes;
+        uint32_t _id;
+        ZSTD_DDict *_ddict;
+    };
+    using dictionary_ptr = std::shared_ptr<const dictionary>;
+
+    // The dictionaries known to the process. Dictionaries are never removed, since the data compressed with them may still be around.
+    struct dictionaries {
+        static dictionaries &get();
+
+        void add(const dictionary_ptr &dict);
+        dictionary_ptr find(uint32_t id) const;
+        // registers the .zdict files in the directory and returns them by id
+        std::map<uint32_t, dictionary_ptr> load_dir(const std::string &dir);
+    private:
+        mutable mutex::unique_lock::mutex_type _mutex alignas(mutex::alignment) {};
+        std::map<uint32_t, dictionary_ptr> _dicts {};
+    };
+
+    // the id of the dictionary used to compress the first frame or zero
+    inline uint32_t dictionary_id(const buffer compressed)
+    {
+        return ZSTD_getDictID_fromFrame(compressed.data(), compressed.size());
+    }
+
     struct compress_context {
         explicit compress_context(): _ctx { ZSTD_createCCtx() }
         {
@@ -44,8 +103,21 @@ namespace daedalus_turbo::zstd {
             if (ZSTD_isError(res))
                 throw error(fmt::format("ZSTD: failed to change the compression level to {}: {}", level, ZSTD_getErrorName(res)));
         }
+
+        // the dictionary stays in use until replaced; an empty pointer disables it
+        void set_dictionary(const dictionary_ptr &dict)
+        {
+            if (dict == _dict)
+                return;
+            const auto res = dict ? ZSTD_CCtx_loadDictionary(_ctx, dict->bytes().data(), dict->bytes().size())
+                : ZSTD_CCtx_loadDictionary(_ctx, nullptr, 0);
+            if (ZSTD_isError(res))
+                throw error(fmt::format("ZSTD: failed to load a compression dictionary: {}", ZSTD_getErrorName(res)));
+            _dict = dict;
+        }
     private:
         ZSTD_CCtx* _ctx;
+        dictionary_ptr _dict {};
     };
 
     struct decompress_context {
@@ -72,11 +144,23 @@ namespace daedalus_turbo::zstd {
             if (ZSTD_isError(res))
                 throw error(fmt::format("ZSTD: failed to reset a compression context: {}", ZSTD_getErrorName(res)));
         }
+
+        // the dictionary stays in use until replaced; an empty pointer disables it
+        void set_dictionary(const dictionary_ptr &dict)
+        {
+            if (dict == _dict)
+                return;
+            const auto res = ZSTD_DCtx_refDDict(_ctx, dict ? dict->ddict() : nullptr);
+            if (ZSTD_isError(res))
+                throw error(fmt::format("ZSTD: failed to load a decompression dictionary: {}", ZSTD_getErrorName(res)));
+            _dict = dict;
+        }
     private:
         ZSTD_DCtx* _ctx;
+        dictionary_ptr _dict {};
     };
 
-    inline void compress(uint8_vector &compressed, const buffer &orig, const int level=22, const size_t max_buffer=max_zstd_buffer)
+    inline void compress(uint8_vector &compressed, const buffer &orig, const int level=22, const size_t max_buffer=max_zstd_buffer, const dictionary_ptr &dict={})
     {
         if (orig.size() > max_buffer)
             throw error(fmt::format("data size {} is greater than the maximum allowed: {}!", orig.size(), max_buffer));
@@ -84,6 +168,7 @@ namespace daedalus_turbo::zstd {
         thread_local compress_context ctx {};
         ctx.reset();
         ctx.set_level(level);
+        ctx.set_dictionary(dict);
         const size_t compressed_size = ZSTD_compress2(ctx.get(), compressed.data(), compressed.size(), reinterpret_cast<const void *>(orig.data()), orig.size());
         if (ZSTD_isError(compressed_size))
             throw error(fmt::format("zstd compression error: {}", ZSTD_getErrorName(compressed_size)));
@@ -128,7 +213,7 @@ namespace daedalus_turbo::zstd {
         return sz;
     }
 
-    inline uint64_t decompressed_size(const buffer compressed)
+    inline uint64_t frame_content_size(const buffer compressed)
     {
         switch (const auto sz = ZSTD_getFrameContentSize(compressed.data(), compressed.size()); sz) {
             case ZSTD_CONTENTSIZE_UNKNOWN:
@@ -140,6 +225,74 @@ namespace daedalus_turbo::zstd {
         }
     }
 
+    // the total size of all concatenated frames
+    inline uint64_t decompressed_size(const buffer compressed)
+    {
+        uint64_t sz = frame_content_size(compressed);
+        for (uint64_t pos = frame_size(compressed); pos < compressed.size(); ) {
+            const auto frame = compressed.subbuf(pos);
+            sz += frame_content_size(frame);
+            pos += frame_size(frame);
+        }
+        return sz;
+    }
+
+    struct frame_info {
+        uint64_t offset = 0; // in the decompressed data
+        uint64_t compressed_offset = 0;
+
+        constexpr static auto serialize(auto &archive, auto &self)
+        {
+            return archive(self.offset, self.compressed_offset);
+        }
+
+        bool operator==(const frame_info &o) const =default;
+    };
+    using frame_list = std::vector<frame_info>;
+
+    // the offsets of all frames in a buffer of concatenated frames
+    inline frame_list frames(const buffer compressed)
+    {
+        frame_list res {};
+        uint64_t offset = 0;
+        for (uint64_t pos = 0; pos < compressed.size(); ) {
+            const auto frame = compressed.subbuf(pos);
+            res.emplace_back(offset, pos);
+            offset += frame_content_size(frame);
+            pos += frame_size(frame);
+        }
+        return res;
+    }
+
+    // Compresses the data as a sequence of independent frames of up to frame_size bytes each,
+    // so that any range can be decompressed without the data preceding it.
+    inline frame_list compress_frames(uint8_vector &compressed, const buffer &orig, const size_t frame_size, const int level=22, const dictionary_ptr &dict={})
+    {
+        if (!frame_size)
+            throw error("the frame size must be positive!");
+        if (orig.size() > max_zstd_buffer)
+            throw error(fmt::format("data size {} is greater than the maximum allowed: {}!", orig.size(), max_zstd_buffer));
+        const size_t num_frames = std::max(static_cast<size_t>(1), (orig.size() + frame_size - 1) / frame_size);
+        compressed.resize(num_frames * ZSTD_compressBound(std::min(frame_size, orig.size())));
+        thread_local compress_context ctx {};
+        ctx.reset();
+        ctx.set_level(level);
+        ctx.set_dictionary(dict);
+        frame_list res {};
+        res.reserve(num_frames);
+        size_t compressed_size = 0;
+        for (size_t i = 0; i < num_frames; ++i) {
+            const auto part = orig.subbuf(i * frame_size, std::min(frame_size, orig.size() - i * frame_size));
+            res.emplace_back(i * frame_size, compressed_size);
+            const size_t part_size = ZSTD_compress2(ctx.get(), compressed.data() + compressed_size, compressed.size() - compressed_size, part.data(), part.size());
+            if (ZSTD_isError(part_size))
+                throw error(fmt::format("zstd compression error: {}", ZSTD_getErrorName(part_size)));
+            compressed_size += part_size;
+        }
+        compressed.resize(compressed_size);
+        return res;
+    }
+
     template<typename T>
     void decompress(T &out, const buffer &compressed)
     {
@@ -149,6 +302,14 @@ namespace daedalus_turbo::zstd {
         _check_out_size(out, orig_data_size);
         thread_local decompress_context ctx {};
         ctx.reset();
+        // the frames of a buffer share the dictionary
+        dictionary_ptr dict {};
+        if (const auto dict_id = dictionary_id(compressed); dict_id) {
+            dict = dictionaries::get().find(dict_id);
+            if (!dict)
+                throw error(fmt::format("zstd decompression error: unknown dictionary id: {}", dict_id));
+        }
+        ctx.set_dictionary(dict);
         const size_t decompressed_size = ZSTD_decompressDCtx(ctx.get(), reinterpret_cast<void *>(out.data()), out.size(), compressed.data(), compressed.size());
         if (ZSTD_isError(decompressed_size)) 
             throw error(fmt::format("zstd decompression error: {}", ZSTD_getErrorName(decompressed_size)));
@@ -170,16 +331,6 @@ namespace daedalus_turbo::zstd {
         decompress(out, compressed);
     }
 
-    template<typename T=write_vector>
-    inline void read_steam(const std::string &path, T &out)
-    {
-        zstd::read_stream f { path };
-        out.resize(f.size());
-        const auto nread = f.try_read(out);
-        if (nread != f.size()) [[unlikely]]
-            throw error(fmt::format("failed to read the advertized size {}: got only {} bytes!", out.size(), nread));
-    }
-
     template<typename T=write_vector>
     inline T read(const std::string &path)
     {
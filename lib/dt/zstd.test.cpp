@@ -38,6 +38,48 @@ suite zstd_suite = [] {
             auto decompressed = zstd::decompress(compressed);
             expect(decompressed.size() == 0_ull);
         };
+        "compress_frames"_test = [] {
+            uint8_vector orig(70000);
+            for (size_t i = 0; i < orig.size(); ++i)
+                orig[i] = static_cast<uint8_t>(i * 7 % 251);
+            uint8_vector compressed {};
+            const auto frames = zstd::compress_frames(compressed, orig, 16384, 3);
+            test_same(5, frames.size());
+            expect(frames == zstd::frames(compressed));
+            test_same(orig.size(), zstd::decompressed_size(compressed));
+            test_same(orig, zstd::decompress(compressed));
+            // each frame can be decompressed on its own
+            const auto &f = frames.at(2);
+            const auto part = zstd::decompress(static_cast<buffer>(compressed).subbuf(f.compressed_offset, frames.at(3).compressed_offset - f.compressed_offset));
+            test_same(uint8_vector { static_cast<buffer>(orig).subbuf(f.offset, 16384) }, part);
+            expect(throws([&] { zstd::compress_frames(compressed, orig, 0); }));
+        };
+        "dictionary"_test = [] {
+            std::vector<std::string> texts {};
+            for (size_t i = 0; i < 2000; ++i)
+                texts.emplace_back(fmt::format("{{\"slot\":{},\"hash\":\"{:016X}\",\"txs\":[{},{}],\"era\":\"babbage\"}}", i * 20, i * 0x9E3779B97F4A7C15ULL, i % 7, i % 13));
+            std::vector<buffer> samples {};
+            for (const auto &t: texts)
+                samples.emplace_back(t);
+            const auto dict = zstd::dictionary::train(samples, 4096);
+            expect(dict->id() != 0_ull);
+            const buffer orig { texts.at(1000) };
+            uint8_vector compressed {};
+            zstd::compress(compressed, orig, 3, zstd::max_zstd_buffer, dict);
+            test_same(dict->id(), zstd::dictionary_id(compressed));
+            expect(compressed.size() < zstd::compress(orig, 3).size());
+            // the dictionary must be known to decompress the data
+            expect(throws([&] { zstd::decompress(compressed); }));
+            zstd::dictionaries::get().add(dict);
+            test_same(uint8_vector { orig }, zstd::decompress(compressed));
+            // the thread's context must not reuse the dictionary for data without one
+            test_same(uint8_vector { orig }, zstd::decompress(zstd::compress(orig, 3)));
+            file::tmp_directory tmp_dir { "zstd-dictionary" };
+            file::write(fmt::format("{}/{}.zdict", tmp_dir.path(), dict->id()), dict->bytes());
+            const auto loaded = zstd::dictionaries::get().load_dir(tmp_dir.path());
+            test_same(1, loaded.size());
+            expect(loaded.at(dict->id()) == dict);
+        };
         "file compress/decompress"_test = [] {
             auto raw = file::read("./data/immutable/04309.chunk");
             auto compressed = zstd::compress(raw, 1);